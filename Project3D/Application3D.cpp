@@ -6,6 +6,11 @@
 #include <iostream>
 #include "imgui.h"
 #include "Scene.h"
+#include "Benchmarks.h"
+#include "GLState.h"
+#include "TextureCache.h"
+#include "JobSystem.h"
+#include "gl_core_4_4.h"
 
 using glm::vec3;
 using glm::vec4;
@@ -21,23 +26,40 @@ Application3D::~Application3D() {
 }
 
 /// <summary>
-/// startup() contains all of the scene initialisation logic for filling the scene with objects, loading their
-/// meshes, loading the member shaders, as well as populating the scene with a directional light and some 
-/// point lights.
+/// hasLoaded() checks whether a mesh load has finished successfully, without waiting for it. Unlike the mesh's own
+/// isLoaded(), the load's future is safe to check from update() while the render thread is uploading the mesh.
 /// </summary>
-/// <returns>True if successful, false if a mesh/shader fails loading or linking.</returns>
+/// <param name="load">The future returned when the mesh was queued to load.</param>
+/// <returns>True if the mesh has loaded and been uploaded.</returns>
+static bool hasLoaded(const std::shared_future<bool>& load)
+{
+	return load.valid() && load.wait_for(std::chrono::seconds(0)) == std::future_status::ready && load.get();
+}
+
+/// <summary>
+/// startup() contains all of the scene initialisation logic for filling the scene with objects, queueing their
+/// meshes to load in the background, loading the member shaders, as well as populating the scene with a directional
+/// light and some point lights. Objects are drawn as placeholder boxes until their meshes have loaded.
+/// </summary>
+/// <returns>True if successful, false if the placeholder mesh or a shader fails loading or linking.</returns>
 bool Application3D::startup() {
 	
 	// Set the background colour to grey and initialise gizmo primitive counts
 	setBackgroundColour(0.25f, 0.25f, 0.25f);
 	Gizmos::create(10000, 10000, 10000, 10000);
 
-	// Attempt to initialise the render target member, exit early if failed
-	if (m_renderTarget.initialise(1, getWindowWidth(), getWindowHeight()) == false) 
+	// Attempt to initialise the render target member with a depth texture, so GPU culling can build it's depth pyramid from it, exit early if failed
+	if (m_renderTarget.initialise(1, getWindowWidth(), getWindowHeight(), true) == false) 
 	{
 		printf("Render Target Error!\n");
 		return false;
 	}
+	// Attempt to initialise the G-buffer with a depth texture, so the deferred lighting pass can rebuild positions from it
+	if (m_gBuffer.initialise(m_gBufferTargetCount, getWindowWidth(), getWindowHeight(), true) == false)
+	{
+		printf("G-Buffer Error!\n");
+		return false;
+	}
 
 	// Initialise the main directional light and ambient scene lighting
 	m_light.colour = { 1.0f, 1.0f, 1.0f };
@@ -46,6 +68,8 @@ bool Application3D::startup() {
 
 	// Initialise the main scene with a camera above the scene looking down at it, and pass the main directional light and ambient light as references
 	m_mainScene = new Scene(new Camera(-90.0f, -40.0f, { 0, 10, 10 }), vec2(getWindowWidth(), getWindowHeight()), &m_light, m_ambientLight);
+	m_mainScene->setGBufferShader(&m_simpleShader, &m_gBufferSimpleShader);
+	m_mainScene->setGBufferShader(&m_phongShader, &m_gBufferPhongShader);
 	// Add two point lights to the main scene
 	m_mainScene->getPointLights().push_back(Light(vec3(5, 3, 0), vec3(1, 0, 0), 50));
 	m_mainScene->getPointLights().push_back(Light(vec3(-5, 3, 0), vec3(0, 1, 0), 50));
@@ -57,6 +81,19 @@ bool Application3D::startup() {
 	m_phongShader.loadShader(aie::eShaderStage::FRAGMENT, "./shaders/phong.frag");
 	m_postShader.loadShader(aie::eShaderStage::VERTEX, "./shaders/post.vert");
 	m_postShader.loadShader(aie::eShaderStage::FRAGMENT, "./shaders/post.frag");
+	// The G-buffer shaders share the forward vertex stages, and the deferred lighting pass is drawn over the fullscreen quad like post processing
+	m_gBufferSimpleShader.loadShader(aie::eShaderStage::VERTEX, "./shaders/simple.vert");
+	m_gBufferSimpleShader.loadShader(aie::eShaderStage::FRAGMENT, "./shaders/gbuffer_simple.frag");
+	m_gBufferPhongShader.loadShader(aie::eShaderStage::VERTEX, "./shaders/phong.vert");
+	m_gBufferPhongShader.loadShader(aie::eShaderStage::FRAGMENT, "./shaders/gbuffer_phong.frag");
+	m_deferredShader.loadShader(aie::eShaderStage::VERTEX, "./shaders/post.vert");
+	m_deferredShader.loadShader(aie::eShaderStage::FRAGMENT, "./shaders/deferred.frag");
+	m_shadowShader.loadShader(aie::eShaderStage::VERTEX, "./shaders/shadow.vert");
+	m_shadowShader.loadShader(aie::eShaderStage::FRAGMENT, "./shaders/shadow.frag");
+	m_occlusionBoxShader.loadShader(aie::eShaderStage::VERTEX, "./shaders/occlusion_box.vert");
+	m_occlusionBoxShader.loadShader(aie::eShaderStage::FRAGMENT, "./shaders/occlusion_box.frag");
+	m_gpuCullShader.loadShader(aie::eShaderStage::COMPUTE, "./shaders/gpu_cull.comp");
+	m_depthPyramidShader.loadShader(aie::eShaderStage::COMPUTE, "./shaders/depth_pyramid.comp");
 	// Attempt to link each shader into it's own program, exit early if failed
 	if (m_simpleShader.link() == false)
 	{
@@ -70,25 +107,81 @@ bool Application3D::startup() {
 	{
 		printf("Post Shader Error: %s\n", m_postShader.getLastError());
 		return false;
+	}if (m_gBufferSimpleShader.link() == false)
+	{
+		printf("G-Buffer Simple Shader Error: %s\n", m_gBufferSimpleShader.getLastError());
+		return false;
+	}if (m_gBufferPhongShader.link() == false)
+	{
+		printf("G-Buffer Phong Shader Error: %s\n", m_gBufferPhongShader.getLastError());
+		return false;
+	}if (m_deferredShader.link() == false)
+	{
+		printf("Deferred Shader Error: %s\n", m_deferredShader.getLastError());
+		return false;
+	}if (m_shadowShader.link() == false)
+	{
+		printf("Shadow Shader Error: %s\n", m_shadowShader.getLastError());
+		return false;
+	}if (m_occlusionBoxShader.link() == false)
+	{
+		printf("Occlusion Box Shader Error: %s\n", m_occlusionBoxShader.getLastError());
+		return false;
+	}if (m_gpuCullShader.link() == false)
+	{
+		printf("GPU Cull Shader Error: %s\n", m_gpuCullShader.getLastError());
+		return false;
+	}if (m_depthPyramidShader.link() == false)
+	{
+		printf("Depth Pyramid Shader Error: %s\n", m_depthPyramidShader.getLastError());
+		return false;
 	}
 
-	// Attempt to load the bunny obj in and add an instance of it to the scene
-	if (m_bunnyMesh.load("./stanford/bunny.obj", true, true) == false)
+	// Attempt to create the sun's shadow cascades, exit early if failed
+	if (m_mainScene->enableShadows(&m_shadowShader) == false)
 	{
-		printf("Bunny Mesh Error!\n");
+		printf("Shadow Map Error!\n");
 		return false;
 	}
-	m_mainScene->AddObjectInstance(new ObjectInstance(&m_simpleShader, &m_bunnyMesh, vec3(8, 0, 8), vec3(0), vec3(0.2f)));
-	
-	// Attempt to load the spear obj in and add 11 instances of it to the scene along a diagonal line
-	if (m_spearMesh.load("./soulspear/soulspear.obj", true, true) == false)
+	m_mainScene->enableOcclusionQueries(&m_occlusionBoxShader);
+	// GPU culling is optional, the camera's instances are culled on the CPU if the GL can't run the compute programs
+	if (m_mainScene->enableGPUCulling(&m_gpuCullShader, &m_depthPyramidShader) == false)
+		printf("GPU culling unavailable, too few compute storage blocks\n");
+
+	// Look up the post shader's per-frame uniform once, and point it's render texture sampler at texture slot 0 (where the render target is bound)
+	m_selectedPostProcessorUniform = m_postShader.getUniform("selectedPostProcessor");
+	m_postShader.bind();
+	m_postShader.bindUniform("renderTexture", 0);
+	// Point the deferred shader's samplers at the texture slots the G-buffer targets are bound to, with depth after the colour targets
+	m_deferredShader.bind();
+	m_deferredShader.bindUniform("albedoTexture", 0);
+	m_deferredShader.bindUniform("normalTexture", 1);
+	m_deferredShader.bindUniform("specularTexture", 2);
+	m_deferredShader.bindUniform("ambientTexture", 3);
+	m_deferredShader.bindUniform("depthTexture", (int)m_gBufferTargetCount);
+
+	// Load the placeholder box straight away, so there is something to draw while the other meshes load
+	if (m_placeholderMesh.load("./placeholder/box.obj") == false)
 	{
-		printf("Spear Mesh Error!\n");
+		printf("Placeholder Mesh Error!\n");
 		return false;
 	}
+	m_mainScene->setPlaceholderMesh(&m_placeholderMesh);
+
+	// Queue the bunny obj to load (with a chain of simplified LODs, as the scan is far denser than it ever needs
+	// to be on screen) and add an instance of it to the scene. Both meshes are also reordered for the post-transform
+	// vertex cache, overdraw and vertex fetch, and packed into compressed vertices, before they're uploaded
+	OBJMesh::LodSettings lodSettings;
+	m_bunnyLoad = m_assetLoader.loadMesh(&m_bunnyMesh, "./stanford/bunny.obj", true, true, &lodSettings, true, true);
+	// The bunny is the largest solid object in the scene, so is made an occluder to hide the spears behind it when occlusion culling is on
+	ObjectInstance bunny = m_mainScene->AddObjectInstance(&m_simpleShader, &m_bunnyMesh, ObjectInstance::makeTransform(vec3(8, 0, 8), vec3(0), vec3(0.2f)));
+	bunny.setOccluder(true);
+	
+	// Queue the spear obj to load and add 11 instances of it to the scene along a diagonal line
+	m_spearLoad = m_assetLoader.loadMesh(&m_spearMesh, "./soulspear/soulspear.obj", true, true, &lodSettings, true, true);
 	for (int i = -5; i <= 5; i++)
 	{
-		m_mainScene->AddObjectInstance(new ObjectInstance(&m_phongShader, &m_spearMesh, vec3(i, 0, i), vec3(0, 0, 0)));
+		m_mainScene->AddObjectInstance(&m_phongShader, &m_spearMesh, ObjectInstance::makeTransform(vec3(i, 0, i)));
 	}
 	
 	// Initialise the fullscreen quad for post processing
@@ -98,26 +191,45 @@ bool Application3D::startup() {
 }
 
 /// <summary>
-/// shutdown() is called when the user presses escape during the update() sequence, and simply calls
-/// destroy on the Gizmo class and then deletes the mainScene member.
+/// shutdown() is called when the user presses escape during the update() sequence, and stops the asset
+/// loader (whose jobs run on the job system, which shuts down with the window), calls destroy on the
+/// Gizmo class and then deletes the mainScene member, followed by the geometry arena's buffers. The meshes are
+/// only destroyed with the application, and releasing their geometry once the arena is gone does nothing.
 /// </summary>
 void Application3D::shutdown() {
 
+	m_assetLoader.stop();
 	Gizmos::destroy();
 	delete m_mainScene;
+	GeometryArena::destroy();
 }
 
 /// <summary>
-/// update() is called by the Application base class' update loop. The function first calls
-/// update on the member scene, which essentially just checks for any user input in updating the
-/// camera position, and will then use the AIE::Gizmos class to draw a flat 10x10 cartesian grid 
+/// update() is called by the Application base class' update loop. The function first quits if either of the
+/// scene's meshes failed to load, and then calls update on the member scene, which essentially just
+/// checks for any user input in updating the camera position, and will then use the AIE::Gizmos class to draw a flat 10x10 cartesian grid 
 /// across the y = 0 plane. The function then makes use of the ImGui library to display all of the
-/// UI required for the scene (controls, as well as interactable post processor and light settings).
-/// Finally, update() checks for any user input attempting to close the application, and will call
-/// Application::quit() if found.
+/// UI required for the scene (controls, as well as interactable post processor and light settings), with the render
+/// stats of the last frame drawn with this frame's packet. Finally, update() checks for any user input attempting to
+/// close the application, and will call Application::quit() if found, and fills the frame's packet for draw().
 /// </summary>
 void Application3D::update(float deltaTime) 
 {
+	ScenePacket* packet = (ScenePacket*)getUpdatePacket();
+	const RenderStats& stats = packet->stats;
+
+	// Give up as startup used to if a mesh couldn't be loaded
+	if (m_bunnyLoad.valid() && m_bunnyLoad.wait_for(std::chrono::seconds(0)) == std::future_status::ready && m_bunnyLoad.get() == false)
+	{
+		printf("Bunny Mesh Error!\n");
+		quit();
+	}
+	if (m_spearLoad.valid() && m_spearLoad.wait_for(std::chrono::seconds(0)) == std::future_status::ready && m_spearLoad.get() == false)
+	{
+		printf("Spear Mesh Error!\n");
+		quit();
+	}
+
 	// Trigger the update sequence on the main scene
 	m_mainScene->update(deltaTime, getTime());
 	// Update the scene's window size incase it has changed
@@ -149,6 +261,13 @@ void Application3D::update(float deltaTime)
 	// Create a GUI panel for selecting the post processing effect to use, and the direction and colour of the sunlight in the scene
 	ImGui::Begin("Main Graphics Settings");
 	ImGui::Combo("Post Processor Effect", &m_selectedPostProcessor, m_postProcessors, m_postProcessorsCount, -1);
+	ImGui::Checkbox("Deferred Shading", &m_deferredShading);
+	ImGui::Checkbox("Occlusion Culling", m_mainScene->getOcclusionCulling());
+	ImGui::Checkbox("GPU Occlusion Queries", m_mainScene->getQueryCulling());
+	ImGui::Checkbox("Multi-Draw Indirect", m_mainScene->getMultiDrawIndirect());
+	if (m_mainScene->canGPUCull())
+		ImGui::Checkbox("GPU Culling", m_mainScene->getGPUCulling());
+	ImGui::SliderFloat("LOD Pixel Error", m_mainScene->getLodPixelError(), 0.0f, 8.0f);
 	ImGui::DragFloat3("Sunlight Direction", &m_light.direction[0], 0.1f, -1.0f, 1.0f);
 	ImGui::DragFloat3("Sunlight Colour", &m_light.colour[0], 0.1f, 0.0f, 2.0f);
 	ImGui::End();
@@ -162,41 +281,254 @@ void Application3D::update(float deltaTime)
 	ImGui::DragFloat3("Colour", &pointLights[m_selectedPointLight].colour[0], 0.1f, 0.0f, 2.0f);
 	ImGui::End();
 
+	// Create a GUI panel displaying how much work the scene submitted to the GPU in the last frame drawn with this packet
+	ImGui::Begin("Render Stats");
+	ImGui::Text("FPS: %i", getFPS());
+	ImGui::Text("Update / draw: %.2f / %.2f ms (%s)", getUpdateMilliseconds(), packet->drawMilliseconds, hasRenderThread() ? "render thread" : "single thread");
+	ImGui::Text("Instance batches: %i", stats.batchCount);
+	ImGui::Text("Draw calls: %i (%i chunk draws)", stats.drawCallCount, stats.chunkDrawCount);
+	ImGui::Text("Geometry arena: %.1f / %.1f MB in %u pools", stats.geometryStats.allocatedBytes / (1024.0f * 1024.0f),
+		stats.geometryStats.capacityBytes / (1024.0f * 1024.0f), stats.geometryStats.poolCount);
+	const aie::FrameArena& frameArena = getFrameArena();
+	ImGui::Text("Frame arena last frame / high water: %.1f / %.1f KB (%u heap allocations)", frameArena.getLastFrameUsed() / 1024.0f,
+		frameArena.getHighWater() / 1024.0f, frameArena.getHeapAllocations());
+	if (hasRenderThread())
+		ImGui::Text("Render thread arena last frame / high water: %.1f / %.1f KB", packet->drawArenaUsed / 1024.0f, packet->drawArenaHighWater / 1024.0f);
+	ImGui::Text("Instances drawn / culled: %i / %i", stats.instancesDrawn, stats.instancesCulled);
+	ImGui::Text("Chunks drawn / culled: %i / %i", stats.chunksDrawn, stats.chunksCulled);
+	ImGui::Text("Triangles drawn: %lld", stats.trianglesDrawn);
+	ImGui::Text("Assets loading: %u (last upload %.2f ms, %u chunks / textures)", stats.assetsLoading, stats.lastUploadMilliseconds, stats.lastUploadCount);
+	TextureCache::Stats textureStats = TextureCache::getStats();
+	ImGui::Text("Textures resident: %u, %.1f MB (cache hits / misses: %u / %u)", textureStats.residentCount,
+		textureStats.residentBytes / (1024.0f * 1024.0f), textureStats.hits, textureStats.misses);
+	// The meshes are being written by the loader's jobs until they have loaded, so their stats are only shown after
+	if (hasLoaded(m_bunnyLoad))
+	{
+		const MeshOptimizer::CacheStats& bunnyBefore = m_bunnyMesh.getCacheStatsBefore();
+		const MeshOptimizer::CacheStats& bunnyAfter = m_bunnyMesh.getCacheStatsAfter();
+		ImGui::Text("Bunny ACMR / ATVR before: %.3f / %.3f, after: %.3f / %.3f", bunnyBefore.getACMR(), bunnyBefore.getATVR(),
+			bunnyAfter.getACMR(), bunnyAfter.getATVR());
+		ImGui::Text("Bunny vertex / index memory: %.1f / %.1f KB", m_bunnyMesh.getVertexBufferSize() / 1024.0f, m_bunnyMesh.getIndexBufferSize() / 1024.0f);
+		ImGui::Text("Bunny load: %.1f ms (%s)", m_bunnyMesh.getLoadMilliseconds(), m_bunnyMesh.wasLoadedFromCache() ? "cached" : "parsed");
+	}
+	if (hasLoaded(m_spearLoad))
+	{
+		const MeshOptimizer::CacheStats& spearBefore = m_spearMesh.getCacheStatsBefore();
+		const MeshOptimizer::CacheStats& spearAfter = m_spearMesh.getCacheStatsAfter();
+		ImGui::Text("Spear ACMR / ATVR before: %.3f / %.3f, after: %.3f / %.3f", spearBefore.getACMR(), spearBefore.getATVR(),
+			spearAfter.getACMR(), spearAfter.getATVR());
+		ImGui::Text("Spear vertex / index memory: %.1f / %.1f KB", m_spearMesh.getVertexBufferSize() / 1024.0f, m_spearMesh.getIndexBufferSize() / 1024.0f);
+		ImGui::Text("Spear load: %.1f ms (%s)", m_spearMesh.getLoadMilliseconds(), m_spearMesh.wasLoadedFromCache() ? "cached" : "parsed");
+	}
+	if (*m_mainScene->getOcclusionCulling() && *m_mainScene->getGPUCulling() == false)
+	{
+		ImGui::Text("Instances occluded: %i", stats.instancesOccluded);
+		ImGui::Text("Occluder raster: %.3f ms (%u occluders, %u triangles)", stats.occluderRasterMilliseconds, stats.occluderCount, stats.occluderTriangleCount);
+	}
+	if (*m_mainScene->getGPUCulling())
+		ImGui::Text("Instances occluded by the depth pyramid: %i", stats.instancesOccluded);
+	else if (*m_mainScene->getQueryCulling())
+	{
+		ImGui::Text("Instances skipped by queries: %i", stats.instancesQueryCulled);
+		ImGui::Text("Occlusion queries issued / pending: %i / %i", stats.queriesIssued, stats.queriesPending);
+	}
+	ImGui::Text("Program switches unsorted / sorted: %i / %i", stats.submittedSwitches.programs, stats.sortedSwitches.programs);
+	ImGui::Text("Material switches unsorted / sorted: %i / %i", stats.submittedSwitches.materials, stats.sortedSwitches.materials);
+	ImGui::Text("VAO switches unsorted / sorted: %i / %i", stats.submittedSwitches.vertexArrays, stats.sortedSwitches.vertexArrays);
+	ImGui::Text("GL binds issued / skipped: %u / %u", stats.glCounters.issued, stats.glCounters.skipped);
+	ImGui::Text("Point lights visible / total: %u / %i", stats.visibleLightCount, m_mainScene->getNumLights());
+	ImGui::Text("Occupied light clusters: %u / %u", stats.occupiedClusterCount, LightClusterGrid::CLUSTER_COUNT);
+	ImGui::Text("Max lights per cluster: %u", stats.maxClusterLightCount);
+	ImGui::Text("Shadow cascades refitted / re-rendered: %u / %u of %u", stats.cascadesRefitted, stats.cascadesRendered, ShadowCascades::CASCADE_COUNT);
+	ImGui::End();
+
+	// Create a GUI panel for triggering the engine microbenchmarks, the results of the last one run are displayed underneath
+	ImGui::Begin("Benchmarks");
+	if (ImGui::Button("Instance Store (100k instances)"))
+		m_benchmarkResults = Benchmarks::runInstanceStore(100000);
+	if (ImGui::Button("Light Clustering (4 - 1024 lights)"))
+		m_benchmarkResults = Benchmarks::runLightClustering();
+	if (ImGui::Button("Mesh Cache (soulspear cold / warm)") && m_meshCacheBenchmark.valid() == false)
+	{
+		// Every load uploads the mesh, so the benchmark is run as a job on the thread with the GL context (the render thread if there is one)
+		auto benchmark = std::make_shared<std::packaged_task<std::string()>>([]()
+		{
+			OBJMesh::LodSettings lodSettings;
+			return Benchmarks::runMeshCache("./soulspear/soulspear.obj", &lodSettings, true, true);
+		});
+		m_meshCacheBenchmark = benchmark->get_future();
+		aie::JobSystem::getInstance()->runOnMainThread([benchmark]() { (*benchmark)(); });
+	}
+	if (m_meshCacheBenchmark.valid() && m_meshCacheBenchmark.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		m_benchmarkResults = m_meshCacheBenchmark.get();
+	if (ImGui::Button("Obj Parser (soulspear, 10M triangle grid)"))
+		m_benchmarkResults = Benchmarks::runObjParser("./soulspear/soulspear.obj", 10000000);
+	if (ImGui::Button("Job System (1M vertex tangents, 1M transforms)"))
+		m_benchmarkResults = Benchmarks::runJobSystem(1000000, 1000000);
+	ImGui::Text("Scene point lights:");
+	for (unsigned int count : { 4, 64, 256, 1024 })
+	{
+		ImGui::SameLine();
+		if (ImGui::Button(std::to_string(count).c_str()))
+			setPointLightCount(count);
+	}
+	ImGui::TextWrapped("%s", m_benchmarkResults.c_str());
+	ImGui::End();
+
 	// Quit the application if the user has pressed escape this frame
 	aie::Input* input = aie::Input::getInstance();
 	if (input->isKeyDown(aie::INPUT_KEY_ESCAPE))
 		quit();
+
+	// Add the point light gizmos now the lights have been edited, and hand everything the frame is drawn from to draw()
+	m_mainScene->addGizmos();
+	m_mainScene->captureFrame(packet->scene);
+	if (hasRenderThread())
+		Gizmos::capture(packet->gizmos);
+	packet->deferredShading = m_deferredShading;
+	packet->selectedPostProcessor = m_selectedPostProcessor;
 }
 
 /// <summary>
-/// draw() is called by the Application base class' update loop. The function first binds the member
-/// m_renderTarget for use so whatever is drawn gets drawn to the frame buffer, and then calls draw on 
-/// the member scene of the application, which iterates through and draws all ObjectInstance's managed
-/// by the scene. The function will then bind the post processing shader for use (as well as it's uniforms),
-/// and then finally call draw on the m_fullscreenQuad member, which effectively redraws the screen using the
-/// initial scene drawing as a texture, allowing for post processing effects. 
+/// draw() is called by the Application base class' update loop (on the render thread if there is one) and
+/// draws the frame held in the draw packet. The function first uploads whatever has loaded in the background
+/// within this frame's budget and brings the sun's shadow cascades up to date, then draws the scene into the
+/// member m_renderTarget, either forward shaded or through the member m_gBuffer when deferred shading is ticked.
+/// The render target's depth is reduced into the depth pyramid for the next frame's GPU cull before the gizmos
+/// are drawn. The function will then bind the post processing shader for use (as well as it's uniforms), and
+/// call draw on the m_fullscreenQuad member, which redraws the screen using the scene drawing as a texture,
+/// allowing for post processing effects. Finally, the frame's statistics are written back into the packet.
 /// </summary>
 void Application3D::draw() {
 
-	// Bind the render target for use
-	m_renderTarget.bind();
-	// wipe the screen to the background colour
-	clearScreen();
-	// draw all object instances in the scene
-	m_mainScene->draw();
-	// Draw the scene gizmos (the grid and the point lights if ticked to draw)
-	Gizmos::draw(m_mainScene->getCamera()->getProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_mainScene->getCamera()->getViewMatrix());
+	ScenePacket* packet = (ScenePacket*)getDrawPacket();
+
+	// Upload whatever has finished loading in the background
+	m_assetLoader.update(m_uploadBudgetMilliseconds);
+
+	// Bring the sun's shadow cascades up to date before anything samples them
+	m_mainScene->drawShadows(packet->scene);
+
+	if (packet->deferredShading)
+	{
+		// Draw the opaque object instances' surface properties into the G-buffer
+		m_gBuffer.bind();
+		clearScreen();
+		m_mainScene->drawGBuffer(packet->scene);
+
+		// Light every covered pixel of the G-buffer once into the render target, without touching it's depth
+		m_renderTarget.bind();
+		clearScreen();
+		m_deferredShader.bind();
+		for (unsigned int i = 0; i < m_gBufferTargetCount; i++)
+			m_gBuffer.getTarget(i).bind(i);
+		m_gBuffer.bindDepthTarget(m_gBufferTargetCount);
+		glDepthMask(GL_FALSE);
+		m_fullscreenQuad.draw();
+		glDepthMask(GL_TRUE);
+
+		// Copy the G-buffer depth across so the transparent object instances are hidden behind the opaque ones, then forward shade them on top
+		m_gBuffer.blitDepth(m_renderTarget);
+		m_mainScene->drawTransparent();
+	}
+	else
+	{
+		// Bind the render target for use
+		m_renderTarget.bind();
+		// wipe the screen to the background colour
+		clearScreen();
+		// draw all object instances in the scene
+		m_mainScene->draw(packet->scene);
+	}
+	// Build the next frame's depth pyramid from the scene's depth alone
+	m_mainScene->buildDepthPyramid(m_renderTarget);
+	// Draw the scene gizmos (the grid and the point lights if ticked to draw), from the packet's copy if update() is already adding the next frame's
+	mat4 projectionView = packet->scene.projection * packet->scene.view;
+	if (hasRenderThread())
+		Gizmos::draw(packet->gizmos, projectionView);
+	else
+		Gizmos::draw(projectionView);
 	// Unbind the render target and clear the backbuffer
 	m_renderTarget.unbind();
 	clearScreen();
 
 	// Now we bind the post processing shader and uniforms to redraw the scene for post processing
 	m_postShader.bind();
-	m_postShader.bindUniform("Time", getTime());
-	m_postShader.bindUniform("selectedPostProcessor", m_selectedPostProcessor); // Dictates which processing function is called in post.frag
-	m_postShader.bindUniform("renderTexture", 0);
+	m_postShader.bindUniform(m_selectedPostProcessorUniform, packet->selectedPostProcessor); // Dictates which processing function is called in post.frag
 	m_renderTarget.getTarget(0).bind(0); // Bind the renderTarget to the 0th texture slot for the uniform
 
 	// Draw the fullscreen quad now that we have the initial scene drawing in the renderTexture uniform
 	m_fullscreenQuad.draw();
+
+	gatherRenderStats(packet->stats);
+}
+
+/// <summary>
+/// createFramePacket() is called by the Application base class to create the packets update() hands to draw().
+/// </summary>
+/// <returns>A new, empty ScenePacket.</returns>
+aie::FramePacket* Application3D::createFramePacket()
+{
+	return new ScenePacket();
+}
+
+/// <summary>
+/// gatherRenderStats() copies the statistics of the frame draw() has just drawn out of the main scene, it's occlusion
+/// buffer, light clusters and shadow cascades, the GL state shadow, the asset loader and the geometry arena. They are gathered on the
+/// thread that drew the frame, as the scene keeps changing them while the next frame is drawn.
+/// </summary>
+/// <param name="stats">The render stats to fill.</param>
+void Application3D::gatherRenderStats(RenderStats& stats)
+{
+	stats.batchCount = m_mainScene->getBatchCount();
+	stats.drawCallCount = m_mainScene->getDrawCallCount();
+	stats.chunkDrawCount = m_mainScene->getChunkDrawCount();
+	stats.instancesDrawn = m_mainScene->getInstancesDrawn();
+	stats.instancesCulled = m_mainScene->getInstancesCulled();
+	stats.chunksDrawn = m_mainScene->getChunksDrawn();
+	stats.chunksCulled = m_mainScene->getChunksCulled();
+	stats.trianglesDrawn = m_mainScene->getTrianglesDrawn();
+
+	const OcclusionBuffer& occlusionBuffer = m_mainScene->getOcclusionBuffer();
+	stats.instancesOccluded = m_mainScene->getInstancesOccluded();
+	stats.occluderRasterMilliseconds = occlusionBuffer.getRasterMilliseconds();
+	stats.occluderCount = occlusionBuffer.getOccluderCount();
+	stats.occluderTriangleCount = occlusionBuffer.getTriangleCount();
+	stats.instancesQueryCulled = m_mainScene->getInstancesQueryCulled();
+	stats.queriesIssued = m_mainScene->getQueriesIssued();
+	stats.queriesPending = m_mainScene->getQueriesPending();
+
+	stats.submittedSwitches = m_mainScene->getSubmittedSwitches();
+	stats.sortedSwitches = m_mainScene->getSortedSwitches();
+	stats.glCounters = aie::GLState::getLastFrameCounters();
+
+	const LightClusterGrid& lightClusters = m_mainScene->getLightClusters();
+	stats.visibleLightCount = lightClusters.getLightCount();
+	stats.occupiedClusterCount = lightClusters.getOccupiedClusterCount();
+	stats.maxClusterLightCount = lightClusters.getMaxClusterLightCount();
+	const ShadowCascades& shadowCascades = m_mainScene->getShadowCascades();
+	stats.cascadesRefitted = shadowCascades.getRefitCount();
+	stats.cascadesRendered = shadowCascades.getRenderCount();
+
+	stats.assetsLoading = m_assetLoader.getPendingCount();
+	stats.lastUploadMilliseconds = m_assetLoader.getLastUploadMilliseconds();
+	stats.lastUploadCount = m_assetLoader.getLastUploadCount();
+	stats.geometryStats = aie::GeometryArena::getStats();
+}
+
+/// <summary>
+/// setPointLightCount() resizes the main scene's point lights to count, keeping the editable point lights at the
+/// front and filling the rest with randomly placed and coloured lights scattered over the grid. The extra lights
+/// have small intensities, so each only reaches a few of the scene's light clusters.
+/// </summary>
+/// <param name="count">Total number of point lights the scene should have.</param>
+void Application3D::setPointLightCount(unsigned int count)
+{
+	std::vector<Light>& pointLights = m_mainScene->getPointLights();
+	pointLights.resize(m_pointLightCount);
+	for (unsigned int i = m_pointLightCount; i < count; i++)
+	{
+		vec3 position = glm::linearRand(vec3(-10, 0.5f, -10), vec3(10, 4, 10));
+		pointLights.push_back(Light(position, glm::linearRand(vec3(0), vec3(1)), glm::linearRand(0.5f, 1.5f)));
+	}
 }
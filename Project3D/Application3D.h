@@ -7,6 +7,12 @@
 #include "OBJMesh.h"
 #include "ObjectInstance.h"
 #include "RenderTarget.h"
+#include "AssetLoader.h"
+#include "Scene.h"
+#include "Gizmos.h"
+#include "GLState.h"
+#include <future>
+#include <string>
 
 using namespace glm;
 using namespace aie;
@@ -19,7 +25,8 @@ using namespace aie;
 /// the application's UI used for manipulating the scene in it's update loop (i.e. changing post processors, editing point 
 /// light positions and colours). The Application base class runs an update loop that triggers the update and draw functions
 /// every frame, which are used to trigger the same functions in the m_mainScene member variable, which in turn update and
-/// draw all relevent scene objects and components.
+/// draw all relevent scene objects and components. Everything draw() needs from update() is handed over in a ScenePacket,
+/// so the application can also be run with draw() on a render thread, a frame behind update().
 /// </summary>
 class Application3D : public aie::Application {
 public:
@@ -34,22 +41,96 @@ public:
 
 protected:
 
+	/// <summary>
+	/// RenderStats are the statistics of drawing a frame shown in the Render Stats panel, gathered by draw() on the
+	/// thread that drew the frame and read by update() once the packet they were written to comes back round to it.
+	/// </summary>
+	struct RenderStats
+	{
+		int batchCount = 0;
+		int drawCallCount = 0;
+		int chunkDrawCount = 0;
+		int instancesDrawn = 0;
+		int instancesCulled = 0;
+		int chunksDrawn = 0;
+		int chunksCulled = 0;
+		long long trianglesDrawn = 0;
+		int instancesOccluded = 0;
+		float occluderRasterMilliseconds = 0;
+		unsigned int occluderCount = 0;
+		unsigned int occluderTriangleCount = 0;
+		int instancesQueryCulled = 0;
+		int queriesIssued = 0;
+		int queriesPending = 0;
+		RenderQueue::SwitchCounts submittedSwitches;
+		RenderQueue::SwitchCounts sortedSwitches;
+		aie::GLState::Counters glCounters;
+		unsigned int visibleLightCount = 0;
+		unsigned int occupiedClusterCount = 0;
+		unsigned int maxClusterLightCount = 0;
+		unsigned int cascadesRefitted = 0;
+		unsigned int cascadesRendered = 0;
+		unsigned int assetsLoading = 0;
+		float lastUploadMilliseconds = 0;
+		unsigned int lastUploadCount = 0;
+		aie::GeometryArena::Stats geometryStats;
+	};
+
+	/// <summary>
+	/// A ScenePacket is everything draw() reads that update() changes: the scene's frame state, the gizmos (only copied
+	/// while drawing on a render thread, otherwise the live gizmos are drawn) and the settings chosen in the ImGui UI.
+	/// draw() writes the frame's render stats back into it.
+	/// </summary>
+	struct ScenePacket : public aie::FramePacket
+	{
+		Scene::FrameState scene;
+		aie::Gizmos::Frame gizmos;
+		bool deferredShading = false;
+		int selectedPostProcessor = 0;
+		RenderStats stats;
+	};
+
+	virtual aie::FramePacket* createFramePacket();
+
+	void gatherRenderStats(RenderStats& stats); // Copies the statistics of the frame just drawn out of the scene and asset loader
+
+	void setPointLightCount(unsigned int count); // Keeps the editable point lights and fills the rest of the scene with random ones
+
 	// Reference to the main scene that encompasses the entire demonstration
 	Scene* m_mainScene;
 	
 	// Model meshes used in the scene
 	OBJMesh m_bunnyMesh;
 	OBJMesh m_spearMesh;
+	OBJMesh m_placeholderMesh; // drawn in place of the other meshes while they load
+
+	// Loads the model meshes in the background, declared after them so it's jobs finish before the meshes are destroyed
+	static constexpr float m_uploadBudgetMilliseconds = 2.0f; // Time spent uploading loaded meshes to the GPU each frame
+	AssetLoader m_assetLoader;
+	std::shared_future<bool> m_bunnyLoad;
+	std::shared_future<bool> m_spearLoad;
 
 	// Shader's used in application
 	ShaderProgram m_simpleShader; // used for bunny object
 	ShaderProgram m_phongShader; // used for spear objects
 	ShaderProgram m_postShader; // used during post processing pass
+	ShaderProgram m_gBufferSimpleShader; // used for the bunny object when filling the G-buffer
+	ShaderProgram m_gBufferPhongShader; // used for spear objects when filling the G-buffer
+	ShaderProgram m_deferredShader; // used during the deferred lighting pass
+	ShaderProgram m_shadowShader; // used to draw the sun's shadow cascades
+	ShaderProgram m_occlusionBoxShader; // used to draw the bounding boxes of GPU occlusion queries
+	ShaderProgram m_gpuCullShader; // compute program culling the camera's instances on the GPU
+	ShaderProgram m_depthPyramidShader; // compute program reducing the frame's depth into the GPU cull's depth pyramid
 
 	// Render target and quad mesh encompassing screenspace for post processing
 	RenderTarget m_renderTarget;
 	Mesh m_fullscreenQuad;
 
+	// G-buffer for the deferred shading path, holding albedo, normal, specular and ambient targets along with a depth texture
+	static const unsigned int m_gBufferTargetCount = 4;
+	RenderTarget m_gBuffer;
+	bool m_deferredShading = false; // Whether the scene is deferred or forward shaded, variable is altered by ImGui UI
+
 	// Scene lights (point lights are added to scene in initialisation)
 	Light m_light;
 	vec3 m_ambientLight;
@@ -58,9 +139,14 @@ protected:
 	static const int m_postProcessorsCount = 6; // Number of post processors to select from
 	const char* m_postProcessors[m_postProcessorsCount] = { "Default", "Box Blur", "Distort", "Water Distort", "Invert", "Edge Detect" }; // Names of post processors to select from
 	int m_selectedPostProcessor = 0; // Tracker for which in the dropdown is currently selected
+	int m_selectedPostProcessorUniform = -1; // Location of the selectedPostProcessor uniform, looked up once after the post shader links
 
 	// Variables for selecting which point light to be editing via ImGui UI
-	static const int m_pointLightCount = 2; // Number of point lights in the scene
+	static const int m_pointLightCount = 2; // Number of editable point lights in the scene
 	const char* m_pointLights[m_pointLightCount] = { "Point Light 1", "Point Light 2"}; // Names of point lights in the scene
 	int m_selectedPointLight = 0; // Tracker for which point light is currently selected
+
+	// Printed results of the last benchmark run from the ImGui UI, and the mesh cache benchmark while it runs on the GL thread
+	std::string m_benchmarkResults;
+	std::future<std::string> m_meshCacheBenchmark;
 };
\ No newline at end of file
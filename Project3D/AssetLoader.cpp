@@ -0,0 +1,198 @@
+#include "AssetLoader.h"
+#include "TextureCache.h"
+#include <algorithm>
+#include <chrono>
+
+AssetLoader::~AssetLoader()
+{
+	stop();
+}
+
+/// <summary>
+/// stop() stops the loader, waiting for any job that is part way through preparing a mesh or decoding a texture
+/// (jobs that haven't started yet return straight away), and then deletes every request that hasn't finished. Their
+/// futures report a broken promise, and their meshes are left as they were. It's called before the job system the
+/// jobs run on shuts down, and again (doing nothing) on destruction.
+/// </summary>
+void AssetLoader::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	if (m_jobs.isDone() == false)
+		aie::JobSystem::getInstance()->wait(m_jobs);
+
+	for (Request* request : m_prepared)
+		delete request;
+	for (Request* request : m_uploading)
+		delete request;
+	m_prepared.clear();
+	m_uploading.clear();
+	m_decodedTextures.clear();
+	m_uploadingTextures.clear();
+}
+
+/// <summary>
+/// submit() runs a prepare or decode job on the job system, counted in m_jobs, or straight away on the calling
+/// thread when there is no job system.
+/// </summary>
+void AssetLoader::submit(aie::JobSystem::Job job)
+{
+	aie::JobSystem* jobSystem = aie::JobSystem::getInstance();
+	if (jobSystem != nullptr)
+		jobSystem->run(std::move(job), &m_jobs);
+	else
+		job();
+}
+
+/// <summary>
+/// loadMesh() copies the load arguments into a new request and submits a job to prepare it.
+/// </summary>
+/// <param name="mesh">The mesh to load into, which must not already be loaded and must outlive the loader.</param>
+/// <returns>A future that becomes true once the mesh's chunks are uploaded, or false if it couldn't be loaded.</returns>
+std::shared_future<bool> AssetLoader::loadMesh(aie::OBJMesh* mesh, const char* filename, bool loadTextures, bool flipTextureV, const aie::OBJMesh::LodSettings* lodSettings, bool optimizeVertexOrder, bool packVertices)
+{
+	Request* request = new Request();
+	request->mesh = mesh;
+	request->filename = filename;
+	request->loadTextures = loadTextures;
+	request->flipTextureV = flipTextureV;
+	request->hasLodSettings = lodSettings != nullptr;
+	if (lodSettings != nullptr)
+		request->lodSettings = *lodSettings;
+	request->optimizeVertexOrder = optimizeVertexOrder;
+	request->packVertices = packVertices;
+	std::shared_future<bool> future = request->promise.get_future().share();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_preparing++;
+	}
+	submit([this, request]() { prepareMesh(request); });
+	return future;
+}
+
+/// <summary>
+/// prepareMesh() is run as a job for every request, and prepares it's mesh (which doesn't touch OpenGL), passing it
+/// on to update() to upload if it succeeded, or completing it's future with false if it failed. A request whose job
+/// only starts once the loader is stopping is deleted without being prepared.
+/// </summary>
+void AssetLoader::prepareMesh(Request* request)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_stopping)
+		{
+			m_preparing--;
+			delete request;
+			return;
+		}
+	}
+
+	bool prepared = request->mesh->prepare(request->filename.c_str(), request->loadTextures, request->flipTextureV,
+		request->hasLodSettings ? &request->lodSettings : nullptr, request->optimizeVertexOrder, request->packVertices);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_preparing--;
+	if (prepared)
+	{
+		m_prepared.push_back(request);
+	}
+	else
+	{
+		request->promise.set_value(false);
+		delete request;
+	}
+}
+
+/// <summary>
+/// decodeTexture() is run as a job for every texture a loaded mesh asks for, and decodes it through the TextureCache,
+/// handing it back to update() to upload. A texture that can't be loaded is still handed back, so the mesh stops
+/// waiting for it.
+/// </summary>
+void AssetLoader::decodeTexture(TextureRequest textureRequest)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_stopping)
+		{
+			m_preparing--;
+			return;
+		}
+	}
+
+	textureRequest.texture = aie::TextureCache::acquire(textureRequest.filename);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_preparing--;
+	m_decodedTextures.push_back(std::move(textureRequest));
+}
+
+/// <summary>
+/// update() first submits a decode job for every texture the loaded meshes asked for while drawing last frame, and
+/// takes every newly prepared request and decoded texture. It then uploads decoded textures, and after them the
+/// oldest request's chunks (with OBJMesh::uploadNext()), one at a time until budgetMilliseconds have passed or
+/// nothing is left, completing each request's future as it's last chunk is uploaded. One upload is always made, so a
+/// chunk or texture that takes longer than the budget to upload doesn't stall loading forever.
+/// </summary>
+/// <param name="budgetMilliseconds">Time to spend uploading this frame.</param>
+void AssetLoader::update(float budgetMilliseconds)
+{
+	for (aie::OBJMesh* mesh : m_loadedMeshes)
+	{
+		m_textureRequests.clear();
+		mesh->takeTextureRequests(m_textureRequests);
+		for (unsigned int request : m_textureRequests)
+		{
+			TextureRequest textureRequest = { mesh, request, mesh->getTextureFilename(request), nullptr };
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_preparing++;
+			}
+			submit([this, textureRequest]() { decodeTexture(textureRequest); });
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_uploading.insert(m_uploading.end(), m_prepared.begin(), m_prepared.end());
+		m_prepared.clear();
+		m_uploadingTextures.insert(m_uploadingTextures.end(), std::make_move_iterator(m_decodedTextures.begin()), std::make_move_iterator(m_decodedTextures.end()));
+		m_decodedTextures.clear();
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	m_lastUploadCount = 0;
+	m_lastUploadMilliseconds = 0;
+	while ((m_uploadingTextures.empty() == false || m_uploading.empty() == false) && (m_lastUploadCount == 0 || m_lastUploadMilliseconds < budgetMilliseconds))
+	{
+		m_lastUploadCount++;
+		if (m_uploadingTextures.empty() == false)
+		{
+			// Textures are shared between meshes, so this one may already have been uploaded for another
+			TextureRequest& textureRequest = m_uploadingTextures.front();
+			if (textureRequest.texture != nullptr)
+				textureRequest.texture->upload();
+			textureRequest.mesh->setTexture(textureRequest.request, textureRequest.texture);
+			m_uploadingTextures.pop_front();
+		}
+		else
+		{
+			Request* request = m_uploading.front();
+			if (request->mesh->uploadNext() == false)
+			{
+				m_loadedMeshes.push_back(request->mesh);
+				request->promise.set_value(true);
+				delete request;
+				m_uploading.pop_front();
+			}
+		}
+		m_lastUploadMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+unsigned int AssetLoader::getPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (unsigned int)(m_preparing + m_prepared.size() + m_uploading.size() + m_decodedTextures.size() +
+		m_uploadingTextures.size());
+}
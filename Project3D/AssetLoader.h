@@ -0,0 +1,96 @@
+#pragma once
+#include "OBJMesh.h"
+#include "JobSystem.h"
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// AssetLoader loads meshes in the background so the application can show a window straight away. Each mesh is
+/// prepared as a job on the job system (parsing or reading it's cache, generating tangents and LODs, optimising and
+/// packing), and then uploaded on the OpenGL thread by update(), which is called once a frame and only spends up to
+/// a budget of time uploading chunks and textures. Until a mesh's chunks are all uploaded it isn't loaded
+/// (OBJMesh::isLoaded()), and the scene draws it's instances with a placeholder mesh instead. Each load returns a
+/// future that becomes true once the mesh is uploaded, or false if it couldn't be loaded.
+/// The loader then keeps loading the mesh's textures as draws first ask for them (OBJMesh::takeTextureRequests()),
+/// decoding them as jobs and uploading them in update(), so only textures a shader samples are ever loaded. Without a
+/// job system (outside the application) each mesh is prepared, and each texture decoded, on the calling thread.
+/// </summary>
+class AssetLoader
+{
+public:
+
+	// Stops the loader as stop() does
+	~AssetLoader();
+
+	// Waits for any mesh or texture being prepared, and abandons everything else still queued. Nothing more is loaded
+	// after, and it must be called before the job system shuts down
+	void stop();
+
+	// Queues the mesh to be loaded with the same arguments as OBJMesh::load(), the mesh must outlive the loader
+	std::shared_future<bool> loadMesh(aie::OBJMesh* mesh, const char* filename, bool loadTextures = true, bool flipTextureV = false, const aie::OBJMesh::LodSettings* lodSettings = nullptr, bool optimizeVertexOrder = false, bool packVertices = false);
+
+	// Uploads prepared meshes for up to budgetMilliseconds, on the OpenGL thread. At least one upload is made if any are waiting
+	void update(float budgetMilliseconds);
+
+	// Number of meshes and textures queued, being prepared or being uploaded
+	unsigned int getPendingCount() const;
+	// Time update() spent uploading last call, and the number of chunks and textures it uploaded
+	float getLastUploadMilliseconds() const { return m_lastUploadMilliseconds; }
+	unsigned int getLastUploadCount() const { return m_lastUploadCount; }
+
+protected:
+
+	/// <summary>
+	/// A Request is a mesh queued to load, with a copy of it's load arguments and the promise behind it's future.
+	/// </summary>
+	struct Request
+	{
+		aie::OBJMesh* mesh;
+		std::string filename;
+		bool loadTextures;
+		bool flipTextureV;
+		bool hasLodSettings;
+		aie::OBJMesh::LodSettings lodSettings;
+		bool optimizeVertexOrder;
+		bool packVertices;
+		std::promise<bool> promise;
+	};
+
+	/// <summary>
+	/// A TextureRequest is a texture a loaded mesh asked for, and the texture once a job has decoded it.
+	/// </summary>
+	struct TextureRequest
+	{
+		aie::OBJMesh* mesh;
+		unsigned int request;
+		std::string filename;
+		std::shared_ptr<aie::Texture> texture;
+	};
+
+	void submit(aie::JobSystem::Job job);
+	void prepareMesh(Request* request);
+	void decodeTexture(TextureRequest textureRequest);
+
+	// Counts the prepare and decode jobs that haven't finished, for stop() to wait on
+	aie::JobSystem::Counter m_jobs;
+
+	// Prepared requests waiting to upload and the number of jobs not yet finished, all guarded by m_mutex
+	mutable std::mutex m_mutex;
+	bool m_stopping = false;
+	std::deque<Request*> m_prepared;
+	std::deque<TextureRequest> m_decodedTextures;
+	unsigned int m_preparing = 0;
+
+	// Prepared requests taken by update(), and the meshes it has finished uploading (which it then loads
+	// textures for), only touched on the OpenGL thread
+	std::deque<Request*> m_uploading;
+	std::deque<TextureRequest> m_uploadingTextures;
+	std::vector<aie::OBJMesh*> m_loadedMeshes;
+	std::vector<unsigned int> m_textureRequests;
+
+	float m_lastUploadMilliseconds = 0;
+	unsigned int m_lastUploadCount = 0;
+};
@@ -0,0 +1,449 @@
+#include "Benchmarks.h"
+#include "InstanceStore.h"
+#include "LightClusterGrid.h"
+#include "Light.h"
+#include "ObjParser.h"
+#include "JobSystem.h"
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <chrono>
+#include <list>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <thread>
+
+// tiny_obj_loader is only kept to compare the ObjParser against
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+/// <summary>
+/// Timer is a small helper used by the benchmarks that records the time it was created (or last reset),
+/// and returns the elapsed time since then in milliseconds.
+/// </summary>
+class Timer
+{
+public:
+	Timer() { reset(); }
+	void reset() { m_start = std::chrono::high_resolution_clock::now(); }
+	double elapsedMilliseconds() const { return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count(); }
+
+private:
+	std::chrono::high_resolution_clock::time_point m_start;
+};
+
+/// <summary>
+/// runInstanceStore() benchmarks the InstanceStore against the heap allocated std::list of instances that the
+/// Scene used before it. Both containers have instanceCount instances added, and are then iterated over
+/// summing the translation of every transform (the same access pattern as the Scene's culling pass). The
+/// store then has every instance removed in a random order through their handles. The list's removal is not
+/// timed, as std::list::remove() is a linear search per instance and would take minutes at this scale.
+/// </summary>
+/// <param name="instanceCount">Number of instances to add, iterate and remove.</param>
+/// <returns>A report of the time taken for each stage.</returns>
+std::string Benchmarks::runInstanceStore(unsigned int instanceCount)
+{
+	// Heap allocated instances, laid out how the Scene used to store them
+	struct ListInstance
+	{
+		glm::mat4 transform;
+		void* mesh;
+		void* shaderProgram;
+	};
+
+	char buffer[512];
+	Timer timer;
+
+	// --- InstanceStore --- //
+	InstanceStore store;
+	std::vector<InstanceHandle> handles;
+	handles.reserve(instanceCount);
+
+	timer.reset();
+	for (unsigned int i = 0; i < instanceCount; i++)
+	{
+		handles.push_back(store.add(glm::translate(glm::mat4(1), glm::vec3((float)i, 0, 0)), i % 4, i % 2));
+	}
+	double storeAdd = timer.elapsedMilliseconds();
+
+	timer.reset();
+	glm::vec3 storeSum(0);
+	const glm::mat4* transforms = store.getTransforms();
+	for (size_t i = 0; i < store.size(); i++)
+	{
+		storeSum += glm::vec3(transforms[i][3]);
+	}
+	double storeIterate = timer.elapsedMilliseconds();
+
+	std::shuffle(handles.begin(), handles.end(), std::mt19937(12345));
+	timer.reset();
+	for (auto& handle : handles)
+	{
+		store.remove(handle);
+	}
+	double storeRemove = timer.elapsedMilliseconds();
+
+	// --- std::list<ListInstance*> --- //
+	std::list<ListInstance*> list;
+
+	timer.reset();
+	for (unsigned int i = 0; i < instanceCount; i++)
+	{
+		list.push_back(new ListInstance{ glm::translate(glm::mat4(1), glm::vec3((float)i, 0, 0)), nullptr, nullptr });
+	}
+	double listAdd = timer.elapsedMilliseconds();
+
+	timer.reset();
+	glm::vec3 listSum(0);
+	for (auto instance : list)
+	{
+		listSum += glm::vec3(instance->transform[3]);
+	}
+	double listIterate = timer.elapsedMilliseconds();
+
+	for (auto instance : list)
+	{
+		delete instance;
+	}
+
+	snprintf(buffer, sizeof(buffer),
+		"Instance Store (%u instances)\n"
+		"  InstanceStore:   add %.2f ms, iterate %.3f ms, remove (random order) %.2f ms\n"
+		"  std::list<ptr>:  add %.2f ms, iterate %.3f ms\n"
+		"  (checksums %.0f / %.0f)",
+		instanceCount, storeAdd, storeIterate, storeRemove, listAdd, listIterate, storeSum.x, listSum.x);
+	return buffer;
+}
+
+/// <summary>
+/// runLightClustering() assigns 4, 64, 256 and 1024 point lights to a LightClusterGrid from a camera placed like
+/// the main scene's. The lights are scattered randomly over a 50x50 area around the scene with small intensities,
+/// so their ranges stay local. Each assignment is repeated and averaged, and the lights per cluster it produces are
+/// compared against the naive shader, where every fragment loops over every light.
+/// </summary>
+/// <returns>A report of the assignment time and cluster occupancy for each light count.</returns>
+std::string Benchmarks::runLightClustering()
+{
+	const unsigned int lightCounts[] = { 4, 64, 256, 1024 };
+	const int repetitions = 20;
+	const float nearPlane = 0.1f;
+	const float farPlane = 1000.0f;
+	glm::mat4 projection = glm::perspective(glm::pi<float>() * 0.25f, 16 / 9.0f, nearPlane, farPlane);
+	glm::mat4 view = glm::lookAt(glm::vec3(0, 10, 10), glm::vec3(0, 0, 2), glm::vec3(0, 1, 0));
+
+	std::string report = "Light Clustering (16x9x24 clusters)\n";
+	char buffer[256];
+	std::mt19937 random(12345);
+	std::uniform_real_distribution<float> position(-25.0f, 25.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	LightClusterGrid grid;
+
+	for (unsigned int lightCount : lightCounts)
+	{
+		std::vector<Light> lights;
+		for (unsigned int i = 0; i < lightCount; i++)
+		{
+			lights.push_back(Light(glm::vec3(position(random), unit(random) * 4, position(random)), glm::vec3(unit(random), unit(random), unit(random)), 0.5f + unit(random)));
+		}
+
+		Timer timer;
+		for (int i = 0; i < repetitions; i++)
+		{
+			grid.assignLights(lights, projection, view, nearPlane, farPlane);
+		}
+		double assign = timer.elapsedMilliseconds() / repetitions;
+
+		unsigned int occupied = grid.getOccupiedClusterCount();
+		snprintf(buffer, sizeof(buffer),
+			"  %4u lights: assign %.3f ms, %u visible, %u occupied clusters, avg %.1f / max %u lights per cluster (naive %u)\n",
+			lightCount, assign, grid.getLightCount(), occupied, occupied > 0 ? (float)grid.getLightIndexCount() / occupied : 0.0f,
+			grid.getMaxClusterLightCount(), lightCount);
+		report += buffer;
+	}
+	return report;
+}
+
+/// <summary>
+/// runMeshCache() times loading an OBJMesh cold, by deleting it's binary cache so the obj is parsed, welded,
+/// simplified, optimised and packed (and the cache written again), against loading it warm from the cache that
+/// the cold load wrote. Each load is into a fresh mesh, and is repeated and averaged. Textures are skipped, as
+/// they are loaded from their own files either way.
+/// </summary>
+/// <param name="filename">The obj to load, which should be loaded with the same settings as the application so it's cache is left as the application expects.</param>
+/// <param name="lodSettings">LOD chain settings passed to every load.</param>
+/// <param name="optimizeVertexOrder">Vertex order optimisation flag passed to every load.</param>
+/// <param name="packVertices">Vertex packing flag passed to every load.</param>
+/// <returns>A report of the cold and warm load times and the size of the cache against the obj.</returns>
+std::string Benchmarks::runMeshCache(const char* filename, const aie::OBJMesh::LodSettings* lodSettings, bool optimizeVertexOrder, bool packVertices)
+{
+	const int repetitions = 3;
+	std::string cacheFilename = aie::OBJMesh::getCacheFilename(filename);
+	double cold = 0, warm = 0;
+	bool cacheHit = true;
+
+	for (int i = 0; i < repetitions; i++)
+	{
+		remove(cacheFilename.c_str());
+		{
+			aie::OBJMesh mesh;
+			Timer timer;
+			if (mesh.load(filename, false, true, lodSettings, optimizeVertexOrder, packVertices) == false)
+				return std::string("Mesh Cache: couldn't load ") + filename;
+			cold += timer.elapsedMilliseconds();
+		}
+		{
+			aie::OBJMesh mesh;
+			Timer timer;
+			mesh.load(filename, false, true, lodSettings, optimizeVertexOrder, packVertices);
+			warm += timer.elapsedMilliseconds();
+			cacheHit = cacheHit && mesh.wasLoadedFromCache();
+		}
+	}
+
+	// Compare the size of the cache against the obj text it replaces
+	long sourceSize = 0, cacheSize = 0;
+	FILE* file = nullptr;
+	if (fopen_s(&file, filename, "rb") == 0 && file != nullptr)
+	{
+		fseek(file, 0, SEEK_END);
+		sourceSize = ftell(file);
+		fclose(file);
+	}
+	if (fopen_s(&file, cacheFilename.c_str(), "rb") == 0 && file != nullptr)
+	{
+		fseek(file, 0, SEEK_END);
+		cacheSize = ftell(file);
+		fclose(file);
+	}
+
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer),
+		"Mesh Cache (%s, %d loads each, no textures)\n"
+		"  cold (parse and write cache): %.2f ms\n"
+		"  warm (mapped cache%s): %.2f ms, %.1fx faster\n"
+		"  obj %.1f KB, cache %.1f KB",
+		filename, repetitions, cold / repetitions, cacheHit ? "" : ", MISSED", warm / repetitions,
+		warm > 0 ? cold / warm : 0.0, sourceSize / 1024.0, cacheSize / 1024.0);
+	return buffer;
+}
+
+// Formats one line of the obj parser report from a parse of byteCount bytes and triangleCount triangles
+static std::string formatParse(const char* name, double milliseconds, size_t byteCount, size_t triangleCount)
+{
+	char buffer[256];
+	double seconds = milliseconds / 1000.0;
+	snprintf(buffer, sizeof(buffer), "  %s: %.1f ms, %.1f MB/s, %.2f M triangles/s\n", name, milliseconds,
+		seconds > 0 ? byteCount / (1024.0 * 1024.0) / seconds : 0.0, seconds > 0 ? triangleCount / 1000000.0 / seconds : 0.0);
+	return buffer;
+}
+
+/// <summary>
+/// runObjParser() times parsing an obj in to chunks of deduplicated vertices, with the ObjParser on one thread and
+/// on every hardware thread, and with the tiny_obj_loader it replaced. It then writes a grid of at least
+/// generatedTriangles triangles (positions only, as a scanned or generated mesh would be) to an obj next to the
+/// executable, times the ObjParser on it the same way and deletes it. tiny_obj_loader isn't run on the grid as it
+/// takes many seconds and gigabytes at that size. Each parse of the given obj is repeated and averaged.
+/// </summary>
+/// <param name="filename">The obj to parse, with it's MTL libraries.</param>
+/// <param name="generatedTriangles">Least number of triangles in the generated grid, 0 to skip it.</param>
+/// <returns>A report of each parser's time, MB/s and triangles/s.</returns>
+std::string Benchmarks::runObjParser(const char* filename, unsigned int generatedTriangles)
+{
+	const int repetitions = 5;
+	unsigned int threadCount = std::max(1u, std::min(ObjParser::MAX_THREADS, std::thread::hardware_concurrency()));
+	std::string report;
+	char buffer[256];
+
+	// --- The given obj --- //
+	double single = 0, threaded = 0, tiny = 0;
+	size_t fileSize = 0, triangleCount = 0;
+	std::string file = filename;
+	std::string folder = file.substr(0, file.find_last_of('/') + 1);
+	for (int i = 0; i < repetitions; i++)
+	{
+		ObjParser parser;
+		Timer timer;
+		if (parser.parse(filename, false, 1) == false)
+			return "Obj Parser: " + parser.getError();
+		single += timer.elapsedMilliseconds();
+		fileSize = parser.getFileSize();
+		triangleCount = parser.getTriangleCount();
+
+		timer.reset();
+		parser.parse(filename, false, threadCount);
+		threaded += timer.elapsedMilliseconds();
+
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string error;
+		timer.reset();
+		tinyobj::LoadObj(shapes, materials, error, filename, folder.c_str());
+		tiny += timer.elapsedMilliseconds();
+	}
+	snprintf(buffer, sizeof(buffer), "Obj Parser (%s, %.1f KB, %zu triangles, %d parses each)\n", filename, fileSize / 1024.0, triangleCount, repetitions);
+	report += buffer;
+	report += formatParse("ObjParser, 1 thread", single / repetitions, fileSize, triangleCount);
+	snprintf(buffer, sizeof(buffer), "ObjParser, %u threads", threadCount);
+	report += formatParse(buffer, threaded / repetitions, fileSize, triangleCount);
+	report += formatParse("tiny_obj_loader", tiny / repetitions, fileSize, triangleCount);
+
+	if (generatedTriangles == 0)
+	{
+		report.pop_back();
+		return report;
+	}
+
+	// --- Generated grid --- //
+	const char* gridFilename = "./benchmark_grid.obj";
+	unsigned int quads = (unsigned int)std::ceil(std::sqrt(generatedTriangles / 2.0));
+	FILE* grid = nullptr;
+	if (fopen_s(&grid, gridFilename, "wb") != 0 || grid == nullptr)
+		return report + "  couldn't write " + gridFilename;
+	Timer timer;
+	for (unsigned int y = 0; y <= quads; y++)
+	{
+		for (unsigned int x = 0; x <= quads; x++)
+		{
+			fprintf(grid, "v %u %u %.3f\n", x, y, std::sin(x * 0.05f) * std::cos(y * 0.05f));
+		}
+	}
+	for (unsigned int y = 0; y < quads; y++)
+	{
+		for (unsigned int x = 0; x < quads; x++)
+		{
+			unsigned int corner = y * (quads + 1) + x + 1;
+			fprintf(grid, "f %u %u %u\nf %u %u %u\n", corner, corner + 1, corner + quads + 2, corner, corner + quads + 2, corner + quads + 1);
+		}
+	}
+	fclose(grid);
+	double writeMilliseconds = timer.elapsedMilliseconds();
+
+	ObjParser parser;
+	timer.reset();
+	bool parsed = parser.parse(gridFilename, false, 1);
+	single = timer.elapsedMilliseconds();
+	fileSize = parser.getFileSize();
+	triangleCount = parser.getTriangleCount();
+	timer.reset();
+	parsed = parsed && parser.parse(gridFilename, false, threadCount);
+	threaded = timer.elapsedMilliseconds();
+	remove(gridFilename);
+	if (parsed == false)
+		return report + "  " + parser.getError();
+
+	snprintf(buffer, sizeof(buffer), "Generated grid (%.1f MB, %zu triangles, written in %.0f ms)\n", fileSize / (1024.0 * 1024.0), triangleCount, writeMilliseconds);
+	report += buffer;
+	report += formatParse("ObjParser, 1 thread", single, fileSize, triangleCount);
+	snprintf(buffer, sizeof(buffer), "ObjParser, %u threads", threadCount);
+	report += formatParse(buffer, threaded, fileSize, triangleCount);
+	report.pop_back();
+	return report;
+}
+
+/// <summary>
+/// runJobSystem() times two data parallel workloads on a job system of it's own, limited to 1 thread and then to
+/// each thread count up to every thread it has: OBJMesh tangent generation on a generated, gently rolling grid mesh,
+/// and a scene-wide transform update that spins every instance of an InstanceStore about it's own up axis (as an
+/// animation system would each frame). Each workload is repeated and averaged at every thread count, and the
+/// tangents are checked to come out identical to the single threaded run. Limiting the threads of the shared job
+/// system would throttle the frames being drawn and the assets loading alongside the benchmark, so it's left alone.
+/// </summary>
+/// <param name="vertexCount">Least number of vertices in the generated grid.</param>
+/// <param name="instanceCount">Number of instances to update the transforms of.</param>
+/// <returns>A report of the time and speedup at each thread count.</returns>
+std::string Benchmarks::runJobSystem(unsigned int vertexCount, unsigned int instanceCount)
+{
+	aie::JobSystem jobSystem;
+
+	const int repetitions = 5;
+	std::string report;
+	char buffer[256];
+
+	// Grid of (side + 1)^2 vertices with texture coordinates running along it, as two triangles per quad
+	unsigned int side = (unsigned int)std::ceil(std::sqrt((double)vertexCount)) - 1;
+	std::vector<aie::OBJMesh::Vertex> vertices((side + 1) * (side + 1));
+	for (unsigned int y = 0; y <= side; y++)
+	{
+		for (unsigned int x = 0; x <= side; x++)
+		{
+			aie::OBJMesh::Vertex& vertex = vertices[y * (side + 1) + x];
+			vertex.position = glm::vec4((float)x, std::sin(x * 0.05f) * std::cos(y * 0.05f), (float)y, 1);
+			vertex.normal = glm::vec4(0, 1, 0, 0);
+			vertex.texcoord = glm::vec2(x / (float)side, y / (float)side);
+		}
+	}
+	std::vector<unsigned int> indices;
+	indices.reserve(side * side * 6);
+	for (unsigned int y = 0; y < side; y++)
+	{
+		for (unsigned int x = 0; x < side; x++)
+		{
+			unsigned int corner = y * (side + 1) + x;
+			indices.insert(indices.end(), { corner, corner + side + 2, corner + 1, corner, corner + side + 1, corner + side + 2 });
+		}
+	}
+
+	InstanceStore store;
+	store.reserve(instanceCount);
+	for (unsigned int i = 0; i < instanceCount; i++)
+	{
+		store.add(glm::translate(glm::mat4(1), glm::vec3((float)(i % 1000), 0, (float)(i / 1000))), 0, 0);
+	}
+	glm::mat4 spin = glm::rotate(glm::mat4(1), 0.01f, glm::vec3(0, 1, 0));
+
+	unsigned int maxThreads = jobSystem.getMaxThreadCount();
+	snprintf(buffer, sizeof(buffer), "Job System (%zu vertex tangents, %u transforms, 1 - %u threads, %d runs each)\n",
+		vertices.size(), instanceCount, maxThreads, repetitions);
+	report += buffer;
+
+	std::vector<glm::vec4> firstTangents;
+	double singleTangents = 0, singleTransforms = 0;
+	bool identical = true;
+	for (unsigned int threads = 1; threads <= maxThreads; threads++)
+	{
+		jobSystem.setThreadCount(threads);
+
+		Timer timer;
+		for (int i = 0; i < repetitions; i++)
+		{
+			aie::OBJMesh::calculateTangents(vertices, indices, &jobSystem);
+		}
+		double tangents = timer.elapsedMilliseconds() / repetitions;
+
+		timer.reset();
+		for (int i = 0; i < repetitions; i++)
+		{
+			glm::mat4* transforms = store.getTransforms();
+			aie::JobSystem::parallelFor(store.size(), 4096, [transforms, &spin](size_t first, size_t last)
+			{
+				for (size_t j = first; j < last; j++)
+				{
+					transforms[j] = transforms[j] * spin;
+				}
+			}, &jobSystem);
+		}
+		double transforms = timer.elapsedMilliseconds() / repetitions;
+
+		if (threads == 1)
+		{
+			singleTangents = tangents;
+			singleTransforms = transforms;
+			for (auto& vertex : vertices)
+				firstTangents.push_back(vertex.tangent);
+		}
+		else
+		{
+			for (size_t j = 0; j < vertices.size(); j++)
+				identical = identical && vertices[j].tangent == firstTangents[j];
+		}
+
+		snprintf(buffer, sizeof(buffer), "  %2u threads:  tangents %.2f ms (%.2fx), transforms %.2f ms (%.2fx)\n",
+			threads, tangents, singleTangents / tangents, transforms, singleTransforms / transforms);
+		report += buffer;
+	}
+
+	report += identical ? "  (tangents identical on every thread count)" : "  (tangents DIFFER between thread counts)";
+	return report;
+}
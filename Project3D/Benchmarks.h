@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include "OBJMesh.h"
+
+/// <summary>
+/// Benchmarks is a collection of static microbenchmarks for the engine's hot paths, which are triggered
+/// from the Benchmarks panel of the Application3D UI. Each benchmark runs synchronously, times each stage
+/// of it's workload with a high resolution clock, and returns a human readable report of the results to
+/// be displayed in the UI.
+/// </summary>
+class Benchmarks
+{
+public:
+
+	// Adds, iterates and removes instanceCount instances in an InstanceStore, and compares adding and
+	// iterating against the heap allocated std::list of instances the scene used previously
+	static std::string runInstanceStore(unsigned int instanceCount);
+
+	// Assigns increasing numbers of randomly placed point lights to a LightClusterGrid, reporting how long the
+	// assignment takes and how many lights a fragment loops over compared to looping over every light
+	static std::string runLightClustering();
+
+	// Loads an obj with the given settings from the obj itself (after deleting it's binary cache) and then from
+	// the cache that load wrote, comparing the cold and warm load times without textures
+	static std::string runMeshCache(const char* filename, const aie::OBJMesh::LodSettings* lodSettings, bool optimizeVertexOrder, bool packVertices);
+
+	// Parses an obj with the ObjParser on one thread and on every thread, and with tiny_obj_loader, and then
+	// parses a generated grid obj of at least generatedTriangles triangles, reporting MB/s and triangles/s
+	static std::string runObjParser(const char* filename, unsigned int generatedTriangles);
+
+	// Generates tangents for a grid mesh of at least vertexCount vertices, and rotates instanceCount instance
+	// transforms in an InstanceStore, on a job system of it's own limited to 1 thread up to every thread,
+	// reporting the time and speedup over 1 thread at each count
+	static std::string runJobSystem(unsigned int vertexCount, unsigned int instanceCount);
+};
@@ -27,6 +27,8 @@ public:
 	mat4 getViewMatrix();
 	mat4 getProjectionMatrix(float screenWidth, float screenHeight);
 	vec3 getPosition() { return m_position; }
+	float getNearPlane() { return m_nearPlane; }
+	float getFarPlane() { return m_farPlane; }
 
 private:
 	//View variables
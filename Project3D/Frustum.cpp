@@ -0,0 +1,76 @@
+#include "Frustum.h"
+#include <glm/geometric.hpp>
+
+/// <summary>
+/// extractPlanes() pulls the six frustum planes out of the rows of the input projectionView matrix (using the
+/// Gribb/Hartmann method), where each plane is the sum or difference of the fourth row with one of the other
+/// three. Each plane is then normalised so that testSphere() can compare signed distances against a radius.
+/// </summary>
+/// <param name="projectionView">The combined projection and view matrix to extract the planes from.</param>
+void Frustum::extractPlanes(const glm::mat4& projectionView)
+{
+	// glm matrices are column major, so build the rows up manually
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(projectionView[0][i], projectionView[1][i], projectionView[2][i], projectionView[3][i]);
+	}
+
+	m_planes[0] = rows[3] + rows[0]; // left
+	m_planes[1] = rows[3] - rows[0]; // right
+	m_planes[2] = rows[3] + rows[1]; // bottom
+	m_planes[3] = rows[3] - rows[1]; // top
+	m_planes[4] = rows[3] + rows[2]; // near
+	m_planes[5] = rows[3] - rows[2]; // far
+
+	for (auto& plane : m_planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+/// <summary>
+/// testSphere() checks the signed distance of the sphere's centre from each plane, the sphere is outside the
+/// frustum as soon as it is further than it's radius behind any one plane.
+/// </summary>
+/// <param name="centre">Centre of the bounding sphere.</param>
+/// <param name="radius">Radius of the bounding sphere.</param>
+/// <returns>Whether the sphere is completely outside, partially inside, or completely inside the frustum.</returns>
+Frustum::eCullResult Frustum::testSphere(const glm::vec3& centre, float radius) const
+{
+	eCullResult result = INSIDE;
+	for (auto& plane : m_planes)
+	{
+		float distance = glm::dot(glm::vec3(plane), centre) + plane.w;
+		if (distance < -radius)
+			return OUTSIDE;
+		if (distance < radius)
+			result = INTERSECTS;
+	}
+	return result;
+}
+
+/// <summary>
+/// testAABB() tests an axis aligned box against each plane using the box's "positive" and "negative" corners,
+/// which are the corners furthest along and furthest against the plane normal respectively. If the positive
+/// corner is behind any plane the whole box is outside, and if the negative corner is behind a plane the box
+/// straddles it.
+/// </summary>
+/// <param name="min">Minimum corner of the box.</param>
+/// <param name="max">Maximum corner of the box.</param>
+/// <returns>Whether the box is completely outside, partially inside, or completely inside the frustum.</returns>
+Frustum::eCullResult Frustum::testAABB(const glm::vec3& min, const glm::vec3& max) const
+{
+	eCullResult result = INSIDE;
+	for (auto& plane : m_planes)
+	{
+		glm::vec3 positive(plane.x >= 0 ? max.x : min.x, plane.y >= 0 ? max.y : min.y, plane.z >= 0 ? max.z : min.z);
+		glm::vec3 negative(plane.x >= 0 ? min.x : max.x, plane.y >= 0 ? min.y : max.y, plane.z >= 0 ? min.z : max.z);
+
+		if (glm::dot(glm::vec3(plane), positive) + plane.w < 0)
+			return OUTSIDE;
+		if (glm::dot(glm::vec3(plane), negative) + plane.w < 0)
+			result = INTERSECTS;
+	}
+	return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+/// <summary>
+/// Frustum is a utility class that holds the six clipping planes of a camera's view volume, extracted
+/// from a combined projection and view matrix, and allows bounding volumes in the same space as that
+/// matrix's input (i.e. worldspace for a ProjectionView matrix) to be tested against them. Each plane is
+/// stored as a vec4 of (normal, distance), normalised and facing into the frustum, so a point p is on the
+/// inside of a plane when dot(plane.xyz, p) + plane.w >= 0.
+/// </summary>
+class Frustum
+{
+public:
+
+	// Result of a bounding volume test, INTERSECTS means the volume straddles at least one plane
+	enum eCullResult { OUTSIDE = 0, INTERSECTS, INSIDE };
+
+	Frustum() {}
+	Frustum(const glm::mat4& projectionView) { extractPlanes(projectionView); }
+
+	void extractPlanes(const glm::mat4& projectionView);
+
+	eCullResult testSphere(const glm::vec3& centre, float radius) const;
+	eCullResult testAABB(const glm::vec3& min, const glm::vec3& max) const;
+
+	const glm::vec4& getPlane(int index) const { return m_planes[index]; }
+
+protected:
+
+	glm::vec4 m_planes[6]; // Left, right, bottom, top, near and far planes
+};
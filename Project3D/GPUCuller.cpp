@@ -0,0 +1,257 @@
+#include "GPUCuller.h"
+#include "Frustum.h"
+#include "Shader.h"
+#include "GLState.h"
+#include "gl_core_4_4.h"
+#include <glm/common.hpp>
+#include <cmath>
+
+// Storage blocks gpu_cull.comp reads and writes, from CULL_TRANSFORM_STORAGE to CULL_STATS_STORAGE
+static const int CULL_STORAGE_BLOCK_COUNT = aie::CULL_STATS_STORAGE - aie::CULL_TRANSFORM_STORAGE + 1;
+
+/// <summary>
+/// ~GPUCuller() deletes the buffers, fences and depth pyramid if they were ever created.
+/// </summary>
+GPUCuller::~GPUCuller()
+{
+	if (m_cullProgram == nullptr)
+		return;
+
+	unsigned int buffers[] = { m_transformBuffer, m_instanceBuffer, m_batchBuffer, m_chunkBuffer, m_drawBuffer, m_commandBuffer, m_culledTransformBuffer, m_culledDequantiseBuffer };
+	glDeleteBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
+	glDeleteBuffers(STATS_FRAMES, m_statsBuffers);
+	for (auto fence : m_statsFences)
+	{
+		if (fence != nullptr)
+			glDeleteSync((GLsync)fence);
+	}
+	if (m_pyramidTexture != 0)
+	{
+		aie::GLState::forgetTexture(m_pyramidTexture);
+		glDeleteTextures(1, &m_pyramidTexture);
+	}
+}
+
+/// <summary>
+/// initialise() checks the compute stage can bind every storage block of the cull program (the GL only promises 8,
+/// though any GL 4.3 driver in practice has 16 or more), then creates the cull's buffers, looks up the uniforms of
+/// both compute programs and points the cull program's depth pyramid sampler at DEPTH_PYRAMID_TEXTURE.
+/// </summary>
+/// <param name="cullProgram">The linked gpu_cull.comp program.</param>
+/// <param name="pyramidProgram">The linked depth_pyramid.comp program.</param>
+/// <returns>True if successful, false if the GL has too few compute storage blocks.</returns>
+bool GPUCuller::initialise(aie::ShaderProgram* cullProgram, aie::ShaderProgram* pyramidProgram)
+{
+	int maxStorageBlocks = 0;
+	glGetIntegerv(GL_MAX_COMPUTE_SHADER_STORAGE_BLOCKS, &maxStorageBlocks);
+	int maxStorageBindings = 0;
+	glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxStorageBindings);
+	if (maxStorageBlocks < CULL_STORAGE_BLOCK_COUNT || maxStorageBindings <= (int)aie::CULL_STATS_STORAGE)
+		return false;
+
+	m_cullProgram = cullProgram;
+	m_pyramidProgram = pyramidProgram;
+	m_instanceCountUniform = cullProgram->getUniform("instanceCount");
+	m_frustumPlanesUniform = cullProgram->getUniform("frustumPlanes");
+	m_pyramidProjectionViewUniform = cullProgram->getUniform("pyramidProjectionView");
+	m_pyramidDepthSizeUniform = cullProgram->getUniform("pyramidDepthSize");
+	m_pyramidLevelsUniform = cullProgram->getUniform("pyramidLevels");
+	m_cameraPositionUniform = cullProgram->getUniform("cameraPosition");
+	m_pixelsPerUnitUniform = cullProgram->getUniform("pixelsPerUnit");
+	m_lodPixelErrorUniform = cullProgram->getUniform("lodPixelError");
+	m_sourceLevelUniform = pyramidProgram->getUniform("sourceLevel");
+	glProgramUniform1i(cullProgram->getHandle(), cullProgram->getUniform("depthPyramid"), aie::DEPTH_PYRAMID_TEXTURE);
+	glProgramUniform1i(pyramidProgram->getHandle(), pyramidProgram->getUniform("sourceDepth"), aie::DEPTH_PYRAMID_TEXTURE);
+
+	glGenBuffers(1, &m_transformBuffer);
+	glGenBuffers(1, &m_instanceBuffer);
+	glGenBuffers(1, &m_batchBuffer);
+	glGenBuffers(1, &m_chunkBuffer);
+	glGenBuffers(1, &m_drawBuffer);
+	glGenBuffers(1, &m_commandBuffer);
+	glGenBuffers(1, &m_culledTransformBuffer);
+	glGenBuffers(1, &m_culledDequantiseBuffer);
+	glGenBuffers(STATS_FRAMES, m_statsBuffers);
+	for (unsigned int i = 0; i < STATS_FRAMES; i++)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_statsBuffers[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(CullStats), nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return true;
+}
+
+/// <summary>
+/// upload() streams data into a storage buffer, orphaning it first so the driver doesn't wait on the last frame still
+/// reading it. The buffer is only grown (to double the required size) when the data doesn't fit, and always holds
+/// something, as storage buffers can't be empty. With no data the buffer is only orphaned, for the GPU to fill.
+/// </summary>
+/// <param name="buffer">The buffer to fill.</param>
+/// <param name="capacity">The buffer's size in bytes, updated when the buffer grows.</param>
+/// <param name="data">The data to copy in, or null.</param>
+/// <param name="size">The size of the data in bytes.</param>
+void GPUCuller::upload(unsigned int buffer, size_t& capacity, const void* data, size_t size)
+{
+	if (size > capacity || capacity == 0)
+		capacity = glm::max(size, (size_t)16) * 2;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+	if (data != nullptr && size > 0)
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+}
+
+/// <summary>
+/// readStats() copies the statistics written by the cull of an earlier frame out of it's statistics buffer, as long
+/// as the fence placed after that cull shows the GPU has finished it. A cull the GPU still hasn't finished (only
+/// possible when it's more than STATS_FRAMES frames behind) simply goes uncounted.
+/// </summary>
+/// <param name="frame">Which of the statistics buffers to read.</param>
+void GPUCuller::readStats(unsigned int frame)
+{
+	GLsync fence = (GLsync)m_statsFences[frame];
+	if (fence == nullptr)
+		return;
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_statsBuffers[frame]);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(CullStats), &m_stats);
+	}
+	glDeleteSync(fence);
+	m_statsFences[frame] = nullptr;
+}
+
+/// <summary>
+/// uploadTables() uploads the scene's instance, batch, chunk and draw tables into the cull's storage buffers, where
+/// they stay for every cull until the scene next rebuilds them. The instance table is also where the cull keeps
+/// each instance's LOD from one frame to the next, so uploading it restarts LOD selection from the scene's LODs.
+/// </summary>
+/// <param name="tables">The tables to cull the instances with.</param>
+void GPUCuller::uploadTables(const CullTables& tables)
+{
+	upload(m_instanceBuffer, m_instanceCapacity, tables.instances.data(), tables.instances.size() * sizeof(GPUInstance));
+	upload(m_batchBuffer, m_batchCapacity, tables.batches.data(), tables.batches.size() * sizeof(GPUBatch));
+	upload(m_chunkBuffer, m_chunkCapacity, tables.chunks.data(), tables.chunks.size() * sizeof(GPUChunk));
+	upload(m_drawBuffer, m_drawCapacity, tables.drawCommands.data(), tables.drawCommands.size() * sizeof(unsigned int));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/// <summary>
+/// cull() uploads the frame's instance transforms into the cull's storage buffer, resets the draw commands (whose
+/// instance counts the scene leaves at 0) and makes room for the culled instances. It then dispatches one invocation
+/// of the cull program per instance, against the frustum's planes and, while it's valid, the depth pyramid, selecting
+/// the LOD of each instance the way Scene::selectLods() does, and puts up a barrier so the draws and vertex fetches
+/// that follow see everything it wrote. The statistics buffer being reused is read back first, and zeroed for this
+/// cull. The rest of the tables must have been uploaded by uploadTables() since they last changed.
+/// </summary>
+/// <param name="tables">The batches, chunks, draws and commands to cull the instances into.</param>
+/// <param name="transforms">The model transform of every instance, tables.instances.size() long.</param>
+/// <param name="frustum">The camera frustum, in worldspace.</param>
+/// <param name="cameraPosition">The camera's worldspace position, LODs are selected by their distance from it.</param>
+/// <param name="pixelsPerUnit">Pixels covered by one unit of worldspace, facing the camera at a distance of one.</param>
+/// <param name="lodPixelError">Largest projected error, in pixels, an instance's LOD may have.</param>
+void GPUCuller::cull(const CullTables& tables, const glm::mat4* transforms, const Frustum& frustum, const glm::vec3& cameraPosition,
+	float pixelsPerUnit, float lodPixelError)
+{
+	unsigned int instanceCount = (unsigned int)tables.instances.size();
+	upload(m_transformBuffer, m_transformCapacity, transforms, instanceCount * sizeof(glm::mat4));
+	upload(m_commandBuffer, m_commandCapacity, tables.commands.data(), tables.commands.size() * sizeof(aie::GeometryArena::DrawCommand));
+
+	// The culled dequantisations are half the size of the transforms, so share their capacity
+	size_t culledSize = tables.culledCapacity * sizeof(glm::mat4);
+	upload(m_culledTransformBuffer, m_culledCapacity, nullptr, culledSize);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_culledDequantiseBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_culledCapacity / 2, nullptr, GL_STREAM_DRAW);
+
+	unsigned int frame = m_frameIndex++ % STATS_FRAMES;
+	readStats(frame);
+	CullStats zero;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_statsBuffers[frame]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(CullStats), &zero, GL_STREAM_READ);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::CULL_TRANSFORM_STORAGE, m_transformBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::CULL_INSTANCE_STORAGE, m_instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::CULL_BATCH_STORAGE, m_batchBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::CULL_CHUNK_STORAGE, m_chunkBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::CULL_DRAW_STORAGE, m_drawBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::CULL_COMMAND_STORAGE, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::CULLED_TRANSFORM_STORAGE, m_culledTransformBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::CULLED_DEQUANTISE_STORAGE, m_culledDequantiseBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::CULL_STATS_STORAGE, m_statsBuffers[frame]);
+
+	glm::vec4 planes[6];
+	for (int i = 0; i < 6; i++)
+		planes[i] = frustum.getPlane(i);
+
+	m_cullProgram->bind();
+	m_cullProgram->bindUniform(m_instanceCountUniform, (int)instanceCount);
+	m_cullProgram->bindUniform(m_frustumPlanesUniform, 6, planes);
+	m_cullProgram->bindUniform(m_pyramidProjectionViewUniform, m_pyramidProjectionView);
+	m_cullProgram->bindUniform(m_pyramidDepthSizeUniform, m_pyramidDepthSize);
+	m_cullProgram->bindUniform(m_pyramidLevelsUniform, m_pyramidValid ? (int)m_pyramidLevels : 0);
+	m_cullProgram->bindUniform(m_cameraPositionUniform, cameraPosition);
+	m_cullProgram->bindUniform(m_pixelsPerUnitUniform, pixelsPerUnit);
+	m_cullProgram->bindUniform(m_lodPixelErrorUniform, lodPixelError);
+	if (m_pyramidTexture != 0)
+		aie::GLState::bindTexture(aie::DEPTH_PYRAMID_TEXTURE, m_pyramidTexture);
+
+	if (instanceCount > 0)
+		glDispatchCompute((instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	m_statsFences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/// <summary>
+/// buildDepthPyramid() reduces a depth texture into the depth pyramid, recreating the pyramid whenever the depth's
+/// size changes. Each level is written by one dispatch of the pyramid program, reading the level below it (or the
+/// depth itself for level 0) through DEPTH_PYRAMID_TEXTURE and writing it as an image, with a barrier between levels
+/// so each dispatch sees the last one's writes. The depth must have been drawn with projectionView, which the next cull
+/// reprojects each instance's bounding box with to test it against the pyramid.
+/// </summary>
+/// <param name="depthTexture">The depth texture of the frame just drawn.</param>
+/// <param name="width">Width of the depth texture.</param>
+/// <param name="height">Height of the depth texture.</param>
+/// <param name="projectionView">The camera transform the depth was drawn with.</param>
+void GPUCuller::buildDepthPyramid(unsigned int depthTexture, unsigned int width, unsigned int height, const glm::mat4& projectionView)
+{
+	unsigned int pyramidWidth = glm::max(width / 2, 1u);
+	unsigned int pyramidHeight = glm::max(height / 2, 1u);
+	if (pyramidWidth != m_pyramidWidth || pyramidHeight != m_pyramidHeight)
+	{
+		if (m_pyramidTexture != 0)
+		{
+			aie::GLState::forgetTexture(m_pyramidTexture);
+			glDeleteTextures(1, &m_pyramidTexture);
+		}
+		m_pyramidWidth = pyramidWidth;
+		m_pyramidHeight = pyramidHeight;
+		m_pyramidLevels = (unsigned int)std::floor(std::log2((float)glm::max(pyramidWidth, pyramidHeight))) + 1;
+
+		glGenTextures(1, &m_pyramidTexture);
+		aie::GLState::bindTexture(aie::DEPTH_PYRAMID_TEXTURE, m_pyramidTexture);
+		glTexStorage2D(GL_TEXTURE_2D, m_pyramidLevels, GL_R32F, pyramidWidth, pyramidHeight);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	m_pyramidProgram->bind();
+	for (unsigned int level = 0; level < m_pyramidLevels; level++)
+	{
+		aie::GLState::bindTexture(aie::DEPTH_PYRAMID_TEXTURE, level == 0 ? depthTexture : m_pyramidTexture);
+		m_pyramidProgram->bindUniform(m_sourceLevelUniform, level == 0 ? 0 : (int)level - 1);
+		glBindImageTexture(0, m_pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		unsigned int levelWidth = glm::max(pyramidWidth >> level, 1u);
+		unsigned int levelHeight = glm::max(pyramidHeight >> level, 1u);
+		glDispatchCompute((levelWidth + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, (levelHeight + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+	aie::GLState::bindTexture(aie::DEPTH_PYRAMID_TEXTURE, m_pyramidTexture);
+
+	m_pyramidDepthSize = glm::vec2((float)width, (float)height);
+	m_pyramidProjectionView = projectionView;
+	m_pyramidValid = true;
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include "GeometryArena.h"
+
+class Frustum;
+namespace aie
+{
+	class ShaderProgram;
+}
+
+/// <summary>
+/// GPUCuller runs the camera's instance culling on the GPU, in the gpu_cull.comp compute shader, so that the CPU no
+/// longer tests, groups or copies the visible instances itself. The scene hands over a table of batches (instances
+/// sharing a mesh and shader), the chunks of their meshes, and one draw command per LOD of each batch's chunks, each
+/// with room for every instance of it's batch. The tables are only uploaded when the scene rebuilds them, while the
+/// transforms are uploaded every cull. One invocation per instance then tests the instance's bounding sphere against
+/// the frustum and it's bounding box against a hierarchical depth pyramid, built from the depth of the last frame
+/// drawn, selects the instance's LOD from the batch's LOD errors, and appends the transform and dequantisation of each
+/// surviving chunk to it's draw command's range of the culled instance buffers, counting the instance into the
+/// command with an atomic. The commands are left in a buffer for glMultiDrawElementsIndirect, so the visible counts
+/// never come back to the CPU. The culling statistics are read back a few frames later, once a fence shows the GPU
+/// has finished with them, so reading never stalls.
+/// </summary>
+class GPUCuller
+{
+public:
+
+	// Batch of an instance that isn't drawn (hidden, or it's mesh is still loading without a placeholder)
+	static const unsigned int NO_BATCH = 0xffffffff;
+
+	// Invocations per work group of gpu_cull.comp, matching it's local_size_x
+	static const unsigned int CULL_GROUP_SIZE = 64;
+	// Invocations per work group of depth_pyramid.comp along each axis, matching it's local size
+	static const unsigned int PYRAMID_GROUP_SIZE = 8;
+
+	// Frames the culling statistics are read back behind, each with it's own statistics buffer and fence
+	static const unsigned int STATS_FRAMES = 3;
+
+	// LODs of a batch the cull can select between, matching the size of Batch.lodErrors in gpu_cull.comp
+	static const unsigned int MAX_LODS = 8;
+
+	/// <summary>
+	/// A GPUInstance mirrors the uvec2 per instance in gpu_cull.comp, the batch the instance is drawn in (or NO_BATCH)
+	/// and the LOD it was last drawn at, which the cull refines from and writes back each time it selects the LOD.
+	/// </summary>
+	struct GPUInstance
+	{
+		unsigned int batch;
+		unsigned int lod;
+	};
+
+	/// <summary>
+	/// A GPUBatch mirrors the std430 Batch struct in gpu_cull.comp, the local bounding sphere (centre and radius) and
+	/// box (centre and half size) of the batch's mesh, where it's chunks and draws start in the chunk and draw tables,
+	/// and the error of each of it's LODs, four to a vec4. The draws of a batch are laid out chunk by chunk, with one
+	/// draw per LOD of each chunk.
+	/// </summary>
+	struct GPUBatch
+	{
+		glm::vec4 sphere;
+		glm::vec4 boxCentre;
+		glm::vec4 boxExtents;
+		unsigned int firstChunk;
+		unsigned int chunkCount;
+		unsigned int lodCount;
+		unsigned int firstDraw;
+		glm::vec4 lodErrors[MAX_LODS / 4];
+	};
+
+	/// <summary>
+	/// A GPUChunk mirrors the std430 Chunk struct in gpu_cull.comp, the local bounding box of a chunk and the
+	/// dequantisation written alongside each of it's instances.
+	/// </summary>
+	struct GPUChunk
+	{
+		glm::vec4 boxCentre;
+		glm::vec4 boxExtents;
+		glm::vec4 dequantise[2];
+	};
+
+	/// <summary>
+	/// CullTables are everything the scene builds for a cull on the CPU, whose size depends on the number of batches
+	/// rather than instances, bar the instances themselves. drawCommands holds the index in commands of each draw, so
+	/// the commands can be laid out in whichever order the scene issues them. Each command's base instance is the
+	/// start of it's range of the culled instance buffers, which must be culledCapacity instances long in total. Every
+	/// table bar the commands (whose instance counts the cull fills in) is uploaded by uploadTables().
+	/// </summary>
+	struct CullTables
+	{
+		std::vector<GPUInstance> instances;
+		std::vector<GPUBatch> batches;
+		std::vector<GPUChunk> chunks;
+		std::vector<unsigned int> drawCommands;
+		std::vector<aie::GeometryArena::DrawCommand> commands;
+		unsigned int culledCapacity = 0;
+	};
+
+	/// <summary>
+	/// CullStats mirror the std430 CullStats block in gpu_cull.comp, counted with atomics as the instances are culled.
+	/// </summary>
+	struct CullStats
+	{
+		unsigned int instancesDrawn = 0;
+		unsigned int instancesCulled = 0;
+		unsigned int instancesOccluded = 0;
+		unsigned int chunksDrawn = 0;
+		unsigned int chunksCulled = 0;
+		unsigned int trianglesDrawn = 0;
+	};
+
+	GPUCuller() {}
+	~GPUCuller();
+
+	// Creates the buffers and sets the compute programs, returns false if the GL can't bind enough storage buffers to run them
+	bool initialise(aie::ShaderProgram* cullProgram, aie::ShaderProgram* pyramidProgram);
+	bool isInitialised() const { return m_cullProgram != nullptr; }
+
+	// Uploads the instance, batch, chunk and draw tables, called whenever the scene rebuilds them
+	void uploadTables(const CullTables& tables);
+	// Uploads the frame's instance transforms and the commands, and dispatches the cull against the frustum and the depth pyramid,
+	// selecting LODs for a camera at cameraPosition with pixelsPerUnit pixels per unit at a distance of one
+	void cull(const CullTables& tables, const glm::mat4* transforms, const Frustum& frustum, const glm::vec3& cameraPosition,
+		float pixelsPerUnit, float lodPixelError);
+	// Reduces the depth texture into the depth pyramid the next cull tests against, projectionView being the transform the depth was drawn with
+	void buildDepthPyramid(unsigned int depthTexture, unsigned int width, unsigned int height, const glm::mat4& projectionView);
+	// Stops culls testing against the depth pyramid until it is next built, for when a frame is drawn without building it
+	void invalidateDepthPyramid() { m_pyramidValid = false; }
+
+	// Buffers the last cull wrote, for drawing it's commands
+	unsigned int getCommandBuffer() const { return m_commandBuffer; }
+	unsigned int getCulledTransformBuffer() const { return m_culledTransformBuffer; }
+	unsigned int getCulledDequantiseBuffer() const { return m_culledDequantiseBuffer; }
+
+	// Statistics of the latest cull the GPU has finished, STATS_FRAMES culls behind at most
+	const CullStats& getStats() const { return m_stats; }
+
+protected:
+
+	// Fills a buffer with data, growing it to double the size when it's too small rather than reallocating every frame
+	static void upload(unsigned int buffer, size_t& capacity, const void* data, size_t size);
+
+	void readStats(unsigned int frame);
+
+	aie::ShaderProgram* m_cullProgram = nullptr;
+	aie::ShaderProgram* m_pyramidProgram = nullptr;
+
+	// Uniform locations of the cull program
+	int m_instanceCountUniform = -1;
+	int m_frustumPlanesUniform = -1;
+	int m_pyramidProjectionViewUniform = -1;
+	int m_pyramidDepthSizeUniform = -1;
+	int m_pyramidLevelsUniform = -1;
+	int m_cameraPositionUniform = -1;
+	int m_pixelsPerUnitUniform = -1;
+	int m_lodPixelErrorUniform = -1;
+	// Uniform locations of the pyramid program
+	int m_sourceLevelUniform = -1;
+
+	// Storage buffers of the cull's inputs, and the byte capacity of each
+	unsigned int m_transformBuffer = 0;
+	unsigned int m_instanceBuffer = 0;
+	unsigned int m_batchBuffer = 0;
+	unsigned int m_chunkBuffer = 0;
+	unsigned int m_drawBuffer = 0;
+	size_t m_transformCapacity = 0;
+	size_t m_instanceCapacity = 0;
+	size_t m_batchCapacity = 0;
+	size_t m_chunkCapacity = 0;
+	size_t m_drawCapacity = 0;
+
+	// Buffers the cull writes, the draw commands and the culled instances they draw
+	unsigned int m_commandBuffer = 0;
+	unsigned int m_culledTransformBuffer = 0;
+	unsigned int m_culledDequantiseBuffer = 0;
+	size_t m_commandCapacity = 0;
+	size_t m_culledCapacity = 0;
+
+	// Statistics buffers, written in turn, and the fence after the cull that last wrote each
+	unsigned int m_statsBuffers[STATS_FRAMES] = {};
+	void* m_statsFences[STATS_FRAMES] = {};
+	unsigned int m_frameIndex = 0;
+	CullStats m_stats;
+
+	// Depth pyramid, a single channel float texture whose level 0 is half the size of the depth it's built from, each
+	// texel holding the furthest depth of the texels it covers. It's only tested against while valid
+	unsigned int m_pyramidTexture = 0;
+	unsigned int m_pyramidWidth = 0;
+	unsigned int m_pyramidHeight = 0;
+	unsigned int m_pyramidLevels = 0;
+	glm::vec2 m_pyramidDepthSize = glm::vec2(0);
+	glm::mat4 m_pyramidProjectionView = glm::mat4(1);
+	bool m_pyramidValid = false;
+};
@@ -0,0 +1,259 @@
+#include "GeometryArena.h"
+#include "OBJMesh.h"
+#include "Mesh.h"
+#include "GLState.h"
+#include "gl_core_4_4.h"
+#include <algorithm>
+
+namespace aie {
+
+std::vector<GeometryArena::Pool> GeometryArena::sm_pools;
+
+unsigned int GeometryArena::RangeAllocator::allocate(unsigned int count) {
+
+	if (count == 0)
+		return 0;
+
+	for (size_t i = 0; i < m_free.size(); ++i) {
+		Range& range = m_free[i];
+		if (range.count < count)
+			continue;
+		unsigned int first = range.first;
+		range.first += count;
+		range.count -= count;
+		if (range.count == 0)
+			m_free.erase(m_free.begin() + i);
+		m_allocated += count;
+		return first;
+	}
+	return NO_SPACE;
+}
+
+void GeometryArena::RangeAllocator::release(unsigned int first, unsigned int count) {
+
+	if (count == 0)
+		return;
+	m_allocated -= count;
+
+	// insert in order, then merge with the ranges either side if they touch
+	auto next = std::lower_bound(m_free.begin(), m_free.end(), first, [](const Range& range, unsigned int first) { return range.first < first; });
+	size_t index = next - m_free.begin();
+	m_free.insert(next, { first, count });
+	if (index + 1 < m_free.size() && m_free[index].first + m_free[index].count == m_free[index + 1].first) {
+		m_free[index].count += m_free[index + 1].count;
+		m_free.erase(m_free.begin() + index + 1);
+	}
+	if (index > 0 && m_free[index - 1].first + m_free[index - 1].count == m_free[index].first) {
+		m_free[index - 1].count += m_free[index].count;
+		m_free.erase(m_free.begin() + index);
+	}
+}
+
+void GeometryArena::RangeAllocator::grow(unsigned int capacity) {
+
+	// counted as allocated first, as releasing them counts them back out
+	unsigned int first = m_capacity;
+	unsigned int count = capacity - m_capacity;
+	m_capacity = capacity;
+	m_allocated += count;
+	release(first, count);
+}
+
+size_t GeometryArena::getVertexStride(eVertexFormat format) {
+	switch (format) {
+	case OBJ_VERTEX_FORMAT:			return sizeof(OBJMesh::Vertex);
+	case OBJ_PACKED_VERTEX_FORMAT:	return sizeof(OBJMesh::PackedVertex);
+	default:						return sizeof(Mesh::Vertex);
+	}
+}
+
+size_t GeometryArena::getIndexSize(unsigned int indexType) {
+	return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+unsigned int GeometryArena::getPool(eVertexFormat format, unsigned int indexType) {
+
+	// a pool for each format with 16 bit indices, followed by one with 32 bit indices
+	unsigned int index = format * 2 + (indexType == GL_UNSIGNED_SHORT ? 0 : 1);
+	if (sm_pools.empty())
+		sm_pools.resize(VERTEX_FORMAT_Count * 2);
+
+	Pool& pool = sm_pools[index];
+	if (pool.vao == 0) {
+		pool.format = format;
+		pool.indexType = indexType == GL_UNSIGNED_SHORT ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		createPool(pool);
+	}
+	return index;
+}
+
+void GeometryArena::createPool(Pool& pool) {
+
+	glGenVertexArrays(1, &pool.vao);
+	GLState::bindVertexArray(pool.vao);
+
+	// the vertices are all read from VERTEX_BINDING, which is pointed at the pool's buffer as it grows
+	switch (pool.format) {
+	case OBJ_PACKED_VERTEX_FORMAT:
+		// positions and the tangent's handedness, normals, texture coords and tangents
+		glVertexAttribFormat(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(OBJMesh::PackedVertex, position));
+		glVertexAttribFormat(1, 2, GL_SHORT, GL_TRUE, offsetof(OBJMesh::PackedVertex, normal));
+		glVertexAttribFormat(2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(OBJMesh::PackedVertex, texcoord));
+		glVertexAttribFormat(3, 2, GL_SHORT, GL_TRUE, offsetof(OBJMesh::PackedVertex, tangent));
+		break;
+	case OBJ_VERTEX_FORMAT:
+		// positions, normals, texture coords and tangents
+		glVertexAttribFormat(0, 4, GL_FLOAT, GL_FALSE, offsetof(OBJMesh::Vertex, position));
+		glVertexAttribFormat(1, 4, GL_FLOAT, GL_TRUE, offsetof(OBJMesh::Vertex, normal));
+		glVertexAttribFormat(2, 2, GL_FLOAT, GL_FALSE, offsetof(OBJMesh::Vertex, texcoord));
+		glVertexAttribFormat(3, 4, GL_FLOAT, GL_FALSE, offsetof(OBJMesh::Vertex, tangent));
+		break;
+	default:
+		// positions, normals and texture coords
+		glVertexAttribFormat(0, 4, GL_FLOAT, GL_FALSE, offsetof(Mesh::Vertex, position));
+		glVertexAttribFormat(1, 4, GL_FLOAT, GL_TRUE, offsetof(Mesh::Vertex, normal));
+		glVertexAttribFormat(2, 2, GL_FLOAT, GL_FALSE, offsetof(Mesh::Vertex, texCoord));
+		break;
+	}
+	unsigned int attributeCount = pool.format == MESH_VERTEX_FORMAT ? 3 : 4;
+	for (unsigned int i = 0; i < attributeCount; ++i) {
+		glEnableVertexAttribArray(i);
+		glVertexAttribBinding(i, VERTEX_BINDING);
+	}
+
+	if (pool.format != MESH_VERTEX_FORMAT) {
+		// per-instance model transforms as 4 vec4 columns, sourced from whichever buffer is
+		// attached to INSTANCE_BINDING at draw time
+		for (unsigned int column = 0; column < 4; ++column) {
+			glEnableVertexAttribArray(4 + column);
+			glVertexAttribFormat(4 + column, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 4 * column);
+			glVertexAttribBinding(4 + column, OBJMesh::INSTANCE_BINDING);
+		}
+		glVertexBindingDivisor(OBJMesh::INSTANCE_BINDING, 1);
+
+		// the dequantisation is per instance too, so a multi-draw can give each draw it's chunk's.
+		// a single chunk's draw binds it's own with a stride of 0 instead
+		for (unsigned int i = 0; i < 2; ++i) {
+			glEnableVertexAttribArray(8 + i);
+			glVertexAttribFormat(8 + i, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 4 * i);
+			glVertexAttribBinding(8 + i, OBJMesh::DEQUANTISE_BINDING);
+		}
+		glVertexBindingDivisor(OBJMesh::DEQUANTISE_BINDING, 1);
+	}
+
+	GLState::bindVertexArray(0);
+}
+
+unsigned int GeometryArena::growBuffer(unsigned int buffer, size_t oldSize, size_t newSize) {
+
+	// copied through the copy targets, so nothing bound to the vertex array in use is disturbed
+	unsigned int grown = 0;
+	glGenBuffers(1, &grown);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+	if (buffer != 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return grown;
+}
+
+// doubles capacity (from at least minimum) until count more elements fit on the end
+static unsigned int growCapacity(unsigned int capacity, unsigned int minimum, unsigned int count) {
+	unsigned int grown = std::max(minimum, capacity * 2);
+	while (grown - capacity < count)
+		grown *= 2;
+	return grown;
+}
+
+GeometryArena::Allocation GeometryArena::allocate(eVertexFormat format, unsigned int indexType, unsigned int vertexCount, unsigned int indexCount) {
+
+	Allocation allocation;
+	allocation.pool = getPool(format, indexType);
+	Pool& pool = sm_pools[allocation.pool];
+	size_t stride = getVertexStride(format);
+	size_t indexSize = getIndexSize(pool.indexType);
+
+	allocation.baseVertex = pool.vertices.allocate(vertexCount);
+	if (allocation.baseVertex == RangeAllocator::NO_SPACE) {
+		unsigned int capacity = growCapacity(pool.vertices.getCapacity(), MIN_VERTEX_CAPACITY, vertexCount);
+		pool.vbo = growBuffer(pool.vbo, pool.vertices.getCapacity() * stride, capacity * stride);
+		pool.vertices.grow(capacity);
+		allocation.baseVertex = pool.vertices.allocate(vertexCount);
+
+		GLState::bindVertexArray(pool.vao);
+		glBindVertexBuffer(VERTEX_BINDING, pool.vbo, 0, (int)stride);
+		GLState::bindVertexArray(0);
+	}
+	allocation.vertexCount = vertexCount;
+
+	allocation.firstIndex = pool.indices.allocate(indexCount);
+	if (allocation.firstIndex == RangeAllocator::NO_SPACE) {
+		unsigned int capacity = growCapacity(pool.indices.getCapacity(), MIN_INDEX_CAPACITY, indexCount);
+		pool.ibo = growBuffer(pool.ibo, pool.indices.getCapacity() * indexSize, capacity * indexSize);
+		pool.indices.grow(capacity);
+		allocation.firstIndex = pool.indices.allocate(indexCount);
+
+		GLState::bindVertexArray(pool.vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.ibo);
+		GLState::bindVertexArray(0);
+	}
+	allocation.indexCount = indexCount;
+
+	return allocation;
+}
+
+void GeometryArena::release(Allocation& allocation) {
+
+	if (allocation.pool < sm_pools.size()) {
+		Pool& pool = sm_pools[allocation.pool];
+		pool.vertices.release(allocation.baseVertex, allocation.vertexCount);
+		pool.indices.release(allocation.firstIndex, allocation.indexCount);
+	}
+	allocation = Allocation();
+}
+
+void GeometryArena::writeVertices(const Allocation& allocation, size_t offset, size_t size, const void* data) {
+	const Pool& pool = sm_pools[allocation.pool];
+	glBindBuffer(GL_COPY_WRITE_BUFFER, pool.vbo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.baseVertex * getVertexStride(pool.format) + offset, size, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GeometryArena::writeIndices(const Allocation& allocation, size_t size, const void* data) {
+	const Pool& pool = sm_pools[allocation.pool];
+	glBindBuffer(GL_COPY_WRITE_BUFFER, pool.ibo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.firstIndex * getIndexSize(pool.indexType), size, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GeometryArena::Stats GeometryArena::getStats() {
+	Stats stats;
+	for (auto& pool : sm_pools) {
+		if (pool.vao == 0)
+			continue;
+		size_t stride = getVertexStride(pool.format);
+		size_t indexSize = getIndexSize(pool.indexType);
+		stats.allocatedBytes += pool.vertices.getAllocated() * stride + pool.indices.getAllocated() * indexSize;
+		stats.capacityBytes += pool.vertices.getCapacity() * stride + pool.indices.getCapacity() * indexSize;
+		stats.poolCount++;
+	}
+	return stats;
+}
+
+void GeometryArena::destroy() {
+	for (auto& pool : sm_pools) {
+		if (pool.vao == 0)
+			continue;
+		GLState::forgetVertexArray(pool.vao);
+		glDeleteVertexArrays(1, &pool.vao);
+		glDeleteBuffers(1, &pool.vbo);
+		glDeleteBuffers(1, &pool.ibo);
+	}
+	sm_pools.clear();
+}
+
+} // namespace aie
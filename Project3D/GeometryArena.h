@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace aie {
+
+// a few large vertex and index buffers that the geometry of every OBJMesh chunk and Mesh is
+// suballocated from, rather than each owning buffers and a vertex array of it's own. geometry is
+// pooled by vertex format and index type, and each pool has one vertex array, so everything in a
+// pool is drawn without switching vertex arrays, and many draws of it can be issued at once with
+// glMultiDrawElementsIndirect (see DrawCommand). allocations are placed first fit, and a pool's
+// buffers double in size when nothing fits, copying the old contents across on the gpu, so an
+// allocation's offsets stay valid for as long as it lives. must only be used on the opengl thread
+class GeometryArena {
+public:
+
+	// the vertex layouts geometry can be allocated with. obj formats read OBJMesh::Vertex or
+	// OBJMesh::PackedVertex, along with the instance transforms and dequantisation bound at
+	// OBJMesh::INSTANCE_BINDING and OBJMesh::DEQUANTISE_BINDING, and the mesh format Mesh::Vertex
+	enum eVertexFormat : unsigned int {
+		OBJ_VERTEX_FORMAT = 0,
+		OBJ_PACKED_VERTEX_FORMAT,
+		MESH_VERTEX_FORMAT,
+
+		VERTEX_FORMAT_Count
+	};
+
+	// vertex buffer binding index the pooled vertices are sourced from
+	static const unsigned int VERTEX_BINDING = 0;
+
+	// pool of an allocation that doesn't have one
+	static const unsigned int NO_POOL = ~0u;
+
+	// a range of a pool's vertices, and of it's indices (counted in indices of the pool's type)
+	struct Allocation {
+		unsigned int pool = NO_POOL;
+		unsigned int baseVertex = 0;
+		unsigned int vertexCount = 0;
+		unsigned int firstIndex = 0;
+		unsigned int indexCount = 0;
+	};
+
+	// one draw of a glMultiDrawElementsIndirect call, laid out as opengl reads them from the bound
+	// GL_DRAW_INDIRECT_BUFFER. firstIndex and baseVertex include the allocation's offsets, and
+	// instanced attributes are read from baseInstance onwards
+	struct DrawCommand {
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int firstIndex;
+		int baseVertex;
+		unsigned int baseInstance;
+	};
+
+	// bytes handed out across every pool versus the bytes their buffers hold, and the buffers
+	struct Stats {
+		size_t allocatedBytes = 0;
+		size_t capacityBytes = 0;
+		unsigned int poolCount = 0;
+	};
+
+	// reserves vertexCount vertices and indexCount indices (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) in
+	// the pool of the format and index type, creating or growing it as needed. geometry without
+	// indices may give either index type
+	static Allocation allocate(eVertexFormat format, unsigned int indexType, unsigned int vertexCount, unsigned int indexCount);
+
+	// returns an allocation's ranges to it's pool, and resets it
+	static void release(Allocation& allocation);
+
+	// copies size bytes of data into an allocation's vertices, offset bytes from the first, or into
+	// it's indices from the first
+	static void writeVertices(const Allocation& allocation, size_t offset, size_t size, const void* data);
+	static void writeIndices(const Allocation& allocation, size_t size, const void* data);
+
+	// the vertex array every allocation of a pool is drawn with, the buffer it's vertices are
+	// in (which changes when the pool grows) and the type of it's indices
+	static unsigned int getVertexArray(unsigned int pool) { return sm_pools[pool].vao; }
+	static unsigned int getVertexBuffer(unsigned int pool) { return sm_pools[pool].vbo; }
+	static unsigned int getIndexType(unsigned int pool) { return sm_pools[pool].indexType; }
+
+	// bytes of a vertex and an index
+	static size_t getVertexStride(eVertexFormat format);
+	static size_t getIndexSize(unsigned int indexType);
+
+	static Stats getStats();
+
+	// deletes every pool's buffers and vertex array, along with the geometry in them. allocations
+	// still alive can be released afterwards, which does nothing
+	static void destroy();
+
+private:
+
+	// free ranges of a buffer, sorted and with neighbouring ranges merged
+	class RangeAllocator {
+	public:
+
+		static const unsigned int NO_SPACE = ~0u;
+
+		// first of count free elements, or NO_SPACE if no range is big enough
+		unsigned int allocate(unsigned int count);
+		void release(unsigned int first, unsigned int count);
+
+		// adds the elements from the current capacity up to capacity to the free ranges
+		void grow(unsigned int capacity);
+
+		unsigned int getCapacity() const { return m_capacity; }
+		unsigned int getAllocated() const { return m_allocated; }
+
+	private:
+
+		struct Range {
+			unsigned int first;
+			unsigned int count;
+		};
+
+		std::vector<Range>	m_free;
+		unsigned int		m_capacity = 0;
+		unsigned int		m_allocated = 0;
+	};
+
+	struct Pool {
+		eVertexFormat	format;
+		unsigned int	indexType;
+		unsigned int	vao = 0, vbo = 0, ibo = 0;
+		RangeAllocator	vertices;
+		RangeAllocator	indices;
+	};
+
+	// smallest buffers a pool starts with, in vertices and indices
+	static const unsigned int MIN_VERTEX_CAPACITY = 1 << 16;
+	static const unsigned int MIN_INDEX_CAPACITY = 1 << 18;
+
+	static unsigned int getPool(eVertexFormat format, unsigned int indexType);
+	static void createPool(Pool& pool);
+	static unsigned int growBuffer(unsigned int buffer, size_t oldSize, size_t newSize);
+
+	static std::vector<Pool>	sm_pools;
+};
+
+} // namespace aie
@@ -0,0 +1,133 @@
+#include "InstanceStore.h"
+
+/// <summary>
+/// add() appends a new instance to the end of each dense array, and assigns it a slot, reusing the head of
+/// the free slot list if there is one. The slot's generation was already advanced when it was freed, so any
+/// handles still referring to the slot's previous instance stay invalid.
+/// </summary>
+/// <param name="transform">Model transform of the new instance.</param>
+/// <param name="meshID">ID of the mesh to draw the instance with.</param>
+/// <param name="shaderID">ID of the shader program to draw the instance with.</param>
+/// <param name="flags">Initial eInstanceFlags of the instance.</param>
+/// <returns>A handle that refers to the new instance until it is removed.</returns>
+InstanceHandle InstanceStore::add(const glm::mat4& transform, unsigned int meshID, unsigned int shaderID, unsigned int flags)
+{
+	unsigned int denseIndex = (unsigned int)m_transforms.size();
+
+	// Take a slot from the free list, or grow the slot table if there are none
+	unsigned int slotIndex;
+	if (m_freeSlot != ~0u)
+	{
+		slotIndex = m_freeSlot;
+		m_freeSlot = m_slots[slotIndex].denseIndex;
+	}
+	else
+	{
+		slotIndex = (unsigned int)m_slots.size();
+		m_slots.push_back({ 0, 1 });
+	}
+	m_slots[slotIndex].denseIndex = denseIndex;
+
+	m_transforms.push_back(transform);
+	m_meshIDs.push_back(meshID);
+	m_shaderIDs.push_back(shaderID);
+	m_flags.push_back(flags);
+	m_denseToSlot.push_back(slotIndex);
+	m_version++;
+
+	return { slotIndex, m_slots[slotIndex].generation };
+}
+
+/// <summary>
+/// remove() deletes the instance referred to by the handle by moving the last instance of every dense array
+/// into it's place, patching the moved instance's slot to point at it's new dense index, and then popping the
+/// last element. The removed instance's slot has it's generation advanced and is pushed onto the free list.
+/// </summary>
+/// <param name="handle">Handle of the instance to remove.</param>
+/// <returns>False if the handle was already invalid.</returns>
+bool InstanceStore::remove(InstanceHandle handle)
+{
+	if (isValid(handle) == false)
+		return false;
+
+	unsigned int denseIndex = m_slots[handle.index].denseIndex;
+	unsigned int lastIndex = (unsigned int)m_transforms.size() - 1;
+
+	// Swap the last instance into the hole
+	if (denseIndex != lastIndex)
+	{
+		m_transforms[denseIndex] = m_transforms[lastIndex];
+		m_meshIDs[denseIndex] = m_meshIDs[lastIndex];
+		m_shaderIDs[denseIndex] = m_shaderIDs[lastIndex];
+		m_flags[denseIndex] = m_flags[lastIndex];
+		m_denseToSlot[denseIndex] = m_denseToSlot[lastIndex];
+		m_slots[m_denseToSlot[denseIndex]].denseIndex = denseIndex;
+	}
+
+	m_transforms.pop_back();
+	m_meshIDs.pop_back();
+	m_shaderIDs.pop_back();
+	m_flags.pop_back();
+	m_denseToSlot.pop_back();
+
+	// Invalidate outstanding handles and free the slot
+	m_slots[handle.index].generation++;
+	m_slots[handle.index].denseIndex = m_freeSlot;
+	m_freeSlot = handle.index;
+	m_version++;
+
+	return true;
+}
+
+/// <summary>
+/// clear() removes every instance at once, invalidating all outstanding handles by advancing the generation
+/// of every slot and rebuilding the free list to contain every slot.
+/// </summary>
+void InstanceStore::clear()
+{
+	m_transforms.clear();
+	m_meshIDs.clear();
+	m_shaderIDs.clear();
+	m_flags.clear();
+	m_denseToSlot.clear();
+	m_version++;
+
+	m_freeSlot = ~0u;
+	for (unsigned int i = (unsigned int)m_slots.size(); i-- > 0;)
+	{
+		m_slots[i].generation++;
+		m_slots[i].denseIndex = m_freeSlot;
+		m_freeSlot = i;
+	}
+}
+
+/// <summary>
+/// reserve() pre-allocates space in every array for the input number of instances, so that adding that many
+/// instances causes no further allocations.
+/// </summary>
+/// <param name="count">Number of instances to reserve space for.</param>
+void InstanceStore::reserve(size_t count)
+{
+	m_transforms.reserve(count);
+	m_meshIDs.reserve(count);
+	m_shaderIDs.reserve(count);
+	m_flags.reserve(count);
+	m_denseToSlot.reserve(count);
+	m_slots.reserve(count);
+}
+
+/// <summary>
+/// isValid() checks that the handle refers to a slot in the table, that the slot's generation hasn't moved on
+/// since the handle was created (i.e. the instance hasn't been removed), and that the slot is currently in use
+/// rather than sitting in the free list.
+/// </summary>
+/// <param name="handle">Handle to check.</param>
+/// <returns>True if the handle still refers to a live instance.</returns>
+bool InstanceStore::isValid(InstanceHandle handle) const
+{
+	if (handle.index >= m_slots.size() || m_slots[handle.index].generation != handle.generation)
+		return false;
+
+	unsigned int denseIndex = m_slots[handle.index].denseIndex;
+	return denseIndex < m_denseToSlot.size() && m_denseToSlot[denseIndex] == handle.index;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+/// <summary>
+/// An InstanceHandle is a stable reference to an instance in an InstanceStore. The index selects a slot
+/// in the store's slot table, and the generation must match the slot's current generation for the
+/// handle to be valid, so handles to removed instances are safely rejected even after their slot has
+/// been reused by a newer instance.
+/// </summary>
+struct InstanceHandle
+{
+	unsigned int index = ~0u;
+	unsigned int generation = 0;
+
+	bool operator==(const InstanceHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const InstanceHandle& other) const { return !(*this == other); }
+};
+
+// Per-instance flags stored alongside each instance
+enum eInstanceFlags : unsigned int
+{
+	INSTANCE_HIDDEN = 1 << 0, // Instance is skipped entirely when drawing
+	INSTANCE_OCCLUDER = 1 << 1, // Instance's mesh is rasterised into the occlusion buffer, hiding instances behind it
+};
+
+/// <summary>
+/// InstanceStore is a data-oriented container for scene instances, laid out as a structure of arrays so
+/// that the per-frame passes over every instance (culling, batching) walk tightly packed memory rather
+/// than chasing pointers. Transforms, mesh IDs, shader IDs and flags are each stored in their own dense
+/// array, where index i of every array belongs to the same instance. Instances are addressed externally
+/// through generational InstanceHandle's, which map through a slot table to the instance's current dense
+/// index. Removal swaps the last instance into the removed instance's place, so both add() and remove()
+/// are O(1) and the dense arrays never contain holes. The state the scene keeps for an instance while
+/// drawing it (it's LOD and occlusion query) is owned by the scene, indexed by the instance's slot. The
+/// store's version changes whenever an instance is added, removed or has it's flags set, so whatever is
+/// built from the mesh IDs, shader IDs and flags only needs rebuilding when the version moves on.
+/// </summary>
+class InstanceStore
+{
+public:
+
+	InstanceStore() {}
+	~InstanceStore() {}
+
+	// Adding and removing instances
+	InstanceHandle add(const glm::mat4& transform, unsigned int meshID, unsigned int shaderID, unsigned int flags = 0);
+	bool remove(InstanceHandle handle);
+	void clear();
+	void reserve(size_t count);
+
+	// Handle lookup
+	bool isValid(InstanceHandle handle) const;
+	unsigned int getDenseIndex(InstanceHandle handle) const { return m_slots[handle.index].denseIndex; }
+
+	// Per-instance access through a handle, the handle must be valid
+	glm::mat4& getTransform(InstanceHandle handle) { return m_transforms[getDenseIndex(handle)]; }
+	unsigned int getMeshID(InstanceHandle handle) const { return m_meshIDs[getDenseIndex(handle)]; }
+	unsigned int getShaderID(InstanceHandle handle) const { return m_shaderIDs[getDenseIndex(handle)]; }
+	unsigned int getFlags(InstanceHandle handle) const { return m_flags[getDenseIndex(handle)]; }
+	void setFlags(InstanceHandle handle, unsigned int flags) { m_flags[getDenseIndex(handle)] = flags; m_version++; }
+
+	// Dense array access, every array is size() long
+	size_t size() const { return m_transforms.size(); }
+	const glm::mat4* getTransforms() const { return m_transforms.data(); }
+	glm::mat4* getTransforms() { return m_transforms.data(); }
+	const unsigned int* getMeshIDs() const { return m_meshIDs.data(); }
+	const unsigned int* getShaderIDs() const { return m_shaderIDs.data(); }
+	const unsigned int* getFlags() const { return m_flags.data(); }
+	InstanceHandle getHandle(unsigned int denseIndex) const { return { m_denseToSlot[denseIndex], m_slots[m_denseToSlot[denseIndex]].generation }; }
+	unsigned int getVersion() const { return m_version; }
+
+protected:
+
+	/// <summary>
+	/// A Slot maps a handle's index to an instance's dense index. While a slot is free, denseIndex instead
+	/// holds the index of the next free slot, forming a free list through the slot table.
+	/// </summary>
+	struct Slot
+	{
+		unsigned int denseIndex;
+		unsigned int generation;
+	};
+
+	// Dense instance data
+	std::vector<glm::mat4> m_transforms;
+	std::vector<unsigned int> m_meshIDs;
+	std::vector<unsigned int> m_shaderIDs;
+	std::vector<unsigned int> m_flags;
+	std::vector<unsigned int> m_denseToSlot; // Slot index of each dense instance, used to patch the slot of a swapped instance on removal
+
+	// Handle indirection
+	std::vector<Slot> m_slots;
+	unsigned int m_freeSlot = ~0u; // Head of the free slot list
+	unsigned int m_version = 0; // Advanced by every change to the mesh IDs, shader IDs or flags, transforms aside
+};
@@ -1,6 +1,10 @@
 #pragma once
 #include "Gizmos.h"
 #include "glm/vec3.hpp"
+#include "glm/common.hpp"
+#include <cmath>
+
+#define LIGHT_CUTOFF 0.05f // Light reaching a surface below this brightness is ignored, bounding the range of point lights
 
 /// <summary>
 /// Light is a class used to represent both the directional lights and point lights in the main scene.
@@ -20,8 +24,12 @@ struct Light
 		intensity = aIntensity;
 	}
 
+	// getRange returns the distance at which a point light's inverse square falloff drops below LIGHT_CUTOFF, past
+	// which the light is treated as having no effect (the lit shaders window the falloff to reach zero there)
+	float getRange() const { return sqrt(glm::max(colour.r, glm::max(colour.g, colour.b)) * intensity / LIGHT_CUTOFF); }
+
 	// drawGizmo simply draws of small sphere gizmo at the position of the point light using it's colour
-	void drawGizmo() { aie::Gizmos::addSphere(direction, 0.2f, 20, 20, vec4(colour * intensity, 1)); }
+	void drawGizmo() { aie::Gizmos::addSphere(direction, 0.2f, 20, 20, glm::vec4(colour * intensity, 1)); }
 
 	glm::vec3 direction;
 	glm::vec3 colour;
@@ -0,0 +1,223 @@
+#include "LightClusterGrid.h"
+#include "Light.h"
+#include "Shader.h"
+#include "gl_core_4_4.h"
+#include <glm/common.hpp>
+#include <cmath>
+
+/// <summary>
+/// ~LightClusterGrid() deletes the storage buffers if they were ever created.
+/// </summary>
+LightClusterGrid::~LightClusterGrid()
+{
+	if (m_lightBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_lightBuffer);
+		glDeleteBuffers(1, &m_clusterBuffer);
+		glDeleteBuffers(1, &m_lightIndexBuffer);
+	}
+}
+
+/// <summary>
+/// buildClusterBounds() calculates the view space AABB of every cluster. The depth slices are spaced exponentially,
+/// so slice k spans near * (far / near)^(k / Z) to near * (far / near)^((k + 1) / Z), and a tile's sides are found by
+/// scaling it's NDC edges by the view depth over the projection's focal length at both the near and far depth of
+/// the slice. The scale and bias that turn log(depth) back into a slice index are also calculated for the shaders.
+/// </summary>
+/// <param name="projection">The camera's (symmetric perspective) projection transform.</param>
+/// <param name="nearPlane">The camera's near plane distance.</param>
+/// <param name="farPlane">The camera's far plane distance.</param>
+void LightClusterGrid::buildClusterBounds(const glm::mat4& projection, float nearPlane, float farPlane)
+{
+	m_boundsProjection = projection;
+	m_nearPlane = nearPlane;
+	m_farPlane = farPlane;
+	m_sliceScale = CLUSTER_COUNT_Z / std::log(farPlane / nearPlane);
+	m_sliceBias = CLUSTER_COUNT_Z * std::log(nearPlane) / std::log(farPlane / nearPlane);
+
+	m_clusterBounds.resize(CLUSTER_COUNT);
+	for (unsigned int z = 0; z < CLUSTER_COUNT_Z; z++)
+	{
+		float sliceNear = nearPlane * std::pow(farPlane / nearPlane, (float)z / CLUSTER_COUNT_Z);
+		float sliceFar = nearPlane * std::pow(farPlane / nearPlane, (float)(z + 1) / CLUSTER_COUNT_Z);
+		for (unsigned int y = 0; y < CLUSTER_COUNT_Y; y++)
+		{
+			float ndcMinY = -1.0f + 2.0f * y / CLUSTER_COUNT_Y;
+			float ndcMaxY = -1.0f + 2.0f * (y + 1) / CLUSTER_COUNT_Y;
+			for (unsigned int x = 0; x < CLUSTER_COUNT_X; x++)
+			{
+				float ndcMinX = -1.0f + 2.0f * x / CLUSTER_COUNT_X;
+				float ndcMaxX = -1.0f + 2.0f * (x + 1) / CLUSTER_COUNT_X;
+
+				// The tile's sides fan out with depth, so the box must enclose both it's near and far face
+				ClusterBounds& bounds = m_clusterBounds[x + y * CLUSTER_COUNT_X + z * CLUSTER_COUNT_X * CLUSTER_COUNT_Y];
+				bounds.min.x = glm::min(ndcMinX * sliceNear, ndcMinX * sliceFar) / projection[0][0];
+				bounds.max.x = glm::max(ndcMaxX * sliceNear, ndcMaxX * sliceFar) / projection[0][0];
+				bounds.min.y = glm::min(ndcMinY * sliceNear, ndcMinY * sliceFar) / projection[1][1];
+				bounds.max.y = glm::max(ndcMaxY * sliceNear, ndcMaxY * sliceFar) / projection[1][1];
+				bounds.min.z = -sliceFar;
+				bounds.max.z = -sliceNear;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// getSlice() returns the depth slice that a view depth falls in, clamped into the grid.
+/// </summary>
+/// <param name="viewDepth">Positive distance in front of the camera.</param>
+/// <returns>The index of the depth slice.</returns>
+unsigned int LightClusterGrid::getSlice(float viewDepth) const
+{
+	float slice = std::log(glm::max(viewDepth, m_nearPlane)) * m_sliceScale - m_sliceBias;
+	return (unsigned int)glm::clamp(slice, 0.0f, (float)(CLUSTER_COUNT_Z - 1));
+}
+
+/// <summary>
+/// assignLights() finds every cluster each point light's sphere of influence touches. A light's candidate clusters
+/// are narrowed down first, the depth slices from the nearest and furthest depth of the sphere, and the tiles from
+/// projecting the corners of the sphere's view space box at it's nearest and furthest depth. Each candidate
+/// cluster's box is then tested against the sphere exactly. The assignments are then counting sorted by cluster
+/// into one compact light index list, with each cluster's offset and count into it stored in m_clusterRanges.
+/// </summary>
+/// <param name="lights">The scene's point lights, where direction holds each light's position.</param>
+/// <param name="projection">The camera's projection transform this frame.</param>
+/// <param name="view">The camera's view transform this frame.</param>
+/// <param name="nearPlane">The camera's near plane distance.</param>
+/// <param name="farPlane">The camera's far plane distance.</param>
+void LightClusterGrid::assignLights(const std::vector<Light>& lights, const glm::mat4& projection, const glm::mat4& view, float nearPlane, float farPlane)
+{
+	if (m_clusterBounds.empty() || projection != m_boundsProjection || nearPlane != m_nearPlane || farPlane != m_farPlane)
+		buildClusterBounds(projection, nearPlane, farPlane);
+
+	m_lights.clear();
+	m_assignedClusters.clear();
+	m_assignedLights.clear();
+
+	for (auto& light : lights)
+	{
+		float range = light.getRange();
+		glm::vec3 centre = glm::vec3(view * glm::vec4(light.direction, 1));
+		float depth = -centre.z;
+		if (range <= 0 || depth + range < nearPlane || depth - range > farPlane)
+			continue;
+
+		// Slice range from the sphere's depth extent
+		float nearestDepth = glm::max(depth - range, nearPlane);
+		float furthestDepth = glm::min(depth + range, farPlane);
+		unsigned int minSlice = getSlice(nearestDepth);
+		unsigned int maxSlice = getSlice(furthestDepth);
+
+		// Tile range from the corners of the sphere's box, which project furthest out at the nearest depth
+		glm::vec2 ndcMin(1), ndcMax(-1);
+		for (float cornerDepth : { nearestDepth, furthestDepth })
+		{
+			for (float offsetX : { -range, range })
+			{
+				for (float offsetY : { -range, range })
+				{
+					glm::vec2 ndc((centre.x + offsetX) * projection[0][0] / cornerDepth, (centre.y + offsetY) * projection[1][1] / cornerDepth);
+					ndcMin = glm::min(ndcMin, ndc);
+					ndcMax = glm::max(ndcMax, ndc);
+				}
+			}
+		}
+		if (ndcMin.x > 1 || ndcMin.y > 1 || ndcMax.x < -1 || ndcMax.y < -1)
+			continue;
+		unsigned int minX = (unsigned int)glm::clamp((ndcMin.x * 0.5f + 0.5f) * CLUSTER_COUNT_X, 0.0f, (float)(CLUSTER_COUNT_X - 1));
+		unsigned int maxX = (unsigned int)glm::clamp((ndcMax.x * 0.5f + 0.5f) * CLUSTER_COUNT_X, 0.0f, (float)(CLUSTER_COUNT_X - 1));
+		unsigned int minY = (unsigned int)glm::clamp((ndcMin.y * 0.5f + 0.5f) * CLUSTER_COUNT_Y, 0.0f, (float)(CLUSTER_COUNT_Y - 1));
+		unsigned int maxY = (unsigned int)glm::clamp((ndcMax.y * 0.5f + 0.5f) * CLUSTER_COUNT_Y, 0.0f, (float)(CLUSTER_COUNT_Y - 1));
+
+		unsigned int lightIndex = (unsigned int)m_lights.size();
+		m_lights.push_back({ glm::vec4(light.direction, range), glm::vec4(light.colour * light.intensity, 1) });
+
+		// Test the sphere against each candidate cluster's box exactly
+		float rangeSquared = range * range;
+		for (unsigned int z = minSlice; z <= maxSlice; z++)
+		{
+			for (unsigned int y = minY; y <= maxY; y++)
+			{
+				for (unsigned int x = minX; x <= maxX; x++)
+				{
+					unsigned int cluster = x + y * CLUSTER_COUNT_X + z * CLUSTER_COUNT_X * CLUSTER_COUNT_Y;
+					const ClusterBounds& bounds = m_clusterBounds[cluster];
+					glm::vec3 closest = glm::clamp(centre, bounds.min, bounds.max);
+					glm::vec3 offset = closest - centre;
+					if (glm::dot(offset, offset) <= rangeSquared)
+					{
+						m_assignedClusters.push_back(cluster);
+						m_assignedLights.push_back(lightIndex);
+					}
+				}
+			}
+		}
+	}
+
+	// Counting sort the assignments by cluster, into each cluster's range of the light index list
+	m_clusterRanges.assign(CLUSTER_COUNT, { 0, 0 });
+	for (unsigned int cluster : m_assignedClusters)
+	{
+		m_clusterRanges[cluster].count++;
+	}
+
+	unsigned int offset = 0;
+	m_maxClusterLightCount = 0;
+	m_occupiedClusterCount = 0;
+	for (auto& range : m_clusterRanges)
+	{
+		range.offset = offset;
+		offset += range.count;
+		m_maxClusterLightCount = glm::max(m_maxClusterLightCount, range.count);
+		if (range.count > 0)
+			m_occupiedClusterCount++;
+		range.count = 0;
+	}
+
+	m_lightIndices.resize(m_assignedLights.size());
+	for (size_t i = 0; i < m_assignedLights.size(); i++)
+	{
+		ClusterRange& range = m_clusterRanges[m_assignedClusters[i]];
+		m_lightIndices[range.offset + range.count++] = m_assignedLights[i];
+	}
+}
+
+/// <summary>
+/// upload() streams the last assignment into the light, cluster and light index storage buffers, creating them on
+/// first use. The light and index buffers are orphaned each frame, and only grown (to double the required size)
+/// when they are too small. Each buffer is then attached to it's fixed binding point for the lit shaders.
+/// </summary>
+void LightClusterGrid::upload()
+{
+	if (m_lightBuffer == 0)
+	{
+		glGenBuffers(1, &m_lightBuffer);
+		glGenBuffers(1, &m_clusterBuffer);
+		glGenBuffers(1, &m_lightIndexBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, CLUSTER_COUNT * sizeof(ClusterRange), nullptr, GL_STREAM_DRAW);
+	}
+
+	// Storage buffers can't be empty, so always hold at least one element
+	size_t lightSize = glm::max(m_lights.size(), (size_t)1) * sizeof(GPULight);
+	if (lightSize > m_lightBufferSize)
+		m_lightBufferSize = lightSize * 2;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_lightBufferSize, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_lights.size() * sizeof(GPULight), m_lights.data());
+
+	size_t indexSize = glm::max(m_lightIndices.size(), (size_t)1) * sizeof(unsigned int);
+	if (indexSize > m_lightIndexBufferSize)
+		m_lightIndexBufferSize = indexSize * 2;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightIndexBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_lightIndexBufferSize, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_lightIndices.size() * sizeof(unsigned int), m_lightIndices.data());
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, CLUSTER_COUNT * sizeof(ClusterRange), m_clusterRanges.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::POINT_LIGHT_STORAGE, m_lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::LIGHT_CLUSTER_STORAGE, m_clusterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, aie::LIGHT_INDEX_STORAGE, m_lightIndexBuffer);
+}
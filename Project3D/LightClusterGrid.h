@@ -0,0 +1,100 @@
+#pragma once
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+struct Light;
+
+/// <summary>
+/// LightClusterGrid implements the CPU side of clustered forward lighting. The camera frustum is divided into
+/// a 3D grid of froxels (clusters), CLUSTER_COUNT_X by CLUSTER_COUNT_Y screen tiles and CLUSTER_COUNT_Z depth
+/// slices, with the slices spaced exponentially between the near and far planes so that clusters stay roughly
+/// cube shaped. Every frame, each point light's sphere of influence is tested against the clusters it could
+/// touch, and the result is packed into a compact light index list per cluster. The lights, cluster ranges and
+/// index list are then uploaded into three shader storage buffers, so that each fragment of the lit shaders only
+/// loops over the lights assigned to the cluster it falls in, rather than every light in the scene.
+/// </summary>
+class LightClusterGrid
+{
+public:
+
+	static const unsigned int CLUSTER_COUNT_X = 16;
+	static const unsigned int CLUSTER_COUNT_Y = 9;
+	static const unsigned int CLUSTER_COUNT_Z = 24;
+	static const unsigned int CLUSTER_COUNT = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+
+	/// <summary>
+	/// A GPULight mirrors the std430 PointLight struct in the lit shaders, the position and range of the light
+	/// packed into one vec4, and the light's colour pre-multiplied by it's intensity.
+	/// </summary>
+	struct GPULight
+	{
+		glm::vec4 positionRange;
+		glm::vec4 colour;
+	};
+
+	/// <summary>
+	/// A ClusterRange mirrors the uvec2 per cluster in the lit shaders, the start and length of the cluster's
+	/// lights in the light index list.
+	/// </summary>
+	struct ClusterRange
+	{
+		unsigned int offset;
+		unsigned int count;
+	};
+
+	LightClusterGrid() {}
+	~LightClusterGrid();
+
+	// Assigns the lights to clusters of the frustum described by the camera transforms (CPU only)
+	void assignLights(const std::vector<Light>& lights, const glm::mat4& projection, const glm::mat4& view, float nearPlane, float farPlane);
+	// Uploads the last assignment into the storage buffers and binds them to their binding points
+	void upload();
+
+	// Slice scale and bias that turn log(view depth) into a depth slice, for the Lights uniform block
+	glm::vec2 getSliceScaleBias() const { return glm::vec2(m_sliceScale, m_sliceBias); }
+
+	// Statistics of the last assignment
+	unsigned int getLightCount() const { return (unsigned int)m_lights.size(); }
+	unsigned int getLightIndexCount() const { return (unsigned int)m_lightIndices.size(); }
+	unsigned int getMaxClusterLightCount() const { return m_maxClusterLightCount; }
+	unsigned int getOccupiedClusterCount() const { return m_occupiedClusterCount; }
+
+protected:
+
+	// Min and max corners of a cluster in view space
+	struct ClusterBounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	void buildClusterBounds(const glm::mat4& projection, float nearPlane, float farPlane);
+	unsigned int getSlice(float viewDepth) const;
+
+	// Cluster geometry, only rebuilt when the projection changes
+	std::vector<ClusterBounds> m_clusterBounds;
+	glm::mat4 m_boundsProjection = glm::mat4(0);
+	float m_nearPlane = 0;
+	float m_farPlane = 0;
+	float m_sliceScale = 0;
+	float m_sliceBias = 0;
+
+	// Result of the last assignment, in the layout they are uploaded in
+	std::vector<GPULight> m_lights;
+	std::vector<ClusterRange> m_clusterRanges;
+	std::vector<unsigned int> m_lightIndices;
+	std::vector<unsigned int> m_assignedClusters; // Cluster of every light to cluster assignment
+	std::vector<unsigned int> m_assignedLights; // Light of every light to cluster assignment
+	unsigned int m_maxClusterLightCount = 0;
+	unsigned int m_occupiedClusterCount = 0;
+
+	// Storage buffers, created on first upload
+	unsigned int m_lightBuffer = 0;
+	unsigned int m_clusterBuffer = 0;
+	unsigned int m_lightIndexBuffer = 0;
+	size_t m_lightBufferSize = 0;
+	size_t m_lightIndexBufferSize = 0;
+};
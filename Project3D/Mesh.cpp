@@ -1,24 +1,21 @@
 #include "Mesh.h"
 #include <gl_core_4_4.h>
+#include "GLState.h"
 
 /// <summary>
-/// The deconstructor for Mesh simply uses the appropriate OpenGL calls to delete the VAO, VBO and IBO variable
-/// data.
+/// The deconstructor for Mesh simply hands this mesh's vertices and indices back to the geometry arena.
 /// </summary>
 Mesh::~Mesh()
 {
-	glDeleteVertexArrays(1, &vao);
-	glDeleteBuffers(1, &vbo);
-	glDeleteBuffers(1, &ibo);
+	aie::GeometryArena::release(geometry);
 }
 
 /// <summary>
 /// initialise() takes an input of the number of vertices to initialise for this mesh, a pointer to said
 /// vertices, the number of indices to use for this mesh (if any), and a pointer to said indices (if any),
-/// and will then generate, bind and fill the vertex array and buffer objects for this mesh to be used
-/// when drawing, as well as the index buffer object if any indices have been passed to the function. The 
-/// function finishes by filling the VBO with said vertices, and then enables the position, normal and 
-/// texCoord variables as OpenGL attributes to be passed correctly to whichever shader is bound.
+/// and will then allocate room for them in the geometry arena's Mesh::Vertex pool and fill it. The pool's
+/// vertex array object already enables the position, normal and texCoord variables as OpenGL attributes
+/// to be passed correctly to whichever shader is bound.
 /// </summary>
 /// <param name="vertexCount"></param>
 /// <param name="vertices"></param>
@@ -27,41 +24,16 @@ Mesh::~Mesh()
 void Mesh::initialise(unsigned int vertexCount, const Vertex* vertices, unsigned int indexCount, unsigned int* indices)
 {
 	// Make sure the mesh is not already initialised
-	assert(vao == 0);
+	assert(geometry.pool == aie::GeometryArena::NO_POOL);
 
-	// Generate the buffer and array object
-	glGenBuffers(1, &vbo);
-	glGenVertexArrays(1, &vao);
-	
-	// Bind the buffers to be ready for manipulating
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	// Allocate the vertices and indices in the arena, and fill them with the arrays
+	geometry = aie::GeometryArena::allocate(aie::GeometryArena::MESH_VERTEX_FORMAT, GL_UNSIGNED_INT, vertexCount, indexCount);
+	aie::GeometryArena::writeVertices(geometry, 0, sizeof(Vertex) * vertexCount, vertices);
 
-	// Fill the buffer with the vertices array
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertexCount, vertices, GL_STATIC_DRAW);
-
-	// Enable the first element as position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
-
-	// Enable the second element as normal
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(Vertex), (void*)sizeof(glm::vec4));
-
-	// Enable the third element as textCoord
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2));
-
-	// If an index buffer was sent, then we need to generate the IBO, bind and fill it
+	// If an index buffer was sent, then the number of tri's will depend on the number of indexes used
 	if (indexCount > 0)
 	{
-		glGenBuffers(1, &ibo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-
-		// Fill the buffer with the vertices array
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indexCount, indices, GL_STATIC_DRAW);
-
-		// The number of tri's will depend on the number of indexes used
+		aie::GeometryArena::writeIndices(geometry, sizeof(unsigned int) * indexCount, indices);
 		triCount = indexCount / 3;
 	}
 	// If no index buffer was sent, just set triCount using vertexCount
@@ -69,36 +41,16 @@ void Mesh::initialise(unsigned int vertexCount, const Vertex* vertices, unsigned
 	{
 		triCount = vertexCount / 3;
 	}
-	
-	// Unbind buffers
-	glBindVertexArray(0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 /// <summary>
 /// initialiseQuad() is a utility function used to initialise this mesh object as a flat quad made up of two
 /// tris (therefore 6 vertices as it doesn't make use of an index buffer). The quad created is 1 by 1 units
-/// across in model space. The function initially follows the standard initialisation pattern of generating
-/// and binding the VAO and VBO member variables, and will then set up an array of 6 vertices representing the
-/// 2 tris that make up the quad. For each vertex, the function initialises the vertex's corresponding position,
-/// normal, and texCoord variables. The function finishes by filling the VBO with said vertices, and then enables
-/// the position, normal and texCoord variables as OpenGL attributes to be passed correctly to whichever 
-/// shader is bound.
+/// across in model space. For each of the 6 vertices, the function initialises the vertex's corresponding
+/// position, normal, and texCoord variables, and then passes them to initialise().
 /// </summary>
 void Mesh::initialiseQuad()
 {
-	// Make sure the mesh is not already initialised
-	assert(vao == 0);
-
-	// Generate the buffers
-	glGenBuffers(1, &vbo);
-	glGenVertexArrays(1, &vao);
-
-	// Bind the buffers to be ready for editing/drawing
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
 	// Define 6 vertices and for 2 triangles (not using ibo), and set their corresponding UV coordinates
 	Vertex vertices[6];
 	// Tri 1
@@ -122,50 +74,19 @@ void Mesh::initialiseQuad()
 	vertices[5].texCoord = { 1, 0 }; 
 	vertices[5].normal = { 0, 1, 0, 0 };
 
-	triCount = 2;
-
-	// Fill the vbo with the vertices data
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * 6, vertices, GL_STATIC_DRAW);
-
-	// Enable the first element as position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
-
-	// Enable the second element as normal
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(Vertex), (void*)sizeof(glm::vec4));
-
-	// Enable the third element as texCoord
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2));
-
-	// Unbind the buffers as we are done assigning to them
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	initialise(6, vertices);
 }
 
 /// <summary>
 /// initialiseFullscreenQuad() is a function used to initialise this mesh with 6 vertices that are pre-positioned
 /// in the four corners of screen space (6 vertices are used as the fullscreen quad mesh doesn't use an index buffer).
-/// The function follows the standard initialisation sequence of generating and binding the VAO and VBO member 
-/// variables using the appropriate OpenGL calls, but then fills the VBO with 6 2D vertices ranging from 
-/// -1, -1 to 1, 1 for the bottom left and top right corners of the screen respectively.
+/// The vertices range from -1, -1 to 1, 1 for the bottom left and top right corners of the screen respectively,
+/// and are passed to initialise() like any other mesh's, with the shaders only reading the x and y of their positions.
 /// </summary>
 void Mesh::initialiseFullscreenQuad()
 {
-	// Make sure the mesh is not already initialised
-	assert(vao == 0);
-
-	// Generate the buffers
-	glGenBuffers(1, &vbo);
-	glGenVertexArrays(1, &vao);
-
-	// Bind the buffers to be ready for manipulating
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
 	// Define 6 vertices and 2 triangles (not using an ibo), and set their corresponding screen-space coordinates
-	float vertices[] = {
+	float corners[] = {
 		-1,1, // left top 
 		-1,-1, // left bottom 
 		1,1, // right top 
@@ -173,38 +94,67 @@ void Mesh::initialiseFullscreenQuad()
 		1,-1, // right bottom 
 		1, 1 // right top
 	};
-	triCount = 2;
+	Vertex vertices[6];
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		vertices[i].position = { corners[i * 2], corners[i * 2 + 1], 0, 1 };
+		vertices[i].normal = { 0, 0, 1, 0 };
+		vertices[i].texCoord = { 0, 0 };
+	}
 
-	// Fill the vbo with the vertices data
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 12, vertices, GL_STATIC_DRAW);
+	initialise(6, vertices);
+}
 
-	// Enable the first element as position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 8, 0);
+/// <summary>
+/// initialiseBox() is a utility function used to initialise this mesh as a closed box spanning -1 to 1 on every
+/// axis, made up of 8 shared corner vertices and an index buffer of 12 tris, each wound counter-clockwise when
+/// viewed from outside the box so that it's front faces survive back face culling. Scaling and translating the box
+/// by a bounding box's extents and centre covers exactly that bounding box. The corners are passed to initialise(),
+/// with the normals pointing out through each corner and no texture coordinates.
+/// </summary>
+void Mesh::initialiseBox()
+{
+	// Corner i sits at the positive end of the x, y and z axes when bits 0, 1 and 2 of i are set respectively
+	Vertex vertices[8];
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		vertices[i].position = { (i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f };
+		vertices[i].normal = { vertices[i].position.x, vertices[i].position.y, vertices[i].position.z, 0 };
+		vertices[i].texCoord = { 0, 0 };
+	}
+
+	// Two tris for each face, in the order +x, -x, +y, -y, +z, -z
+	unsigned int indices[36] = {
+		1, 3, 7, 1, 7, 5,
+		0, 4, 6, 0, 6, 2,
+		2, 6, 7, 2, 7, 3,
+		0, 1, 5, 0, 5, 4,
+		4, 5, 7, 4, 7, 6,
+		0, 2, 3, 0, 3, 1
+	};
 
-	// Unbind the buffers as we are done assigning to them
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	initialise(8, vertices, 36, indices);
 }
 
 /// <summary>
 /// draw() is used to trigger the OpenGL draw sequence for this Mesh object.
-/// The function first binds the Vertex Array Object (vao) of this mesh using
-/// the appropriate OpenGL call, and will then either draw the mesh using the
-/// OpenGL function glDrawElements or glDrawArrays, depending on whether 
-/// or not this mesh was set up to use an index buffer.
+/// The function first binds the Vertex Array Object of the geometry arena
+/// pool this mesh is in using the appropriate OpenGL call, and will then either
+/// draw the mesh using the OpenGL function glDrawElementsBaseVertex or glDrawArrays,
+/// offset to this mesh's range of the pool, depending on whether or not this mesh
+/// was set up to use an index buffer.
 /// </summary>
 void Mesh::draw()
 {
-	glBindVertexArray(vao);
+	aie::GLState::bindVertexArray(aie::GeometryArena::getVertexArray(geometry.pool));
 
 	// Check if we are drawing using an index buffer or just vertices
-	if (ibo != 0)
+	if (geometry.indexCount > 0)
 	{
-		glDrawElements(GL_TRIANGLES, 3 * triCount, GL_UNSIGNED_INT, 0);
+		glDrawElementsBaseVertex(GL_TRIANGLES, 3 * triCount, GL_UNSIGNED_INT, (void*)(geometry.firstIndex * sizeof(unsigned int)), geometry.baseVertex);
 	}
 	else
 	{
-		glDrawArrays(GL_TRIANGLES, 0, 3 * triCount);
+		glDrawArrays(GL_TRIANGLES, geometry.baseVertex, 3 * triCount);
 	}
 }
@@ -2,21 +2,22 @@
 
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
+#include "GeometryArena.h"
 
 /// <summary>
 /// Mesh is a wrapper class used to manage the initialisation and OpenGL based drawing
-/// of a mesh based objects. It holds member variables to track the tri count, vertex
-/// array and buffer objects, as well as the index buffer object if this Mesh is
-/// initialised with one. The class on initialise() will generate and bind the OpenGL
-/// buffers required to draw this mesh, and will also enable the vertex data as OpenGL
-/// attributes. On draw(), the class will call one of two OpenGL glDraw functions depending
+/// of a mesh based objects. It holds member variables to track the tri count, and the
+/// range of the geometry arena's vertex and index buffers that this Mesh was given. The
+/// class on initialise() will allocate and fill it's vertices (and indices if it has any)
+/// in the arena's Mesh::Vertex pool, whose vertex array already enables the vertex data as
+/// OpenGL attributes. On draw(), the class will call one of two OpenGL glDraw functions depending
 /// on whether or not the mesh has been set up to draw using an index buffer.
 /// </summary>
 class Mesh
 {
 public:
 
-	Mesh() : triCount(0), vao(0), vbo(0), ibo(0) {} // Initialise members to 0, as they are properly initialised in the initialise() function
+	Mesh() : triCount(0) {} // Initialise members to 0, as they are properly initialised in the initialise() function
 	virtual ~Mesh();
 
 	/// <summary>
@@ -34,13 +35,14 @@ public:
 	void initialise(unsigned int vertexCount, const Vertex* vertices, unsigned int indexCount = 0, unsigned int* indices = nullptr);
 	void initialiseQuad();
 	void initialiseFullscreenQuad(); // Covers the screen for post processing
+	void initialiseBox(); // Spans -1 to 1 on every axis, for drawing bounding boxes
 
 	virtual void draw();
 
 protected:
 
 	unsigned int triCount; // Calculated once vertices and primative indices have been passed
-	unsigned int vao, vbo, ibo; // Vertex Array and Buffer Objects, and Index Buffer Object
+	aie::GeometryArena::Allocation geometry; // Vertices and indices (if any) in the geometry arena, drawn with it's pool's Vertex Array Object
 
 };
 
@@ -0,0 +1,292 @@
+#include "MeshOptimizer.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Tuning of Forsyth's vertex scores, from his original article
+static const unsigned int SCORE_CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+/// <summary>
+/// vertexScore() scores how much drawing one of a vertex's triangles next would help, from where the vertex sits in
+/// the modelled LRU cache (the three vertices of the last triangle score a fixed amount so that strips don't simply
+/// turn back on themselves, and the rest decay towards the back of the cache), plus a boost for vertices with few
+/// triangles left, so that lone triangles are picked up rather than left stranded for later.
+/// </summary>
+/// <param name="cachePosition">Position of the vertex in the LRU cache, or -1 if it isn't in the cache.</param>
+/// <param name="remainingValence">Number of the vertex's triangles not yet drawn.</param>
+/// <returns>The vertex's score, -1 once all of it's triangles are drawn.</returns>
+static float vertexScore(int cachePosition, unsigned int remainingValence)
+{
+	if (remainingValence == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+			score = LAST_TRIANGLE_SCORE;
+		else
+			score = powf(1.0f - (cachePosition - 3) / (float)(SCORE_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+	return score + VALENCE_BOOST_SCALE * powf((float)remainingValence, -VALENCE_BOOST_POWER);
+}
+
+/// <summary>
+/// analyzeVertexCache() replays the triangles through a FIFO cache of FIFO_CACHE_SIZE vertices, which is how most
+/// hardware's post-transform cache behaves, counting every vertex that wasn't in the cache as a miss.
+/// </summary>
+/// <param name="indices">Triangle list to analyse.</param>
+/// <param name="indexCount">Number of indices in the list.</param>
+/// <param name="vertexCount">Number of vertices the indices refer into.</param>
+/// <returns>The triangle, used vertex and cache miss counts.</returns>
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	CacheStats stats;
+	stats.triangles = (unsigned int)(indexCount / 3);
+
+	// A vertex is in the cache while fewer than FIFO_CACHE_SIZE misses have happened since it was last pushed
+	std::vector<unsigned int> pushedAt(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int pushes = FIFO_CACHE_SIZE + 1;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int vertex = indices[i];
+		if (used[vertex] == false)
+		{
+			used[vertex] = true;
+			stats.vertices++;
+		}
+		if (pushes - pushedAt[vertex] > FIFO_CACHE_SIZE)
+		{
+			pushedAt[vertex] = pushes++;
+			stats.misses++;
+		}
+	}
+	return stats;
+}
+
+/// <summary>
+/// optimizeVertexCache() greedily reorders the triangles with Forsyth's algorithm. Every vertex is scored by
+/// vertexScore() and every triangle by the sum of it's vertices' scores, and the highest scoring triangle is drawn
+/// next. Drawing it moves it's vertices to the front of a modelled LRU cache, so only the scores of vertices in the
+/// cache (and of those pushed out of it) change, along with the scores of their remaining triangles, and the next
+/// triangle is the best of those. When none of the cached vertices have triangles left, drawing continues from the
+/// first triangle not yet drawn.
+/// </summary>
+/// <param name="indices">Triangle list to reorder in place.</param>
+/// <param name="indexCount">Number of indices in the list.</param>
+/// <param name="vertexCount">Number of vertices the indices refer into.</param>
+void MeshOptimizer::optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	unsigned int triangleCount = (unsigned int)(indexCount / 3);
+	if (triangleCount == 0)
+		return;
+
+	// The triangles of each vertex, the first liveCount of which are yet to be drawn
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < indexCount; i++)
+		offsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> vertexTriangles(indexCount);
+	std::vector<unsigned int> liveCount(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int vertex = indices[i];
+		vertexTriangles[offsets[vertex] + liveCount[vertex]++] = (unsigned int)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = vertexScore(-1, liveCount[v]);
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> drawn(triangleCount, false);
+	for (unsigned int t = 0; t < triangleCount; t++)
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+	std::vector<unsigned int> result;
+	result.reserve(indexCount);
+	std::vector<unsigned int> cache, nextCache;
+	cache.reserve(SCORE_CACHE_SIZE + 3);
+	nextCache.reserve(SCORE_CACHE_SIZE + 3);
+
+	int best = (int)(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+	unsigned int nextUndrawn = 0;
+	for (unsigned int drawnCount = 0; drawnCount < triangleCount; drawnCount++)
+	{
+		if (best < 0)
+		{
+			while (drawn[nextUndrawn])
+				nextUndrawn++;
+			best = (int)nextUndrawn;
+		}
+
+		// Draw the triangle, removing it from each of it's vertices' live triangles
+		drawn[best] = true;
+		const unsigned int* triangle = indices + best * 3;
+		for (unsigned int v = 0; v < 3; v++)
+		{
+			unsigned int vertex = triangle[v];
+			result.push_back(vertex);
+			unsigned int* live = vertexTriangles.data() + offsets[vertex];
+			unsigned int* found = std::find(live, live + liveCount[vertex], (unsigned int)best);
+			*found = live[--liveCount[vertex]];
+		}
+
+		// Move the triangle's vertices to the front of the cache, keeping the rest in order behind them
+		nextCache.assign(triangle, triangle + 3);
+		for (auto vertex : cache)
+		{
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				nextCache.push_back(vertex);
+		}
+		std::swap(cache, nextCache);
+
+		// Rescore the cached vertices (and those that just fell out of the cache) and their live triangles, finding the best
+		float bestScore = -1.0f;
+		best = -1;
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			unsigned int vertex = cache[i];
+			cachePosition[vertex] = i < SCORE_CACHE_SIZE ? (int)i : -1;
+			vertexScores[vertex] = vertexScore(cachePosition[vertex], liveCount[vertex]);
+		}
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			unsigned int vertex = cache[i];
+			for (unsigned int t = offsets[vertex]; t < offsets[vertex] + liveCount[vertex]; t++)
+			{
+				unsigned int live = vertexTriangles[t];
+				const unsigned int* liveTriangle = indices + live * 3;
+				float score = vertexScores[liveTriangle[0]] + vertexScores[liveTriangle[1]] + vertexScores[liveTriangle[2]];
+				triangleScores[live] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = (int)live;
+				}
+			}
+		}
+		if (cache.size() > SCORE_CACHE_SIZE)
+			cache.resize(SCORE_CACHE_SIZE);
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+/// <summary>
+/// optimizeOverdraw() splits the cache optimised triangles into clusters wherever a triangle misses the cache for all
+/// three of it's vertices, as the cache is cold at those points anyway and reordering whole clusters barely changes the
+/// ACMR. Each cluster is given the area weighted average normal and centroid of it's triangles, and the clusters are
+/// sorted by how far their centroid sits out along their normal from the mesh's centroid, so the clusters facing out
+/// from the mesh (which are the ones most likely to be in front when seen from any direction) are drawn first and
+/// early depth testing rejects more of what is drawn after them. The new order is only kept if it's ACMR is within
+/// threshold times the cache optimised ACMR.
+/// </summary>
+/// <param name="indices">Cache optimised triangle list to reorder in place.</param>
+/// <param name="indexCount">Number of indices in the list.</param>
+/// <param name="positions">Position of every vertex the indices refer to.</param>
+/// <param name="threshold">Largest factor the reordering may raise the ACMR by.</param>
+void MeshOptimizer::optimizeOverdraw(unsigned int* indices, size_t indexCount, const std::vector<glm::vec3>& positions, float threshold)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Split into clusters at the triangles that miss the FIFO cache entirely
+	std::vector<size_t> clusterStarts;
+	std::vector<unsigned int> pushedAt(positions.size(), 0);
+	unsigned int pushes = FIFO_CACHE_SIZE + 1;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		unsigned int misses = 0;
+		for (unsigned int v = 0; v < 3; v++)
+		{
+			unsigned int vertex = indices[t * 3 + v];
+			if (pushes - pushedAt[vertex] > FIFO_CACHE_SIZE)
+			{
+				pushedAt[vertex] = pushes++;
+				misses++;
+			}
+		}
+		if (misses == 3 || t == 0)
+			clusterStarts.push_back(t);
+	}
+	clusterStarts.push_back(triangleCount);
+	size_t clusterCount = clusterStarts.size() - 1;
+	if (clusterCount < 2)
+		return;
+
+	// Area weighted centroid and normal of every cluster, and of the whole mesh
+	std::vector<glm::vec3> centroids(clusterCount), normals(clusterCount);
+	glm::vec3 meshCentroid(0);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		glm::vec3 centroid(0), normal(0);
+		float area = 0.0f;
+		for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+		{
+			const glm::vec3& p0 = positions[indices[t * 3]];
+			const glm::vec3& p1 = positions[indices[t * 3 + 1]];
+			const glm::vec3& p2 = positions[indices[t * 3 + 2]];
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(cross);
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		centroids[c] = area > 0.0f ? centroid / area : positions[indices[clusterStarts[c] * 3]];
+		float normalLength = glm::length(normal);
+		normals[c] = normalLength > 0.0f ? normal / normalLength : glm::vec3(0);
+		meshCentroid += centroid;
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	std::vector<float> sortKeys(clusterCount);
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		sortKeys[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<unsigned int> result;
+	result.reserve(indexCount);
+	for (auto c : order)
+		result.insert(result.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+
+	float cacheACMR = analyzeVertexCache(indices, indexCount, positions.size()).getACMR();
+	float overdrawACMR = analyzeVertexCache(result.data(), indexCount, positions.size()).getACMR();
+	if (overdrawACMR <= cacheACMR * threshold)
+		std::copy(result.begin(), result.end(), indices);
+}
+
+/// <summary>
+/// optimizeVertexFetch() numbers the vertices in the order the triangles first reference them, so that vertex fetches
+/// walk forwards through the vertex buffer rather than jumping around it. Vertices that no triangle uses are left out.
+/// </summary>
+/// <param name="remap">Filled with the new index of every vertex, or ~0u for unused vertices.</param>
+/// <param name="indices">Triangle list in it's final order.</param>
+/// <param name="indexCount">Number of indices in the list.</param>
+/// <param name="vertexCount">Number of vertices the indices refer into.</param>
+/// <returns>The number of vertices used by the triangles.</returns>
+unsigned int MeshOptimizer::optimizeVertexFetch(std::vector<unsigned int>& remap, const unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	remap.assign(vertexCount, ~0u);
+	unsigned int nextVertex = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (remap[indices[i]] == ~0u)
+			remap[indices[i]] = nextVertex++;
+	}
+	return nextVertex;
+}
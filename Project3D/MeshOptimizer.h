@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <glm/vec3.hpp>
+
+/// <summary>
+/// MeshOptimizer is a collection of static passes that reorder an indexed triangle mesh so the GPU does less
+/// vertex work drawing it, run at load time before the mesh is uploaded. optimizeVertexCache() reorders the
+/// triangles so that vertices are reused while they are still in the post-transform cache (Tom Forsyth's linear
+/// speed vertex cache optimisation), optimizeOverdraw() then reorders clusters of those triangles so that the
+/// outward facing parts of the mesh are drawn first and hide more of what follows, and optimizeVertexFetch()
+/// lastly renumbers the vertices in the order the triangles first use them, so vertex fetching walks the vertex
+/// buffer linearly. analyzeVertexCache() measures the result against a FIFO post-transform cache.
+/// </summary>
+class MeshOptimizer
+{
+public:
+
+	static const unsigned int FIFO_CACHE_SIZE = 16; // Size of the FIFO post-transform cache that analyzeVertexCache() and optimizeOverdraw() simulate
+
+	/// <summary>
+	/// CacheStats is the number of triangles and vertices of a mesh and the post-transform cache misses of
+	/// drawing it, which add together across meshes. ACMR is the average cache misses per triangle (0.5 at
+	/// best for a large regular mesh, 3 at worst), and ATVR the average number of times each vertex is
+	/// transformed (1 at best).
+	/// </summary>
+	struct CacheStats
+	{
+		unsigned int triangles = 0;
+		unsigned int vertices = 0;
+		unsigned int misses = 0;
+
+		void add(const CacheStats& other) { triangles += other.triangles; vertices += other.vertices; misses += other.misses; }
+		float getACMR() const { return triangles > 0 ? (float)misses / triangles : 0.0f; }
+		float getATVR() const { return vertices > 0 ? (float)misses / vertices : 0.0f; }
+	};
+
+	// Simulates drawing the triangles through a FIFO_CACHE_SIZE FIFO cache, vertices counts only the vertices the triangles use
+	static CacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+	// Reorders the triangles for post-transform cache reuse, every index must be below vertexCount
+	static void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+	// Reorders clusters of cache optimised triangles front facing first, unless it raises the ACMR by more than threshold times
+	static void optimizeOverdraw(unsigned int* indices, size_t indexCount, const std::vector<glm::vec3>& positions, float threshold = 1.05f);
+
+	// Fills remap with the new index of every vertex in the order the triangles first use them (~0u for unused vertices), and returns how many are used
+	static unsigned int optimizeVertexFetch(std::vector<unsigned int>& remap, const unsigned int* indices, size_t indexCount, size_t vertexCount);
+};
@@ -0,0 +1,323 @@
+#include "MeshSimplifier.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/// <summary>
+/// addPlane() adds the quadric of the squared distance to a plane, the outer product of the plane's (a, b, c, d)
+/// coefficients with themselves.
+/// </summary>
+/// <param name="normal">Unit normal of the plane.</param>
+/// <param name="distance">The plane's d coefficient, the negated distance of the plane along it's normal from the origin.</param>
+void MeshSimplifier::Quadric::addPlane(const glm::vec3& normal, float distance)
+{
+	double a = normal.x, b = normal.y, c = normal.z, d = distance;
+	a00 += a * a; a01 += a * b; a02 += a * c; a03 += a * d;
+	a11 += b * b; a12 += b * c; a13 += b * d;
+	a22 += c * c; a23 += c * d;
+	a33 += d * d;
+}
+
+void MeshSimplifier::Quadric::add(const Quadric& other)
+{
+	a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+	a11 += other.a11; a12 += other.a12; a13 += other.a13;
+	a22 += other.a22; a23 += other.a23;
+	a33 += other.a33;
+}
+
+/// <summary>
+/// evaluate() returns the sum of squared distances from the position to the quadric's planes, v^T Q v with v = (x, y, z, 1).
+/// </summary>
+double MeshSimplifier::Quadric::evaluate(const glm::vec3& position) const
+{
+	double x = position.x, y = position.y, z = position.z;
+	double result = x * x * a00 + y * y * a11 + z * z * a22 + a33
+		+ 2.0 * (x * y * a01 + x * z * a02 + y * z * a12)
+		+ 2.0 * (x * a03 + y * a13 + z * a23);
+	return result > 0.0 ? result : 0.0;
+}
+
+/// <summary>
+/// The MeshSimplifier constructor copies the mesh, and prepares everything that stays fixed while it is simplified.
+/// The vertices the triangles use are welded by sorting them by position, so each run of identical positions is
+/// represented by it's first vertex, and any run longer than one vertex is a seam and is locked (so exact duplicate
+/// vertices should be merged in the indices first, or they lock the mesh for nothing). Every undirected welded edge is then counted,
+/// locking the ends of edges used by only one triangle (the border) or by more than two (non-manifold geometry).
+/// Lastly, the plane of every triangle is added to the quadrics of it's three welded vertices.
+/// </summary>
+/// <param name="positions">Model space position of every vertex.</param>
+/// <param name="indices">Triangle list indexing into positions.</param>
+MeshSimplifier::MeshSimplifier(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+	: m_positions(positions), m_indices(indices)
+{
+	unsigned int vertexCount = (unsigned int)m_positions.size();
+	m_welded.resize(vertexCount);
+	m_locked.assign(vertexCount, false);
+	m_quadrics.resize(vertexCount);
+
+	// Weld the vertices used by the triangles with identical positions, locking seams
+	std::vector<bool> used(vertexCount, false);
+	for (auto index : m_indices)
+		used[index] = true;
+	std::vector<unsigned int> order;
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		m_welded[i] = i;
+		if (used[i])
+			order.push_back(i);
+	}
+	auto lessPosition = [this](unsigned int a, unsigned int b)
+	{
+		const glm::vec3& pa = m_positions[a];
+		const glm::vec3& pb = m_positions[b];
+		if (pa.x != pb.x) return pa.x < pb.x;
+		if (pa.y != pb.y) return pa.y < pb.y;
+		if (pa.z != pb.z) return pa.z < pb.z;
+		return a < b;
+	};
+	std::sort(order.begin(), order.end(), lessPosition);
+	for (size_t runStart = 0; runStart < order.size();)
+	{
+		size_t runEnd = runStart + 1;
+		while (runEnd < order.size() && m_positions[order[runEnd]] == m_positions[order[runStart]])
+			runEnd++;
+		for (size_t i = runStart; i < runEnd; i++)
+			m_welded[order[i]] = order[runStart];
+		if (runEnd - runStart > 1)
+			m_locked[order[runStart]] = true;
+		runStart = runEnd;
+	}
+
+	// Lock the ends of border and non-manifold edges
+	std::vector<uint64_t> edges;
+	edges.reserve(m_indices.size());
+	for (size_t i = 0; i < m_indices.size(); i += 3)
+	{
+		for (unsigned int e = 0; e < 3; e++)
+		{
+			unsigned int a = m_welded[m_indices[i + e]];
+			unsigned int b = m_welded[m_indices[i + (e + 1) % 3]];
+			edges.push_back(((uint64_t)std::min(a, b) << 32) | std::max(a, b));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t runStart = 0; runStart < edges.size();)
+	{
+		size_t runEnd = runStart + 1;
+		while (runEnd < edges.size() && edges[runEnd] == edges[runStart])
+			runEnd++;
+		if (runEnd - runStart != 2)
+		{
+			m_locked[(unsigned int)(edges[runStart] >> 32)] = true;
+			m_locked[(unsigned int)(edges[runStart] & 0xffffffff)] = true;
+		}
+		runStart = runEnd;
+	}
+
+	// Accumulate the plane of every triangle into it's vertices' quadrics
+	for (size_t i = 0; i < m_indices.size(); i += 3)
+	{
+		const glm::vec3& p0 = m_positions[m_indices[i]];
+		glm::vec3 normal = glm::cross(m_positions[m_indices[i + 1]] - p0, m_positions[m_indices[i + 2]] - p0);
+		float length = glm::length(normal);
+		if (length <= 0.0f)
+			continue;
+		normal /= length;
+		for (unsigned int v = 0; v < 3; v++)
+			m_quadrics[m_welded[m_indices[i + v]]].addPlane(normal, -glm::dot(normal, p0));
+	}
+}
+
+/// <summary>
+/// simplify() collapses edges in passes until the mesh has at most targetIndexCount indices. Each pass gathers every
+/// interior edge once, costs collapsing it in whichever direction is allowed and cheapest, and sorts the candidates by
+/// cost. The candidates are then collapsed cheapest first, skipping any whose ends share a triangle with either end of
+/// a collapse already accepted this pass (so every accepted collapse was validated against an unchanged neighbourhood)
+/// and any that would break the surface, until enough triangles have been removed or the cheapest remaining collapse
+/// costs more than maxError. The collapses are then applied to the index list all at once, dropping the triangles that
+/// became degenerate. The simplifier stops early if a pass can't collapse anything, so the target isn't always reached.
+/// </summary>
+/// <param name="targetIndexCount">Number of indices to simplify down to.</param>
+/// <param name="maxError">Largest error allowed for any collapse, as a distance in model space.</param>
+/// <returns>The largest error of any collapse made so far, including in earlier calls.</returns>
+float MeshSimplifier::simplify(size_t targetIndexCount, float maxError)
+{
+	double maxCost = (double)maxError * maxError;
+	unsigned int vertexCount = (unsigned int)m_positions.size();
+
+	while (m_indices.size() > targetIndexCount)
+	{
+		buildAdjacency();
+
+		// Each interior edge is seen from both of it's triangles, in opposite directions, so only one direction is kept
+		m_collapses.clear();
+		for (size_t i = 0; i < m_indices.size(); i += 3)
+		{
+			for (unsigned int e = 0; e < 3; e++)
+			{
+				unsigned int a = m_indices[i + e];
+				unsigned int b = m_indices[i + (e + 1) % 3];
+				unsigned int weldedA = m_welded[a];
+				unsigned int weldedB = m_welded[b];
+				if (weldedA >= weldedB || (m_locked[weldedA] && m_locked[weldedB]))
+					continue;
+
+				Quadric quadric = m_quadrics[weldedA];
+				quadric.add(m_quadrics[weldedB]);
+				double costAB = m_locked[weldedA] ? HUGE_VAL : quadric.evaluate(m_positions[b]);
+				double costBA = m_locked[weldedB] ? HUGE_VAL : quadric.evaluate(m_positions[a]);
+				if (costAB <= costBA)
+					m_collapses.push_back({ costAB, a, b });
+				else
+					m_collapses.push_back({ costBA, b, a });
+			}
+		}
+		std::sort(m_collapses.begin(), m_collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		// Collapse the cheapest edges whose neighbourhoods are still untouched, each removing (usually) two triangles
+		m_collapseTargets.assign(vertexCount, ~0u);
+		m_touched.assign(vertexCount, false);
+		size_t indexCount = m_indices.size();
+		size_t collapseCount = 0;
+		for (auto& collapse : m_collapses)
+		{
+			if (collapse.cost > maxCost || indexCount <= targetIndexCount)
+				break;
+
+			// An unlocked vertex is never a seam, so it is it's own welded vertex
+			unsigned int from = collapse.from;
+			unsigned int weldedTo = m_welded[collapse.to];
+			if (m_touched[from] || m_touched[weldedTo] || isValidCollapse(from, collapse.to) == false)
+				continue;
+
+			// Both ends' triangles change, so nothing sharing a triangle with either end may collapse again this pass
+			for (unsigned int end : { from, weldedTo })
+			{
+				for (unsigned int t = m_adjacencyOffsets[end]; t < m_adjacencyOffsets[end + 1]; t++)
+				{
+					size_t triangle = m_adjacentTriangles[t] * 3;
+					for (unsigned int v = 0; v < 3; v++)
+						m_touched[m_welded[m_indices[triangle + v]]] = true;
+				}
+			}
+			m_collapseTargets[from] = collapse.to;
+			m_quadrics[weldedTo].add(m_quadrics[from]);
+			m_error = std::max(m_error, (float)std::sqrt(collapse.cost));
+			indexCount -= 6;
+			collapseCount++;
+		}
+		if (collapseCount == 0)
+			break;
+
+		// Apply the collapses and drop the degenerate triangles
+		size_t writeIndex = 0;
+		for (size_t i = 0; i < m_indices.size(); i += 3)
+		{
+			unsigned int triangle[3];
+			for (unsigned int v = 0; v < 3; v++)
+			{
+				unsigned int index = m_indices[i + v];
+				triangle[v] = m_collapseTargets[index] != ~0u ? m_collapseTargets[index] : index;
+			}
+			unsigned int w0 = m_welded[triangle[0]], w1 = m_welded[triangle[1]], w2 = m_welded[triangle[2]];
+			if (w0 == w1 || w1 == w2 || w2 == w0)
+				continue;
+			m_indices[writeIndex++] = triangle[0];
+			m_indices[writeIndex++] = triangle[1];
+			m_indices[writeIndex++] = triangle[2];
+		}
+		m_indices.resize(writeIndex);
+	}
+
+	return m_error;
+}
+
+/// <summary>
+/// isValidCollapse() checks that moving the from vertex onto the to vertex leaves a valid surface. The two welded vertices
+/// must share exactly two neighbours (the far corners of the edge's two triangles), as sharing more would pinch the
+/// surface into non-manifold geometry. And every triangle around from that survives the collapse must keep facing the
+/// same way, rejecting collapses that would fold the surface over itself.
+/// </summary>
+/// <param name="from">The unlocked vertex to move.</param>
+/// <param name="to">The vertex to move it onto.</param>
+/// <returns>True if the collapse can be made.</returns>
+bool MeshSimplifier::isValidCollapse(unsigned int from, unsigned int to)
+{
+	unsigned int weldedTo = m_welded[to];
+
+	// Link condition, from's neighbours are gathered first so that each of to's neighbours is only counted once
+	m_fromNeighbours.clear();
+	for (unsigned int t = m_adjacencyOffsets[from]; t < m_adjacencyOffsets[from + 1]; t++)
+	{
+		size_t triangle = m_adjacentTriangles[t] * 3;
+		for (unsigned int v = 0; v < 3; v++)
+		{
+			unsigned int neighbour = m_welded[m_indices[triangle + v]];
+			if (neighbour != from && neighbour != weldedTo && std::find(m_fromNeighbours.begin(), m_fromNeighbours.end(), neighbour) == m_fromNeighbours.end())
+				m_fromNeighbours.push_back(neighbour);
+		}
+	}
+	unsigned int sharedNeighbours = 0;
+	for (unsigned int t = m_adjacencyOffsets[weldedTo]; t < m_adjacencyOffsets[weldedTo + 1]; t++)
+	{
+		size_t triangle = m_adjacentTriangles[t] * 3;
+		for (unsigned int v = 0; v < 3; v++)
+		{
+			auto shared = std::find(m_fromNeighbours.begin(), m_fromNeighbours.end(), m_welded[m_indices[triangle + v]]);
+			if (shared != m_fromNeighbours.end())
+			{
+				// Swap shared neighbours out of the list once counted
+				*shared = m_fromNeighbours.back();
+				m_fromNeighbours.pop_back();
+				sharedNeighbours++;
+			}
+		}
+	}
+	if (sharedNeighbours != 2)
+		return false;
+
+	// Normal flip test for the triangles that survive the collapse
+	const glm::vec3& target = m_positions[to];
+	for (unsigned int t = m_adjacencyOffsets[from]; t < m_adjacencyOffsets[from + 1]; t++)
+	{
+		size_t triangle = m_adjacentTriangles[t] * 3;
+		glm::vec3 before[3], after[3];
+		bool degenerate = false;
+		for (unsigned int v = 0; v < 3; v++)
+		{
+			unsigned int index = m_indices[triangle + v];
+			degenerate |= m_welded[index] == weldedTo;
+			before[v] = m_positions[index];
+			after[v] = index == from ? target : before[v];
+		}
+		if (degenerate)
+			continue;
+
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		if (glm::dot(normalBefore, normalAfter) < 0.2f * glm::length(normalBefore) * glm::length(normalAfter))
+			return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// buildAdjacency() rebuilds the list of triangles around every welded vertex from the current index list, counting
+/// the triangles of each vertex first and then filling each vertex's range, in compressed sparse row form.
+/// </summary>
+void MeshSimplifier::buildAdjacency()
+{
+	unsigned int vertexCount = (unsigned int)m_positions.size();
+	m_adjacencyOffsets.assign(vertexCount + 1, 0);
+	for (auto index : m_indices)
+		m_adjacencyOffsets[m_welded[index] + 1]++;
+	for (unsigned int i = 0; i < vertexCount; i++)
+		m_adjacencyOffsets[i + 1] += m_adjacencyOffsets[i];
+
+	m_adjacentTriangles.resize(m_indices.size());
+	std::vector<unsigned int> fill(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < m_indices.size(); i++)
+		m_adjacentTriangles[fill[m_welded[m_indices[i]]]++] = (unsigned int)(i / 3);
+}
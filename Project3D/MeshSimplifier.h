@@ -0,0 +1,80 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <glm/vec3.hpp>
+
+/// <summary>
+/// MeshSimplifier reduces the triangle count of an indexed triangle mesh by quadric error edge collapse
+/// (Garland and Heckbert), for generating the LOD chain of a mesh at load time. Every vertex accumulates a
+/// quadric measuring the squared distance to the planes of the triangles around it, and edges are collapsed
+/// cheapest first, with the cost of a collapse being the combined quadric of both ends evaluated at the
+/// surviving vertex. Collapses are half-edge collapses, moving one vertex onto the other rather than onto an
+/// optimal new position, so the vertex buffer never changes and every LOD is just a smaller index list into
+/// it. Vertices that share a position (split by UV or normal seams) are welded together for connectivity, and
+/// seam and border vertices are never moved, so the mesh's outline and texture layout are kept intact. The
+/// simplifier keeps it's state between calls to simplify(), so a chain of LODs is built by repeatedly asking
+/// for fewer indices, with the error of each LOD measured against the original surface.
+/// </summary>
+class MeshSimplifier
+{
+public:
+
+	MeshSimplifier(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices);
+	~MeshSimplifier() {}
+
+	// Collapses edges until there are at most targetIndexCount indices, or the next collapse would cost more than maxError,
+	// returning the largest error (as a distance in model space) of any collapse so far
+	float simplify(size_t targetIndexCount, float maxError);
+
+	// Getters
+	const std::vector<unsigned int>& getIndices() const { return m_indices; }
+	float getError() const { return m_error; }
+
+protected:
+
+	/// <summary>
+	/// A Quadric is the symmetric 4x4 matrix of the sum of squared distances to a set of planes, stored as it's
+	/// 10 unique coefficients, in doubles as the coefficients of many nearly coplanar planes cancel out.
+	/// </summary>
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+		double a11 = 0, a12 = 0, a13 = 0;
+		double a22 = 0, a23 = 0;
+		double a33 = 0;
+
+		void addPlane(const glm::vec3& normal, float distance);
+		void add(const Quadric& other);
+		double evaluate(const glm::vec3& position) const;
+	};
+
+	/// <summary>
+	/// A Collapse is a candidate half-edge collapse of one vertex onto another, and it's quadric error.
+	/// </summary>
+	struct Collapse
+	{
+		double cost;
+		unsigned int from;
+		unsigned int to;
+	};
+
+	bool isValidCollapse(unsigned int from, unsigned int to); // Whether moving from onto to keeps the surface manifold without turning any triangles over
+	void buildAdjacency(); // Rebuilds the triangles around each welded vertex from m_indices
+
+	std::vector<glm::vec3> m_positions; // Position of every vertex, never changed by a collapse
+	std::vector<unsigned int> m_indices; // Current triangles, shrinking with each simplify()
+	std::vector<unsigned int> m_welded; // First vertex with each vertex's position, which stands for all of them in the connectivity
+	std::vector<bool> m_locked; // Whether each welded vertex sits on a seam or border and must never move
+	std::vector<Quadric> m_quadrics; // Accumulated quadric of each welded vertex
+	float m_error = 0; // Largest error of any collapse made so far
+
+	// Triangles around each welded vertex, as offsets into m_adjacentTriangles, rebuilt every pass
+	std::vector<unsigned int> m_adjacencyOffsets;
+	std::vector<unsigned int> m_adjacentTriangles;
+
+	// Per pass scratch
+	std::vector<Collapse> m_collapses;
+	std::vector<unsigned int> m_collapseTargets;
+	std::vector<bool> m_touched;
+	std::vector<unsigned int> m_fromNeighbours;
+};
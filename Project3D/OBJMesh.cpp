@@ -1,325 +1,900 @@
 #include "OBJMesh.h"
+#include "Shader.h"
+#include "MeshSimplifier.h"
+#include "GLState.h"
+#include "MappedFile.h"
+#include "ObjParser.h"
+#include "TextureCache.h"
+#include "JobSystem.h"
 #include "gl_core_4_4.h"
 #include <glm/geometric.hpp>
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
+#include <glm/common.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
 
 namespace aie {
 
+// the parser makes a vertex per unique obj index triple, which often repeats identical vertices.
+// fills firstCopy with the lowest index of a vertex identical to each vertex. tangents are left
+// out of the comparison, as they are accumulated separately for each copy
+static void findFirstCopies(const std::vector<OBJMesh::Vertex>& vertices, std::vector<unsigned int>& firstCopy) {
+	const size_t compareSize = offsetof(OBJMesh::Vertex, tangent);
+	std::vector<unsigned int> order(vertices.size());
+	for (unsigned int i = 0; i < (unsigned int)order.size(); ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&vertices, compareSize](unsigned int a, unsigned int b) {
+		int compare = memcmp(&vertices[a], &vertices[b], compareSize);
+		return compare != 0 ? compare < 0 : a < b;
+	});
+	firstCopy.resize(vertices.size());
+	for (size_t runStart = 0, i = 0; i < order.size(); ++i) {
+		if (memcmp(&vertices[order[i]], &vertices[order[runStart]], compareSize) != 0)
+			runStart = i;
+		firstCopy[order[i]] = order[runStart];
+	}
+}
+
+// chunk data kept by prepare until uploadNext uploads it. a cache hit's chunk data is
+// uploaded straight from the cache's mapping, and a parse's from the buffers it built
+struct OBJMesh::PendingUpload {
+	MappedFile							cache;
+	std::vector<std::vector<char>>		ownedData;
+	std::vector<const void*>			vertexData, indexData;
+	std::vector<size_t>					vertexDataSize, indexDataSize;
+	size_t								nextChunk = 0;
+};
+
+OBJMesh::OBJMesh() {
+}
+
 OBJMesh::~OBJMesh() {
-	for (auto& c : m_meshChunks) {
-		glDeleteVertexArrays(1, &c.vao);
-		glDeleteBuffers(1, &c.vbo);
-		glDeleteBuffers(1, &c.ibo);
+	for (auto& c : m_meshChunks)
+		GeometryArena::release(c.geometry);
+}
+
+// maps a unit vector onto the octahedron |x| + |y| + |z| = 1, folding the lower half over the
+// upper so the whole sphere covers the -1 to 1 square. degenerate vectors map to the centre
+static glm::vec2 octahedralEncode(const glm::vec3& v) {
+	float sum = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	if ((sum > 0) == false)
+		return glm::vec2(0);
+	glm::vec3 n = v / sum;
+	if (n.z >= 0)
+		return glm::vec2(n.x, n.y);
+	return glm::vec2((1 - fabsf(n.y)) * (n.x >= 0 ? 1 : -1), (1 - fabsf(n.x)) * (n.y >= 0 ? 1 : -1));
+}
+
+// packs a vertex, quantising its position across the box from min to min + extent
+static void packVertex(const OBJMesh::Vertex& vertex, const glm::vec3& min, const glm::vec3& extent, OBJMesh::PackedVertex& packed) {
+	for (int i = 0; i < 3; ++i)
+		packed.position[i] = glm::packUnorm1x16(extent[i] > 0 ? (vertex.position[i] - min[i]) / extent[i] : 0);
+	packed.position[3] = vertex.tangent.w > 0 ? 65535 : 0;
+
+	glm::vec2 normal = octahedralEncode(glm::vec3(vertex.normal));
+	glm::vec2 tangent = octahedralEncode(glm::vec3(vertex.tangent));
+	for (int i = 0; i < 2; ++i) {
+		packed.normal[i] = (short)glm::packSnorm1x16(normal[i]);
+		packed.tangent[i] = (short)glm::packSnorm1x16(tangent[i]);
+		packed.texcoord[i] = glm::packHalf1x16(vertex.texcoord[i]);
 	}
 }
 
-bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool flipTextureV /* = false */) {
+// fnv-1a, continuing from a previous hash so several buffers can be hashed as one
+static unsigned long long hashBytes(const void* data, size_t size, unsigned long long hash = 14695981039346656037ull) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
 
-	if (m_meshChunks.empty() == false) {
+// hashes an obj and the material libraries it names, as edits to either change the loaded mesh
+static bool hashSource(const std::string& file, const std::string& folder, unsigned long long& hash) {
+	MappedFile source;
+	if (source.open(file.c_str()) == false)
+		return false;
+
+	const char* text = (const char*)source.getData();
+	size_t size = source.getSize();
+	hash = hashBytes(text, size);
+	for (size_t i = 0; i + 7 < size; ++i) {
+		if ((i == 0 || text[i - 1] == '\n') && strncmp(text + i, "mtllib", 6) == 0 && (text[i + 6] == ' ' || text[i + 6] == '\t')) {
+			size_t first = i + 7;
+			while (first < size && (text[first] == ' ' || text[first] == '\t'))
+				++first;
+			size_t last = first;
+			while (last < size && text[last] != '\r' && text[last] != '\n')
+				++last;
+			std::string library(text + first, last - first);
+			hash = hashBytes(library.data(), library.size(), hash);
+			MappedFile mtl;
+			if (mtl.open((folder + library).c_str()))
+				hash = hashBytes(mtl.getData(), mtl.getSize(), hash);
+		}
+	}
+	return true;
+}
+
+// appends values to a cache being written
+template <typename T>
+static void writeCache(std::vector<char>& cache, const T& value) {
+	const char* bytes = (const char*)&value;
+	cache.insert(cache.end(), bytes, bytes + sizeof(T));
+}
+
+static void writeCacheBytes(std::vector<char>& cache, const void* data, size_t size) {
+	writeCache(cache, (unsigned long long)size);
+	cache.insert(cache.end(), (const char*)data, (const char*)data + size);
+}
+
+template <typename T>
+static void writeCacheVector(std::vector<char>& cache, const std::vector<T>& values) {
+	writeCacheBytes(cache, values.data(), values.size() * sizeof(T));
+}
+
+// reads values back out of a mapped cache, failing rather than reading past its end
+class CacheReader {
+public:
+
+	CacheReader(const unsigned char* data, size_t size) : m_cursor(data), m_end(data + size) {}
+
+	template <typename T>
+	bool read(T& value) {
+		if ((size_t)(m_end - m_cursor) < sizeof(T))
+			return false;
+		memcpy(&value, m_cursor, sizeof(T));
+		m_cursor += sizeof(T);
+		return true;
+	}
+
+	// returns a pointer in to the mapping, or null past the end
+	const unsigned char* readBytes(size_t& size) {
+		unsigned long long length;
+		if (read(length) == false || (unsigned long long)(m_end - m_cursor) < length)
+			return nullptr;
+		const unsigned char* bytes = m_cursor;
+		m_cursor += length;
+		size = (size_t)length;
+		return bytes;
+	}
+
+	template <typename T>
+	bool readVector(std::vector<T>& values) {
+		size_t size;
+		const unsigned char* bytes = readBytes(size);
+		if (bytes == nullptr || size % sizeof(T) != 0)
+			return false;
+		values.resize(size / sizeof(T));
+		if (size > 0)
+			memcpy(values.data(), bytes, size);
+		return true;
+	}
+
+	bool readString(std::string& value) {
+		size_t size;
+		const unsigned char* bytes = readBytes(size);
+		if (bytes == nullptr)
+			return false;
+		value.assign((const char*)bytes, size);
+		return true;
+	}
+
+	bool atEnd() const { return m_cursor == m_end; }
+
+private:
+
+	const unsigned char* m_cursor;
+	const unsigned char* m_end;
+};
+
+std::string OBJMesh::getCacheFilename(const char* filename) {
+	return std::string(filename) + ".meshcache";
+}
+
+bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool flipTextureV /* = false */, const LodSettings* lodSettings /* = nullptr */, bool optimizeVertexOrder /* = false */, bool packVertices /* = false */) {
+
+	if (prepare(filename, loadTextures, flipTextureV, lodSettings, optimizeVertexOrder, packVertices) == false)
+		return false;
+	while (uploadNext()) {}
+	return true;
+}
+
+bool OBJMesh::prepare(const char* filename, bool loadTextures /* = true */, bool flipTextureV /* = false */, const LodSettings* lodSettings /* = nullptr */, bool optimizeVertexOrder /* = false */, bool packVertices /* = false */) {
+
+	if (m_meshChunks.empty() == false || m_pending != nullptr) {
 		printf("Mesh already initialised, can't re-initialise!\n");
 		return false;
 	}
 
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string error = "";
+	auto startTime = std::chrono::high_resolution_clock::now();
+	m_pending.reset(new PendingUpload());
 
 	std::string file = filename;
 	std::string folder = file.substr(0, file.find_last_of('/') + 1);
 
-	bool success = tinyobj::LoadObj(shapes, materials, error,
-									filename, folder.c_str());
+	// the cache is keyed on the source and every setting that changes what is uploaded. textures are
+	// loaded from their own files either way, so loadTextures isn't part of the key
+	unsigned long long cacheKey = 0;
+	bool hashed = hashSource(file, folder, cacheKey);
+	if (hashed) {
+		unsigned char flags[3] = { flipTextureV, optimizeVertexOrder, packVertices };
+		cacheKey = hashBytes(flags, sizeof(flags), cacheKey);
+		if (lodSettings != nullptr) {
+			cacheKey = hashBytes(lodSettings->ratios.data(), lodSettings->ratios.size() * sizeof(float), cacheKey);
+			cacheKey = hashBytes(&lodSettings->maxError, sizeof(float), cacheKey);
+		}
+
+		if (loadCache(getCacheFilename(filename).c_str(), cacheKey, folder, loadTextures)) {
+			m_filename = filename;
+			m_loadedFromCache = true;
+			m_loadMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+			return true;
+		}
+	}
+
+	// a rejected cache may have been left mapped
+	m_pending.reset(new PendingUpload());
 
-	if (success == false) {
-		printf("%s\n", error.c_str());
+	ObjParser parser;
+	if (parser.parse(filename, flipTextureV) == false) {
+		printf("%s\n", parser.getError().c_str());
+		m_pending.reset();
 		return false;
 	}
 
 	m_filename = filename;
 
 	// copy materials
-	m_materials.resize(materials.size());
+	m_materials.resize(parser.getMaterials().size());
+	std::vector<std::string> textureNames;
 	int index = 0;
-	for (auto& m : materials) {
-
-		m_materials[index].ambient = glm::vec3(m.ambient[0], m.ambient[1], m.ambient[2]);
-		m_materials[index].diffuse = glm::vec3(m.diffuse[0], m.diffuse[1], m.diffuse[2]);
-		m_materials[index].specular = glm::vec3(m.specular[0], m.specular[1], m.specular[2]);
-		m_materials[index].emissive = glm::vec3(m.emission[0], m.emission[1], m.emission[2]);
-		m_materials[index].specularPower = m.shininess;
-		m_materials[index].opacity = m.dissolve;
-
-		// textures
-		m_materials[index].alphaTexture.load((folder + m.alpha_texname).c_str());
-		m_materials[index].ambientTexture.load((folder + m.ambient_texname).c_str());
-		m_materials[index].diffuseTexture.load((folder + m.diffuse_texname).c_str());
-		m_materials[index].specularTexture.load((folder + m.specular_texname).c_str());
-		m_materials[index].specularHighlightTexture.load((folder + m.specular_highlight_texname).c_str());
-		m_materials[index].normalTexture.load((folder + m.bump_texname).c_str());
-		m_materials[index].displacementTexture.load((folder + m.displacement_texname).c_str());
+	for (auto& m : parser.getMaterials()) {
+
+		m_materials[index].ambient = m.ambient;
+		m_materials[index].diffuse = m.diffuse;
+		m_materials[index].specular = m.specular;
+		m_materials[index].emissive = m.emissive;
+		m_materials[index].specularPower = m.specularPower;
+		m_materials[index].opacity = m.opacity;
+
+		// textures, in binding slot order
+		textureNames.insert(textureNames.end(), m.textures, m.textures + MATERIAL_TEXTURE_Count);
 
 		++index;
 	}
-
-	// copy shapes
-	m_meshChunks.reserve(shapes.size());
-	for (auto& s : shapes) {
+	if (loadTextures)
+		setTextureFilenames(folder, textureNames);
+
+	// copy chunks, keeping each chunk's indices and lod errors until the mesh's lod count is known,
+	// and its uploaded buffers for the cache
+	std::vector<ObjParser::Chunk>& parsedChunks = parser.getChunks();
+	m_meshChunks.reserve(parsedChunks.size());
+	std::vector<std::vector<unsigned int>> chunkIndices(parsedChunks.size());
+	std::vector<std::vector<float>> chunkLodErrors(parsedChunks.size());
+	std::vector<unsigned int> occluderBases(parsedChunks.size());
+	std::vector<std::vector<char>> chunkVertexData(parsedChunks.size());
+	std::vector<std::vector<char>> chunkIndexData(parsedChunks.size());
+	for (auto& parsed : parsedChunks) {
 
 		MeshChunk chunk;
 
-		// generate buffers
-		glGenBuffers(1, &chunk.vbo);
-		glGenBuffers(1, &chunk.ibo);
-		glGenVertexArrays(1, &chunk.vao);
-
-		// bind vertex array aka a mesh wrapper
-		glBindVertexArray(chunk.vao);
-
-		// set the index buffer data
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-					 s.mesh.indices.size() * sizeof(unsigned int),
-					 s.mesh.indices.data(), GL_STATIC_DRAW);
-
-		// store index count for rendering
-		chunk.indexCount = (unsigned int)s.mesh.indices.size();
-
-		// create vertex data
+		// vertex data comes from the parser with any V flip already applied
 		std::vector<Vertex> vertices;
-		vertices.resize(s.mesh.positions.size() / 3);
-		size_t vertCount = vertices.size();
-
-		bool hasPosition = s.mesh.positions.empty() == false;
-		bool hasNormal = s.mesh.normals.empty() == false;
-		bool hasTexture = s.mesh.texcoords.empty() == false;
-
-		for (size_t i = 0; i < vertCount; ++i) {
-			if (hasPosition)
-				vertices[i].position = glm::vec4(s.mesh.positions[i * 3 + 0], s.mesh.positions[i * 3 + 1], s.mesh.positions[i * 3 + 2], 1);
-			if (hasNormal)
-				vertices[i].normal = glm::vec4(s.mesh.normals[i * 3 + 0], s.mesh.normals[i * 3 + 1], s.mesh.normals[i * 3 + 2], 0);
-
-			// flip the T / V (might not always be needed, depends on how mesh was made)
-			if (hasTexture)
-				vertices[i].texcoord = glm::vec2(s.mesh.texcoords[i * 2 + 0], flipTextureV ? 1.0f - s.mesh.texcoords[i * 2 + 1] : s.mesh.texcoords[i * 2 + 1]);
+		vertices.swap(parsed.vertices);
+		bool hasNormal = parsed.hasNormals;
+		bool hasTexture = parsed.hasTexcoords;
+
+		size_t chunkIndex = m_meshChunks.size();
+		std::vector<unsigned int>& indices = chunkIndices[chunkIndex];
+		indices.swap(parsed.indices);
+
+		// weld identical vertices before tangents are accumulated, so each welded vertex gets the
+		// tangent of all its triangles. the copies left unused are dropped by optimizeChunkOrder
+		if (optimizeVertexOrder) {
+			m_cacheStatsBefore.add(MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertices.size()));
+			std::vector<unsigned int> firstCopy;
+			findFirstCopies(vertices, firstCopy);
+			for (auto& i : indices)
+				i = firstCopy[i];
 		}
 
 		// calculate for normal mapping
 		if (hasNormal && hasTexture)
-			calculateTangents(vertices, s.mesh.indices);
-
-		// bind vertex buffer
-		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
-
-		// fill vertex buffer
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+			calculateTangents(vertices, indices);
 
-		// enable first element as positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+		// calculate for culling
+		calculateBounds(vertices, chunk.bounds);
 
-		// enable normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 1));
+		// lod 0 is the full mesh, with any simplified lods following it in the same index buffer
+		chunk.lods.push_back({ 0, (unsigned int)indices.size() });
+		chunkLodErrors[chunkIndex].push_back(0);
+		if (lodSettings != nullptr)
+			generateLods(vertices, *lodSettings, chunk.bounds.radius, indices, chunk.lods, chunkLodErrors[chunkIndex]);
 
-		// enable texture coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2));
+		if (optimizeVertexOrder) {
+			optimizeChunkOrder(vertices, indices, chunk.lods);
+			m_cacheStatsAfter.add(MeshOptimizer::analyzeVertexCache(indices.data(), chunk.lods[0].indexCount, vertices.size()));
+		}
 
-		// enable tangents
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2 + sizeof(glm::vec2)));
+		// keep the positions on the cpu for occlusion culling
+		occluderBases[chunkIndex] = (unsigned int)m_occluderPositions.size();
+		for (auto& vertex : vertices)
+			m_occluderPositions.push_back(glm::vec3(vertex.position));
+
+		// index data, in 16 bits when packing a chunk small enough for them
+		std::vector<char>& indexData = chunkIndexData[chunkIndex];
+		if (packVertices && vertices.size() < 65536) {
+			std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+			indexData.assign((const char*)shortIndices.data(), (const char*)(shortIndices.data() + shortIndices.size()));
+			chunk.indexType = GL_UNSIGNED_SHORT;
+		}
+		else {
+			indexData.assign((const char*)indices.data(), (const char*)(indices.data() + indices.size()));
+			chunk.indexType = GL_UNSIGNED_INT;
+		}
 
-		// bind 0 for safety
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		// vertex data, and the chunk's dequantisation scale and offset
+		std::vector<char>& vertexData = chunkVertexData[chunkIndex];
+		chunk.packed = packVertices;
+		chunk.dequantise[0] = glm::vec4(1, 1, 1, 0);
+		chunk.dequantise[1] = glm::vec4(0);
+		if (packVertices) {
+			glm::vec3 extent = chunk.bounds.max - chunk.bounds.min;
+			chunk.dequantise[0] = glm::vec4(extent, 1);
+			chunk.dequantise[1] = glm::vec4(chunk.bounds.min, 0);
+			std::vector<PackedVertex> packed(vertices.size());
+			for (size_t i = 0; i < vertices.size(); ++i)
+				packVertex(vertices[i], chunk.bounds.min, extent, packed[i]);
+			vertexData.assign((const char*)packed.data(), (const char*)(packed.data() + packed.size()));
+		}
+		else {
+			vertexData.assign((const char*)vertices.data(), (const char*)(vertices.data() + vertices.size()));
+		}
 
 		// set chunk material
-		chunk.materialID = s.mesh.material_ids.empty() ? -1 : s.mesh.material_ids[0];
+		chunk.materialID = parsed.materialID;
 
 		m_meshChunks.push_back(chunk);
 	}
-	
+
+	// combine chunk bounds into the whole mesh's bounds
+	if (m_meshChunks.empty() == false) {
+		m_bounds.min = m_meshChunks[0].bounds.min;
+		m_bounds.max = m_meshChunks[0].bounds.max;
+		for (auto& c : m_meshChunks) {
+			m_bounds.min = glm::min(m_bounds.min, c.bounds.min);
+			m_bounds.max = glm::max(m_bounds.max, c.bounds.max);
+		}
+		m_bounds.centre = (m_bounds.min + m_bounds.max) * 0.5f;
+		m_bounds.radius = 0;
+		for (auto& c : m_meshChunks)
+			m_bounds.radius = glm::max(m_bounds.radius, glm::distance(m_bounds.centre, c.bounds.centre) + c.bounds.radius);
+	}
+
+	// every chunk has the same number of lods, so the mesh's chain ends at the first lod that
+	// doesn't remove a tenth of the previous lod's triangles across the whole mesh
+	m_lodErrors.assign(1, 0.0f);
+	size_t lodCount = m_meshChunks.empty() ? 0 : m_meshChunks[0].lods.size();
+	for (size_t lod = 1; lod < lodCount; ++lod) {
+		size_t previousIndices = 0, lodIndices = 0;
+		float error = 0;
+		for (size_t c = 0; c < m_meshChunks.size(); ++c) {
+			previousIndices += m_meshChunks[c].lods[lod - 1].indexCount;
+			lodIndices += m_meshChunks[c].lods[lod].indexCount;
+			error = glm::max(error, chunkLodErrors[c][lod]);
+		}
+		if (lodIndices * 10 > previousIndices * 9)
+			break;
+		m_lodErrors.push_back(error);
+	}
+
+	// occluders rasterise the coarsest lod
+	for (size_t c = 0; c < m_meshChunks.size(); ++c) {
+		m_meshChunks[c].lods.resize(m_lodErrors.size());
+		const LodRange& range = m_meshChunks[c].lods.back();
+		for (unsigned int i = 0; i < range.indexCount; ++i)
+			m_occluderIndices.push_back(occluderBases[c] + chunkIndices[c][range.firstIndex + i]);
+	}
+
+	if (hashed)
+		saveCache(getCacheFilename(filename).c_str(), cacheKey, textureNames, chunkVertexData, chunkIndexData);
+
+	// keep the chunks' data for uploadNext
+	for (size_t c = 0; c < m_meshChunks.size(); ++c) {
+		m_pending->vertexData.push_back(chunkVertexData[c].data());
+		m_pending->vertexDataSize.push_back(chunkVertexData[c].size());
+		m_pending->indexData.push_back(chunkIndexData[c].data());
+		m_pending->indexDataSize.push_back(chunkIndexData[c].size());
+		m_pending->ownedData.push_back(std::move(chunkVertexData[c]));
+		m_pending->ownedData.push_back(std::move(chunkIndexData[c]));
+	}
+
+	m_loadedFromCache = false;
+	m_loadMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
 	// load obj
 	return true;
 }
 
-void OBJMesh::draw(bool usePatches /* = false */) {
+bool OBJMesh::uploadNext() {
 
-	int program = -1;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	if (m_pending == nullptr)
+		return false;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	PendingUpload& pending = *m_pending;
+	if (pending.nextChunk < m_meshChunks.size()) {
+		size_t c = pending.nextChunk++;
+		uploadChunk(m_meshChunks[c], pending.vertexData[c], pending.vertexDataSize[c], pending.indexData[c], pending.indexDataSize[c]);
+		if (pending.ownedData.empty() == false) {
+			std::vector<char>().swap(pending.ownedData[c * 2]);
+			std::vector<char>().swap(pending.ownedData[c * 2 + 1]);
+		}
+	}
 
-	if (program == -1) {
-		printf("No shader bound!\n");
+	m_loadMilliseconds += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+	if (pending.nextChunk == m_meshChunks.size()) {
+		m_loaded = true;
+		m_pending.reset();
+		return false;
+	}
+	return true;
+}
+
+// a material's texture in a binding slot
+static std::shared_ptr<Texture>& getMaterialTexture(OBJMesh::Material& material, unsigned int slot) {
+	std::shared_ptr<Texture>* textures[MATERIAL_TEXTURE_Count] = {
+		&material.diffuseTexture, &material.alphaTexture, &material.ambientTexture, &material.specularTexture,
+		&material.specularHighlightTexture, &material.normalTexture, &material.displacementTexture };
+	return *textures[slot];
+}
+
+void OBJMesh::takeTextureRequests(std::vector<unsigned int>& requests) {
+	requests.insert(requests.end(), m_textureRequests.begin(), m_textureRequests.end());
+	m_textureRequests.clear();
+}
+
+void OBJMesh::setTexture(unsigned int request, const std::shared_ptr<Texture>& texture) {
+	getMaterialTexture(m_materials[request / MATERIAL_TEXTURE_Count], request % MATERIAL_TEXTURE_Count) = texture;
+}
+
+void OBJMesh::loadRequestedTextures() {
+	std::vector<unsigned int> requests;
+	takeTextureRequests(requests);
+	for (unsigned int request : requests) {
+		std::shared_ptr<Texture> texture = TextureCache::acquire(m_textureFilenames[request]);
+		if (texture != nullptr)
+			texture->upload();
+		setTexture(request, texture);
+	}
+}
+
+void OBJMesh::setTextureFilenames(const std::string& folder, const std::vector<std::string>& names) {
+	m_textureFilenames.resize(names.size());
+	for (size_t i = 0; i < names.size(); ++i)
+		m_textureFilenames[i] = names[i].empty() ? std::string() : folder + names[i];
+	m_texturesRequested.assign(names.size(), false);
+}
+
+void OBJMesh::uploadChunk(MeshChunk& chunk, const void* vertexData, size_t vertexDataSize, const void* indexData, size_t indexDataSize) {
+
+	// suballocate the chunk's vertices, followed by it's dequantisation scale and offset, and it's indices
+	GeometryArena::eVertexFormat format = chunk.packed ? GeometryArena::OBJ_PACKED_VERTEX_FORMAT : GeometryArena::OBJ_VERTEX_FORMAT;
+	size_t stride = GeometryArena::getVertexStride(format);
+	unsigned int vertexCount = (unsigned int)((vertexDataSize + sizeof(chunk.dequantise) + stride - 1) / stride);
+	unsigned int indexCount = (unsigned int)(indexDataSize / GeometryArena::getIndexSize(chunk.indexType));
+	chunk.geometry = GeometryArena::allocate(format, chunk.indexType, vertexCount, indexCount);
+	chunk.dequantiseOffset = vertexDataSize;
+
+	GeometryArena::writeVertices(chunk.geometry, 0, vertexDataSize, vertexData);
+	GeometryArena::writeVertices(chunk.geometry, vertexDataSize, sizeof(chunk.dequantise), chunk.dequantise);
+	GeometryArena::writeIndices(chunk.geometry, indexDataSize, indexData);
+	m_vertexBufferSize += vertexDataSize;
+	m_indexBufferSize += indexDataSize;
+}
+
+void OBJMesh::saveCache(const char* cacheFilename, unsigned long long key, const std::vector<std::string>& textureNames, const std::vector<std::vector<char>>& chunkVertexData, const std::vector<std::vector<char>>& chunkIndexData) {
+
+	std::vector<char> cache;
+	writeCache(cache, (unsigned int)CACHE_MAGIC);
+	writeCache(cache, (unsigned int)CACHE_VERSION);
+	writeCache(cache, key);
+
+	writeCache(cache, (unsigned int)m_materials.size());
+	for (size_t i = 0; i < m_materials.size(); ++i) {
+		const Material& material = m_materials[i];
+		writeCache(cache, material.ambient);
+		writeCache(cache, material.diffuse);
+		writeCache(cache, material.specular);
+		writeCache(cache, material.emissive);
+		writeCache(cache, material.specularPower);
+		writeCache(cache, material.opacity);
+		for (unsigned int t = 0; t < MATERIAL_TEXTURE_Count; ++t) {
+			const std::string& name = textureNames[i * MATERIAL_TEXTURE_Count + t];
+			writeCacheBytes(cache, name.data(), name.size());
+		}
+	}
+
+	writeCache(cache, m_bounds);
+	writeCacheVector(cache, m_lodErrors);
+	writeCache(cache, m_cacheStatsBefore);
+	writeCache(cache, m_cacheStatsAfter);
+	writeCacheVector(cache, m_occluderPositions);
+	writeCacheVector(cache, m_occluderIndices);
+
+	writeCache(cache, (unsigned int)m_meshChunks.size());
+	for (size_t i = 0; i < m_meshChunks.size(); ++i) {
+		const MeshChunk& chunk = m_meshChunks[i];
+		writeCache(cache, chunk.materialID);
+		writeCache(cache, chunk.bounds);
+		writeCache(cache, chunk.indexType);
+		writeCache(cache, chunk.packed);
+		writeCache(cache, chunk.dequantise);
+		writeCacheVector(cache, chunk.lods);
+		writeCacheVector(cache, chunkVertexData[i]);
+		writeCacheVector(cache, chunkIndexData[i]);
+	}
+
+	FILE* file = nullptr;
+	if (fopen_s(&file, cacheFilename, "wb") != 0 || file == nullptr) {
+		printf("Couldn't write mesh cache %s\n", cacheFilename);
 		return;
 	}
+	size_t written = fwrite(cache.data(), 1, cache.size(), file);
+	fclose(file);
+
+	// a partly written cache would only be rejected on every later load, so don't leave one
+	if (written != cache.size())
+		remove(cacheFilename);
+}
+
+bool OBJMesh::loadCache(const char* cacheFilename, unsigned long long key, const std::string& folder, bool loadTextures) {
+
+	MappedFile& mapping = m_pending->cache;
+	if (mapping.open(cacheFilename) == false)
+		return false;
+
+	CacheReader reader(mapping.getData(), mapping.getSize());
+	unsigned int magic, version, materialCount, chunkCount;
+	unsigned long long cachedKey;
+	if (reader.read(magic) == false || magic != CACHE_MAGIC ||
+		reader.read(version) == false || version != CACHE_VERSION ||
+		reader.read(cachedKey) == false || cachedKey != key ||
+		reader.read(materialCount) == false)
+		return false;
+
+	// read everything before creating any gl objects, so a bad cache leaves the mesh untouched
+	std::vector<Material> materials(materialCount);
+	std::vector<std::string> textureNames(materialCount * MATERIAL_TEXTURE_Count);
+	for (unsigned int i = 0; i < materialCount; ++i) {
+		Material& material = materials[i];
+		if (reader.read(material.ambient) == false || reader.read(material.diffuse) == false ||
+			reader.read(material.specular) == false || reader.read(material.emissive) == false ||
+			reader.read(material.specularPower) == false || reader.read(material.opacity) == false)
+			return false;
+		for (unsigned int t = 0; t < MATERIAL_TEXTURE_Count; ++t) {
+			if (reader.readString(textureNames[i * MATERIAL_TEXTURE_Count + t]) == false)
+				return false;
+		}
+	}
 
-	// pull uniforms from the shader
-	int kaUniform = glGetUniformLocation(program, "Ka");
-	int kdUniform = glGetUniformLocation(program, "Kd");
-	int ksUniform = glGetUniformLocation(program, "Ks");
-	int keUniform = glGetUniformLocation(program, "Ke");
-	int opacityUniform = glGetUniformLocation(program, "opacity");
-	int specPowUniform = glGetUniformLocation(program, "specularPower");
-
-	int alphaTexUniform = glGetUniformLocation(program, "alphaTexture");
-	int ambientTexUniform = glGetUniformLocation(program, "ambientTexture");
-	int diffuseTexUniform = glGetUniformLocation(program, "diffuseTexture");
-	int specTexUniform = glGetUniformLocation(program, "specularTexture");
-	int specHighlightTexUniform = glGetUniformLocation(program, "specularHighlightTexture");
-	int normalTexUniform = glGetUniformLocation(program, "normalTexture");
-	int dispTexUniform = glGetUniformLocation(program, "displacementTexture");
-
-	// set texture slots (these don't change per material)
-	if (diffuseTexUniform >= 0)
-		glUniform1i(diffuseTexUniform, 0);
-	if (alphaTexUniform >= 0)
-		glUniform1i(alphaTexUniform, 1);
-	if (ambientTexUniform >= 0)
-		glUniform1i(ambientTexUniform, 2);
-	if (specTexUniform >= 0)
-		glUniform1i(specTexUniform, 3);
-	if (specHighlightTexUniform >= 0)
-		glUniform1i(specHighlightTexUniform, 4);
-	if (normalTexUniform >= 0)
-		glUniform1i(normalTexUniform, 5);
-	if (dispTexUniform >= 0)
-		glUniform1i(dispTexUniform, 6);
-
-	int currentMaterial = -1;
-
-	// draw the mesh chunks
-	for (auto& c : m_meshChunks) {
-
-		// bind material
-		if (currentMaterial != c.materialID) {
-			currentMaterial = c.materialID;
-			if (kaUniform >= 0)
-				glUniform3fv(kaUniform, 1, &m_materials[currentMaterial].ambient[0]);
-			if (kdUniform >= 0)
-				glUniform3fv(kdUniform, 1, &m_materials[currentMaterial].diffuse[0]);
-			if (ksUniform >= 0)
-				glUniform3fv(ksUniform, 1, &m_materials[currentMaterial].specular[0]);
-			if (keUniform >= 0)
-				glUniform3fv(keUniform, 1, &m_materials[currentMaterial].emissive[0]);
-			if (opacityUniform >= 0)
-				glUniform1f(opacityUniform, m_materials[currentMaterial].opacity);
-			if (specPowUniform >= 0)
-				glUniform1f(specPowUniform, m_materials[currentMaterial].specularPower);
-
-			glActiveTexture(GL_TEXTURE0);
-			if (m_materials[currentMaterial].diffuseTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].diffuseTexture.getHandle());
-			else if (diffuseTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE1);
-			if (m_materials[currentMaterial].alphaTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].alphaTexture.getHandle());
-			else if (alphaTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE2);
-			if (m_materials[currentMaterial].ambientTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].ambientTexture.getHandle());
-			else if (ambientTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE3);
-			if (m_materials[currentMaterial].specularTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularTexture.getHandle());
-			else if (specTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE4);
-			if (m_materials[currentMaterial].specularHighlightTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularHighlightTexture.getHandle());
-			else if (specHighlightTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE5);
-			if (m_materials[currentMaterial].normalTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].normalTexture.getHandle());
-			else if (normalTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE6);
-			if (m_materials[currentMaterial].displacementTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].displacementTexture.getHandle());
-			else if (dispTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
+	Bounds bounds;
+	std::vector<float> lodErrors;
+	MeshOptimizer::CacheStats cacheStatsBefore, cacheStatsAfter;
+	std::vector<glm::vec3> occluderPositions;
+	std::vector<unsigned int> occluderIndices;
+	if (reader.read(bounds) == false || reader.readVector(lodErrors) == false ||
+		reader.read(cacheStatsBefore) == false || reader.read(cacheStatsAfter) == false ||
+		reader.readVector(occluderPositions) == false || reader.readVector(occluderIndices) == false ||
+		reader.read(chunkCount) == false)
+		return false;
+
+	std::vector<MeshChunk> chunks(chunkCount);
+	std::vector<const unsigned char*> vertexData(chunkCount), indexData(chunkCount);
+	std::vector<size_t> vertexDataSize(chunkCount), indexDataSize(chunkCount);
+	for (unsigned int i = 0; i < chunkCount; ++i) {
+		MeshChunk& chunk = chunks[i];
+		if (reader.read(chunk.materialID) == false || reader.read(chunk.bounds) == false ||
+			reader.read(chunk.indexType) == false || reader.read(chunk.packed) == false ||
+			reader.read(chunk.dequantise) == false || reader.readVector(chunk.lods) == false)
+			return false;
+		vertexData[i] = reader.readBytes(vertexDataSize[i]);
+		indexData[i] = reader.readBytes(indexDataSize[i]);
+		if (vertexData[i] == nullptr || indexData[i] == nullptr)
+			return false;
+	}
+	if (reader.atEnd() == false)
+		return false;
+
+	// chunks are uploaded straight from the mapping
+	m_materials.swap(materials);
+	if (loadTextures)
+		setTextureFilenames(folder, textureNames);
+	m_bounds = bounds;
+	m_lodErrors.swap(lodErrors);
+	m_cacheStatsBefore = cacheStatsBefore;
+	m_cacheStatsAfter = cacheStatsAfter;
+	m_occluderPositions.swap(occluderPositions);
+	m_occluderIndices.swap(occluderIndices);
+	m_meshChunks.swap(chunks);
+	m_pending->vertexData.assign(vertexData.begin(), vertexData.end());
+	m_pending->indexData.assign(indexData.begin(), indexData.end());
+	m_pending->vertexDataSize.swap(vertexDataSize);
+	m_pending->indexDataSize.swap(indexDataSize);
+	return true;
+}
+
+// 1x1 textures bound in place of a material's textures while they are still uploading, and for the
+// default material. white, other than a flat normal and no displacement. they are made on first use
+// (on the opengl thread) and kept until exit
+static unsigned int getPlaceholderTexture(unsigned int slot) {
+	static Texture* placeholders[MATERIAL_TEXTURE_Count] = {};
+	if (placeholders[slot] == nullptr) {
+		unsigned char pixel[4] = { 255, 255, 255, 255 };
+		if (slot == NORMAL_TEXTURE)
+			pixel[0] = pixel[1] = 128;
+		else if (slot == DISPLACEMENT_TEXTURE)
+			pixel[0] = pixel[1] = pixel[2] = 0;
+		placeholders[slot] = new Texture(1, 1, Texture::RGBA, pixel);
+	}
+	return placeholders[slot]->getHandle();
+}
+
+void OBJMesh::bindMaterial(const MaterialBindingLayout& layout, int materialIndex) {
+
+	// chunks without a material are drawn with the default material properties
+	static const Material defaultMaterial;
+	const Material& material = materialIndex < 0 ? defaultMaterial : m_materials[materialIndex];
+	if (layout.ambient >= 0)
+		glUniform3fv(layout.ambient, 1, &material.ambient[0]);
+	if (layout.diffuse >= 0)
+		glUniform3fv(layout.diffuse, 1, &material.diffuse[0]);
+	if (layout.specular >= 0)
+		glUniform3fv(layout.specular, 1, &material.specular[0]);
+	if (layout.emissive >= 0)
+		glUniform3fv(layout.emissive, 1, &material.emissive[0]);
+	if (layout.opacity >= 0)
+		glUniform1f(layout.opacity, material.opacity);
+	if (layout.specularPower >= 0)
+		glUniform1f(layout.specularPower, material.specularPower);
+
+	// only the texture units the program samples need binding, and only they are loaded. a texture
+	// the material names that isn't loaded yet is asked for the first time it's needed, and stands in
+	// as a placeholder until it has been
+	const Texture* textures[eMaterialTexture::MATERIAL_TEXTURE_Count] = {
+		material.diffuseTexture.get(), material.alphaTexture.get(), material.ambientTexture.get(), material.specularTexture.get(),
+		material.specularHighlightTexture.get(), material.normalTexture.get(), material.displacementTexture.get() };
+	for (unsigned int i = 0; i < eMaterialTexture::MATERIAL_TEXTURE_Count; ++i) {
+		if (layout.usesTexture[i] == false)
+			continue;
+		if (materialIndex < 0) {
+			GLState::bindTexture(i, getPlaceholderTexture(i));
+			continue;
 		}
 
-		// bind and draw geometry
-		glBindVertexArray(c.vao);
-		if (usePatches)
-			glDrawElements(GL_PATCHES, c.indexCount, GL_UNSIGNED_INT, 0);
+		unsigned int request = materialIndex * MATERIAL_TEXTURE_Count + i;
+		bool named = request < m_textureFilenames.size() && m_textureFilenames[request].empty() == false;
+		if (textures[i] == nullptr && named && m_texturesRequested[request] == false) {
+			m_texturesRequested[request] = true;
+			m_textureRequests.push_back(request);
+		}
+
+		if ((textures[i] == nullptr && named) || (textures[i] != nullptr && textures[i]->isPendingUpload()))
+			GLState::bindTexture(i, getPlaceholderTexture(i));
 		else
-			glDrawElements(GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT, 0);
+			GLState::bindTexture(i, textures[i] != nullptr ? textures[i]->getHandle() : 0);
 	}
 }
 
-void OBJMesh::calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
-	unsigned int vertexCount = (unsigned int)vertices.size();
-	glm::vec4* tan1 = new glm::vec4[vertexCount * 2];
-	glm::vec4* tan2 = tan1 + vertexCount;
-	memset(tan1, 0, vertexCount * sizeof(glm::vec4) * 2);
+void OBJMesh::drawChunkInstanced(size_t chunkIndex, unsigned int lod, unsigned int instanceBuffer, unsigned int firstInstance, unsigned int instanceCount, bool usePatches /* = false */) {
+
+	auto& c = m_meshChunks[chunkIndex];
+	const LodRange& range = c.lods[lod];
+	const void* offset = (const void*)((c.geometry.firstIndex + range.firstIndex) * GeometryArena::getIndexSize(c.indexType));
+
+	// bind the pool's geometry, point the instanced attributes at this draw's range of transforms
+	// and every instance at the chunk's dequantisation
+	unsigned int pool = c.geometry.pool;
+	size_t stride = GeometryArena::getVertexStride(c.packed ? GeometryArena::OBJ_PACKED_VERTEX_FORMAT : GeometryArena::OBJ_VERTEX_FORMAT);
+	GLState::bindVertexArray(GeometryArena::getVertexArray(pool));
+	glBindVertexBuffer(INSTANCE_BINDING, instanceBuffer, firstInstance * sizeof(glm::mat4), sizeof(glm::mat4));
+	glBindVertexBuffer(DEQUANTISE_BINDING, GeometryArena::getVertexBuffer(pool), c.geometry.baseVertex * stride + c.dequantiseOffset, 0);
+
+	// draw every instance of the chunk in one call
+	if (usePatches)
+		glDrawElementsInstancedBaseVertex(GL_PATCHES, range.indexCount, c.indexType, offset, instanceCount, c.geometry.baseVertex);
+	else
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, c.indexType, offset, instanceCount, c.geometry.baseVertex);
+}
 
-	unsigned int indexCount = (unsigned int)indices.size();
-	for (unsigned int a = 0; a < indexCount; a += 3) {
-		long i1 = indices[a];
-		long i2 = indices[a + 1];
-		long i3 = indices[a + 2];
+GeometryArena::DrawCommand OBJMesh::getChunkDrawCommand(size_t chunkIndex, unsigned int lod, unsigned int firstInstance, unsigned int instanceCount) const {
+	const MeshChunk& c = m_meshChunks[chunkIndex];
+	const LodRange& range = c.lods[lod];
+	return { range.indexCount, instanceCount, c.geometry.firstIndex + range.firstIndex, (int)c.geometry.baseVertex, firstInstance };
+}
 
-		const glm::vec4& v1 = vertices[i1].position;
-		const glm::vec4& v2 = vertices[i2].position;
-		const glm::vec4& v3 = vertices[i3].position;
+// fewest vertices worth calculating the tangents of as a job of their own
+static const size_t MIN_TANGENT_RANGE = 4096;
+
+void OBJMesh::calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, JobSystem* jobSystem) {
+
+	// each job accumulates the tangents of a range of vertices over every triangle using them. no two jobs
+	// write the same vertex, and each vertex sums its triangles in the same order on any number of threads
+	auto calculateRange = [&vertices, &indices](size_t firstVertex, size_t lastVertex) {
+		unsigned int first = (unsigned int)firstVertex;
+		unsigned int rangeSize = (unsigned int)(lastVertex - firstVertex);
+		std::vector<glm::vec4> tan1(rangeSize * 2, glm::vec4(0));
+		glm::vec4* tan2 = tan1.data() + rangeSize;
+
+		unsigned int indexCount = (unsigned int)indices.size();
+		for (unsigned int a = 0; a < indexCount; a += 3) {
+			unsigned int i1 = indices[a];
+			unsigned int i2 = indices[a + 1];
+			unsigned int i3 = indices[a + 2];
+			bool in1 = i1 - first < rangeSize;
+			bool in2 = i2 - first < rangeSize;
+			bool in3 = i3 - first < rangeSize;
+			if (in1 == false && in2 == false && in3 == false)
+				continue;
+
+			const glm::vec4& v1 = vertices[i1].position;
+			const glm::vec4& v2 = vertices[i2].position;
+			const glm::vec4& v3 = vertices[i3].position;
+
+			const glm::vec2& w1 = vertices[i1].texcoord;
+			const glm::vec2& w2 = vertices[i2].texcoord;
+			const glm::vec2& w3 = vertices[i3].texcoord;
+
+			float x1 = v2.x - v1.x;
+			float x2 = v3.x - v1.x;
+			float y1 = v2.y - v1.y;
+			float y2 = v3.y - v1.y;
+			float z1 = v2.z - v1.z;
+			float z2 = v3.z - v1.z;
+
+			float s1 = w2.x - w1.x;
+			float s2 = w3.x - w1.x;
+			float t1 = w2.y - w1.y;
+			float t2 = w3.y - w1.y;
+
+			float r = 1.0F / (s1 * t2 - s2 * t1);
+			glm::vec4 sdir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r,
+						   (t2 * z1 - t1 * z2) * r, 0);
+			glm::vec4 tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r,
+						   (s1 * z2 - s2 * z1) * r, 0);
+
+			if (in1) {
+				tan1[i1 - first] += sdir;
+				tan2[i1 - first] += tdir;
+			}
+			if (in2) {
+				tan1[i2 - first] += sdir;
+				tan2[i2 - first] += tdir;
+			}
+			if (in3) {
+				tan1[i3 - first] += sdir;
+				tan2[i3 - first] += tdir;
+			}
+		}
 
-		const glm::vec2& w1 = vertices[i1].texcoord;
-		const glm::vec2& w2 = vertices[i2].texcoord;
-		const glm::vec2& w3 = vertices[i3].texcoord;
+		for (unsigned int a = 0; a < rangeSize; a++) {
+			Vertex& vertex = vertices[first + a];
+			const glm::vec3& n = glm::vec3(vertex.normal);
+			const glm::vec3& t = glm::vec3(tan1[a]);
 
-		float x1 = v2.x - v1.x;
-		float x2 = v3.x - v1.x;
-		float y1 = v2.y - v1.y;
-		float y2 = v3.y - v1.y;
-		float z1 = v2.z - v1.z;
-		float z2 = v3.z - v1.z;
+			// Gram-Schmidt orthogonalize
+			vertex.tangent = glm::vec4(glm::normalize(t - n * glm::dot(n, t)), 0);
 
-		float s1 = w2.x - w1.x;
-		float s2 = w3.x - w1.x;
-		float t1 = w2.y - w1.y;
-		float t2 = w3.y - w1.y;
+			// Calculate handedness (direction of bitangent)
+			vertex.tangent.w = (glm::dot(glm::cross(glm::vec3(n), glm::vec3(t)), glm::vec3(tan2[a])) < 0.0F) ? 1.0F : -1.0F;
+		}
+	};
+
+	// one range per thread, as every job reads every triangle
+	if (jobSystem == nullptr)
+		jobSystem = JobSystem::getInstance();
+	unsigned int threadCount = JobSystem::getAvailableThreadCount(jobSystem);
+	size_t rangeSize = (vertices.size() + threadCount - 1) / threadCount;
+	JobSystem::parallelFor(vertices.size(), std::max(MIN_TANGENT_RANGE, rangeSize), calculateRange, jobSystem);
+}
+
+void OBJMesh::calculateBounds(const std::vector<Vertex>& vertices, Bounds& bounds) {
+	if (vertices.empty()) {
+		bounds.min = bounds.max = bounds.centre = glm::vec3(0);
+		bounds.radius = 0;
+		return;
+	}
 
-		float r = 1.0F / (s1 * t2 - s2 * t1);
-		glm::vec4 sdir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r,
-					   (t2 * z1 - t1 * z2) * r, 0);
-		glm::vec4 tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r,
-					   (s1 * z2 - s2 * z1) * r, 0);
+	bounds.min = bounds.max = glm::vec3(vertices[0].position);
+	for (auto& v : vertices) {
+		bounds.min = glm::min(bounds.min, glm::vec3(v.position));
+		bounds.max = glm::max(bounds.max, glm::vec3(v.position));
+	}
 
-		tan1[i1] += sdir;
-		tan1[i2] += sdir;
-		tan1[i3] += sdir;
+	// sphere is centred on the box, but sized to the furthest vertex so it's tighter than the box's corners
+	bounds.centre = (bounds.min + bounds.max) * 0.5f;
+	float radiusSquared = 0;
+	for (auto& v : vertices) {
+		glm::vec3 offset = glm::vec3(v.position) - bounds.centre;
+		radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+	}
+	bounds.radius = sqrtf(radiusSquared);
+}
 
-		tan2[i1] += tdir;
-		tan2[i2] += tdir;
-		tan2[i3] += tdir;
+void OBJMesh::generateLods(const std::vector<Vertex>& vertices, const LodSettings& settings, float radius, std::vector<unsigned int>& indices, std::vector<LodRange>& lods, std::vector<float>& errors) {
+
+	// the simplifier would see repeated identical vertices as seams and never move them, so point
+	// each triangle at the first copy of its vertices instead
+	std::vector<unsigned int> firstCopy;
+	findFirstCopies(vertices, firstCopy);
+
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+		positions[i] = glm::vec3(vertices[i].position);
+	std::vector<unsigned int> welded(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i)
+		welded[i] = firstCopy[indices[i]];
+
+	// each lod continues simplifying from the last, and is appended to the index buffer unless it
+	// removed nothing, in which case it shares the previous lod's range
+	MeshSimplifier simplifier(positions, welded);
+	size_t fullIndexCount = indices.size();
+	for (float ratio : settings.ratios) {
+		size_t target = (size_t)(fullIndexCount / 3 * ratio) * 3;
+		float error = simplifier.simplify(target, settings.maxError * radius);
+		const std::vector<unsigned int>& simplified = simplifier.getIndices();
+		if (simplified.size() < lods.back().indexCount) {
+			lods.push_back({ (unsigned int)indices.size(), (unsigned int)simplified.size() });
+			indices.insert(indices.end(), simplified.begin(), simplified.end());
+		}
+		else {
+			lods.push_back(lods.back());
+		}
+		errors.push_back(error);
 	}
+}
+
+void OBJMesh::optimizeChunkOrder(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::vector<LodRange>& lods) {
 
-	for (unsigned int a = 0; a < vertexCount; a++) {
-		const glm::vec3& n = glm::vec3(vertices[a].normal);
-		const glm::vec3& t = glm::vec3(tan1[a]);
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+		positions[i] = glm::vec3(vertices[i].position);
 
-		// Gram-Schmidt orthogonalize
-		vertices[a].tangent = glm::vec4(glm::normalize(t - n * glm::dot(n, t)), 0);
+	// each lod is drawn on its own, so each is ordered on its own. lods that share the previous
+	// lod's range have already been done
+	for (size_t lod = 0; lod < lods.size(); ++lod) {
+		if (lod > 0 && lods[lod].firstIndex == lods[lod - 1].firstIndex)
+			continue;
+		unsigned int* lodIndices = indices.data() + lods[lod].firstIndex;
+		MeshOptimizer::optimizeVertexCache(lodIndices, lods[lod].indexCount, vertices.size());
+		MeshOptimizer::optimizeOverdraw(lodIndices, lods[lod].indexCount, positions);
+	}
 
-		// Calculate handedness (direction of bitangent)
-		vertices[a].tangent.w = (glm::dot(glm::cross(glm::vec3(n), glm::vec3(t)), glm::vec3(tan2[a])) < 0.0F) ? 1.0F : -1.0F;
+	// number the vertices in the order lod 0 and then the coarser lods first use them, dropping
+	// those no triangle uses
+	std::vector<unsigned int> remap;
+	unsigned int usedCount = MeshOptimizer::optimizeVertexFetch(remap, indices.data(), indices.size(), vertices.size());
+	std::vector<Vertex> reordered(usedCount);
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		if (remap[i] != ~0u)
+			reordered[remap[i]] = vertices[i];
 	}
+	vertices.swap(reordered);
+	for (auto& i : indices)
+		i = remap[i];
+}
 
-	delete[] tan1;
+void OBJMesh::setOccluderProxy(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices) {
+	m_occluderPositions = positions;
+	m_occluderIndices = indices;
 }
 }
\ No newline at end of file
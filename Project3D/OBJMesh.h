@@ -5,10 +5,16 @@
 #include <glm/vec4.hpp>
 #include <string>
 #include <vector>
+#include <memory>
 #include "Texture.h"
+#include "MeshOptimizer.h"
+#include "GeometryArena.h"
 
 namespace aie {
 
+struct MaterialBindingLayout;
+class JobSystem;
+
 // a simple triangle mesh wrapper
 class OBJMesh {
 public:
@@ -23,6 +29,42 @@ public:
 		glm::vec4 tangent;	// added to attrib location 3
 	};
 
+	// a compressed vertex, 20 bytes rather than 56. positions are quantised to 16 bits across the
+	// chunk's bounds, normals and tangents are octahedral encoded as snorm16 and texcoords are half
+	// floats. the position's w holds the tangent's handedness (0 for -1, 1 for +1)
+	struct PackedVertex {
+		unsigned short	position[4];	// added to attrib location 0
+		short			normal[2];		// added to attrib location 1
+		unsigned short	texcoord[2];	// added to attrib location 2
+		short			tangent[2];		// added to attrib location 3
+	};
+
+	// vertex buffer binding index that per-instance model transforms are sourced from
+	static const unsigned int INSTANCE_BINDING = 4;
+
+	// vertex buffer binding index that a chunk's dequantisation (a scale and an offset vec4 at attrib
+	// locations 8 and 9) is sourced from, per instance. drawChunkInstanced binds it with a stride of 0,
+	// so every vertex reads the same values, and a multi-draw binds a copy for each instance drawn.
+	// the scale's w is 1 when the chunk's vertices are packed, and 0 when they are plain Vertex
+	static const unsigned int DEQUANTISE_BINDING = 5;
+
+	// model space bounding volumes, computed at load
+	struct Bounds {
+		glm::vec3 min;
+		glm::vec3 max;
+		glm::vec3 centre;
+		float radius;
+	};
+
+	// settings for generating an lod chain at load time by quadric error edge collapse. lod i + 1
+	// targets ratios[i] of the full triangle count, and collapses stop once they would move the
+	// surface further than maxError (as a fraction of each chunk's bounding radius). lods that
+	// can't remove at least a tenth of the previous lod's triangles end the chain
+	struct LodSettings {
+		std::vector<float> ratios = { 0.5f, 0.25f, 0.125f, 0.0625f };
+		float maxError = 0.05f;
+	};
+
 	// a basic material
 	class Material {
 	public:
@@ -38,44 +80,177 @@ public:
 		float specularPower;
 		float opacity;
 
-		Texture diffuseTexture;				// bound slot 0
-		Texture alphaTexture;				// bound slot 1
-		Texture ambientTexture;				// bound slot 2
-		Texture specularTexture;			// bound slot 3
-		Texture specularHighlightTexture;	// bound slot 4
-		Texture normalTexture;				// bound slot 5
-		Texture displacementTexture;		// bound slot 6
+		// shared through the TextureCache, and null where the material has no texture
+		std::shared_ptr<Texture> diffuseTexture;			// bound slot 0 (DIFFUSE_TEXTURE)
+		std::shared_ptr<Texture> alphaTexture;				// bound slot 1 (ALPHA_TEXTURE)
+		std::shared_ptr<Texture> ambientTexture;			// bound slot 2 (AMBIENT_TEXTURE)
+		std::shared_ptr<Texture> specularTexture;			// bound slot 3 (SPECULAR_TEXTURE)
+		std::shared_ptr<Texture> specularHighlightTexture;	// bound slot 4 (SPECULAR_HIGHLIGHT_TEXTURE)
+		std::shared_ptr<Texture> normalTexture;				// bound slot 5 (NORMAL_TEXTURE)
+		std::shared_ptr<Texture> displacementTexture;		// bound slot 6 (DISPLACEMENT_TEXTURE)
 	};
 
-	OBJMesh() {}
+	OBJMesh();
 	~OBJMesh();
 
-	// will fail if a mesh has already been loaded in to this instance
-	bool load(const char* filename, bool loadTextures = true, bool flipTextureV = false);
+	// will fail if a mesh has already been loaded in to this instance. the uploaded buffers are cached
+	// next to the obj (see getCacheFilename) and loaded from there instead while the obj, its material
+	// libraries and the load settings stay the same. textures are only loaded when loadTextures is set,
+	// on first use (see takeTextureRequests), and are shared with every other mesh naming the same file
+	// an lod chain is generated when lodSettings is given. optimizeVertexOrder welds identical
+	// vertices, reorders every lod's triangles for the post-transform cache and then overdraw, and
+	// reorders the vertices in the order the triangles use them. packVertices uploads PackedVertex
+	// rather than Vertex, with 16 bit indices for chunks of fewer than 65536 vertices
+	bool load(const char* filename, bool loadTextures = true, bool flipTextureV = false, const LodSettings* lodSettings = nullptr, bool optimizeVertexOrder = false, bool packVertices = false);
 
+	// load split in two, so everything but the opengl work can run on another thread. prepare takes
+	// the same arguments as load, and parses (or reads the cache) and builds the chunks without
+	// touching opengl. uploadNext then uploads one chunk per call on the opengl thread, returning
+	// false once nothing is left, and the mesh can be drawn once they are all up (isLoaded)
+	bool prepare(const char* filename, bool loadTextures = true, bool flipTextureV = false, const LodSettings* lodSettings = nullptr, bool optimizeVertexOrder = false, bool packVertices = false);
+	bool uploadNext();
+	bool isLoaded() const { return m_loaded; }
+
+	// textures are loaded on first use. bindMaterial asks for each texture the bound program samples
+	// that the material names but isn't loaded yet, binding a placeholder in it's place meanwhile.
+	// takeTextureRequests hands over the textures asked for since it was last called, as material
+	// index * MATERIAL_TEXTURE_Count + slot, for a loader to load getTextureFilename(request) and give
+	// the uploaded texture back with setTexture (see AssetLoader). loadRequestedTextures does all of
+	// that straight away, for meshes that were loaded without a loader
+	void takeTextureRequests(std::vector<unsigned int>& requests);
+	const std::string& getTextureFilename(unsigned int request) const { return m_textureFilenames[request]; }
+	void setTexture(unsigned int request, const std::shared_ptr<Texture>& texture);
+	void loadRequestedTextures();
+
+	// drawing for callers that order draws themselves (the scene's render queue). bindMaterial
+	// binds a material (or the default material for an index of -1) using the layout of the
+	// bound program, drawChunkInstanced draws one lod of one chunk without binding its material,
+	// reading each copy's model transform from instanceBuffer starting at firstInstance.
 	// allow option to draw as patches for tessellation
-	void draw(bool usePatches = false);
+	void bindMaterial(const MaterialBindingLayout& layout, int materialIndex);
+	void drawChunkInstanced(size_t chunkIndex, unsigned int lod, unsigned int instanceBuffer, unsigned int firstInstance, unsigned int instanceCount, bool usePatches = false);
+
+	// the command drawing one lod of one chunk in a multi-draw of it's vertex array, reading the
+	// instanced attributes from firstInstance onwards of the buffers bound at INSTANCE_BINDING and
+	// DEQUANTISE_BINDING, which the caller fills with each instance's transform and getChunkDequantise
+	GeometryArena::DrawCommand getChunkDrawCommand(size_t chunkIndex, unsigned int lod, unsigned int firstInstance, unsigned int instanceCount) const;
 
 	// access to the filename that was loaded
 	const std::string& getFilename() const { return m_filename; }
 
+	// the binary cache written for an obj
+	static std::string getCacheFilename(const char* filename);
+
+	// whether the last load came from the cache, and how long it took (not including textures, which
+	// load later, or any time spent between prepare and uploadNext calls)
+	bool wasLoadedFromCache() const { return m_loadedFromCache; }
+	float getLoadMilliseconds() const { return m_loadMilliseconds; }
+
+	// number of separately drawn chunks (one draw call each)
+	size_t getChunkCount() const { return m_meshChunks.size(); }
+
+	// bounding volume access, for the whole mesh or a single chunk
+	const Bounds& getBounds() const { return m_bounds; }
+	const Bounds& getChunkBounds(size_t index) const { return m_meshChunks[index].bounds; }
+
+	// per chunk state, the material index is -1 if the chunk has no material. chunks are drawn with
+	// the vertex array of the geometry arena pool they were uploaded to, which they share with every
+	// other chunk of the same vertex format and index type
+	int getChunkMaterialIndex(size_t index) const { return m_meshChunks[index].materialID; }
+	unsigned int getChunkVertexArray(size_t index) const { return GeometryArena::getVertexArray(m_meshChunks[index].geometry.pool); }
+	unsigned int getChunkIndexType(size_t index) const { return m_meshChunks[index].indexType; }
+	const glm::vec4* getChunkDequantise(size_t index) const { return m_meshChunks[index].dequantise; }
+
+	// lod access, lod 0 is the full mesh and every chunk has the same number of lods. the error
+	// of an lod is the furthest (in model space) any of its chunks' collapses moved the surface
+	unsigned int getLodCount() const { return (unsigned int)m_lodErrors.size(); }
+	float getLodError(unsigned int lod) const { return m_lodErrors[lod]; }
+	unsigned int getChunkIndexCount(size_t index, unsigned int lod) const { return m_meshChunks[index].lods[lod].indexCount; }
+
+	// post-transform cache behaviour of lod 0 across every chunk, in the order tinyobj produced it and
+	// after optimizeVertexOrder. both are empty unless the mesh was loaded with optimizeVertexOrder
+	const MeshOptimizer::CacheStats& getCacheStatsBefore() const { return m_cacheStatsBefore; }
+	const MeshOptimizer::CacheStats& getCacheStatsAfter() const { return m_cacheStatsAfter; }
+
+	// bytes of vertex and index data uploaded for every chunk of the mesh
+	size_t getVertexBufferSize() const { return m_vertexBufferSize; }
+	size_t getIndexBufferSize() const { return m_indexBufferSize; }
+
 	// material access
 	size_t getMaterialCount() const { return m_materials.size();  }
 	Material& getMaterial(size_t index) { return m_materials[index];  }
 
+	// model space triangles rasterised when an instance of this mesh is an occluder, by default
+	// every chunk's triangles of the coarsest lod merged together. a simplified proxy can be set
+	// in their place
+	const std::vector<glm::vec3>& getOccluderPositions() const { return m_occluderPositions; }
+	const std::vector<unsigned int>& getOccluderIndices() const { return m_occluderIndices; }
+	void setOccluderProxy(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices);
+
+	// generates the tangent of every vertex from the triangles using it, across jobSystem's threads (the
+	// shared job system's when null) when there is one. public so the job system benchmark can time it on
+	// its own job system
+	static void calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, JobSystem* jobSystem = nullptr);
+
 private:
 
-	void calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+	void calculateBounds(const std::vector<Vertex>& vertices, Bounds& bounds);
+	// a range of a chunk's index buffer, which holds every lod one after another
+	struct LodRange {
+		unsigned int	firstIndex;
+		unsigned int	indexCount;
+	};
+
+	void generateLods(const std::vector<Vertex>& vertices, const LodSettings& settings, float radius, std::vector<unsigned int>& indices, std::vector<LodRange>& lods, std::vector<float>& errors);
+	void optimizeChunkOrder(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::vector<LodRange>& lods);
 
 	struct MeshChunk {
-		unsigned int	vao, vbo, ibo;
-		unsigned int	indexCount;
-		int				materialID;
+		GeometryArena::Allocation	geometry;
+		size_t					dequantiseOffset = 0;	// bytes from the chunk's first vertex to it's dequantisation
+		std::vector<LodRange>	lods;
+		unsigned int			indexType;
+		bool					packed;
+		glm::vec4				dequantise[2];
+		int						materialID;
+		Bounds					bounds;
 	};
 
+	// cache files start with "OBJC" and a version that must be bumped whenever their layout changes
+	static const unsigned int CACHE_MAGIC = 0x434A424F;
+	static const unsigned int CACHE_VERSION = 1;
+
+	void setTextureFilenames(const std::string& folder, const std::vector<std::string>& names);
+	void uploadChunk(MeshChunk& chunk, const void* vertexData, size_t vertexDataSize, const void* indexData, size_t indexDataSize);
+	void saveCache(const char* cacheFilename, unsigned long long key, const std::vector<std::string>& textureNames, const std::vector<std::vector<char>>& chunkVertexData, const std::vector<std::vector<char>>& chunkIndexData);
+	bool loadCache(const char* cacheFilename, unsigned long long key, const std::string& folder, bool loadTextures);
+
 	std::string				m_filename;
+	Bounds					m_bounds;
 	std::vector<MeshChunk>	m_meshChunks;
 	std::vector<Material>	m_materials;
+	std::vector<float>		m_lodErrors;
+
+	MeshOptimizer::CacheStats	m_cacheStatsBefore;
+	MeshOptimizer::CacheStats	m_cacheStatsAfter;
+
+	size_t					m_vertexBufferSize = 0;
+	size_t					m_indexBufferSize = 0;
+
+	struct PendingUpload;
+	std::unique_ptr<PendingUpload>	m_pending;
+	bool					m_loaded = false;
+
+	// each material's texture file names in binding slot order (empty where it has none, or none at all
+	// if textures aren't loaded), whether each has been asked for, and those still to be taken
+	std::vector<std::string>	m_textureFilenames;
+	std::vector<bool>			m_texturesRequested;
+	std::vector<unsigned int>	m_textureRequests;
+
+	bool					m_loadedFromCache = false;
+	float					m_loadMilliseconds = 0;
+
+	std::vector<glm::vec3>		m_occluderPositions;
+	std::vector<unsigned int>	m_occluderIndices;
 };
 
 } // namespace aie
\ No newline at end of file
@@ -0,0 +1,614 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static const char* skipSpace(const char* cursor, const char* end)
+{
+	while (cursor < end && isSpace(*cursor))
+		cursor++;
+	return cursor;
+}
+
+// Parses a float after any spaces, leaving value 0 and the cursor where it was if there isn't one
+static const char* parseFloat(const char* cursor, const char* end, float& value)
+{
+	cursor = skipSpace(cursor, end);
+	const char* start = cursor < end && *cursor == '+' ? cursor + 1 : cursor;
+	std::from_chars_result result = std::from_chars(start, end, value);
+	if (result.ec != std::errc())
+	{
+		value = 0;
+		return result.ptr == start ? cursor : result.ptr;
+	}
+	return result.ptr;
+}
+
+// Parses an integer, leaving value 0 and the cursor where it was if there isn't one
+static const char* parseInt(const char* cursor, const char* end, int& value)
+{
+	std::from_chars_result result = std::from_chars(cursor, end, value);
+	if (result.ec != std::errc())
+	{
+		value = 0;
+		return result.ptr == cursor ? cursor : result.ptr;
+	}
+	return result.ptr;
+}
+
+// Returns the first word after any spaces
+static std::string parseName(const char* cursor, const char* end)
+{
+	cursor = skipSpace(cursor, end);
+	const char* last = cursor;
+	while (last < end && isSpace(*last) == false)
+		last++;
+	return std::string(cursor, last);
+}
+
+// Returns the rest of the line after any spaces, without trailing spaces
+static std::string parseRestOfLine(const char* cursor, const char* end)
+{
+	cursor = skipSpace(cursor, end);
+	while (end > cursor && isSpace(end[-1]))
+		end--;
+	return std::string(cursor, end);
+}
+
+// Whether the line starts with the keyword followed by a space
+static bool isKeyword(const char* line, const char* end, const char* keyword)
+{
+	size_t length = strlen(keyword);
+	return (size_t)(end - line) > length && strncmp(line, keyword, length) == 0 && isSpace(line[length]);
+}
+
+/// <summary>
+/// CornerMap maps corners to the index of the vertex made for them, used to deduplicate a chunk's vertices. It
+/// keeps a chain of the entries sharing each position in a table indexed by position, rather than hashing. An OBJ
+/// uses it's positions close to where they are defined, so lookups walk a nearby table entry and a chain that is
+/// rarely longer than the number of texture seams at a position, instead of missing the cache on a hash bucket.
+/// </summary>
+class ObjParser::CornerMap
+{
+public:
+
+	// The map only takes corners with positions from firstPosition to lastPosition inclusive
+	CornerMap(int firstPosition, int lastPosition) : m_firstPosition(firstPosition)
+	{
+		m_heads.assign(lastPosition >= firstPosition ? lastPosition - firstPosition + 1 : 0, NO_ENTRY);
+	}
+
+	// Returns the value stored for the corner, storing value for it first if the corner isn't in the map yet
+	unsigned int insert(const Corner& corner, unsigned int value)
+	{
+		unsigned int& head = m_heads[corner.position - m_firstPosition];
+		for (unsigned int i = head; i != NO_ENTRY; i = m_entries[i].next)
+		{
+			const Entry& entry = m_entries[i];
+			if (entry.texcoord == corner.texcoord && entry.normal == corner.normal)
+				return entry.value;
+		}
+		m_entries.push_back({ corner.texcoord, corner.normal, value, head });
+		head = (unsigned int)m_entries.size() - 1;
+		return value;
+	}
+
+private:
+
+	static constexpr unsigned int NO_ENTRY = 0xFFFFFFFF;
+
+	struct Entry
+	{
+		int texcoord;
+		int normal;
+		unsigned int value;
+		unsigned int next;
+	};
+
+	int m_firstPosition;
+	std::vector<unsigned int> m_heads;
+	std::vector<Entry> m_entries;
+};
+
+/// <summary>
+/// parse() maps the file and splits it into one line aligned block per thread (fewer for small files), parses the
+/// blocks in parallel, and then merges them. The blocks' attributes are concatenated, their relative indices are
+/// resolved against the attributes of the blocks before them, and every index is checked. The group, object,
+/// material and library lines are then replayed in file order, loading libraries and splitting the faces into a
+/// chunk per run of a material, and lastly each chunk's vertices are built.
+/// </summary>
+/// <param name="filename">The OBJ file to parse, with it's MTL libraries relative to it's folder.</param>
+/// <param name="flipTextureV">Whether to flip the V of texture coordinates.</param>
+/// <param name="threadCount">Most threads to parse with, 0 for one per hardware thread.</param>
+/// <returns>False if the file couldn't be read or a face refers to an attribute that doesn't exist, with getError() saying why.</returns>
+bool ObjParser::parse(const char* filename, bool flipTextureV, unsigned int threadCount)
+{
+	m_chunks.clear();
+	m_materials.clear();
+	m_error.clear();
+	m_triangleCount = 0;
+
+	aie::MappedFile file;
+	if (file.open(filename) == false)
+	{
+		m_error = std::string("Couldn't open ") + filename;
+		return false;
+	}
+	m_fileSize = file.getSize();
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, MAX_THREADS);
+
+	// Split the file into blocks that each end just after a newline
+	size_t blockCount = std::max((size_t)1, std::min((size_t)threadCount, m_fileSize / MIN_BLOCK_SIZE));
+	std::vector<Block> blocks(blockCount);
+	const char* text = (const char*)file.getData();
+	const char* textEnd = text + m_fileSize;
+	const char* blockStart = text;
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		const char* blockEnd = i + 1 < blockCount ? std::max(blockStart, text + m_fileSize / blockCount * (i + 1)) : textEnd;
+		const char* newline = (const char*)memchr(blockEnd, '\n', textEnd - blockEnd);
+		blockEnd = newline != nullptr && i + 1 < blockCount ? newline + 1 : textEnd;
+		blocks[i].begin = blockStart;
+		blocks[i].end = blockEnd;
+		blockStart = blockEnd;
+	}
+
+	aie::JobSystem::parallelFor(blockCount, 1, [&blocks](size_t firstBlock, size_t lastBlock)
+	{
+		for (size_t i = firstBlock; i < lastBlock; i++)
+			parseBlock(blocks[i]);
+	});
+
+	// Merge the attributes, remembering where each block's start
+	std::vector<size_t> positionBases(blockCount), texcoordBases(blockCount), normalBases(blockCount), cornerBases(blockCount);
+	size_t positionCount = 0, texcoordCount = 0, normalCount = 0, cornerCount = 0;
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		positionBases[i] = positionCount;
+		texcoordBases[i] = texcoordCount;
+		normalBases[i] = normalCount;
+		cornerBases[i] = cornerCount;
+		positionCount += blocks[i].positions.size();
+		texcoordCount += blocks[i].texcoords.size();
+		normalCount += blocks[i].normals.size();
+		cornerCount += blocks[i].corners.size();
+	}
+	m_positions.resize(positionCount);
+	m_texcoords.resize(texcoordCount);
+	m_normals.resize(normalCount);
+	std::vector<Corner> corners(cornerCount);
+	m_triangleCount = cornerCount / 3;
+
+	// Resolve relative indices, check every index, and copy each block's data in to place
+	std::vector<char> blockValid(blockCount, 1);
+	aie::JobSystem::parallelFor(blockCount, 1, [&](size_t firstBlock, size_t lastBlock)
+	{
+		for (size_t i = firstBlock; i < lastBlock; i++)
+		{
+			Block& block = blocks[i];
+			int bases[3] = { (int)positionBases[i], (int)texcoordBases[i], (int)normalBases[i] };
+			for (size_t relative : block.relativeCorners)
+			{
+				int* attribute = &block.corners[relative / 3].position + relative % 3;
+				*attribute += bases[relative % 3];
+			}
+			for (auto& corner : block.corners)
+			{
+				if (corner.position < 0 || corner.position >= (int)positionCount ||
+					corner.texcoord < -1 || corner.texcoord >= (int)texcoordCount ||
+					corner.normal < -1 || corner.normal >= (int)normalCount)
+				{
+					blockValid[i] = 0;
+					break;
+				}
+			}
+			std::copy(block.positions.begin(), block.positions.end(), m_positions.begin() + positionBases[i]);
+			std::copy(block.texcoords.begin(), block.texcoords.end(), m_texcoords.begin() + texcoordBases[i]);
+			std::copy(block.normals.begin(), block.normals.end(), m_normals.begin() + normalBases[i]);
+			std::copy(block.corners.begin(), block.corners.end(), corners.begin() + cornerBases[i]);
+			std::vector<Corner>().swap(block.corners);
+		}
+	});
+	if (std::find(blockValid.begin(), blockValid.end(), 0) != blockValid.end())
+	{
+		m_error = std::string(filename) + " has a face index out of range";
+		return false;
+	}
+
+	// Replay the events in file order, cutting a chunk at every group, object and material change
+	std::string folder = std::string(filename).substr(0, std::string(filename).find_last_of('/') + 1);
+	struct Range { size_t first, last; int materialID; };
+	std::vector<Range> ranges;
+	size_t rangeStart = 0;
+	int materialID = -1;
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		for (auto& event : blocks[i].events)
+		{
+			size_t triangle = cornerBases[i] / 3 + event.triangle;
+			if (event.type == Event::LIBRARY)
+			{
+				parseMaterialLibrary(folder + event.name);
+				continue;
+			}
+			if (triangle > rangeStart)
+				ranges.push_back({ rangeStart, triangle, materialID });
+			rangeStart = triangle;
+			if (event.type == Event::MATERIAL)
+			{
+				materialID = -1;
+				for (size_t m = 0; m < m_materials.size() && materialID < 0; m++)
+				{
+					if (m_materials[m].name == event.name)
+						materialID = (int)m;
+				}
+			}
+		}
+	}
+	if (m_triangleCount > rangeStart)
+		ranges.push_back({ rangeStart, m_triangleCount, materialID });
+
+	m_chunks.resize(ranges.size());
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		m_chunks[i].materialID = ranges[i].materialID;
+		buildChunk(m_chunks[i], corners.data() + ranges[i].first * 3, (ranges[i].last - ranges[i].first) * 3, flipTextureV, threadCount);
+	}
+
+	std::vector<glm::vec3>().swap(m_positions);
+	std::vector<glm::vec2>().swap(m_texcoords);
+	std::vector<glm::vec3>().swap(m_normals);
+	return true;
+}
+
+/// <summary>
+/// parseBlock() parses every line of a block. Vertex attributes are appended to the block's arrays, faces are
+/// triangulated as fans and appended as corners, and group, object, material and library lines are recorded as
+/// events at the block's current triangle count. Anything else is ignored.
+/// </summary>
+/// <param name="block">The block to parse, which only reads the file between it's begin and end.</param>
+void ObjParser::parseBlock(Block& block)
+{
+	const char* cursor = block.begin;
+	while (cursor < block.end)
+	{
+		const char* lineEnd = (const char*)memchr(cursor, '\n', block.end - cursor);
+		if (lineEnd == nullptr)
+			lineEnd = block.end;
+		const char* nextLine = lineEnd < block.end ? lineEnd + 1 : block.end;
+		if (lineEnd > cursor && lineEnd[-1] == '\r')
+			lineEnd--;
+
+		const char* line = skipSpace(cursor, lineEnd);
+		cursor = nextLine;
+		if (lineEnd - line < 2)
+			continue;
+
+		if (line[0] == 'v' && isSpace(line[1]))
+		{
+			glm::vec3 position;
+			const char* c = parseFloat(line + 2, lineEnd, position.x);
+			c = parseFloat(c, lineEnd, position.y);
+			parseFloat(c, lineEnd, position.z);
+			block.positions.push_back(position);
+		}
+		else if (isKeyword(line, lineEnd, "vn"))
+		{
+			glm::vec3 normal;
+			const char* c = parseFloat(line + 3, lineEnd, normal.x);
+			c = parseFloat(c, lineEnd, normal.y);
+			parseFloat(c, lineEnd, normal.z);
+			block.normals.push_back(normal);
+		}
+		else if (isKeyword(line, lineEnd, "vt"))
+		{
+			glm::vec2 texcoord;
+			const char* c = parseFloat(line + 3, lineEnd, texcoord.x);
+			parseFloat(c, lineEnd, texcoord.y);
+			block.texcoords.push_back(texcoord);
+		}
+		else if (line[0] == 'f' && isSpace(line[1]))
+		{
+			// Each corner is v, v/vt, v//vn or v/vt/vn, with negative indices counting back from the latest attribute
+			const size_t counts[3] = { block.positions.size(), block.texcoords.size(), block.normals.size() };
+			Corner first = {}, previous = {};
+			unsigned int firstRelative = 0, previousRelative = 0;
+			unsigned int cornerIndex = 0;
+			const char* c = line + 2;
+			while (true)
+			{
+				c = skipSpace(c, lineEnd);
+				int values[3] = { 0, 0, 0 };
+				bool present[3] = { false, false, false };
+				const char* after = parseInt(c, lineEnd, values[0]);
+				if (after == c)
+					break;
+				present[0] = true;
+				c = after;
+				if (c < lineEnd && *c == '/')
+				{
+					c++;
+					if (c < lineEnd && *c != '/')
+					{
+						after = parseInt(c, lineEnd, values[1]);
+						present[1] = after != c;
+						c = after;
+					}
+					if (c < lineEnd && *c == '/')
+					{
+						c++;
+						after = parseInt(c, lineEnd, values[2]);
+						present[2] = after != c;
+						c = after;
+					}
+				}
+				while (c < lineEnd && isSpace(*c) == false)
+					c++;
+
+				Corner corner;
+				unsigned int relative = 0;
+				int* attributes = &corner.position;
+				for (int a = 0; a < 3; a++)
+				{
+					if (present[a] == false)
+						attributes[a] = -1;
+					else if (values[a] > 0)
+						attributes[a] = values[a] - 1;
+					else if (values[a] == 0)
+						attributes[a] = 0;
+					else
+					{
+						attributes[a] = (int)counts[a] + values[a];
+						relative |= 1 << a;
+					}
+				}
+
+				if (cornerIndex == 0)
+				{
+					first = corner;
+					firstRelative = relative;
+				}
+				else if (cornerIndex >= 2)
+				{
+					const Corner triangle[3] = { first, previous, corner };
+					const unsigned int triangleRelative[3] = { firstRelative, previousRelative, relative };
+					for (int v = 0; v < 3; v++)
+					{
+						for (int a = 0; a < 3; a++)
+						{
+							if (triangleRelative[v] & (1 << a))
+								block.relativeCorners.push_back(block.corners.size() * 3 + a);
+						}
+						block.corners.push_back(triangle[v]);
+					}
+				}
+				previous = corner;
+				previousRelative = relative;
+				cornerIndex++;
+			}
+		}
+		else if ((line[0] == 'g' || line[0] == 'o') && isSpace(line[1]))
+		{
+			block.events.push_back({ Event::GROUP, block.corners.size() / 3, std::string() });
+		}
+		else if (isKeyword(line, lineEnd, "usemtl"))
+		{
+			block.events.push_back({ Event::MATERIAL, block.corners.size() / 3, parseName(line + 7, lineEnd) });
+		}
+		else if (isKeyword(line, lineEnd, "mtllib"))
+		{
+			block.events.push_back({ Event::LIBRARY, block.corners.size() / 3, parseName(line + 7, lineEnd) });
+		}
+	}
+}
+
+/// <summary>
+/// parseMaterialLibrary() appends the materials of an MTL file to the parser's materials. Texture lines keep the
+/// rest of the line as the file name, and a Tr line sets the opacity to 1 - Tr, both as tiny_obj_loader did.
+/// </summary>
+/// <param name="filename">The MTL file to load.</param>
+/// <returns>False if the file couldn't be opened, which isn't an error for the OBJ, it's faces just have no material.</returns>
+bool ObjParser::parseMaterialLibrary(const std::string& filename)
+{
+	aie::MappedFile file;
+	if (file.open(filename.c_str()) == false)
+		return false;
+
+	// Texture keywords, in binding slot order, with bump as an alias of map_bump
+	static const char* textureKeywords[aie::MATERIAL_TEXTURE_Count] = { "map_Kd", "map_d", "map_Ka", "map_Ks", "map_Ns", "map_bump", "disp" };
+
+	const char* cursor = (const char*)file.getData();
+	const char* end = cursor + file.getSize();
+	Material* material = nullptr;
+	while (cursor < end)
+	{
+		const char* lineEnd = (const char*)memchr(cursor, '\n', end - cursor);
+		if (lineEnd == nullptr)
+			lineEnd = end;
+		const char* nextLine = lineEnd < end ? lineEnd + 1 : end;
+		if (lineEnd > cursor && lineEnd[-1] == '\r')
+			lineEnd--;
+		const char* line = skipSpace(cursor, lineEnd);
+		cursor = nextLine;
+
+		if (isKeyword(line, lineEnd, "newmtl"))
+		{
+			m_materials.push_back(Material());
+			material = &m_materials.back();
+			material->name = parseName(line + 7, lineEnd);
+			continue;
+		}
+		if (material == nullptr)
+			continue;
+
+		glm::vec3* colour = nullptr;
+		if (isKeyword(line, lineEnd, "Ka"))
+			colour = &material->ambient;
+		else if (isKeyword(line, lineEnd, "Kd"))
+			colour = &material->diffuse;
+		else if (isKeyword(line, lineEnd, "Ks"))
+			colour = &material->specular;
+		else if (isKeyword(line, lineEnd, "Ke"))
+			colour = &material->emissive;
+		if (colour != nullptr)
+		{
+			const char* c = parseFloat(line + 3, lineEnd, colour->x);
+			c = parseFloat(c, lineEnd, colour->y);
+			parseFloat(c, lineEnd, colour->z);
+			continue;
+		}
+
+		if (isKeyword(line, lineEnd, "Ns"))
+			parseFloat(line + 3, lineEnd, material->specularPower);
+		else if (isKeyword(line, lineEnd, "d"))
+			parseFloat(line + 2, lineEnd, material->opacity);
+		else if (isKeyword(line, lineEnd, "Tr"))
+		{
+			float transparency;
+			parseFloat(line + 3, lineEnd, transparency);
+			material->opacity = 1.0f - transparency;
+		}
+		else if (isKeyword(line, lineEnd, "bump"))
+			material->textures[aie::NORMAL_TEXTURE] = parseRestOfLine(line + 5, lineEnd);
+		else
+		{
+			for (unsigned int i = 0; i < aie::MATERIAL_TEXTURE_Count; i++)
+			{
+				if (isKeyword(line, lineEnd, textureKeywords[i]))
+				{
+					material->textures[i] = parseRestOfLine(line + strlen(textureKeywords[i]) + 1, lineEnd);
+					break;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// buildChunk() deduplicates a chunk's corners into vertices in parallel. The corners are split into one slice per
+/// thread, and each slice is deduplicated on it's own into slice local vertices, writing the local index of each
+/// corner. The slices' vertices are then merged in slice order, which keeps every vertex in the order it is first
+/// used across the whole chunk, and each slice's indices are remapped to the merged vertices, which are then built
+/// from the file's attributes in parallel.
+/// </summary>
+/// <param name="chunk">The chunk to fill, which already has it's material.</param>
+/// <param name="corners">The chunk's triangles' corners.</param>
+/// <param name="cornerCount">The number of corners, 3 per triangle.</param>
+/// <param name="flipTextureV">Whether to flip the V of texture coordinates.</param>
+/// <param name="threadCount">Most threads to split the chunk over.</param>
+void ObjParser::buildChunk(Chunk& chunk, const Corner* corners, size_t cornerCount, bool flipTextureV, unsigned int threadCount)
+{
+	const size_t minimumSliceSize = 64 * 1024;
+	size_t sliceCount = std::max((size_t)1, std::min((size_t)threadCount, cornerCount / minimumSliceSize));
+	size_t sliceSize = (cornerCount + sliceCount - 1) / sliceCount;
+
+	chunk.indices.resize(cornerCount);
+	std::vector<std::vector<Corner>> sliceVertices(sliceCount);
+	aie::JobSystem::parallelFor(sliceCount, 1, [&](size_t firstSlice, size_t lastSlice)
+	{
+		for (size_t slice = firstSlice; slice < lastSlice; slice++)
+		{
+			size_t first = std::min(cornerCount, slice * sliceSize);
+			size_t last = std::min(cornerCount, first + sliceSize);
+			std::vector<Corner>& vertices = sliceVertices[slice];
+			int firstPosition = INT_MAX, lastPosition = -1;
+			for (size_t i = first; i < last; i++)
+			{
+				firstPosition = std::min(firstPosition, corners[i].position);
+				lastPosition = std::max(lastPosition, corners[i].position);
+			}
+			CornerMap map(firstPosition, lastPosition);
+			for (size_t i = first; i < last; i++)
+			{
+				unsigned int index = map.insert(corners[i], (unsigned int)vertices.size());
+				if (index == vertices.size())
+					vertices.push_back(corners[i]);
+				chunk.indices[i] = index;
+			}
+		}
+	});
+
+	// Merge the slices' vertices in order, then remap each slice's indices
+	std::vector<Corner> vertices;
+	if (sliceCount == 1)
+	{
+		vertices.swap(sliceVertices[0]);
+	}
+	else
+	{
+		std::vector<std::vector<unsigned int>> remaps(sliceCount);
+		CornerMap map(0, (int)m_positions.size() - 1);
+		for (size_t slice = 0; slice < sliceCount; slice++)
+		{
+			remaps[slice].resize(sliceVertices[slice].size());
+			for (size_t i = 0; i < sliceVertices[slice].size(); i++)
+			{
+				unsigned int index = map.insert(sliceVertices[slice][i], (unsigned int)vertices.size());
+				if (index == vertices.size())
+					vertices.push_back(sliceVertices[slice][i]);
+				remaps[slice][i] = index;
+			}
+			std::vector<Corner>().swap(sliceVertices[slice]);
+		}
+		aie::JobSystem::parallelFor(sliceCount, 1, [&](size_t firstSlice, size_t lastSlice)
+		{
+			for (size_t slice = firstSlice; slice < lastSlice; slice++)
+			{
+				size_t first = std::min(cornerCount, slice * sliceSize);
+				size_t last = std::min(cornerCount, first + sliceSize);
+				for (size_t i = first; i < last; i++)
+				{
+					chunk.indices[i] = remaps[slice][chunk.indices[i]];
+				}
+			}
+		});
+	}
+
+	// Build the vertices from the file's attributes, split over the same number of threads
+	chunk.vertices.resize(vertices.size());
+	size_t vertexSliceSize = (vertices.size() + sliceCount - 1) / sliceCount;
+	std::vector<char> sliceHasNormals(sliceCount, 0), sliceHasTexcoords(sliceCount, 0);
+	aie::JobSystem::parallelFor(sliceCount, 1, [&](size_t firstSlice, size_t lastSlice)
+	{
+		for (size_t slice = firstSlice; slice < lastSlice; slice++)
+		{
+			size_t first = std::min(vertices.size(), slice * vertexSliceSize);
+			size_t last = std::min(vertices.size(), first + vertexSliceSize);
+			for (size_t i = first; i < last; i++)
+			{
+				const Corner& corner = vertices[i];
+				aie::OBJMesh::Vertex& vertex = chunk.vertices[i];
+				vertex.position = glm::vec4(m_positions[corner.position], 1);
+				vertex.normal = glm::vec4(0);
+				vertex.texcoord = glm::vec2(0);
+				vertex.tangent = glm::vec4(0);
+				if (corner.normal >= 0)
+				{
+					vertex.normal = glm::vec4(m_normals[corner.normal], 0);
+					sliceHasNormals[slice] = 1;
+				}
+				if (corner.texcoord >= 0)
+				{
+					glm::vec2 texcoord = m_texcoords[corner.texcoord];
+					vertex.texcoord = glm::vec2(texcoord.x, flipTextureV ? 1.0f - texcoord.y : texcoord.y);
+					sliceHasTexcoords[slice] = 1;
+				}
+			}
+		}
+	});
+	chunk.hasNormals = std::find(sliceHasNormals.begin(), sliceHasNormals.end(), 1) != sliceHasNormals.end();
+	chunk.hasTexcoords = std::find(sliceHasTexcoords.begin(), sliceHasTexcoords.end(), 1) != sliceHasTexcoords.end();
+}
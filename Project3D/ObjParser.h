@@ -0,0 +1,122 @@
+#pragma once
+#include "OBJMesh.h"
+#include "Shader.h"
+#include <string>
+#include <vector>
+
+/// <summary>
+/// ObjParser reads an OBJ file and the MTL libraries it names straight into the arrays OBJMesh uploads. The file
+/// is memory mapped and split into line aligned blocks, which are parsed in parallel with std::from_chars into
+/// block local positions, normals, texture coordinates and triangulated faces, noting where each group, object and
+/// material change falls. The blocks are then merged in file order, with relative indices resolved, into one chunk
+/// per run of faces between those changes (as tiny_obj_loader splits shapes), and each chunk's vertices are
+/// deduplicated by their position, texture coordinate and normal indices in parallel, keeping the order each
+/// vertex is first used in.
+/// </summary>
+class ObjParser
+{
+public:
+
+	static constexpr unsigned int MAX_THREADS = 16; // Most threads a parse is split over
+	static constexpr size_t MIN_BLOCK_SIZE = 256 * 1024; // Smallest block of the file worth parsing on it's own thread
+
+	/// <summary>
+	/// A Material is one newmtl entry of an MTL library, with it's texture file names (relative to the OBJ's
+	/// folder) in binding slot order, empty where the material has no texture.
+	/// </summary>
+	struct Material
+	{
+		std::string name;
+		glm::vec3 ambient = glm::vec3(0);
+		glm::vec3 diffuse = glm::vec3(0);
+		glm::vec3 specular = glm::vec3(0);
+		glm::vec3 emissive = glm::vec3(0);
+		float specularPower = 1;
+		float opacity = 1;
+		std::string textures[aie::MATERIAL_TEXTURE_Count];
+	};
+
+	/// <summary>
+	/// A Chunk is a run of faces sharing a material, as OBJMesh vertices (without tangents) and triangle indices.
+	/// </summary>
+	struct Chunk
+	{
+		std::vector<aie::OBJMesh::Vertex> vertices;
+		std::vector<unsigned int> indices;
+		int materialID = -1;
+		bool hasNormals = false;
+		bool hasTexcoords = false;
+	};
+
+	ObjParser() {}
+	~ObjParser() {}
+
+	// Parses the file, flipping V texture coordinates if asked, split into jobs for threadCount threads (0 for one per hardware thread)
+	bool parse(const char* filename, bool flipTextureV = false, unsigned int threadCount = 0);
+
+	// Getters, chunks are non-const so they can be moved out of the parser
+	std::vector<Chunk>& getChunks() { return m_chunks; }
+	const std::vector<Material>& getMaterials() const { return m_materials; }
+	const std::string& getError() const { return m_error; }
+	size_t getFileSize() const { return m_fileSize; }
+	size_t getTriangleCount() const { return m_triangleCount; }
+
+protected:
+
+	/// <summary>
+	/// A Corner is one vertex of a face, as indices into the whole file's positions, texture coordinates and
+	/// normals, with -1 for an attribute the corner doesn't have.
+	/// </summary>
+	struct Corner
+	{
+		int position;
+		int texcoord;
+		int normal;
+	};
+
+	/// <summary>
+	/// An Event is a line of a block that splits chunks or loads materials, and the number of the block's
+	/// triangles that came before it.
+	/// </summary>
+	struct Event
+	{
+		enum Type { GROUP, MATERIAL, LIBRARY };
+		Type type;
+		size_t triangle;
+		std::string name;
+	};
+
+	/// <summary>
+	/// A Block is a line aligned range of the file and everything parsed from it. Negative (relative) indices
+	/// can only be resolved once the blocks before it are counted, so until then they are stored relative to
+	/// the block's first element, and listed in relativeCorners (as corner index * 3 + attribute).
+	/// </summary>
+	struct Block
+	{
+		const char* begin;
+		const char* end;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texcoords;
+		std::vector<glm::vec3> normals;
+		std::vector<Corner> corners;
+		std::vector<Event> events;
+		std::vector<size_t> relativeCorners;
+	};
+
+	class CornerMap;
+
+	static void parseBlock(Block& block);
+	bool parseMaterialLibrary(const std::string& filename);
+	void buildChunk(Chunk& chunk, const Corner* corners, size_t cornerCount, bool flipTextureV, unsigned int threadCount);
+
+	std::vector<Chunk> m_chunks;
+	std::vector<Material> m_materials;
+	std::string m_error;
+	size_t m_fileSize = 0;
+	size_t m_triangleCount = 0;
+
+	// The whole file's attributes, merged from every block
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::vec2> m_texcoords;
+	std::vector<glm::vec3> m_normals;
+};
@@ -1,47 +1,13 @@
 #include "ObjectInstance.h"
 #include "Scene.h"
-#include "Camera.h"
 #include "Light.h"
-#include "OBJMesh.h"
-#include "Shader.h"
-
-/// <summary>
-/// draw() takes an an input pointer to the scene we're drawing from, and goes through and binds
-/// all of the appropriate and corresponding uniforms for this ObjectInstance, before calling the
-/// draw function on the mesh of this ObjectInstance itself.
-/// </summary>
-/// <param name="scene">The scene this ObjectInstance is being drawn from.</param>
-void ObjectInstance::draw(Scene* scene)
-{
-	// Bind the shader program used for this ObjectInstance
-	m_shaderProgram->bind();
-
-	// Bind the camera position and ProjectionView uniforms using the scene main camera
-	m_shaderProgram->bindUniform("CameraPosition", scene->getCamera()->getPosition());
-	auto pv = scene->getCamera()->getProjectionMatrix(scene->getWindowSize().x, scene->getWindowSize().y) * scene->getCamera()->getViewMatrix();
-	m_shaderProgram->bindUniform("ProjectionViewTransform", pv);
-	// Bind the model transform uniform using this ObjectInstance's transform
-	m_shaderProgram->bindUniform("ModelTransform", m_transform);
-
-	// Bind the light uniforms for ambient lighting, main sunlighting, and the point lights in the scene
-	m_shaderProgram->bindUniform("AmbientColour", scene->getAmbientLight());
-	m_shaderProgram->bindUniform("LightColour", scene->getSunlight()->colour);
-	m_shaderProgram->bindUniform("LightDirection", scene->getSunlight()->direction);
-	int numLights = scene->getNumLights();
-	m_shaderProgram->bindUniform("numLights", numLights);
-	m_shaderProgram->bindUniform("PointLightColours", numLights, scene->getPointLightColours());
-	m_shaderProgram->bindUniform("PointLightPositions", numLights, scene->getPointLightPositions());
-	
-	// Draw the mesh of this ObjectInstance now the uniforms have been set correctly
-	m_mesh->draw();
-}
+#include <glm/ext.hpp>
 
 /// <summary>
 /// makeTransform() is a utility function that takes vec3 inputs for a position, set of euler angles, 
 /// and scale, and uses them to create a corresponding transformation matrix to represent said 
-/// position, rotation and scale. This function is called by one of the two custom constructors for
-/// ObjectInstance, and allows objects to be instantiated using vectors without having to input the
-/// transformation matrix yourself.
+/// position, rotation and scale. This function allows objects to be added to a scene using vectors
+/// without having to input the transformation matrix yourself.
 /// </summary>
 /// <param name="position">The desired position for the transformation matrix.</param>
 /// <param name="eulerAngles">The desired rotation in euler angles for the transformation matrix.</param>
@@ -55,3 +21,65 @@ glm::mat4 ObjectInstance::makeTransform(glm::vec3 position, glm::vec3 eulerAngle
 		* glm::rotate(glm::mat4(1), glm::radians(eulerAngles.x), glm::vec3(1, 0, 0))
 		* glm::scale(glm::mat4(1), scale);
 }
+
+/// <summary>
+/// isValid() checks whether this facade still refers to a live instance, that is, it was created by a scene
+/// and the instance hasn't since been removed from it. All other functions assume the facade is valid.
+/// </summary>
+/// <returns>True if the instance this facade refers to still exists.</returns>
+bool ObjectInstance::isValid() const
+{
+	return m_scene != nullptr && m_scene->getInstanceStore().isValid(m_handle);
+}
+
+const glm::mat4& ObjectInstance::getTransform() const
+{
+	return m_scene->getInstanceStore().getTransform(m_handle);
+}
+
+aie::OBJMesh* ObjectInstance::getMesh() const
+{
+	return m_scene->getMesh(m_scene->getInstanceStore().getMeshID(m_handle));
+}
+
+aie::ShaderProgram* ObjectInstance::getShaderProgram() const
+{
+	return m_scene->getShaderProgram(m_scene->getInstanceStore().getShaderID(m_handle));
+}
+
+bool ObjectInstance::isVisible() const
+{
+	return (m_scene->getInstanceStore().getFlags(m_handle) & INSTANCE_HIDDEN) == 0;
+}
+
+bool ObjectInstance::isOccluder() const
+{
+	return (m_scene->getInstanceStore().getFlags(m_handle) & INSTANCE_OCCLUDER) != 0;
+}
+
+void ObjectInstance::setTransform(const glm::mat4& transform)
+{
+	m_scene->getInstanceStore().getTransform(m_handle) = transform;
+}
+
+/// <summary>
+/// setVisible() shows or hides the instance by clearing or setting it's INSTANCE_HIDDEN flag, hidden
+/// instances stay in the scene but are skipped when drawing.
+/// </summary>
+/// <param name="visible">Whether the instance should be drawn.</param>
+void ObjectInstance::setVisible(bool visible)
+{
+	unsigned int flags = m_scene->getInstanceStore().getFlags(m_handle);
+	m_scene->getInstanceStore().setFlags(m_handle, visible ? (flags & ~INSTANCE_HIDDEN) : (flags | INSTANCE_HIDDEN));
+}
+
+/// <summary>
+/// setOccluder() sets or clears the instance's INSTANCE_OCCLUDER flag. The mesh of an occluder is rasterised
+/// into the scene's occlusion buffer each frame, so should be large and solid (or given a simplified proxy).
+/// </summary>
+/// <param name="occluder">Whether the instance should hide the instances behind it.</param>
+void ObjectInstance::setOccluder(bool occluder)
+{
+	unsigned int flags = m_scene->getInstanceStore().getFlags(m_handle);
+	m_scene->getInstanceStore().setFlags(m_handle, occluder ? (flags | INSTANCE_OCCLUDER) : (flags & ~INSTANCE_OCCLUDER));
+}
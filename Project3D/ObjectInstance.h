@@ -1,6 +1,7 @@
 #pragma once
 #include "glm/mat4x4.hpp"
 #include "glm/vec4.hpp"
+#include "InstanceStore.h"
 
 // Forward declarations of classes defined elsewhere
 namespace aie
@@ -13,34 +14,41 @@ class Camera;
 struct Light;
 
 /// <summary>
-/// ObjectInstance is a wrapper class that wraps the variables and drawing logic that is common for any object
-/// placed in the application's main scene. That is, the class contains a member variable to track the current
-/// transform of this ObjectInstance, as well as references to the Mesh and ShaderProgram used to draw this
-/// ObjectInstance. The draw() function for this class simply binds the member shader program for use, and
-/// then bind's the appropriate scene uniforms to the shader, as well as binding the appropriate uniforms
-/// corresponding to this ObjectInstance (i.e. the Model transform).
+/// ObjectInstance is a lightweight facade over an instance stored in a Scene's InstanceStore, holding only
+/// the scene the instance lives in and a generational handle to it. The instance's actual data (transform,
+/// mesh, shader program and flags) lives in the scene's dense per-instance arrays, so ObjectInstance's can
+/// be freely copied and passed by value, and any access through a facade whose instance has since been
+/// removed is detected with isValid(). ObjectInstance's are not drawn individually, instead the Scene groups
+/// all instances sharing a Mesh and ShaderProgram together each frame and draws them with a single instanced
+/// draw call, reading each instance's transform from a per-frame instance buffer.
 /// </summary>
 class ObjectInstance
 {
 public:
 
-	// Custom constructors for initialising the m_transform of this ObjectInstance with either a matrix or a set of vectors
-	ObjectInstance(aie::ShaderProgram* shaderProgram, aie::OBJMesh* mesh, glm::mat4 transform = glm::mat4(1)) : m_shaderProgram(shaderProgram), m_mesh(mesh), m_transform(transform) {}
-	ObjectInstance(aie::ShaderProgram* shaderProgram, aie::OBJMesh* mesh, glm::vec3 position, glm::vec3 eulerRotation = glm::vec3(0, 0, 0), glm::vec3 scale = glm::vec3(1, 1, 1)) : m_shaderProgram(shaderProgram), m_mesh(mesh), m_transform(makeTransform(position, eulerRotation, scale)) {}
+	ObjectInstance() : m_scene(nullptr) {}
+	ObjectInstance(Scene* scene, InstanceHandle handle) : m_scene(scene), m_handle(handle) {}
 	~ObjectInstance() {}
 
-	void draw(Scene* scene);
+	static glm::mat4 makeTransform(glm::vec3 position, glm::vec3 eulerAngles = glm::vec3(0, 0, 0), glm::vec3 scale = glm::vec3(1, 1, 1));
 
-	glm::mat4 makeTransform(glm::vec3 position, glm::vec3 eulerAngles, glm::vec3 scale);
+	bool isValid() const;
 	
 	// Getters
-	glm::vec3 getPosition() { return glm::vec3(m_transform[3][0], m_transform[3][1], m_transform[3][2]); }
+	glm::vec3 getPosition() const { return glm::vec3(getTransform()[3]); }
+	const glm::mat4& getTransform() const;
+	aie::OBJMesh* getMesh() const;
+	aie::ShaderProgram* getShaderProgram() const;
+	bool isVisible() const;
+	bool isOccluder() const;
+	InstanceHandle getHandle() const { return m_handle; }
 	// Setters
-	void setTransform(glm::mat4 transform) { m_transform = transform; }
+	void setTransform(const glm::mat4& transform);
+	void setVisible(bool visible);
+	void setOccluder(bool occluder);
 
 protected:
 
-	glm::mat4 m_transform;
-	aie::OBJMesh* m_mesh; // Pre-loaded mesh reference to draw this ObjectInstance with
-	aie::ShaderProgram* m_shaderProgram; // Shader reference used to draw this ObjectInstance
+	Scene* m_scene; // Scene whose instance store holds this ObjectInstance's data
+	InstanceHandle m_handle; // Handle into the scene's instance store
 };
@@ -0,0 +1,261 @@
+#include "OcclusionBuffer.h"
+#include "JobSystem.h"
+#include <glm/glm.hpp>
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+
+/// <summary>
+/// begin() starts a new frame of occlusion culling, clearing the depth buffer to the far plane and forgetting the
+/// last frame's occluders.
+/// </summary>
+/// <param name="projectionView">The camera's projection view transform this frame.</param>
+void OcclusionBuffer::begin(const glm::mat4& projectionView)
+{
+	m_projectionView = projectionView;
+	m_depth.assign(WIDTH * HEIGHT, 1.0f);
+	m_occluders.clear();
+	m_screenVertices.clear();
+	m_triangles.clear();
+	m_triangleCount = 0;
+}
+
+/// <summary>
+/// addOccluder() queues a triangle mesh to be rasterised into the buffer by the next rasterize(). The positions
+/// and indices aren't copied, so must stay alive until then.
+/// </summary>
+/// <param name="transform">The occluder's model transform.</param>
+/// <param name="positions">The occluder's model space vertex positions.</param>
+/// <param name="indices">Three indices into positions per triangle.</param>
+void OcclusionBuffer::addOccluder(const glm::mat4& transform, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+{
+	m_occluders.push_back({ transform, &positions, &indices, m_screenVertices.size(), m_triangles.size() });
+	m_screenVertices.resize(m_screenVertices.size() + positions.size());
+	m_triangles.resize(m_triangles.size() + indices.size() / 3);
+}
+
+/// <summary>
+/// rasterize() draws every queued occluder into the buffer, first transforming all of their vertices and setting up
+/// all of their triangles in parallel, and then rasterising each band of rows on it's own thread.
+/// </summary>
+void OcclusionBuffer::rasterize()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	aie::JobSystem::parallelFor(m_screenVertices.size(), 1024, [this](size_t first, size_t last) { transformVertices(first, last); });
+	aie::JobSystem::parallelFor(m_triangles.size(), 1024, [this](size_t first, size_t last) { setupTriangles(first, last); });
+
+	m_triangleCount = 0;
+	for (auto& triangle : m_triangles)
+	{
+		if (triangle.minY <= triangle.maxY)
+			m_triangleCount++;
+	}
+	if (m_triangleCount > 0)
+		aie::JobSystem::parallelFor(HEIGHT, 8, [this](size_t first, size_t last) { rasterizeRows((int)first, (int)last); });
+
+	m_rasterMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+/// <summary>
+/// transformVertices() transforms a range of the occluders' vertices into pixel coordinates and NDC depth.
+/// Vertices behind the near plane are marked with a w of 0, as they can't be projected.
+/// </summary>
+/// <param name="first">First screen vertex to transform.</param>
+/// <param name="last">One past the last screen vertex to transform.</param>
+void OcclusionBuffer::transformVertices(size_t first, size_t last)
+{
+	// Find the occluder the first vertex belongs to, then walk forwards through them
+	size_t occluder = 0;
+	while (occluder + 1 < m_occluders.size() && m_occluders[occluder + 1].firstVertex <= first)
+		occluder++;
+	glm::mat4 transform = m_projectionView * m_occluders[occluder].transform;
+
+	for (size_t i = first; i < last; i++)
+	{
+		if (occluder + 1 < m_occluders.size() && m_occluders[occluder + 1].firstVertex <= i)
+		{
+			// Skip any occluders without vertices
+			while (occluder + 1 < m_occluders.size() && m_occluders[occluder + 1].firstVertex <= i)
+				occluder++;
+			transform = m_projectionView * m_occluders[occluder].transform;
+		}
+		const Occluder& owner = m_occluders[occluder];
+
+		glm::vec4 clip = transform * glm::vec4((*owner.positions)[i - owner.firstVertex], 1);
+		if (clip.w <= 1e-5f || clip.z < -clip.w)
+		{
+			m_screenVertices[i] = glm::vec4(0);
+			continue;
+		}
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		m_screenVertices[i] = glm::vec4((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT, ndc.z, 1);
+	}
+}
+
+/// <summary>
+/// setupTriangles() calculates the pixel bounds, edge equations and depth plane of a range of the occluders'
+/// triangles. Triangles with a vertex behind the near plane, no area, or no pixels on screen are rejected by
+/// giving them empty bounds. Both windings are kept (flipping clockwise triangles), as occluders may be open.
+/// </summary>
+/// <param name="first">First triangle to set up.</param>
+/// <param name="last">One past the last triangle to set up.</param>
+void OcclusionBuffer::setupTriangles(size_t first, size_t last)
+{
+	size_t occluder = 0;
+	while (occluder + 1 < m_occluders.size() && m_occluders[occluder + 1].firstTriangle <= first)
+		occluder++;
+
+	for (size_t i = first; i < last; i++)
+	{
+		while (occluder + 1 < m_occluders.size() && m_occluders[occluder + 1].firstTriangle <= i)
+			occluder++;
+		const Occluder& owner = m_occluders[occluder];
+		const unsigned int* indices = owner.indices->data() + (i - owner.firstTriangle) * 3;
+		Triangle& triangle = m_triangles[i];
+		triangle.minY = 1;
+		triangle.maxY = 0;
+
+		glm::vec4 v[3];
+		for (int corner = 0; corner < 3; corner++)
+			v[corner] = m_screenVertices[owner.firstVertex + indices[corner]];
+		if (v[0].w == 0 || v[1].w == 0 || v[2].w == 0)
+			continue;
+
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+		if (std::abs(area) < 1e-6f)
+			continue;
+		if (area < 0)
+		{
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		triangle.minX = std::max(0, (int)std::floor(std::min(v[0].x, std::min(v[1].x, v[2].x))));
+		triangle.maxX = std::min(WIDTH - 1, (int)std::floor(std::max(v[0].x, std::max(v[1].x, v[2].x))));
+		int minY = std::max(0, (int)std::floor(std::min(v[0].y, std::min(v[1].y, v[2].y))));
+		int maxY = std::min(HEIGHT - 1, (int)std::floor(std::max(v[0].y, std::max(v[1].y, v[2].y))));
+		if (triangle.minX > triangle.maxX || minY > maxY)
+			continue;
+
+		// Edge from a to b is positive on the inside of a counter clockwise triangle
+		for (int edge = 0; edge < 3; edge++)
+		{
+			const glm::vec4& a = v[edge];
+			const glm::vec4& b = v[(edge + 1) % 3];
+			triangle.edgeA[edge] = a.y - b.y;
+			triangle.edgeB[edge] = b.x - a.x;
+			triangle.edgeC[edge] = a.x * b.y - b.x * a.y;
+		}
+
+		// Depth is linear in screen space, solved from the edge from the opposite side of each vertex
+		triangle.depthA = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+		triangle.depthB = ((v[2].z - v[0].z) * (v[1].x - v[0].x) - (v[1].z - v[0].z) * (v[2].x - v[0].x)) / area;
+		triangle.depthC = v[0].z - triangle.depthA * v[0].x - triangle.depthB * v[0].y;
+		triangle.minY = minY;
+		triangle.maxY = maxY;
+	}
+}
+
+/// <summary>
+/// rasterizeRows() rasterises every triangle overlapping a band of rows, 4 pixels at a time. For each group of 4
+/// pixel centres, the edge equations and depth plane are evaluated with SSE, and the nearest of the interpolated
+/// and stored depths is written back to the pixels inside all three edges.
+/// </summary>
+/// <param name="firstRow">First row of the band.</param>
+/// <param name="lastRow">One past the last row of the band.</param>
+void OcclusionBuffer::rasterizeRows(int firstRow, int lastRow)
+{
+	const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (auto& triangle : m_triangles)
+	{
+		int minY = std::max(triangle.minY, firstRow);
+		int maxY = std::min(triangle.maxY, lastRow - 1);
+		if (minY > maxY)
+			continue;
+
+		int minX = triangle.minX & ~3;
+		__m128 edgeA[3], edgeB[3], edgeC[3];
+		for (int edge = 0; edge < 3; edge++)
+		{
+			edgeA[edge] = _mm_set1_ps(triangle.edgeA[edge]);
+			edgeB[edge] = _mm_set1_ps(triangle.edgeB[edge]);
+			edgeC[edge] = _mm_set1_ps(triangle.edgeC[edge]);
+		}
+		__m128 depthA = _mm_set1_ps(triangle.depthA);
+		__m128 depthB = _mm_set1_ps(triangle.depthB);
+		__m128 depthC = _mm_set1_ps(triangle.depthC);
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			__m128 pixelY = _mm_set1_ps(y + 0.5f);
+			float* row = m_depth.data() + y * WIDTH;
+			for (int x = minX; x <= triangle.maxX; x += 4)
+			{
+				__m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), pixelOffsets);
+
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (int edge = 0; edge < 3; edge++)
+				{
+					__m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[edge], pixelX), _mm_mul_ps(edgeB[edge], pixelY)), edgeC[edge]);
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(value, zero));
+				}
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				__m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthA, pixelX), _mm_mul_ps(depthB, pixelY)), depthC);
+				__m128 stored = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(stored, depth);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, stored)));
+			}
+		}
+	}
+}
+
+/// <summary>
+/// isOccluded() tests a worldspace box against the buffer. The box's corners are projected to find the pixels it
+/// covers and it's nearest depth, and it is only occluded if every one of those pixels holds a nearer depth. Boxes
+/// crossing the near plane are never occluded. The covered columns are widened out to whole groups of 4 so they
+/// can be compared with SSE, which can only make the test more conservative.
+/// </summary>
+/// <param name="worldMin">Minimum corner of the worldspace box.</param>
+/// <param name="worldMax">Maximum corner of the worldspace box.</param>
+/// <returns>True if the box is hidden behind the rasterised occluders.</returns>
+bool OcclusionBuffer::isOccluded(const glm::vec3& worldMin, const glm::vec3& worldMax) const
+{
+	glm::vec2 screenMin(WIDTH, HEIGHT), screenMax(0);
+	float nearestDepth = 1;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 position((corner & 1) ? worldMax.x : worldMin.x, (corner & 2) ? worldMax.y : worldMin.y, (corner & 4) ? worldMax.z : worldMin.z);
+		glm::vec4 clip = m_projectionView * glm::vec4(position, 1);
+		if (clip.w <= 1e-5f || clip.z < -clip.w)
+			return false;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		glm::vec2 pixel((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT);
+		screenMin = glm::min(screenMin, pixel);
+		screenMax = glm::max(screenMax, pixel);
+		nearestDepth = std::min(nearestDepth, ndc.z);
+	}
+
+	int minX = std::max(0, (int)std::floor(screenMin.x)) & ~3;
+	int maxX = std::min(WIDTH - 1, (int)std::floor(screenMax.x));
+	int minY = std::max(0, (int)std::floor(screenMin.y));
+	int maxY = std::min(HEIGHT - 1, (int)std::floor(screenMax.y));
+	if (minX > maxX || minY > maxY)
+		return false;
+
+	__m128 boxDepth = _mm_set1_ps(nearestDepth);
+	for (int y = minY; y <= maxY; y++)
+	{
+		const float* row = m_depth.data() + y * WIDTH;
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)) != 0)
+				return false;
+		}
+	}
+	return true;
+}
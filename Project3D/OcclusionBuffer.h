@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+/// <summary>
+/// OcclusionBuffer is a low resolution depth buffer that designated occluders are rasterised into on the CPU,
+/// so that instances hidden entirely behind them can be culled before they are ever submitted to the GPU.
+/// Each frame, begin() clears the buffer for the camera's projection view transform, the occluders are added with
+/// addOccluder(), and rasterize() draws their triangles in three parallel stages: transforming every occluder
+/// vertex into screen space, setting up the edge and depth equations of every triangle, and rasterising horizontal
+/// bands of the buffer as separate jobs, so no two threads ever write to the same row. The rasteriser uses
+/// SSE to test and depth write 4 pixels at once, keeping the nearest depth of every pixel. isOccluded() can then
+/// test a worldspace box against the buffer, which is occluded only if every pixel it covers is nearer than it.
+/// </summary>
+class OcclusionBuffer
+{
+public:
+
+	static const int WIDTH = 320; // Must be a multiple of 4, as pixels are rasterised and tested 4 at a time
+	static const int HEIGHT = 180;
+
+	static_assert(WIDTH % 4 == 0, "OcclusionBuffer rows must be a whole number of SSE registers");
+
+	void begin(const glm::mat4& projectionView); // Clears the buffer and occluders for a new frame
+	void addOccluder(const glm::mat4& transform, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices); // Queues a mesh to be rasterised
+	void rasterize(); // Rasterises every queued occluder into the buffer
+	bool isOccluded(const glm::vec3& worldMin, const glm::vec3& worldMax) const; // Whether a worldspace box is entirely hidden by the occluders
+
+	// Getters
+	const float* getDepth() const { return m_depth.data(); }
+	unsigned int getOccluderCount() const { return (unsigned int)m_occluders.size(); }
+	unsigned int getTriangleCount() const { return m_triangleCount; }
+	double getRasterMilliseconds() const { return m_rasterMilliseconds; }
+
+protected:
+
+	/// <summary>
+	/// An Occluder is a mesh queued for rasterisation, along with where it's vertices and triangles start in the
+	/// screen space vertex and triangle setup arrays.
+	/// </summary>
+	struct Occluder
+	{
+		glm::mat4 transform;
+		const std::vector<glm::vec3>* positions;
+		const std::vector<unsigned int>* indices;
+		size_t firstVertex;
+		size_t firstTriangle;
+	};
+
+	/// <summary>
+	/// A Triangle holds the set up of a screen space triangle, it's pixel bounds (empty if it was rejected), the
+	/// three edge equations that are positive inside it, and the plane it's depth is interpolated across.
+	/// </summary>
+	struct Triangle
+	{
+		int minX, maxX, minY, maxY;
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;
+	};
+
+	void transformVertices(size_t first, size_t last);
+	void setupTriangles(size_t first, size_t last);
+	void rasterizeRows(int firstRow, int lastRow);
+
+	glm::mat4 m_projectionView;
+	std::vector<float> m_depth; // Nearest NDC depth of each pixel, row by row from the bottom of the screen
+	std::vector<Occluder> m_occluders;
+	std::vector<glm::vec4> m_screenVertices; // Pixel x and y, NDC depth, and whether the vertex is in front of the camera
+	std::vector<Triangle> m_triangles;
+	unsigned int m_triangleCount = 0; // Triangles that survived set up last frame
+	double m_rasterMilliseconds = 0; // Time taken by the last rasterize()
+};
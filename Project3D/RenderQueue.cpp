@@ -0,0 +1,189 @@
+#include "RenderQueue.h"
+#include <glm/common.hpp>
+#include <cassert>
+#include <utility>
+
+/// <summary>
+/// radixSortEntries() is the least significant digit radix sort shared by the key only and the key and item
+/// sorts. The keys are sorted a byte at a time from the lowest byte up, with each pass being a stable counting
+/// sort from one buffer into the other. The histograms of every byte are built up front in a single read of
+/// the data, which also lets any pass where every key has the same byte (common for the high bytes, as few
+/// programs and meshes are in use) be skipped entirely.
+/// </summary>
+/// <param name="data">The entries to sort, which hold the sorted result on return.</param>
+/// <param name="scratch">A buffer of the same size as data to sort through.</param>
+/// <param name="getKey">Returns the 64-bit key of an entry.</param>
+template <typename Vector, typename GetKey>
+static void radixSortEntries(Vector& data, Vector& scratch, GetKey getKey)
+{
+	typedef typename Vector::value_type T;
+	size_t count = data.size();
+	if (count < 2)
+		return;
+	scratch.resize(count);
+
+	size_t histograms[8][256] = {};
+	for (const T& entry : data)
+	{
+		uint64_t key = getKey(entry);
+		for (int byte = 0; byte < 8; byte++)
+		{
+			histograms[byte][(key >> (byte * 8)) & 0xff]++;
+		}
+	}
+
+	T* source = data.data();
+	T* destination = scratch.data();
+	for (int byte = 0; byte < 8; byte++)
+	{
+		size_t* histogram = histograms[byte];
+
+		// Skip the pass if every key shares this byte
+		uint64_t firstDigit = (getKey(source[0]) >> (byte * 8)) & 0xff;
+		if (histogram[firstDigit] == count)
+			continue;
+
+		// Turn the digit counts into each digit's starting offset
+		size_t offset = 0;
+		for (int digit = 0; digit < 256; digit++)
+		{
+			size_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			destination[histogram[(getKey(source[i]) >> (byte * 8)) & 0xff]++] = source[i];
+		}
+		std::swap(source, destination);
+	}
+
+	// An odd number of passes leaves the result in the scratch buffer
+	if (source != data.data())
+		data.swap(scratch);
+}
+
+/// <summary>
+/// makeKey() packs a draw's state and depth into it's 64-bit sort key, with the pass always in the top two
+/// bits. Opaque draws are ordered by program, then material, then mesh, and only then by front to back depth,
+/// as state switches cost more than the overdraw saved. Transparent draws must blend back to front to look
+/// correct, so the inverted depth comes directly after the pass and the state fields only break ties. The IDs must
+/// fit their fields, as a truncated ID would group draws of different state into the same bucket.
+/// </summary>
+/// <param name="pass">The pass the draw belongs to.</param>
+/// <param name="programID">The scene's ID for the draw's shader program.</param>
+/// <param name="materialID">The scene-wide ID of the draw's material.</param>
+/// <param name="meshID">The scene's ID for the draw's mesh.</param>
+/// <param name="depth">The draw's view depth divided by the far plane, clamped to the 0 to 1 range.</param>
+/// <returns>The sort key for the draw.</returns>
+uint64_t RenderQueue::makeKey(ePass pass, unsigned int programID, unsigned int materialID, unsigned int meshID, float depth)
+{
+	const uint64_t depthMax = (1u << DEPTH_BITS) - 1;
+	uint64_t quantisedDepth = (uint64_t)(glm::clamp(depth, 0.0f, 1.0f) * depthMax);
+	assert(programID < (1u << PROGRAM_BITS) && materialID < (1u << MATERIAL_BITS) && meshID < (1u << MESH_BITS));
+	uint64_t program = programID;
+	uint64_t material = materialID;
+	uint64_t mesh = meshID;
+
+	uint64_t key = (uint64_t)pass << 62;
+	if (pass == TRANSPARENT_PASS)
+	{
+		key |= (depthMax - quantisedDepth) << (PROGRAM_BITS + MATERIAL_BITS + MESH_BITS);
+		key |= program << (MATERIAL_BITS + MESH_BITS);
+		key |= material << MESH_BITS;
+		key |= mesh;
+	}
+	else
+	{
+		key |= program << (MATERIAL_BITS + MESH_BITS + DEPTH_BITS);
+		key |= material << (MESH_BITS + DEPTH_BITS);
+		key |= mesh << DEPTH_BITS;
+		key |= quantisedDepth;
+	}
+	return key;
+}
+
+/// <summary>
+/// radixSort() sorts an array of plain 64-bit keys in ascending order.
+/// </summary>
+/// <param name="keys">The keys to sort.</param>
+/// <param name="scratch">Scratch buffer used by the sort, taken from the frame arena like the keys.</param>
+void RenderQueue::radixSort(aie::FrameVector<uint64_t>& keys, aie::FrameVector<uint64_t>& scratch)
+{
+	radixSortEntries(keys, scratch, [](uint64_t key) { return key; });
+}
+
+/// <summary>
+/// clear() empties the queue ready for the next frame, keeping the memory of it's arrays.
+/// </summary>
+void RenderQueue::clear()
+{
+	m_items.clear();
+	m_sortedEntries.clear();
+}
+
+/// <summary>
+/// submit() adds a draw to the end of the queue along with it's sort key.
+/// </summary>
+/// <param name="key">The draw's sort key, built with makeKey().</param>
+/// <param name="item">The draw to add.</param>
+void RenderQueue::submit(uint64_t key, const DrawItem& item)
+{
+	m_sortedEntries.push_back({ key, (unsigned int)m_items.size() });
+	m_items.push_back(item);
+}
+
+/// <summary>
+/// sort() radix sorts the queue's keys, after which getSorted() returns the draws in key order.
+/// </summary>
+void RenderQueue::sort()
+{
+	radixSortEntries(m_sortedEntries, m_scratch, [](const SortEntry& entry) { return entry.key; });
+}
+
+/// <summary>
+/// countSwitch() adds any state switches needed to go from drawing the previous item to drawing the next one.
+/// Material uniforms belong to the bound program, so a program switch always rebinds the material as well.
+/// </summary>
+/// <param name="counts">The running switch counts.</param>
+/// <param name="previous">The previously drawn item, or nullptr for the first item.</param>
+/// <param name="item">The item being drawn.</param>
+void RenderQueue::countSwitch(SwitchCounts& counts, const DrawItem* previous, const DrawItem& item)
+{
+	bool programSwitch = previous == nullptr || previous->shaderProgram != item.shaderProgram;
+	if (programSwitch)
+		counts.programs++;
+	if (programSwitch || previous->material != item.material)
+		counts.materials++;
+	if (previous == nullptr || previous->vertexArray != item.vertexArray)
+		counts.vertexArrays++;
+}
+
+/// <summary>
+/// countSubmittedSwitches() counts the state switches that issuing the draws in submission order would need.
+/// </summary>
+/// <returns>The program, material and vertex array switch counts.</returns>
+RenderQueue::SwitchCounts RenderQueue::countSubmittedSwitches() const
+{
+	SwitchCounts counts;
+	for (size_t i = 0; i < m_items.size(); i++)
+	{
+		countSwitch(counts, i > 0 ? &m_items[i - 1] : nullptr, m_items[i]);
+	}
+	return counts;
+}
+
+/// <summary>
+/// countSortedSwitches() counts the state switches that issuing the draws in sorted order needs.
+/// </summary>
+/// <returns>The program, material and vertex array switch counts.</returns>
+RenderQueue::SwitchCounts RenderQueue::countSortedSwitches() const
+{
+	SwitchCounts counts;
+	for (size_t i = 0; i < m_sortedEntries.size(); i++)
+	{
+		countSwitch(counts, i > 0 ? &getSorted(i - 1) : nullptr, getSorted(i));
+	}
+	return counts;
+}
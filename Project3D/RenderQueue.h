@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "FrameArena.h"
+
+// Forward declarations of classes defined elsewhere
+namespace aie
+{
+	class OBJMesh;
+	class ShaderProgram;
+}
+
+/// <summary>
+/// RenderQueue collects every draw the Scene wants to make in a frame (one per visible mesh chunk of each
+/// instance batch) along with a 64-bit sort key, and radix sorts the keys so that the draws can be issued
+/// with as few program, material and vertex array switches as possible. Opaque keys are ordered by pass,
+/// program, material, mesh and then view depth (so that draws sharing all of their state are issued front
+/// to back for early-Z rejection), while transparent keys put the inverted view depth straight after the
+/// pass so that transparent geometry is always drawn back to front regardless of it's state.
+/// </summary>
+class RenderQueue
+{
+public:
+
+	// Passes, in the order they are drawn
+	enum ePass : unsigned int
+	{
+		OPAQUE_PASS = 0,
+		TRANSPARENT_PASS,
+	};
+
+	// Key field widths, the scene asserts it never hands out an ID wider than it's field
+	static const unsigned int PROGRAM_BITS = 10;
+	static const unsigned int MATERIAL_BITS = 16;
+	static const unsigned int MESH_BITS = 12;
+	static const unsigned int DEPTH_BITS = 24;
+	static const unsigned int NO_MATERIAL = (1 << MATERIAL_BITS) - 1; // Material ID of chunks without a material
+
+	/// <summary>
+	/// A DrawItem is one instanced draw of a single LOD of a mesh chunk, drawing instanceCount transforms from
+	/// the scene's instance buffer starting at firstInstance. The material is the scene-wide material ID that
+	/// was put in the sort key, and materialIndex the index of the material within the mesh.
+	/// </summary>
+	struct DrawItem
+	{
+		aie::ShaderProgram* shaderProgram;
+		aie::OBJMesh* mesh;
+		unsigned int chunk;
+		unsigned int lod;
+		unsigned int vertexArray;
+		unsigned int material;
+		int materialIndex;
+		unsigned int firstInstance;
+		unsigned int instanceCount;
+		ePass pass;
+	};
+
+	// Number of state changes needed to issue the queue's draws in a given order
+	struct SwitchCounts
+	{
+		int programs = 0;
+		int materials = 0;
+		int vertexArrays = 0;
+	};
+
+	RenderQueue() {}
+	~RenderQueue() {}
+
+	// Builds the sort key of a draw, depth is the view depth of the draw mapped into the 0 to 1 range
+	static uint64_t makeKey(ePass pass, unsigned int programID, unsigned int materialID, unsigned int meshID, float depth);
+
+	// Sorts 64-bit keys in ascending order with an 8-bit LSD radix sort, scratch is resized as needed
+	static void radixSort(aie::FrameVector<uint64_t>& keys, aie::FrameVector<uint64_t>& scratch);
+
+	void clear();
+	void submit(uint64_t key, const DrawItem& item);
+	void sort();
+
+	// Draw access, getSorted() is only valid after sort()
+	size_t size() const { return m_items.size(); }
+	const DrawItem& getItem(size_t index) const { return m_items[index]; }
+	const DrawItem& getSorted(size_t index) const { return m_items[m_sortedEntries[index].item]; }
+	unsigned int getSortedItemIndex(size_t index) const { return m_sortedEntries[index].item; } // Submission index of the sorted draw
+
+	// State switches needed to issue the draws in submission order, and in sorted order
+	SwitchCounts countSubmittedSwitches() const;
+	SwitchCounts countSortedSwitches() const;
+
+protected:
+
+	// A key paired with the index of it's draw, which is what actually gets sorted
+	struct SortEntry
+	{
+		uint64_t key;
+		unsigned int item;
+	};
+
+	static void countSwitch(SwitchCounts& counts, const DrawItem* previous, const DrawItem& item);
+
+	std::vector<DrawItem> m_items; // Draws in submission order
+	std::vector<SortEntry> m_sortedEntries; // Keys and their draw index, sorted by sort()
+	std::vector<SortEntry> m_scratch; // Radix sort ping-pong buffer
+};
@@ -1,5 +1,6 @@
 #include "RenderTarget.h"
 #include "gl_core_4_4.h"
+#include "GLState.h"
 #include <vector>
 
 namespace aie {
@@ -7,17 +8,19 @@ namespace aie {
 RenderTarget::RenderTarget()
 	: m_width(0),
 	m_height(0),
+	m_rbo(0),
 	m_targetCount(0),
-	m_targets(nullptr) {
+	m_targets(nullptr),
+	m_depthTarget(0) {
 }
 
 RenderTarget::RenderTarget(unsigned int targetCount, unsigned int width, unsigned int height)
 	: m_width(0),
 	m_height(0),
+	m_rbo(0),
 	m_targetCount(0),
 	m_targets(nullptr),
-    m_depthTarget(0),
-    m_rbo(0){
+	m_depthTarget(0) {
 	initialise(targetCount, width, height);
 }
 
@@ -25,19 +28,20 @@ bool RenderTarget::initialise(unsigned int targetCount, unsigned int width, unsi
 
 	// setup and bind a framebuffer object
 	glGenFramebuffers(1, &m_fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	GLState::bindFramebuffer(m_fbo);
 
     if (use_depth_texture) {
         glGenTextures(1, &m_depthTarget);
-        glBindTexture(GL_TEXTURE_2D, m_depthTarget);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+        GLState::bindTexture(0, m_depthTarget);
+        // sized to match the depth renderbuffer, so depth can be blitted between the two
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 
         //bind texture to depth map
         glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTarget, 0);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::bindTexture(0, 0);
     }
     else { // setup and bind a 24bit depth buffer as a render buffer
         glGenRenderbuffers(1, &m_rbo);
@@ -66,18 +70,26 @@ bool RenderTarget::initialise(unsigned int targetCount, unsigned int width, unsi
 
 		glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
 	}
+	else {
+		// depth only, so nothing is drawn or read from colour
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
 
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
 
 		// cleanup
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::bindFramebuffer(0);
 		delete[] m_targets;
 		m_targets = nullptr;
-        if(m_depthTarget)
+        if(m_depthTarget) {
+            GLState::forgetTexture(m_depthTarget);
             glDeleteTextures(1, &m_depthTarget);
+        }
         else
 		    glDeleteRenderbuffers(1, &m_rbo);
         
+		GLState::forgetFramebuffer(m_fbo);
 		glDeleteFramebuffers(1, &m_fbo);
 		m_rbo = 0;
 		m_fbo = 0;
@@ -86,7 +98,7 @@ bool RenderTarget::initialise(unsigned int targetCount, unsigned int width, unsi
 	}
 
 	// success
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::bindFramebuffer(0);
 	m_targetCount = targetCount;
 	m_width = width;
 	m_height = height;
@@ -96,24 +108,36 @@ bool RenderTarget::initialise(unsigned int targetCount, unsigned int width, unsi
 
 RenderTarget::~RenderTarget() {
 	delete[] m_targets;
-    if (m_depthTarget)
+    if (m_depthTarget) {
+        GLState::forgetTexture(m_depthTarget);
         glDeleteTextures(1, &m_depthTarget);
+    }
     else
     	glDeleteRenderbuffers(1, &m_rbo);
+	GLState::forgetFramebuffer(m_fbo);
 	glDeleteFramebuffers(1, &m_fbo);
 }
 
 void RenderTarget::bind() {
-	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	GLState::bindFramebuffer(m_fbo);
 }
 
 void RenderTarget::unbind() {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::bindFramebuffer(0);
 }
 
 void RenderTarget::bindDepthTarget(unsigned int index) const {
-    glActiveTexture(GL_TEXTURE0 + index);
-    glBindTexture(GL_TEXTURE_2D, m_depthTarget);
+    GLState::bindTexture(index, m_depthTarget);
+}
+
+void RenderTarget::blitDepth(const RenderTarget& target) const {
+	// bind the target through the shadow first, then only swap the read binding
+	// for the blit so the shadowed binding is still correct afterwards
+	GLState::bindFramebuffer(target.m_fbo);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, target.m_width, target.m_height,
+					  GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target.m_fbo);
 }
 
 } // namespace aie
\ No newline at end of file
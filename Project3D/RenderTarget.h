@@ -20,11 +20,15 @@ public:
 	unsigned int	getHeight() const { return m_height; }
 
 	unsigned int	getFrameBufferHandle() const { return m_fbo; }
+	unsigned int	getDepthTarget() const { return m_depthTarget; }
 
 	unsigned int	getTargetCount() const { return m_targetCount; }
 	const Texture&	getTarget(unsigned int target) const { return m_targets[target]; }
     void            bindDepthTarget(unsigned int index) const;
 
+	// copies this target's depth into the target's (which must be the same size), leaving the target bound
+	void			blitDepth(const RenderTarget& target) const;
+
 protected:
 
 	unsigned int	m_width;
@@ -2,6 +2,14 @@
 #include "ObjectInstance.h"
 #include "Camera.h"
 #include "Light.h"
+#include "OBJMesh.h"
+#include "Shader.h"
+#include "Frustum.h"
+#include "GLState.h"
+#include "gl_core_4_4.h"
+#include <algorithm>
+#include <cassert>
+#include <glm/gtc/matrix_transform.hpp>
 
 /// <summary>
 /// Scene's only constructor simply takes it's inputs and with them 
@@ -19,80 +27,1276 @@ Scene::Scene(Camera* camera, vec2 windowSize, Light* mainLight, vec3 ambientLigh
 	m_windowSize = windowSize;
 	m_sunLight = mainLight;
 	m_ambientLight = ambientLight;
+
+	// Generate the buffers that instance transforms and dequantisations, and multi-draw commands, are streamed into
+	// each frame, they are sized on first use
+	glGenBuffers(1, &m_instanceBuffer);
+	glGenBuffers(1, &m_dequantiseBuffer);
+	glGenBuffers(1, &m_indirectBuffer);
+
+	// Generate the per-frame uniform buffers and attach them to their fixed binding points, where they stay for the
+	// scene's lifetime
+	glGenBuffers(1, &m_frameDataBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_frameDataBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameDataBlock), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, aie::FRAME_DATA_BLOCK, m_frameDataBuffer);
+	glGenBuffers(1, &m_lightsBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_lightsBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LightsBlock), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, aie::LIGHTS_BLOCK, m_lightsBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 /// <summary>
-/// ~Scene() simply calls delete on all of the ObjectInstance's managed by this scene, and then calls delete
-/// on the main camera of the scene.
+/// ~Scene() simply calls delete on the main camera of the scene, and then deletes the instance and uniform buffers,
+/// and the occlusion query of every instance slot. The instance data itself is owned by the m_instances store and so
+/// is cleaned up with it.
 /// </summary>
 Scene::~Scene()
 {
-	for (auto objectInstance : m_objectInstances)
+	delete m_mainCamera;
+
+	// Slots that have never been queried hold a query name of 0, which glDeleteQueries ignores
+	for (auto& drawState : m_drawStates)
+		glDeleteQueries(1, &drawState.query);
+	glDeleteBuffers(1, &m_instanceBuffer);
+	glDeleteBuffers(1, &m_dequantiseBuffer);
+	glDeleteBuffers(1, &m_indirectBuffer);
+	glDeleteBuffers(1, &m_frameDataBuffer);
+	glDeleteBuffers(1, &m_lightsBuffer);
+}
+
+/// <summary>
+/// AddObjectInstance takes an input of the shader program and mesh to draw a new object instance with, as well
+/// as it's initial transform, and adds it to the m_instances store, registering the mesh and shader program in
+/// the scene's tables if they haven't been seen before. The instance is drawn from the next frame captured.
+/// </summary>
+/// <param name="shaderProgram">Shader program to draw the instance with.</param>
+/// <param name="mesh">Pre-loaded mesh to draw the instance with.</param>
+/// <param name="transform">Initial model transform of the instance.</param>
+/// <returns>An ObjectInstance facade referring to the new instance.</returns>
+ObjectInstance Scene::AddObjectInstance(aie::ShaderProgram* shaderProgram, aie::OBJMesh* mesh, const mat4& transform)
+{
+	InstanceHandle handle = m_instances.add(transform, registerMesh(mesh), registerShaderProgram(shaderProgram));
+	return ObjectInstance(this, handle);
+}
+
+/// <summary>
+/// RemoveObjectInstance takes an input of the ObjectInstance to remove from this scene, and removes it's data
+/// from the m_instances store in constant time. Any copies of the ObjectInstance become invalid. It's occlusion
+/// query is kept by it's slot, for the next instance to use the slot.
+/// </summary>
+/// <param name="objInstance">The object instance to remove.</param>
+/// <returns>False if the instance had already been removed or doesn't belong to this scene.</returns>
+bool Scene::RemoveObjectInstance(const ObjectInstance& objInstance)
+{
+	return m_instances.remove(objInstance.getHandle());
+}
+
+/// <summary>
+/// registerMesh() finds the ID of the input mesh in the scene's mesh table, adding it to the end of the table
+/// if it isn't there yet. The table only holds the unique meshes used by the scene so is searched linearly.
+/// Each mesh is given a range of scene-wide material IDs by resolveMeshID() when it is first drawn loaded, as a mesh
+/// that is still loading doesn't know how many materials it has yet. Mesh IDs are packed into the render queue's
+/// sort keys, so the table can't grow past the render queue's mesh field.
+/// </summary>
+/// <param name="mesh">The mesh to find the ID of.</param>
+/// <returns>The mesh's index in m_meshes.</returns>
+unsigned int Scene::registerMesh(aie::OBJMesh* mesh)
+{
+	for (unsigned int i = 0; i < m_meshes.size(); i++)
 	{
-		delete objectInstance;
+		if (m_meshes[i] == mesh)
+			return i;
 	}
+	assert(m_meshes.size() < (1u << RenderQueue::MESH_BITS) && "Too many meshes for the render queue's sort keys");
+	m_meshes.push_back(mesh);
+	return (unsigned int)m_meshes.size() - 1;
+}
 
-	delete m_mainCamera;
+/// <summary>
+/// resolveMeshID() returns the ID of the mesh that instances of a mesh are drawn with this frame. That is the mesh
+/// itself once it has loaded, giving it it's range of scene-wide material IDs the first time, and until then the
+/// placeholder mesh, or NO_MESH if the scene has no placeholder and the instances aren't drawn. The material IDs
+/// are only handed out while drawing, from the frame's copy of the mesh table.
+/// </summary>
+/// <param name="meshID">ID of the instances' own mesh.</param>
+/// <returns>ID of the mesh to draw the instances with, or NO_MESH.</returns>
+unsigned int Scene::resolveMeshID(unsigned int meshID)
+{
+	aie::OBJMesh* mesh = m_frame->meshes[meshID];
+	if (mesh->isLoaded() == false)
+		return m_placeholderMeshID;
+
+	if (m_meshMaterialBases[meshID] == UNASSIGNED_MATERIALS)
+	{
+		m_meshMaterialBases[meshID] = m_materialCount;
+		m_materialCount += (unsigned int)mesh->getMaterialCount();
+		assert(m_materialCount <= RenderQueue::NO_MATERIAL && "Too many materials for the render queue's sort keys");
+	}
+	return meshID;
 }
 
 /// <summary>
-/// AddObjectInstance takes an input of a pointer to the specific ObjectInstance to add to this scene,
-/// and simply adds it to the m_objectInstances list using the std::push_back() function.
+/// setPlaceholderMesh() sets the mesh drawn in place of every mesh that is still loading, with the shader of each
+/// instance it stands in for, so the scene fills in as meshes finish loading rather than popping in from nothing.
 /// </summary>
-/// <param name="objInstance"></param>
-void Scene::AddObjectInstance(ObjectInstance* objInstance)
+/// <param name="mesh">The placeholder, which must already be loaded.</param>
+void Scene::setPlaceholderMesh(aie::OBJMesh* mesh)
 {
-	m_objectInstances.push_back(objInstance);
+	m_placeholderMeshID = registerMesh(mesh);
 }
 
 /// <summary>
-/// RemoveObjectInstance takes an input of a pointer to the specific ObjectInstance to remove from this
-/// scene, and will attempt to remove it from the scene using the std::remove() function.
+/// registerShaderProgram() finds the ID of the input shader program in the scene's shader table, adding it to
+/// the end of the table if it isn't there yet. Like mesh IDs, shader IDs must fit the render queue's program field.
 /// </summary>
-/// <param name="objInstance"></param>
-void Scene::RemoveObjectInstance(ObjectInstance* objInstance)
+/// <param name="shaderProgram">The shader program to find the ID of.</param>
+/// <returns>The shader program's index in m_shaderPrograms.</returns>
+unsigned int Scene::registerShaderProgram(aie::ShaderProgram* shaderProgram)
 {
-	m_objectInstances.remove(objInstance);
+	for (unsigned int i = 0; i < m_shaderPrograms.size(); i++)
+	{
+		if (m_shaderPrograms[i] == shaderProgram)
+			return i;
+	}
+	assert(m_shaderPrograms.size() < (1u << RenderQueue::PROGRAM_BITS) && "Too many shader programs for the render queue's sort keys");
+	m_shaderPrograms.push_back(shaderProgram);
+	return (unsigned int)m_shaderPrograms.size() - 1;
 }
 
 /// <summary>
 /// The Scene::update() function is called each loop of Application3D::update(), and simply calls update on
-/// the main camera of the scene to check for user input in moving or rotating it this frame.
+/// the main camera of the scene to check for user input in moving or rotating it this frame, and stores the
+/// application time to upload in the FrameData block.
 /// </summary>
 void Scene::update(float deltaTime, float time)
 {
+	m_time = time;
+
 	// check for user input to update the main camera with
 	m_mainCamera->update(deltaTime);
 }
 
 /// <summary>
-/// draw() is called each loop of Application3D::draw(), and first simply updates the lightPositions and lightColours
-/// arrays with the current positions and colours of the scene's point lights. Then, the function iterates through
-/// each objectInstance managed by the scene and calls draw on it, passing the scene itself as a parameter into
-/// the ObjectInstance draw() function. The function will then iterate through all of the point lights and draw
-/// gizmos to visualise their positions if the member bool m_drawPointLights is true.
+/// addGizmos() iterates through all of the point lights and adds gizmos to visualise their positions if the member
+/// bool m_drawPointLights is true. It is called by Application3D::update() after the point lights have been edited
+/// through the ImGui UI, so the gizmos are drawn in the frame with the lights.
 /// </summary>
-void Scene::draw()
+void Scene::addGizmos()
 {
-	for (int i = 0; i < MAX_LIGHTS && i < m_pointLights.size(); i++)
+	if (m_drawPointLights)
 	{
-		m_pointLightPositions[i] = m_pointLights[i].direction;
-		// Multiply each point light's colour by it's intensity so it is passed to the shader uniform when drawing objects
-		m_pointLightColours[i] = m_pointLights[i].colour * m_pointLights[i].intensity;
+		for (auto pointLight : m_pointLights)
+		{
+			pointLight.drawGizmo();
+		}
 	}
+}
+
+/// <summary>
+/// captureFrame() is called at the end of each Application3D::update(), and copies the camera's transforms, the
+/// lights, the culling and LOD settings, the mesh and shader tables and the dense arrays of the instance store into
+/// frame, to draw the frame from. The copy means the frame can be drawn on the render thread while the camera, lights,
+/// settings and instances change for the next frame. Only the transforms are copied every frame, the rest is only
+/// copied again once instances have been added, removed or flagged (or meshes or shaders registered) since it was.
+/// </summary>
+/// <param name="frame">The frame state to fill, whose storage is reused.</param>
+void Scene::captureFrame(FrameState& frame)
+{
+	frame.projection = m_mainCamera->getProjectionMatrix(m_windowSize.x, m_windowSize.y);
+	frame.view = m_mainCamera->getViewMatrix();
+	frame.cameraPosition = m_mainCamera->getPosition();
+	frame.nearPlane = m_mainCamera->getNearPlane();
+	frame.farPlane = m_mainCamera->getFarPlane();
+	frame.windowSize = m_windowSize;
+	frame.time = m_time;
+	frame.sunLight = *m_sunLight;
+	frame.ambientLight = m_ambientLight;
+	frame.pointLights = m_pointLights;
+	frame.occlusionCulling = m_occlusionCulling;
+	frame.queryCulling = m_queryCulling;
+	frame.lodPixelError = m_lodPixelError;
+	frame.multiDrawIndirect = m_multiDrawIndirect;
+	frame.gpuCulling = m_gpuCulling;
 
-	// Draw all of the objectInstance's in this scene
-	for (auto objectInstance : m_objectInstances)
+	size_t instanceCount = m_instances.size();
+	frame.instanceTransforms.assign(m_instances.getTransforms(), m_instances.getTransforms() + instanceCount);
+	if (frame.instancesVersion == m_instances.getVersion() && frame.meshes.size() == m_meshes.size() &&
+		frame.shaderPrograms.size() == m_shaderPrograms.size())
+		return;
+
+	frame.instancesVersion = m_instances.getVersion();
+	frame.meshes = m_meshes;
+	frame.shaderPrograms = m_shaderPrograms;
+	frame.instanceHandles.resize(instanceCount);
+	for (unsigned int i = 0; i < instanceCount; i++)
+		frame.instanceHandles[i] = m_instances.getHandle(i);
+	frame.instanceMeshIDs.assign(m_instances.getMeshIDs(), m_instances.getMeshIDs() + instanceCount);
+	frame.instanceShaderIDs.assign(m_instances.getShaderIDs(), m_instances.getShaderIDs() + instanceCount);
+	frame.instanceFlags.assign(m_instances.getFlags(), m_instances.getFlags() + instanceCount);
+}
+
+/// <summary>
+/// beginFrame() sets the frame the draw functions draw from, giving every mesh registered since the last frame an
+/// unassigned material base. Whenever the frame's instances were copied from a different version of the instance store
+/// than the last frame's, the draw state of every instance slot whose generation differs from the instance now in it
+/// is reset, as the slot's instance has been added (or removed and replaced) since the slot was last drawn. The slot's
+/// occlusion query is kept for the new instance.
+/// </summary>
+/// <param name="frame">The frame about to be drawn.</param>
+void Scene::beginFrame(const FrameState& frame)
+{
+	m_frame = &frame;
+	m_meshMaterialBases.resize(frame.meshes.size(), UNASSIGNED_MATERIALS);
+	if (frame.instancesVersion == m_drawStatesVersion)
+		return;
+	m_drawStatesVersion = frame.instancesVersion;
+
+	for (auto& handle : frame.instanceHandles)
 	{
-		objectInstance->draw(this);
+		if (handle.index >= m_drawStates.size())
+			m_drawStates.resize(handle.index + 1, { 0, 0, 0, 0 });
+
+		InstanceDrawState& drawState = m_drawStates[handle.index];
+		if (drawState.generation != handle.generation)
+		{
+			drawState.generation = handle.generation;
+			drawState.lod = 0;
+			drawState.queryFlags = 0;
+		}
 	}
+}
 
-	// Draw the point light gizmos if drawPointLights is true
-	if (m_drawPointLights)
+/// <summary>
+/// draw() is called each loop of Application3D::draw() when forward shading. The frame is first prepared, uploading
+/// the uniform blocks and culling, uploading and sorting the draws of every visible mesh chunk into the render queue,
+/// and then the opaque pass and the transparent pass of the render queue are drawn with each instance's own shader.
+/// Any occlusion queries due this frame are issued between the two passes, once the opaque depth is complete.
+/// </summary>
+void Scene::draw(const FrameState& frame)
+{
+	beginFrame(frame);
+	prepareFrame();
+	drawRenderQueue(RenderQueue::OPAQUE_PASS, FORWARD_DRAW);
+	issueOcclusionQueries();
+	drawRenderQueue(RenderQueue::TRANSPARENT_PASS, FORWARD_DRAW);
+}
+
+/// <summary>
+/// drawGBuffer() is called each loop of Application3D::draw() when deferred shading, with the G-buffer render
+/// target bound. The frame is prepared the same as a forward draw, but only the opaque pass is drawn, with each
+/// shader program swapped for it's G-buffer counterpart. Opaque instances whose shader has no G-buffer program
+/// set are not drawn. Any occlusion queries due this frame are issued against the G-buffer's depth afterwards.
+/// </summary>
+void Scene::drawGBuffer(const FrameState& frame)
+{
+	beginFrame(frame);
+	prepareFrame();
+	drawRenderQueue(RenderQueue::OPAQUE_PASS, GBUFFER_DRAW);
+	issueOcclusionQueries();
+}
+
+/// <summary>
+/// drawTransparent() forward shades the transparent pass of the frame prepared by the last drawGBuffer(). It is
+/// called once the G-buffer has been lit, with the G-buffer's depth copied into the lit render target, so that
+/// transparent surfaces are still hidden behind the opaque surfaces in front of them.
+/// </summary>
+void Scene::drawTransparent()
+{
+	drawRenderQueue(RenderQueue::TRANSPARENT_PASS, FORWARD_DRAW);
+}
+
+/// <summary>
+/// setGBufferShader() sets the program that draws the opaque instances of shaderProgram into the G-buffer during
+/// drawGBuffer(). The G-buffer program must resolve the same material uniforms, and write the albedo, normal,
+/// specular and ambient targets that the deferred lighting shader reads.
+/// </summary>
+/// <param name="shaderProgram">The forward shader program of the scene's instances.</param>
+/// <param name="gBufferProgram">The program to draw them with when filling the G-buffer.</param>
+void Scene::setGBufferShader(aie::ShaderProgram* shaderProgram, aie::ShaderProgram* gBufferProgram)
+{
+	m_gBufferPrograms[shaderProgram] = gBufferProgram;
+}
+
+/// <summary>
+/// enableShadows() creates the render targets of the sun's shadow cascades, and sets the depth only program they
+/// are drawn with, which must take the instanced model transform like the scene's shaders and a LightProjectionView
+/// uniform. The lit shaders only sample the cascades once shadows are enabled.
+/// </summary>
+/// <param name="shadowProgram">The depth only program to draw the shadow casters with.</param>
+/// <returns>True if successful, false if the cascades' render targets couldn't be created.</returns>
+bool Scene::enableShadows(aie::ShaderProgram* shadowProgram)
+{
+	if (m_shadowCascades.initialise() == false)
+		return false;
+
+	m_shadowProgram = shadowProgram;
+	m_lightProjectionViewUniform = shadowProgram->getUniform("LightProjectionView");
+	return true;
+}
+
+/// <summary>
+/// drawShadows() is called each loop of Application3D::draw() before the scene is drawn, while no render target is
+/// bound. The shadow cascades are refitted to the camera's view and the sun's direction, and then for each cascade,
+/// the instances are culled and batched into the render queue against the cascade's frustum, exactly as they are
+/// for the camera. The opaque draws that survive are hashed, and the cascade is only re-rendered (depth only, with
+/// a polygon offset against shadow acne) when it was refitted or the hash differs from it's last render. Every
+/// cascade's depth texture is then bound to it's texture unit for the lit shaders. The cascades draw the LODs last
+/// selected for the camera on the CPU, which are selected here first when the camera's are selected on the GPU.
+/// </summary>
+void Scene::drawShadows(const FrameState& frame)
+{
+	if (m_shadowProgram == nullptr)
+		return;
+
+	beginFrame(frame);
+	m_shadowCascades.fit(frame.projection, frame.view, frame.nearPlane, frame.farPlane, frame.sunLight.direction);
+
+	// The GPU cull selects the camera's LODs where the CPU can't read them, so the cascades select their own
+	if (frame.gpuCulling && m_gpuCuller.isInitialised())
+		selectLods(frame.projection);
+
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+	for (unsigned int i = 0; i < ShadowCascades::CASCADE_COUNT; i++)
 	{
-		for (auto pointLight : m_pointLights)
+		const mat4& lightProjectionView = m_shadowCascades.getLightProjectionView(i);
+		buildRenderQueue(Frustum(lightProjectionView), m_shadowCascades.getLightView(i), m_shadowCascades.getDepthRange(i));
+		if (m_shadowCascades.needsRender(i, hashOpaqueCasters()) == false)
+			continue;
+
+		uploadInstanceTransforms();
+		m_renderQueue.sort();
+
+		aie::RenderTarget& target = m_shadowCascades.getTarget(i);
+		target.bind();
+		glViewport(0, 0, target.getWidth(), target.getHeight());
+		glClear(GL_DEPTH_BUFFER_BIT);
+		m_shadowProgram->bind();
+		m_shadowProgram->bindUniform(m_lightProjectionViewUniform, lightProjectionView);
+		drawRenderQueue(RenderQueue::OPAQUE_PASS, DEPTH_DRAW);
+	}
+	glDisable(GL_POLYGON_OFFSET_FILL);
+
+	aie::GLState::bindFramebuffer(0);
+	glViewport(0, 0, (int)frame.windowSize.x, (int)frame.windowSize.y);
+	for (unsigned int i = 0; i < ShadowCascades::CASCADE_COUNT; i++)
+	{
+		m_shadowCascades.getTarget(i).bindDepthTarget(aie::SHADOW_MAP_TEXTURE + i);
+	}
+}
+
+/// <summary>
+/// enableOcclusionQueries() creates the box that occlusion queries are drawn with, and sets the program it is drawn
+/// with, which must take a BoxTransform uniform transforming the box into clip-space. Instances are only culled by
+/// their queries once query culling is also ticked.
+/// </summary>
+/// <param name="boxProgram">The program to draw the query boxes with.</param>
+void Scene::enableOcclusionQueries(aie::ShaderProgram* boxProgram)
+{
+	m_queryBox.initialiseBox();
+	m_queryProgram = boxProgram;
+	m_boxTransformUniform = boxProgram->getUniform("BoxTransform");
+}
+
+/// <summary>
+/// enableGPUCulling() hands the compute programs to the GPU culler, creating it's buffers. The camera's instances
+/// are only culled on the GPU once GPU culling is also ticked, and never if the GL can't run the programs.
+/// </summary>
+/// <param name="cullProgram">The linked gpu_cull.comp program.</param>
+/// <param name="pyramidProgram">The linked depth_pyramid.comp program.</param>
+/// <returns>Whether the GL can run the programs.</returns>
+bool Scene::enableGPUCulling(aie::ShaderProgram* cullProgram, aie::ShaderProgram* pyramidProgram)
+{
+	return m_gpuCuller.initialise(cullProgram, pyramidProgram);
+}
+
+/// <summary>
+/// buildDepthPyramid() is called each loop of Application3D::draw() once the scene has been drawn into target, and
+/// reduces target's depth into the depth pyramid that the next frame's GPU cull tests instances against, along with
+/// the camera transform the frame was drawn with. The pyramid is invalidated instead while GPU culling is off, so a
+/// stale pyramid is never tested against when it's turned back on.
+/// </summary>
+/// <param name="target">The render target the frame's opaque geometry was drawn into, with a depth texture.</param>
+void Scene::buildDepthPyramid(const aie::RenderTarget& target)
+{
+	if (m_frame->gpuCulling == false || m_gpuCuller.isInitialised() == false)
+	{
+		m_gpuCuller.invalidateDepthPyramid();
+		return;
+	}
+	m_gpuCuller.buildDepthPyramid(target.getDepthTarget(), target.getWidth(), target.getHeight(), m_frameData.projectionView);
+}
+
+/// <summary>
+/// hashOpaqueCasters() hashes the mesh, chunk and instance range of every opaque draw in the render queue, along with
+/// every instance transform, with 64 bit FNV-1a over 32 bit words rather than bytes. The hash changes whenever a
+/// caster inside the frustum the queue was built for is added, removed, hidden or moved.
+/// </summary>
+/// <returns>The hash of the render queue's opaque draws.</returns>
+uint64_t Scene::hashOpaqueCasters() const
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto hashWords = [&hash](const void* data, size_t size)
+	{
+		const uint32_t* words = (const uint32_t*)data;
+		for (size_t i = 0; i < size / sizeof(uint32_t); i++)
+			hash = (hash ^ words[i]) * 1099511628211ull;
+	};
+
+	for (size_t i = 0; i < m_renderQueue.size(); i++)
+	{
+		const RenderQueue::DrawItem& item = m_renderQueue.getItem(i);
+		if (item.pass != RenderQueue::OPAQUE_PASS)
+			continue;
+		hashWords(&item.mesh, sizeof(item.mesh));
+		hashWords(&item.chunk, sizeof(item.chunk));
+		hashWords(&item.lod, sizeof(item.lod));
+		hashWords(&item.firstInstance, sizeof(item.firstInstance));
+		hashWords(&item.instanceCount, sizeof(item.instanceCount));
+	}
+	hashWords(m_instanceTransforms.data(), m_instanceTransforms.size() * sizeof(mat4));
+	return hash;
+}
+
+/// <summary>
+/// prepareFrame() first fills and uploads the FrameData and Lights uniform blocks with this frame's camera transforms
+/// and the current state of the scene's lights. Then, the function extracts the camera frustum, culls the
+/// objectInstance's managed by the scene, groups the survivors into batches that share a mesh and shader and submits
+/// a draw for every visible chunk of each batch to the render queue. All of the visible transforms are then streamed
+/// into the instance buffer, and the render queue is sorted. When occlusion culling is enabled, the occluders are
+/// rasterised first so that the instances hidden behind them can be culled too. When query culling is enabled, the
+/// results of earlier frames' occlusion queries are read first, so the instances they found hidden can be skipped.
+/// Every instance's LOD is selected before culling, and the shadow cascades draw the LODs selected for the camera.
+/// With GPU culling, the CPU only batches the instances and lays out every draw they could need, and only when the
+/// instances or the meshes that have loaded change, so each frame just uploads the transforms and dispatches the
+/// compute cull to select the LODs and fill in the draws, replacing occlusion and query culling with it's depth pyramid
+/// test. The culling statistics are then the GPU's, from a few frames before.
+/// </summary>
+void Scene::prepareFrame()
+{
+	// Read back whichever occlusion query results are ready, or forget them all once query culling is turned off
+	bool gpuCulling = m_frame->gpuCulling && m_gpuCuller.isInitialised();
+	bool queryCulling = m_frame->queryCulling && m_queryProgram != nullptr && gpuCulling == false;
+	if (queryCulling)
+		readOcclusionQueries();
+	else if (m_queriedLastFrame)
+		resetOcclusionQueries();
+	m_queriedLastFrame = queryCulling;
+	m_queryBoxes.clear();
+	m_frameIndex++;
+
+	// The camera transforms are the same for every batch this frame, so are calculated and uploaded once
+	const mat4& projection = m_frame->projection;
+	const mat4& view = m_frame->view;
+	updateUniformBlocks(projection, view);
+	Frustum frustum(m_frameData.projectionView);
+
+	if (gpuCulling)
+	{
+		// The batches only change with the instances, or as meshes finish loading in place of their placeholder
+		unsigned int loadedMeshes = 0;
+		for (auto mesh : m_frame->meshes)
+			loadedMeshes += mesh->isLoaded() ? 1 : 0;
+		bool tablesChanged = m_frame->instancesVersion != m_cullTablesVersion || m_frame->meshes.size() != m_cullTablesMeshes ||
+			loadedMeshes != m_cullTablesLoadedMeshes;
+		if (tablesChanged)
 		{
-			pointLight.drawGizmo();
+			buildGPUCullTables();
+			m_cullTablesVersion = m_frame->instancesVersion;
+			m_cullTablesMeshes = (unsigned int)m_frame->meshes.size();
+			m_cullTablesLoadedMeshes = loadedMeshes;
+		}
+
+		// Lay out the draws of every batch, sorted, unless they're still in the render queue from last frame, and have the
+		// GPU cull the instances into them, selecting their LODs as it goes
+		if (tablesChanged || m_gpuCulledQueue == false)
+			submitGPUCullDraws();
+		if (tablesChanged)
+			m_gpuCuller.uploadTables(m_cullTables);
+		float pixelsPerUnit = projection[1][1] * m_frame->windowSize.y * 0.5f;
+		m_gpuCuller.cull(m_cullTables, m_frame->instanceTransforms.data(), frustum, m_frame->cameraPosition, pixelsPerUnit, m_frame->lodPixelError);
+		m_gpuCulledQueue = true;
+		m_batchCount = (int)m_cullBatches.size();
+
+		const GPUCuller::CullStats& stats = m_gpuCuller.getStats();
+		m_instancesDrawn = (int)stats.instancesDrawn;
+		m_instancesCulled = (int)stats.instancesCulled;
+		m_instancesOccluded = (int)stats.instancesOccluded;
+		m_instancesQueryCulled = 0;
+		m_chunksDrawn = (int)stats.chunksDrawn;
+		m_chunksCulled = (int)stats.chunksCulled;
+		m_trianglesDrawn = stats.trianglesDrawn;
+	}
+	else
+	{
+		// Cull and group the instances into draws (behind the occluders too, if enabled), then send all of the
+		// visible transforms to the GPU in one upload
+		if (m_frame->occlusionCulling)
+			rasterizeOccluders(frustum);
+		selectLods(projection);
+		buildRenderQueue(frustum, view, m_frame->farPlane, m_frame->occlusionCulling ? &m_occlusionBuffer : nullptr, queryCulling);
+		uploadInstanceTransforms();
+		m_renderQueue.sort();
+	}
+
+	// Keep how many state switches the sort saved for the render stats
+	m_submittedSwitches = m_renderQueue.countSubmittedSwitches();
+	m_sortedSwitches = m_renderQueue.countSortedSwitches();
+	m_drawCallCount = 0;
+	m_chunkDrawCount = 0;
+}
+
+/// <summary>
+/// selectLods() picks the LOD of every instance whose mesh has an LOD chain. An LOD's error is scaled into worldspace
+/// by the instance's scale and projected into pixels at the distance from the camera to the nearest point of the
+/// instance's bounding sphere (so instances the camera is inside always get the full mesh). Starting from the LOD the
+/// instance was last drawn at, the LOD is refined while it's projected error is over the frame's LOD pixel error, and
+/// only coarsened while the next LOD's error is under LOD_HYSTERESIS of the threshold, so an instance sitting on a
+/// boundary keeps it's LOD.
+/// </summary>
+/// <param name="projection">The camera's projection transform for this frame.</param>
+void Scene::selectLods(const mat4& projection)
+{
+	const mat4* transforms = m_frame->instanceTransforms.data();
+	const unsigned int* meshIDs = m_frame->instanceMeshIDs.data();
+	const InstanceHandle* handles = m_frame->instanceHandles.data();
+
+	// Pixels covered by one unit of worldspace, facing the camera at a view distance of one
+	float pixelsPerUnit = projection[1][1] * m_frame->windowSize.y * 0.5f;
+	for (size_t i = 0; i < m_frame->instanceHandles.size(); i++)
+	{
+		const aie::OBJMesh* mesh = m_frame->meshes[meshIDs[i]];
+		if (mesh->isLoaded() == false)
+			continue;
+		unsigned int lodCount = mesh->getLodCount();
+		if (lodCount == 1)
+			continue;
+
+		const aie::OBJMesh::Bounds& bounds = mesh->getBounds();
+		const mat4& transform = transforms[i];
+		float scale = glm::max(glm::length(vec3(transform[0])), glm::max(glm::length(vec3(transform[1])), glm::length(vec3(transform[2]))));
+		float distance = glm::length(vec3(transform * vec4(bounds.centre, 1)) - m_frame->cameraPosition) - bounds.radius * scale;
+		unsigned int& lod = m_drawStates[handles[i].index].lod;
+		if (distance <= 0.0f)
+		{
+			lod = 0;
+			continue;
+		}
+
+		float pixelsPerError = scale * pixelsPerUnit / distance;
+		lod = glm::min(lod, lodCount - 1);
+		while (lod > 0 && mesh->getLodError(lod) * pixelsPerError > m_frame->lodPixelError)
+			lod--;
+		while (lod + 1 < lodCount && mesh->getLodError(lod + 1) * pixelsPerError < m_frame->lodPixelError * LOD_HYSTERESIS)
+			lod++;
+	}
+}
+
+/// <summary>
+/// rasterizeOccluders() clears the occlusion buffer for this frame's camera, and rasterises the occluder geometry
+/// of every visible instance flagged as an occluder whose bounding sphere reaches into the frustum.
+/// </summary>
+/// <param name="frustum">The camera frustum, in worldspace.</param>
+void Scene::rasterizeOccluders(const Frustum& frustum)
+{
+	const mat4* transforms = m_frame->instanceTransforms.data();
+	const unsigned int* meshIDs = m_frame->instanceMeshIDs.data();
+	const unsigned int* flags = m_frame->instanceFlags.data();
+
+	m_occlusionBuffer.begin(m_frameData.projectionView);
+	for (size_t i = 0; i < m_frame->instanceFlags.size(); i++)
+	{
+		if ((flags[i] & (INSTANCE_OCCLUDER | INSTANCE_HIDDEN)) != INSTANCE_OCCLUDER)
+			continue;
+
+		const aie::OBJMesh* mesh = m_frame->meshes[meshIDs[i]];
+		if (mesh->isLoaded() == false)
+			continue;
+		const aie::OBJMesh::Bounds& bounds = mesh->getBounds();
+		const mat4& transform = transforms[i];
+		float scale = glm::max(glm::length(vec3(transform[0])), glm::max(glm::length(vec3(transform[1])), glm::length(vec3(transform[2]))));
+		if (frustum.testSphere(vec3(transform * vec4(bounds.centre, 1)), bounds.radius * scale) != Frustum::OUTSIDE)
+			m_occlusionBuffer.addOccluder(transform, mesh->getOccluderPositions(), mesh->getOccluderIndices());
+	}
+	m_occlusionBuffer.rasterize();
+}
+
+/// <summary>
+/// buildRenderQueue() builds a sort key for every visible instance out of it's shader ID, mesh ID and dense index,
+/// and radix sorts them so that every instance sharing a shader and mesh sits next to each other, and then walks each
+/// run of instances sharing a mesh and shader. Each instance's mesh bounding sphere is transformed into worldspace
+/// and tested against the frustum, rejecting the instance outright if it is outside. For every chunk of the mesh, the
+/// transforms of the surviving instances are then written into m_instanceTransforms, testing the chunk's worldspace
+/// AABB first for any instance that wasn't entirely inside the frustum. Each chunk's range of transforms is then
+/// submitted to the render queue as one draw per LOD the instances were selected at, keyed by the nearest instance's
+/// view depth for opaque chunks. Chunks with a transparent material have their instances ordered back to front, and
+/// are drawn as one draw at the finest LOD any of them selected, keyed by the furthest instance's view depth. When
+/// given an occlusion buffer, every instance that passes the frustum test (other than the occluders themselves) also
+/// has it's worldspace AABB tested against the buffer. With query culling, every instance that passes has it's AABB
+/// checked against it's GPU occlusion query instead, and instances outside the frustum have their last query result
+/// forgotten, as it no longer says anything about the view they will reappear in.
+/// </summary>
+/// <param name="frustum">The camera (or shadow cascade) frustum, in worldspace, to cull against.</param>
+/// <param name="view">The view transform the frustum belongs to, for view depths.</param>
+/// <param name="farPlane">The furthest view depth of the frustum, for scaling depths into sort keys.</param>
+/// <param name="occlusionBuffer">Rasterised occluders to cull hidden instances against, or null to skip.</param>
+/// <param name="queryCulling">Whether to cull instances by their occlusion queries, only for the camera.</param>
+void Scene::buildRenderQueue(const Frustum& frustum, const mat4& view, float farPlane, const OcclusionBuffer* occlusionBuffer, bool queryCulling)
+{
+	// Build sort keys from the dense arrays, shader ID in the top 16 bits, then mesh ID (of the placeholder for
+	// meshes still loading), then the dense index. registerMesh() and registerShaderProgram() keep both IDs well
+	// inside 16 bits
+	const mat4* transforms = m_frame->instanceTransforms.data();
+	const unsigned int* meshIDs = m_frame->instanceMeshIDs.data();
+	const unsigned int* shaderIDs = m_frame->instanceShaderIDs.data();
+	const unsigned int* flags = m_frame->instanceFlags.data();
+	const InstanceHandle* handles = m_frame->instanceHandles.data();
+	unsigned int instanceCount = (unsigned int)m_frame->instanceHandles.size();
+
+	// The culling temporaries only last for this call, so they come from the frame arena, reserved up front so that
+	// they never grow and are freed (in reverse order) on return, letting the next call reuse the same memory
+	aie::FrameVector<uint64_t> sortKeys; // Shader ID, mesh ID and dense index of each instance, sorted into runs
+	aie::FrameVector<uint64_t> sortScratch; // Scratch buffer for radix sorting sortKeys
+	aie::FrameVector<VisibleInstance> visibleInstances; // Instances of the batch being built that passed frustum culling
+	aie::FrameVector<ChunkInstance> chunkInstances; // Instances of the chunk being built that passed chunk culling
+	sortKeys.reserve(instanceCount);
+	sortScratch.reserve(instanceCount);
+	visibleInstances.reserve(instanceCount);
+	chunkInstances.reserve(instanceCount);
+
+	for (unsigned int i = 0; i < instanceCount; i++)
+	{
+		if ((flags[i] & INSTANCE_HIDDEN) != 0)
+			continue;
+		unsigned int meshID = resolveMeshID(meshIDs[i]);
+		if (meshID != NO_MESH)
+			sortKeys.push_back(((uint64_t)shaderIDs[i] << 48) | ((uint64_t)meshID << 32) | i);
+	}
+	RenderQueue::radixSort(sortKeys, sortScratch);
+
+	m_renderQueue.clear();
+	m_gpuCulledQueue = false;
+	m_instanceTransforms.clear();
+	m_instanceDequantise.clear();
+	m_batchCount = 0;
+	m_instancesDrawn = m_instancesCulled = m_instancesOccluded = m_instancesQueryCulled = m_chunksDrawn = m_chunksCulled = 0;
+	m_trianglesDrawn = 0;
+
+	// View depth is the distance along the view's forward axis, which is the negated z row of the view transform
+	vec4 depthRow = -vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+	float inverseFarPlane = 1.0f / farPlane;
+
+	size_t runStart = 0;
+	while (runStart < sortKeys.size())
+	{
+		uint64_t runKey = sortKeys[runStart] >> 32;
+		unsigned int meshID = (unsigned int)(runKey & 0xffff);
+		unsigned int shaderID = (unsigned int)(runKey >> 16);
+		aie::OBJMesh* mesh = m_frame->meshes[meshID];
+		aie::ShaderProgram* shaderProgram = m_frame->shaderPrograms[shaderID];
+		size_t chunkCount = mesh->getChunkCount();
+		const aie::OBJMesh::Bounds& meshBounds = mesh->getBounds();
+
+		// Cull the whole mesh of every instance in this run
+		visibleInstances.clear();
+		size_t runEnd = runStart;
+		for (; runEnd < sortKeys.size() && (sortKeys[runEnd] >> 32) == runKey; runEnd++)
+		{
+			unsigned int index = (unsigned int)(sortKeys[runEnd] & 0xffffffff);
+			InstanceDrawState& drawState = m_drawStates[handles[index].index];
+			const mat4& transform = transforms[index];
+			float scale = glm::max(glm::length(vec3(transform[0])), glm::max(glm::length(vec3(transform[1])), glm::length(vec3(transform[2]))));
+			Frustum::eCullResult result = frustum.testSphere(vec3(transform * vec4(meshBounds.centre, 1)), meshBounds.radius * scale);
+			if (result == Frustum::OUTSIDE)
+			{
+				if (queryCulling)
+					drawState.queryFlags &= ~QUERY_OCCLUDED;
+				m_instancesCulled++;
+				m_chunksCulled += (int)chunkCount;
+				continue;
+			}
+
+			if (occlusionBuffer != nullptr || queryCulling)
+			{
+				// Transform the mesh's box into a worldspace AABB that encloses it
+				mat3 absolute = mat3(glm::abs(vec3(transform[0])), glm::abs(vec3(transform[1])), glm::abs(vec3(transform[2])));
+				vec3 centre = vec3(transform * vec4((meshBounds.min + meshBounds.max) * 0.5f, 1));
+				vec3 extents = absolute * ((meshBounds.max - meshBounds.min) * 0.5f);
+				if (occlusionBuffer != nullptr && (flags[index] & INSTANCE_OCCLUDER) == 0 && occlusionBuffer->isOccluded(centre - extents, centre + extents))
+				{
+					m_instancesOccluded++;
+					m_chunksCulled += (int)chunkCount;
+					continue;
+				}
+				if (queryCulling && testQueryOcclusion(index, centre, extents))
+				{
+					m_instancesQueryCulled++;
+					m_chunksCulled += (int)chunkCount;
+					continue;
+				}
+			}
+
+			m_instancesDrawn++;
+			visibleInstances.push_back({ &transform, result == Frustum::INSIDE || chunkCount == 1, glm::min(drawState.lod, mesh->getLodCount() - 1) });
+		}
+		runStart = runEnd;
+
+		if (visibleInstances.empty())
+			continue;
+		m_batchCount++;
+
+		// Gather the visible instances of each chunk into a contiguous range of transforms, and submit it as one draw
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			const aie::OBJMesh::Bounds& chunkBounds = mesh->getChunkBounds(chunk);
+			vec3 localCentre = (chunkBounds.min + chunkBounds.max) * 0.5f;
+			vec3 localExtents = (chunkBounds.max - chunkBounds.min) * 0.5f;
+
+			chunkInstances.clear();
+			for (auto& visibleInstance : visibleInstances)
+			{
+				const mat4& transform = *visibleInstance.transform;
+				vec3 centre = vec3(transform * vec4(localCentre, 1));
+				if (visibleInstance.fullyInside == false)
+				{
+					// Transform the chunk's box into a worldspace AABB that encloses it
+					mat3 absolute = mat3(glm::abs(vec3(transform[0])), glm::abs(vec3(transform[1])), glm::abs(vec3(transform[2])));
+					vec3 extents = absolute * localExtents;
+					if (frustum.testAABB(centre - extents, centre + extents) == Frustum::OUTSIDE)
+					{
+						m_chunksCulled++;
+						continue;
+					}
+				}
+
+				chunkInstances.push_back({ glm::dot(depthRow, vec4(centre, 1)), &transform, visibleInstance.lod });
+			}
+
+			if (chunkInstances.empty())
+				continue;
+			m_chunksDrawn += (int)chunkInstances.size();
+
+			// Transparent chunks blend, so must be drawn back to front, which a draw per LOD would break
+			int materialIndex = mesh->getChunkMaterialIndex(chunk);
+			bool transparent = materialIndex >= 0 && mesh->getMaterial(materialIndex).opacity < 1.0f;
+			if (transparent)
+			{
+				std::sort(chunkInstances.begin(), chunkInstances.end(), [](const ChunkInstance& a, const ChunkInstance& b) { return a.depth > b.depth; });
+				unsigned int finestLod = chunkInstances[0].lod;
+				for (auto& chunkInstance : chunkInstances)
+					finestLod = glm::min(finestLod, chunkInstance.lod);
+				for (auto& chunkInstance : chunkInstances)
+					chunkInstance.lod = finestLod;
+			}
+			else if (mesh->getLodCount() > 1)
+			{
+				std::sort(chunkInstances.begin(), chunkInstances.end(), [](const ChunkInstance& a, const ChunkInstance& b) { return a.lod < b.lod; });
+			}
+
+			// Submit each run of instances sharing a LOD as one draw
+			for (size_t lodStart = 0; lodStart < chunkInstances.size();)
+			{
+				unsigned int lod = chunkInstances[lodStart].lod;
+				float depth = chunkInstances[lodStart].depth;
+				size_t lodEnd = lodStart;
+				for (; lodEnd < chunkInstances.size() && chunkInstances[lodEnd].lod == lod; lodEnd++)
+				{
+					if (transparent == false)
+						depth = glm::min(depth, chunkInstances[lodEnd].depth);
+				}
+
+				RenderQueue::DrawItem item;
+				item.shaderProgram = shaderProgram;
+				item.mesh = mesh;
+				item.chunk = (unsigned int)chunk;
+				item.lod = lod;
+				item.vertexArray = mesh->getChunkVertexArray(chunk);
+				item.material = materialIndex >= 0 ? m_meshMaterialBases[meshID] + materialIndex : RenderQueue::NO_MATERIAL;
+				item.materialIndex = materialIndex;
+				item.firstInstance = (unsigned int)m_instanceTransforms.size();
+				item.instanceCount = (unsigned int)(lodEnd - lodStart);
+				item.pass = transparent ? RenderQueue::TRANSPARENT_PASS : RenderQueue::OPAQUE_PASS;
+				m_renderQueue.submit(RenderQueue::makeKey(item.pass, shaderID, item.material, meshID, depth * inverseFarPlane), item);
+				m_trianglesDrawn += (long long)(mesh->getChunkIndexCount(chunk, lod) / 3) * item.instanceCount;
+
+				// Each instance also gets a copy of the chunk's dequantisation, as a multi-draw reads it per instance
+				const vec4* dequantise = mesh->getChunkDequantise(chunk);
+				for (size_t i = lodStart; i < lodEnd; i++)
+				{
+					m_instanceTransforms.push_back(*chunkInstances[i].transform);
+					m_instanceDequantise.push_back(dequantise[0]);
+					m_instanceDequantise.push_back(dequantise[1]);
+				}
+				lodStart = lodEnd;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// buildGPUCullTables() fills m_cullTables for the GPU cull, in place of buildRenderQueue() culling the instances
+/// itself, whenever the instances or the meshes that have loaded change. Every instance that isn't hidden is given the
+/// batch of it's shader and mesh (the placeholder's while it's mesh loads) and the LOD it was last drawn at for the cull
+/// to select it's LOD from, and each batch's mesh bounds, LOD errors and chunks are then laid out, along with where
+/// it's draws start. A batch has one draw per LOD of each chunk, for up to MAX_LODS LODs of it's mesh.
+/// </summary>
+void Scene::buildGPUCullTables()
+{
+	const unsigned int* meshIDs = m_frame->instanceMeshIDs.data();
+	const unsigned int* shaderIDs = m_frame->instanceShaderIDs.data();
+	const unsigned int* flags = m_frame->instanceFlags.data();
+	const InstanceHandle* handles = m_frame->instanceHandles.data();
+	unsigned int instanceCount = (unsigned int)m_frame->instanceHandles.size();
+	size_t meshCount = m_frame->meshes.size();
+
+	// Find the batch of every visible instance, counting each batch's instances
+	m_cullBatches.clear();
+	m_cullBatchLookup.assign(m_frame->shaderPrograms.size() * meshCount, (unsigned int)GPUCuller::NO_BATCH);
+	m_cullTables.instances.resize(instanceCount);
+	for (unsigned int i = 0; i < instanceCount; i++)
+	{
+		GPUCuller::GPUInstance& instance = m_cullTables.instances[i];
+		instance = { GPUCuller::NO_BATCH, 0 };
+		if ((flags[i] & INSTANCE_HIDDEN) != 0)
+			continue;
+		unsigned int meshID = resolveMeshID(meshIDs[i]);
+		if (meshID == NO_MESH)
+			continue;
+
+		unsigned int& batch = m_cullBatchLookup[shaderIDs[i] * meshCount + meshID];
+		if (batch == GPUCuller::NO_BATCH)
+		{
+			batch = (unsigned int)m_cullBatches.size();
+			m_cullBatches.push_back({ shaderIDs[i], meshID, 0 });
 		}
+		m_cullBatches[batch].instanceCount++;
+		instance.batch = batch;
+		instance.lod = m_drawStates[handles[i].index].lod;
 	}
+
+	m_cullTables.batches.clear();
+	m_cullTables.chunks.clear();
+	unsigned int drawCount = 0;
+	for (auto& cullBatch : m_cullBatches)
+	{
+		aie::OBJMesh* mesh = m_frame->meshes[cullBatch.meshID];
+		const aie::OBJMesh::Bounds& meshBounds = mesh->getBounds();
+		unsigned int chunkCount = (unsigned int)mesh->getChunkCount();
+
+		GPUCuller::GPUBatch batch;
+		batch.sphere = vec4(meshBounds.centre, meshBounds.radius);
+		batch.boxCentre = vec4((meshBounds.min + meshBounds.max) * 0.5f, 0);
+		batch.boxExtents = vec4((meshBounds.max - meshBounds.min) * 0.5f, 0);
+		batch.firstChunk = (unsigned int)m_cullTables.chunks.size();
+		batch.chunkCount = chunkCount;
+		batch.lodCount = glm::min(mesh->getLodCount(), GPUCuller::MAX_LODS);
+		batch.firstDraw = drawCount;
+		for (unsigned int lod = 0; lod < GPUCuller::MAX_LODS; lod++)
+			batch.lodErrors[lod / 4][lod % 4] = lod < batch.lodCount ? mesh->getLodError(lod) : 0.0f;
+		m_cullTables.batches.push_back(batch);
+		drawCount += chunkCount * batch.lodCount;
+
+		for (unsigned int chunk = 0; chunk < chunkCount; chunk++)
+		{
+			const aie::OBJMesh::Bounds& chunkBounds = mesh->getChunkBounds(chunk);
+			const vec4* dequantise = mesh->getChunkDequantise(chunk);
+			m_cullTables.chunks.push_back({ vec4((chunkBounds.min + chunkBounds.max) * 0.5f, 0),
+				vec4((chunkBounds.max - chunkBounds.min) * 0.5f, 0), { dequantise[0], dequantise[1] } });
+		}
+	}
+}
+
+/// <summary>
+/// submitGPUCullDraws() submits the draws of m_cullTables' batches to the render queue, one draw per LOD of every chunk
+/// of each batch, each with room for every instance of the batch, as which instances survive and which LOD each is
+/// drawn at is only known on the GPU. For the same reason, draws are keyed with no depth, and transparent chunks draw
+/// their instances in whichever order the cull appends them. Once the queue is sorted, the draw commands are laid out
+/// in sorted order with no instances, so every run of sorted draws sharing their state is a contiguous run of commands
+/// that can be drawn by one multi-draw. The draws only need submitting again when the tables change, or when the
+/// render queue has been rebuilt for something else (such as a shadow cascade) since, as submitting the same tables
+/// always lays out the same commands.
+/// </summary>
+void Scene::submitGPUCullDraws()
+{
+	m_renderQueue.clear();
+	m_cullTables.drawCommands.clear();
+	m_cullTables.culledCapacity = 0;
+	for (size_t i = 0; i < m_cullBatches.size(); i++)
+	{
+		const CullBatch& cullBatch = m_cullBatches[i];
+		aie::OBJMesh* mesh = m_frame->meshes[cullBatch.meshID];
+		aie::ShaderProgram* shaderProgram = m_frame->shaderPrograms[cullBatch.shaderID];
+		unsigned int chunkCount = m_cullTables.batches[i].chunkCount;
+		unsigned int lodCount = m_cullTables.batches[i].lodCount;
+		for (unsigned int chunk = 0; chunk < chunkCount; chunk++)
+		{
+			int materialIndex = mesh->getChunkMaterialIndex(chunk);
+			bool transparent = materialIndex >= 0 && mesh->getMaterial(materialIndex).opacity < 1.0f;
+			for (unsigned int lod = 0; lod < lodCount; lod++)
+			{
+				RenderQueue::DrawItem item;
+				item.shaderProgram = shaderProgram;
+				item.mesh = mesh;
+				item.chunk = chunk;
+				item.lod = lod;
+				item.vertexArray = mesh->getChunkVertexArray(chunk);
+				item.material = materialIndex >= 0 ? m_meshMaterialBases[cullBatch.meshID] + materialIndex : RenderQueue::NO_MATERIAL;
+				item.materialIndex = materialIndex;
+				item.firstInstance = m_cullTables.culledCapacity;
+				item.instanceCount = cullBatch.instanceCount;
+				item.pass = transparent ? RenderQueue::TRANSPARENT_PASS : RenderQueue::OPAQUE_PASS;
+				m_renderQueue.submit(RenderQueue::makeKey(item.pass, cullBatch.shaderID, item.material, cullBatch.meshID, 0.0f), item);
+				m_cullTables.drawCommands.push_back(0);
+				m_cullTables.culledCapacity += cullBatch.instanceCount;
+			}
+		}
+	}
+
+	// Lay out the commands in sorted order for the cull to count instances into, pointing each draw at it's command
+	m_renderQueue.sort();
+	m_cullTables.commands.resize(m_renderQueue.size());
+	for (size_t i = 0; i < m_renderQueue.size(); i++)
+	{
+		const RenderQueue::DrawItem& item = m_renderQueue.getSorted(i);
+		m_cullTables.commands[i] = item.mesh->getChunkDrawCommand(item.chunk, item.lod, item.firstInstance, 0);
+		m_cullTables.drawCommands[m_renderQueue.getSortedItemIndex(i)] = (unsigned int)i;
+	}
+}
+
+/// <summary>
+/// testQueryOcclusion() checks whether the last occlusion query of the instance found it hidden, and queues a new query
+/// of the instance's AABB when one is due and it's last query isn't still pending. Hidden instances are queried every
+/// frame so they reappear as soon as possible, while visible instances are only re-queried every QUERY_INTERVAL frames,
+/// as they are far more likely to stay visible. While the camera is inside (or nearly inside) the AABB, the box's front
+/// faces would be clipped by the near plane and the query could pass no samples, so the instance is always visible.
+/// </summary>
+/// <param name="index">Dense index of the instance.</param>
+/// <param name="centre">Centre of the instance's worldspace AABB.</param>
+/// <param name="extents">Half size of the instance's worldspace AABB.</param>
+/// <returns>True if the instance should be skipped this frame.</returns>
+bool Scene::testQueryOcclusion(unsigned int index, const vec3& centre, const vec3& extents)
+{
+	unsigned int slot = m_frame->instanceHandles[index].index;
+	unsigned int& flags = m_drawStates[slot].queryFlags;
+
+	// Pad the box by the near plane distance, which is far enough to cover the corners of the near plane at any
+	// sensible field of view
+	vec3 cameraOffset = glm::abs(m_frameData.cameraPosition - centre);
+	if (glm::all(glm::lessThanEqual(cameraOffset, extents + m_frame->nearPlane * 2.0f)))
+	{
+		flags &= ~QUERY_OCCLUDED;
+		return false;
+	}
+
+	bool occluded = (flags & QUERY_OCCLUDED) != 0;
+	if ((flags & QUERY_PENDING) == 0 && (occluded || (index + m_frameIndex) % QUERY_INTERVAL == 0))
+		m_queryBoxes.push_back({ centre, extents, slot });
+	return occluded;
+}
+
+/// <summary>
+/// readOcclusionQueries() checks every pending occlusion query for an available result, without waiting on those that
+/// the GPU hasn't reached yet (they are checked again next frame). An available result marks the instance as hidden
+/// if no samples of it's box passed the depth test, and visible otherwise.
+/// </summary>
+void Scene::readOcclusionQueries()
+{
+	m_queriesPending = 0;
+	for (auto& drawState : m_drawStates)
+	{
+		if ((drawState.queryFlags & QUERY_PENDING) == 0)
+			continue;
+
+		unsigned int available = 0;
+		glGetQueryObjectuiv(drawState.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+		{
+			m_queriesPending++;
+			continue;
+		}
+
+		unsigned int anySamplesPassed = 0;
+		glGetQueryObjectuiv(drawState.query, GL_QUERY_RESULT, &anySamplesPassed);
+		drawState.queryFlags &= ~(QUERY_PENDING | QUERY_OCCLUDED);
+		if (anySamplesPassed == 0)
+			drawState.queryFlags |= QUERY_OCCLUDED;
+	}
+}
+
+/// <summary>
+/// issueOcclusionQueries() is called straight after the opaque pass, and draws the box of every instance queued by
+/// testQueryOcclusion() this frame inside the occlusion query of the instance's slot (generating the query the first
+/// time the slot is queried). The boxes are depth tested against the opaque pass without writing colour or depth, so
+/// they leave the frame untouched, and each query only records whether any sample of it's box passed.
+/// </summary>
+void Scene::issueOcclusionQueries()
+{
+	m_queriesIssued = (int)m_queryBoxes.size();
+	if (m_queryBoxes.empty())
+		return;
+
+	m_queryProgram->bind();
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	for (auto& queryBox : m_queryBoxes)
+	{
+		InstanceDrawState& drawState = m_drawStates[queryBox.slot];
+		unsigned int& query = drawState.query;
+		if (query == 0)
+			glGenQueries(1, &query);
+
+		mat4 boxTransform = glm::scale(glm::translate(m_frameData.projectionView, queryBox.centre), queryBox.extents);
+		m_queryProgram->bindUniform(m_boxTransformUniform, boxTransform);
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+		m_queryBox.draw();
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		drawState.queryFlags |= QUERY_PENDING;
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_TRUE);
+}
+
+/// <summary>
+/// resetOcclusionQueries() clears the query state of every instance, so that when query culling is next enabled every
+/// instance starts visible rather than hidden by a stale result. Any query still pending is simply never read, as it
+/// is reset the next time it is begun.
+/// </summary>
+void Scene::resetOcclusionQueries()
+{
+	for (auto& drawState : m_drawStates)
+		drawState.queryFlags &= ~(QUERY_PENDING | QUERY_OCCLUDED);
+	m_queriesIssued = m_queriesPending = 0;
+}
+
+/// <summary>
+/// drawRenderQueue() issues every draw of one pass of the sorted render queue, binding the shader program and
+/// material of a draw only when they differ from the previous draw's. When drawing into the G-buffer, each draw's
+/// shader program is swapped for it's G-buffer program, and draws without one are skipped. When drawing depth
+/// only, every draw uses the shadow program and no materials are bound. With multi-draw indirect enabled, the
+/// draws are instead gathered into buckets of consecutive draws sharing their program, material and vertex array
+/// (which every mesh chunk in the same geometry arena pool shares), and each bucket is drawn by issueMultiDraws()
+/// with a single call. The GPU cull's draws are always drawn this way, as only the GPU knows their instance counts,
+/// and as their commands were laid out in sorted order, a bucket is simply a run of the GPU's commands. The
+/// transparent pass enables blending and disables depth writes until it has been drawn. Blending is left enabled
+/// afterwards, as the application enables it at startup and everything else relies on it.
+/// </summary>
+/// <param name="pass">Which pass of the render queue to draw.</param>
+/// <param name="mode">Whether to draw with each instance's shader, it's G-buffer program or the shadow program.</param>
+void Scene::drawRenderQueue(RenderQueue::ePass pass, eDrawMode mode)
+{
+	aie::ShaderProgram* boundShader = nullptr;
+	aie::ShaderProgram* itemShader = nullptr;
+	aie::ShaderProgram* drawShader = nullptr;
+	unsigned int boundMaterial = RenderQueue::NO_MATERIAL;
+	bool multiDraw = m_frame->multiDrawIndirect || m_gpuCulledQueue;
+
+	if (pass == RenderQueue::TRANSPARENT_PASS)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDepthMask(GL_FALSE);
+	}
+
+	m_drawCommands.clear();
+	m_drawBuckets.clear();
+	for (size_t i = 0; i < m_renderQueue.size(); i++)
+	{
+		const RenderQueue::DrawItem& item = m_renderQueue.getSorted(i);
+		if (item.pass != pass)
+			continue;
+
+		// Only look up the G-buffer program when the instance's shader changes, as the queue is sorted by shader
+		if (item.shaderProgram != itemShader)
+		{
+			itemShader = item.shaderProgram;
+			drawShader = mode == DEPTH_DRAW ? m_shadowProgram : itemShader;
+			if (mode == GBUFFER_DRAW)
+			{
+				auto gBufferProgram = m_gBufferPrograms.find(itemShader);
+				drawShader = gBufferProgram != m_gBufferPrograms.end() ? gBufferProgram->second : nullptr;
+			}
+		}
+		if (drawShader == nullptr)
+			continue;
+		m_chunkDrawCount++;
+
+		// Add the draw to the current bucket if it shares all of it's state (and follows on from it's commands), so
+		// that the queue's order is kept
+		if (multiDraw)
+		{
+			unsigned int command = m_gpuCulledQueue ? (unsigned int)i : (unsigned int)m_drawCommands.size();
+			DrawBucket* bucket = m_drawBuckets.empty() ? nullptr : &m_drawBuckets.back();
+			if (bucket == nullptr || bucket->shaderProgram != drawShader || bucket->vertexArray != item.vertexArray ||
+				(mode != DEPTH_DRAW && bucket->item->material != item.material) || bucket->firstCommand + bucket->commandCount != command)
+			{
+				m_drawBuckets.push_back({ drawShader, &item, item.vertexArray, item.mesh->getChunkIndexType(item.chunk), command, 0 });
+				bucket = &m_drawBuckets.back();
+			}
+			if (m_gpuCulledQueue == false)
+				m_drawCommands.push_back(item.mesh->getChunkDrawCommand(item.chunk, item.lod, item.firstInstance, item.instanceCount));
+			bucket->commandCount++;
+			continue;
+		}
+
+		// Material uniforms belong to the program, so a new program always needs the material binding again
+		if (drawShader != boundShader)
+		{
+			boundShader = drawShader;
+			boundShader->bind();
+			boundMaterial = RenderQueue::NO_MATERIAL;
+		}
+		if (item.material != boundMaterial && mode != DEPTH_DRAW)
+		{
+			boundMaterial = item.material;
+			item.mesh->bindMaterial(boundShader->getMaterialLayout(), item.materialIndex);
+		}
+
+		item.mesh->drawChunkInstanced(item.chunk, item.lod, m_instanceBuffer, item.firstInstance, item.instanceCount);
+		m_drawCallCount++;
+	}
+
+	if (multiDraw)
+		issueMultiDraws(mode);
+
+	if (pass == RenderQueue::TRANSPARENT_PASS)
+		glDepthMask(GL_TRUE);
+}
+
+/// <summary>
+/// issueMultiDraws() uploads the draw commands gathered by drawRenderQueue() into the indirect buffer (orphaning it,
+/// as it's refilled for every pass), or for the GPU cull's draws, binds the commands and culled instances it wrote,
+/// and draws each bucket of them with one glMultiDrawElementsIndirect call, binding the program and material of a
+/// bucket only when they differ from the previous bucket's. Every draw of a bucket reads it's instances' transforms
+/// and dequantisations from it's own range of the instance buffers, starting at it's base instance, so the buffers
+/// are attached to each vertex array from the start rather than at each draw's first instance.
+/// </summary>
+/// <param name="mode">Whether the buckets are drawn with material bindings, or depth only.</param>
+void Scene::issueMultiDraws(eDrawMode mode)
+{
+	if (m_drawBuckets.empty())
+		return;
+
+	unsigned int instanceBuffer = m_instanceBuffer;
+	unsigned int dequantiseBuffer = m_dequantiseBuffer;
+	if (m_gpuCulledQueue)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_gpuCuller.getCommandBuffer());
+		instanceBuffer = m_gpuCuller.getCulledTransformBuffer();
+		dequantiseBuffer = m_gpuCuller.getCulledDequantiseBuffer();
+	}
+	else
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_drawCommands.size() * sizeof(aie::GeometryArena::DrawCommand), m_drawCommands.data(), GL_STREAM_DRAW);
+	}
+
+	aie::ShaderProgram* boundShader = nullptr;
+	unsigned int boundMaterial = RenderQueue::NO_MATERIAL;
+	unsigned int boundVertexArray = 0;
+	for (auto& bucket : m_drawBuckets)
+	{
+		if (bucket.shaderProgram != boundShader)
+		{
+			boundShader = bucket.shaderProgram;
+			boundShader->bind();
+			boundMaterial = RenderQueue::NO_MATERIAL;
+		}
+		if (bucket.item->material != boundMaterial && mode != DEPTH_DRAW)
+		{
+			boundMaterial = bucket.item->material;
+			bucket.item->mesh->bindMaterial(boundShader->getMaterialLayout(), bucket.item->materialIndex);
+		}
+		if (bucket.vertexArray != boundVertexArray)
+		{
+			boundVertexArray = bucket.vertexArray;
+			aie::GLState::bindVertexArray(boundVertexArray);
+			glBindVertexBuffer(aie::OBJMesh::INSTANCE_BINDING, instanceBuffer, 0, sizeof(mat4));
+			glBindVertexBuffer(aie::OBJMesh::DEQUANTISE_BINDING, dequantiseBuffer, 0, sizeof(vec4) * 2);
+		}
+
+		const void* firstCommand = (const void*)(bucket.firstCommand * sizeof(aie::GeometryArena::DrawCommand));
+		glMultiDrawElementsIndirect(GL_TRIANGLES, bucket.indexType, firstCommand, bucket.commandCount, 0);
+		m_drawCallCount++;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/// <summary>
+/// uploadInstanceTransforms() streams this frame's instance transforms, and their chunks' dequantisations, into the
+/// instance buffers. The buffers are orphaned each frame so the driver doesn't need to wait on last frame's draws,
+/// and are only grown (to double the required size) when the number of instances exceeds their capacity.
+/// </summary>
+void Scene::uploadInstanceTransforms()
+{
+	if (m_instanceTransforms.empty())
+		return;
+
+	unsigned int instanceCount = (unsigned int)m_instanceTransforms.size();
+	if (instanceCount > m_instanceBufferCapacity)
+	{
+		m_instanceBufferCapacity = instanceCount * 2;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_instanceBufferCapacity * sizeof(mat4), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(mat4), m_instanceTransforms.data());
+	glBindBuffer(GL_ARRAY_BUFFER, m_dequantiseBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_instanceBufferCapacity * sizeof(vec4) * 2, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(vec4) * 2, m_instanceDequantise.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/// <summary>
+/// updateUniformBlocks() fills the FrameData block with this frame's camera transforms, position, time and screen
+/// size, and the Lights block with the ambient colour, main sunlight and the light cluster grid's dimensions and
+/// depth slicing (along with the shadow cascades' split depths and transforms, when shadows are enabled), and
+/// uploads both into their uniform buffers. The point lights are then assigned to the clusters they reach and
+/// uploaded into the cluster grid's storage buffers. As all of the buffers stay attached to their binding points,
+/// every shader program drawn this frame reads from them.
+/// </summary>
+/// <param name="projection">The camera's projection transform for this frame.</param>
+/// <param name="view">The camera's view transform for this frame.</param>
+void Scene::updateUniformBlocks(const mat4& projection, const mat4& view)
+{
+	m_frameData.projection = projection;
+	m_frameData.view = view;
+	m_frameData.projectionView = projection * view;
+	m_frameData.inverseProjectionView = glm::inverse(m_frameData.projectionView);
+	m_frameData.cameraPosition = m_frame->cameraPosition;
+	m_frameData.time = m_frame->time;
+	m_frameData.screenSize = m_frame->windowSize;
+
+	m_lightsData.ambientColour = m_frame->ambientLight;
+	m_lightsData.lightColour = m_frame->sunLight.colour;
+	m_lightsData.lightDirection = m_frame->sunLight.direction;
+
+	// Bin the point lights first, as only the lights reaching the view frustum are uploaded
+	float nearPlane = m_frame->nearPlane;
+	float farPlane = m_frame->farPlane;
+	m_lightClusters.assignLights(m_frame->pointLights, projection, view, nearPlane, farPlane);
+	m_lightClusters.upload();
+	vec2 sliceScaleBias = m_lightClusters.getSliceScaleBias();
+	m_lightsData.numLights = (int)m_lightClusters.getLightCount();
+	m_lightsData.clusterGrid = glm::uvec4(LightClusterGrid::CLUSTER_COUNT_X, LightClusterGrid::CLUSTER_COUNT_Y, LightClusterGrid::CLUSTER_COUNT_Z, 0);
+	m_lightsData.clusterDepth = vec4(nearPlane, farPlane, sliceScaleBias.x, sliceScaleBias.y);
+
+	// Unused cascades end at a depth of 0, so the lit shaders never pick them (or any, while shadows are disabled)
+	m_lightsData.cascadeSplits = vec4(0);
+	if (m_shadowProgram != nullptr)
+	{
+		for (unsigned int i = 0; i < ShadowCascades::CASCADE_COUNT; i++)
+		{
+			m_lightsData.cascadeSplits[i] = m_shadowCascades.getSplitDepth(i);
+			m_lightsData.shadowMatrices[i] = m_shadowCascades.getShadowMatrix(i);
+		}
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_frameDataBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameDataBlock), &m_frameData);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_lightsBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightsBlock), &m_lightsData);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
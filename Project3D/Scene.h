@@ -1,65 +1,362 @@
 #pragma once
-#include<list>
 #include <vector>
+#include <cstdint>
+#include <unordered_map>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
-
-#define MAX_LIGHTS 4 // Max number of lights that can affect one object in the scene
+#include <glm/mat4x4.hpp>
+#include "InstanceStore.h"
+#include "ObjectInstance.h"
+#include "UniformBlocks.h"
+#include "RenderQueue.h"
+#include "LightClusterGrid.h"
+#include "ShadowCascades.h"
+#include "OcclusionBuffer.h"
+#include "Mesh.h"
+#include "Light.h"
+#include "GeometryArena.h"
+#include "GPUCuller.h"
 
 using namespace glm;
 
 // Forward declarations of classes defined elsewhere
 class Camera;
-class ObjectInstance;
-struct Light;
+class Frustum;
+namespace aie
+{
+	class OBJMesh;
+	class ShaderProgram;
+}
 
 /// <summary>
 /// The Scene class holds reference to all of the common world variables required for an
 /// ObjectInstance to be drawn to the screen, that is, primarily, a reference to the main
 /// camera for transforming ObjectInstance's into screenspace for drawing, as well as references
 /// to all of the lights present in the scene that should affect the colouring and lighting
-/// of scene objects. The Scene class also holds a list of reference to all the ObjectInstance's
-/// currently in the scene, and each frame cycle will iterate through them and trigger their
-/// draw() functions, passing itself as a reference to each ObjectInstance for uniform binding.
+/// of scene objects. The Scene class also owns the data of every object instance in the scene,
+/// stored in an InstanceStore and referenced externally through ObjectInstance handles, along with
+/// the tables of meshes and shader programs the instances draw with. Each frame is drawn from a
+/// FrameState captured at the end of the update, so it can be drawn on a render thread. Drawing
+/// culls the instances (on the CPU, or with a compute shader when GPU culling is enabled), picks
+/// the LOD of each one and submits a draw per visible chunk of each batch to a sorted RenderQueue,
+/// which is drawn forward or deferred shaded. Shadow cascades, clustered point lights and
+/// occlusion culling are handled by the helper classes the scene owns.
 /// </summary>
 class Scene
 {
 public:
 
+	/// <summary>
+	/// A FrameState is a copy of everything the draw functions read that can change during an update: the camera's
+	/// transforms, the lights, the settings altered by the ImGui UI, the mesh and shader tables, and the handle,
+	/// transform, mesh ID, shader ID and flags of every instance (indexed by dense index). Drawing never reads the
+	/// instance store, so instances can be added, removed and changed while a render thread draws the last frame. All
+	/// but the transforms are only copied when the store's version differs from the version they were copied at.
+	/// </summary>
+	struct FrameState
+	{
+		mat4 projection;
+		mat4 view;
+		vec3 cameraPosition;
+		float nearPlane;
+		float farPlane;
+		vec2 windowSize;
+		float time;
+		Light sunLight;
+		vec3 ambientLight;
+		std::vector<Light> pointLights;
+		bool occlusionCulling;
+		bool queryCulling;
+		float lodPixelError;
+		bool multiDrawIndirect;
+		bool gpuCulling;
+		unsigned int instancesVersion = ~0u; // Version of the instance store the tables and instances were copied at
+		std::vector<aie::OBJMesh*> meshes;
+		std::vector<aie::ShaderProgram*> shaderPrograms;
+		std::vector<InstanceHandle> instanceHandles;
+		std::vector<mat4> instanceTransforms;
+		std::vector<unsigned int> instanceMeshIDs;
+		std::vector<unsigned int> instanceShaderIDs;
+		std::vector<unsigned int> instanceFlags;
+	};
+
 	Scene(Camera* camera, vec2 windowSize, Light* mainLight, vec3 ambientLight);
 	~Scene();
 
 	// Utility functions
-	void AddObjectInstance(ObjectInstance* objInstance);
-	void RemoveObjectInstance(ObjectInstance* objInstance);
+	ObjectInstance AddObjectInstance(aie::ShaderProgram* shaderProgram, aie::OBJMesh* mesh, const mat4& transform = mat4(1));
+	bool RemoveObjectInstance(const ObjectInstance& objInstance);
 
 	void update(float deltaTime, float time); // Call update on the camera to check for user input
-	void draw(); // Call draw on all objects in the scene
+	void addGizmos(); // Add the point light gizmos if ticked to draw, once the lights have been edited for the frame
+	void captureFrame(FrameState& frame); // Copy the state the frame is drawn from, at the end of the update
+	void draw(const FrameState& frame); // Call draw on all objects in the scene, forward shading them
+	void drawGBuffer(const FrameState& frame); // Prepare the frame and draw the opaque objects into the bound G-buffer with their G-buffer programs
+	void drawTransparent(); // Forward shade the transparent objects of the frame prepared by drawGBuffer()
+	// Set the program that replaces shaderProgram in the G-buffer pass
+	void setGBufferShader(aie::ShaderProgram* shaderProgram, aie::ShaderProgram* gBufferProgram);
+	bool enableShadows(aie::ShaderProgram* shadowProgram); // Create the sun's shadow cascades, drawn with the depth only shadowProgram
+	// Refit the sun's shadow cascades and re-render the ones that are out of date, called before draw() or drawGBuffer()
+	void drawShadows(const FrameState& frame);
+	void enableOcclusionQueries(aie::ShaderProgram* boxProgram); // Allow GPU occlusion queries, drawing the query boxes with boxProgram
+	void setPlaceholderMesh(aie::OBJMesh* mesh); // Set the loaded mesh drawn in place of meshes that haven't finished loading
+	// Allow culling the camera's instances with the compute programs, returns false if the GL can't run them
+	bool enableGPUCulling(aie::ShaderProgram* cullProgram, aie::ShaderProgram* pyramidProgram);
+	// Reduce the depth of the frame just drawn into target into the depth pyramid the next GPU cull tests against
+	void buildDepthPyramid(const aie::RenderTarget& target);
 
 	// Getters
 	vec2 getWindowSize() { return m_windowSize; }
+	InstanceStore& getInstanceStore() { return m_instances; }
+	int getObjectInstanceCount() { return (int)m_instances.size(); }
+	aie::OBJMesh* getMesh(unsigned int meshID) { return m_meshes[meshID]; }
+	aie::ShaderProgram* getShaderProgram(unsigned int shaderID) { return m_shaderPrograms[shaderID]; }
 	Camera* getCamera() { return m_mainCamera; }
 	Light* getSunlight() { return m_sunLight; }
 	std::vector<Light>& getPointLights() { return m_pointLights; }
 	vec3 getAmbientLight() { return m_ambientLight; }
-	int getNumLights() { return m_pointLights.size(); }
-	vec3* getPointLightPositions() { return &m_pointLightPositions[0]; }
-	vec3* getPointLightColours() { return &m_pointLightColours[0]; }
+	int getNumLights() { return (int)m_pointLights.size(); }
+	const LightClusterGrid& getLightClusters() const { return m_lightClusters; }
+	const ShadowCascades& getShadowCascades() const { return m_shadowCascades; }
 	bool* getDrawPointLights() { return &m_drawPointLights; }
+	bool* getOcclusionCulling() { return &m_occlusionCulling; }
+	const OcclusionBuffer& getOcclusionBuffer() const { return m_occlusionBuffer; }
+	bool* getQueryCulling() { return &m_queryCulling; }
+	float* getLodPixelError() { return &m_lodPixelError; }
+	bool* getMultiDrawIndirect() { return &m_multiDrawIndirect; }
+	bool* getGPUCulling() { return &m_gpuCulling; }
+	bool canGPUCull() const { return m_gpuCuller.isInitialised(); }
+	int getBatchCount() { return m_batchCount; }
+	const RenderQueue::SwitchCounts& getSubmittedSwitches() { return m_submittedSwitches; }
+	const RenderQueue::SwitchCounts& getSortedSwitches() { return m_sortedSwitches; }
+	int getDrawCallCount() { return m_drawCallCount; }
+	int getChunkDrawCount() { return m_chunkDrawCount; }
+	int getInstancesDrawn() { return m_instancesDrawn; }
+	int getInstancesCulled() { return m_instancesCulled; }
+	int getInstancesOccluded() { return m_instancesOccluded; }
+	int getInstancesQueryCulled() { return m_instancesQueryCulled; }
+	int getQueriesIssued() { return m_queriesIssued; }
+	int getQueriesPending() { return m_queriesPending; }
+	int getChunksDrawn() { return m_chunksDrawn; }
+	long long getTrianglesDrawn() { return m_trianglesDrawn; }
+	int getChunksCulled() { return m_chunksCulled; }
 	// Setters
 	void setWindowSize(vec2 windowSize) { m_windowSize = windowSize; }
 
 protected:
 
+	// Visible instances are only re-queried once every QUERY_INTERVAL frames (staggered across the instances) to find when they become hidden
+	static const unsigned int QUERY_INTERVAL = 4;
+
+	// Query state of an instance, kept in it's InstanceDrawState
+	enum eQueryFlags : unsigned int
+	{
+		QUERY_OCCLUDED = 1 << 0, // Instance's last GPU occlusion query found it hidden
+		QUERY_PENDING = 1 << 1, // Instance's GPU occlusion query has been issued but it's result not yet read
+	};
+
+	// Mesh ID of no mesh, and the material base of a mesh that hasn't loaded it's materials yet
+	static const unsigned int NO_MESH = 0xffffffff;
+	static constexpr unsigned int UNASSIGNED_MATERIALS = 0xffffffff;
+
+	// An instance only switches to a coarser LOD once it's projected error falls below this fraction of the
+	// pixel threshold, so it doesn't flicker between LODs at the boundary
+	static constexpr float LOD_HYSTERESIS = 0.75f;
+
+	/// <summary>
+	/// eDrawMode is which programs drawRenderQueue() draws with, each instance's own shader, it's G-buffer
+	/// counterpart, or the depth only shadow program.
+	/// </summary>
+	enum eDrawMode
+	{
+		FORWARD_DRAW,
+		GBUFFER_DRAW,
+		DEPTH_DRAW,
+	};
+
+	/// <summary>
+	/// A VisibleInstance is an instance that passed the whole mesh frustum test, whether it was entirely
+	/// inside the frustum (in which case none of it's chunks need testing), and the LOD to draw it at.
+	/// </summary>
+	struct VisibleInstance
+	{
+		const mat4* transform;
+		bool fullyInside;
+		unsigned int lod;
+	};
+
+	/// <summary>
+	/// An InstanceDrawState is what the draw functions keep of an instance from one frame to the next, the LOD it was
+	/// last drawn at and it's GPU occlusion query, indexed by the slot of the instance's handle. The state belongs to
+	/// the instance whose handle has the same generation, and is reset when the slot is reused by a newer instance.
+	/// </summary>
+	struct InstanceDrawState
+	{
+		unsigned int generation; // Generation of the handle the state belongs to, 0 for a slot no instance has used yet
+		unsigned int lod; // LOD of the instance's mesh to draw, 0 being the full mesh
+		unsigned int queryFlags; // eQueryFlags of the instance's occlusion query
+		unsigned int query; // GL occlusion query name, 0 until the slot is first queried, and kept when the slot is reused
+	};
+
+	/// <summary>
+	/// A QueryBox is the worldspace AABB of an instance to issue a GPU occlusion query for after the opaque pass,
+	/// and the slot of the instance's handle.
+	/// </summary>
+	struct QueryBox
+	{
+		vec3 centre;
+		vec3 extents;
+		unsigned int slot;
+	};
+
+	/// <summary>
+	/// A ChunkInstance is an instance whose chunk survived culling, along with the view depth of the chunk,
+	/// used to order a transparent chunk's instances back to front, and the LOD to draw it at.
+	/// </summary>
+	struct ChunkInstance
+	{
+		float depth;
+		const mat4* transform;
+		unsigned int lod;
+	};
+
+	/// <summary>
+	/// A CullBatch is a shader and mesh pair with instances to draw this frame, and how many, gathered by
+	/// buildGPUCullTables() for the GPU cull.
+	/// </summary>
+	struct CullBatch
+	{
+		unsigned int shaderID;
+		unsigned int meshID;
+		unsigned int instanceCount;
+	};
+
+	/// <summary>
+	/// A DrawBucket is a run of consecutive draws of the sorted render queue that share their program, material
+	/// and vertex array, drawn by one multi-draw over commandCount of m_drawCommands (or of the GPU cull's commands)
+	/// starting at firstCommand. The material is bound from the bucket's first draw item.
+	/// </summary>
+	struct DrawBucket
+	{
+		aie::ShaderProgram* shaderProgram;
+		const RenderQueue::DrawItem* item;
+		unsigned int vertexArray;
+		unsigned int indexType;
+		unsigned int firstCommand;
+		unsigned int commandCount;
+	};
+
+	unsigned int registerMesh(aie::OBJMesh* mesh); // Returns the ID of the mesh, adding it to the mesh table if needed
+	// Returns the ID of the mesh to draw in place of the mesh, the placeholder's (or NO_MESH) until it's loaded
+	unsigned int resolveMeshID(unsigned int meshID);
+	unsigned int registerShaderProgram(aie::ShaderProgram* shaderProgram); // Returns the ID of the shader, adding it to the shader table if needed
+
+	void beginFrame(const FrameState& frame); // Sets m_frame, resetting the draw state of instances added since the instances last changed
+
+	void selectLods(const mat4& projection); // Picks the LOD of every instance from it's projected screen-space error
+	void rasterizeOccluders(const Frustum& frustum); // Rasterises the occluder instances inside the frustum into m_occlusionBuffer
+	// Culls and groups the object instances by mesh and shader, filling m_instanceTransforms and m_renderQueue
+	void buildRenderQueue(const Frustum& frustum, const mat4& view, float farPlane,
+		const OcclusionBuffer* occlusionBuffer = nullptr, bool queryCulling = false);
+	void buildGPUCullTables(); // Batches the visible instances, filling m_cullTables for the GPU cull
+	void submitGPUCullDraws(); // Submits every LOD of every chunk of m_cullBatches to m_renderQueue, laying out the cull's commands
+	// Returns whether the instance's last query found it hidden, queueing a new query when one is due
+	bool testQueryOcclusion(unsigned int index, const vec3& centre, const vec3& extents);
+	void readOcclusionQueries(); // Reads the results of the queries that have become available, without waiting on the rest
+	void issueOcclusionQueries(); // Draws the box of every instance in m_queryBoxes inside it's query, against the opaque pass' depth
+	void resetOcclusionQueries(); // Forgets every query result, so no instance starts hidden when queries are next enabled
+	uint64_t hashOpaqueCasters() const; // Hashes the opaque draws and transforms in m_renderQueue, to detect when a shadow cascade's casters change
+	void prepareFrame(); // Uploads the uniform blocks, then culls, uploads and sorts this frame's draws into m_renderQueue
+	// Issues the sorted draws of one pass of m_renderQueue, only switching state when it changes
+	void drawRenderQueue(RenderQueue::ePass pass, eDrawMode mode);
+	void issueMultiDraws(eDrawMode mode); // Uploads m_drawCommands (or binds the GPU cull's) and draws each of m_drawBuckets with one multi-draw
+	void uploadInstanceTransforms(); // Streams m_instanceTransforms and m_instanceDequantise into the instance buffers
+	void updateUniformBlocks(const mat4& projection, const mat4& view); // Fills and uploads the FrameData and Lights uniform buffers
+
 	vec2 m_windowSize;
 	Camera* m_mainCamera; // Virtual camera for transforming mesh data to screenspace
-	std::list<ObjectInstance*> m_objectInstances; // List of ObjectInstance references to maintain and draw in this scene object
+	const FrameState* m_frame = nullptr; // Captured state of the frame being drawn, set by drawShadows(), draw() and drawGBuffer()
+	unsigned int m_drawStatesVersion = ~0u; // Instance store version m_drawStates were last brought up to date with
+
+	// Variables for the scene's object instances
+	InstanceStore m_instances; // Dense per-instance data for every object instance in the scene
+	std::vector<InstanceDrawState> m_drawStates; // State kept between frames by the draw functions, indexed by instance slot
+	std::vector<aie::OBJMesh*> m_meshes; // Mesh table, indexed by the mesh IDs in m_instances
+	std::vector<unsigned int> m_meshMaterialBases; // Scene-wide material ID of each mesh's first material, indexed by mesh ID, set while drawing
+	unsigned int m_materialCount = 0; // Number of scene-wide material IDs handed out to registered meshes
+	unsigned int m_placeholderMeshID = NO_MESH; // Mesh drawn in place of meshes that haven't finished loading
+	std::vector<aie::ShaderProgram*> m_shaderPrograms; // Shader table, indexed by the shader IDs in m_instances
+	std::unordered_map<aie::ShaderProgram*, aie::ShaderProgram*> m_gBufferPrograms; // G-buffer program of each shader program that can be deferred
 
 	// Variables for the scene lights
 	Light* m_sunLight;
 	vec3 m_ambientLight;
 	std::vector<Light> m_pointLights;
-	vec3 m_pointLightPositions[MAX_LIGHTS]; // Array of point light positions, filled using m_pointLights every update for shader uniform
-	vec3 m_pointLightColours[MAX_LIGHTS]; // Array of point light colours, filled using m_pointLights every update for shader uniform
 	bool m_drawPointLights = true; // Whether or not to draw point light gizmos, variable is altered by ImGui UI
+	LightClusterGrid m_lightClusters; // Point lights binned into view space clusters, rebuilt every draw()
+	ShadowCascades m_shadowCascades; // Cascaded shadow maps of the sun light, only re-rendered when out of date
+	aie::ShaderProgram* m_shadowProgram = nullptr; // Depth only program for the shadow cascades, shadows are disabled while null
+	int m_lightProjectionViewUniform = -1; // Location of the shadow program's LightProjectionView uniform
+
+	// Variables for occlusion culling
+	OcclusionBuffer m_occlusionBuffer; // CPU depth buffer the occluders are rasterised into each draw()
+	bool m_occlusionCulling = false; // Whether instances hidden behind occluders are culled, variable is altered by ImGui UI
+	bool m_queryCulling = false; // Whether instances hidden by their GPU occlusion queries are culled, variable is altered by ImGui UI
+	bool m_queriedLastFrame = false; // Whether query culling was active last frame, to reset the query results when it is disabled
+	aie::ShaderProgram* m_queryProgram = nullptr; // Program the query boxes are drawn with, queries are disabled while null
+	int m_boxTransformUniform = -1; // Location of the query program's BoxTransform uniform
+	Mesh m_queryBox; // Box spanning -1 to 1, scaled and moved onto each instance's AABB to query it
+	std::vector<QueryBox> m_queryBoxes; // Boxes to query after this frame's opaque pass
+	unsigned int m_frameIndex = 0; // Frames drawn, staggering which visible instances are re-queried each frame
+
+	// Variables for LOD selection
+	float m_lodPixelError = 1.0f; // Largest projected simplification error, in pixels, an instance's LOD may have, variable is altered by ImGui UI
+
+	// Variables for the per-frame uniform blocks shared by every shader program
+	FrameDataBlock m_frameData; // Camera and timing data, filled once per draw()
+	LightsBlock m_lightsData; // Ambient, sunlight and point light data, filled once per draw()
+	unsigned int m_frameDataBuffer = 0; // Uniform buffer bound at aie::FRAME_DATA_BLOCK
+	unsigned int m_lightsBuffer = 0; // Uniform buffer bound at aie::LIGHTS_BLOCK
+	float m_time = 0; // Application time passed to the last update(), uploaded in the FrameData block
+
+	// Variables for instanced drawing, rebuilt every draw()
+	std::vector<mat4> m_instanceTransforms; // Model transforms of every visible instance chunk, in submission order
+	std::vector<vec4> m_instanceDequantise; // Dequantisation scale and offset of the chunk of each of m_instanceTransforms
+	RenderQueue m_renderQueue; // One draw per visible chunk of each batch, sorted before drawing
+	int m_batchCount = 0; // Number of unique shader and mesh pairs with visible instances last draw()
+	RenderQueue::SwitchCounts m_submittedSwitches; // State switches last draw() would have needed without sorting
+	RenderQueue::SwitchCounts m_sortedSwitches; // State switches last draw() needed after sorting
+	unsigned int m_instanceBuffer = 0; // GL buffer the instance transforms are streamed into each frame
+	unsigned int m_dequantiseBuffer = 0; // GL buffer the instance dequantisations are streamed into each frame
+	unsigned int m_instanceBufferCapacity = 0; // Number of transforms the instance buffers can currently hold
+	int m_drawCallCount = 0; // Number of instanced draw calls (or multi-draws) issued last draw()
+	int m_chunkDrawCount = 0; // Number of instanced chunk draws last draw(), whether issued alone or in a multi-draw
+
+	// Variables for multi-draw indirect, rebuilt for every pass drawn
+	bool m_multiDrawIndirect = true; // Whether draws sharing their state are issued together as multi-draws, variable is altered by ImGui UI
+	std::vector<aie::GeometryArena::DrawCommand> m_drawCommands; // Command of every draw of the pass, in sorted order
+	std::vector<DrawBucket> m_drawBuckets; // Runs of m_drawCommands drawn by one multi-draw each
+	unsigned int m_indirectBuffer = 0; // GL buffer m_drawCommands are uploaded into for each pass
+
+	// Variables for GPU culling
+	GPUCuller m_gpuCuller; // Culls the camera's instances and fills in their draw commands with a compute shader
+	bool m_gpuCulling = false; // Whether the camera's instances are culled on the GPU, variable is altered by ImGui UI
+	bool m_gpuCulledQueue = false; // Whether m_renderQueue holds the GPU cull's draws, drawn from it's command buffer rather than m_drawCommands
+	GPUCuller::CullTables m_cullTables; // Batches, chunks and draw commands of the instances, only rebuilt when they change
+	unsigned int m_cullTablesVersion = ~0u; // Instance store version m_cullTables were built from
+	unsigned int m_cullTablesMeshes = 0; // Meshes in the mesh table when m_cullTables were built
+	unsigned int m_cullTablesLoadedMeshes = 0; // Loaded meshes of the mesh table when m_cullTables were built
+	std::vector<CullBatch> m_cullBatches; // Shader and mesh of each batch in m_cullTables
+	std::vector<unsigned int> m_cullBatchLookup; // Batch of each shader and mesh pair, indexed by shader ID * mesh count + mesh ID
+
+	// Culling statistics from the last draw()
+	int m_instancesDrawn = 0; // Instances with at least part of their mesh inside the frustum
+	int m_instancesCulled = 0; // Instances entirely outside the frustum
+	int m_instancesOccluded = 0; // Instances inside the frustum but hidden behind occluders, or behind the depth pyramid when culling on the GPU
+	int m_instancesQueryCulled = 0; // Instances inside the frustum but skipped as their last occlusion query found them hidden
+	int m_queriesIssued = 0; // Occlusion queries issued after the opaque pass
+	int m_queriesPending = 0; // Occlusion queries whose results were still unavailable at the start of the frame
+	int m_chunksDrawn = 0; // Instance chunks submitted for drawing
+	int m_chunksCulled = 0; // Instance chunks rejected, including those of culled instances
+	long long m_trianglesDrawn = 0; // Triangles of every submitted instance chunk, at it's LOD
 };
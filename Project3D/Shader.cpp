@@ -2,6 +2,7 @@
 #include <cstdio>
 #include <cassert>
 #include "gl_core_4_4.h"
+#include "GLState.h"
 
 namespace aie {
 
@@ -20,6 +21,7 @@ bool Shader::loadShader(unsigned int stage, const char* filename) {
 	case eShaderStage::TESSELLATION_CONTROL:	m_handle = glCreateShader(GL_TESS_CONTROL_SHADER);	break;
 	case eShaderStage::GEOMETRY:	m_handle = glCreateShader(GL_GEOMETRY_SHADER);	break;
 	case eShaderStage::FRAGMENT:	m_handle = glCreateShader(GL_FRAGMENT_SHADER);	break;
+	case eShaderStage::COMPUTE:	m_handle = glCreateShader(GL_COMPUTE_SHADER);	break;
 	default:	break;
 	};
 	
@@ -65,6 +67,7 @@ bool Shader::createShader(unsigned int stage, const char* string) {
 	case eShaderStage::TESSELLATION_CONTROL:	m_handle = glCreateShader(GL_TESS_CONTROL_SHADER);	break;
 	case eShaderStage::GEOMETRY:	m_handle = glCreateShader(GL_GEOMETRY_SHADER);	break;
 	case eShaderStage::FRAGMENT:	m_handle = glCreateShader(GL_FRAGMENT_SHADER);	break;
+	case eShaderStage::COMPUTE:	m_handle = glCreateShader(GL_COMPUTE_SHADER);	break;
 	default:	break;
 	};
 
@@ -88,6 +91,7 @@ bool Shader::createShader(unsigned int stage, const char* string) {
 
 ShaderProgram::~ShaderProgram() {
 	delete[] m_lastError;
+	GLState::forgetProgram(m_program);
 	glDeleteProgram(m_program);
 }
 
@@ -126,18 +130,65 @@ bool ShaderProgram::link() {
 		glGetProgramInfoLog(m_program, infoLogLength, 0, m_lastError);
 		return false;
 	}
+
+	// attach any shared uniform blocks the program uses to their fixed binding points
+	static const char* blockNames[eUniformBlockBinding::UNIFORM_BLOCK_Count] = { "FrameData", "Lights" };
+	for (unsigned int i = 0; i < eUniformBlockBinding::UNIFORM_BLOCK_Count; ++i)
+		bindUniformBlock(blockNames[i], i);
+
+	resolveMaterialLayout();
+
 	return true;
 }
 
+void ShaderProgram::resolveMaterialLayout() {
+	m_materialLayout.ambient = glGetUniformLocation(m_program, "Ka");
+	m_materialLayout.diffuse = glGetUniformLocation(m_program, "Kd");
+	m_materialLayout.specular = glGetUniformLocation(m_program, "Ks");
+	m_materialLayout.emissive = glGetUniformLocation(m_program, "Ke");
+	m_materialLayout.opacity = glGetUniformLocation(m_program, "opacity");
+	m_materialLayout.specularPower = glGetUniformLocation(m_program, "specularPower");
+
+	// samplers never change texture unit, so are set once here rather than every draw
+	static const char* samplerNames[eMaterialTexture::MATERIAL_TEXTURE_Count] = {
+		"diffuseTexture", "alphaTexture", "ambientTexture", "specularTexture",
+		"specularHighlightTexture", "normalTexture", "displacementTexture" };
+	for (unsigned int i = 0; i < eMaterialTexture::MATERIAL_TEXTURE_Count; ++i) {
+		int location = glGetUniformLocation(m_program, samplerNames[i]);
+		m_materialLayout.usesTexture[i] = location >= 0;
+		if (location >= 0)
+			glProgramUniform1i(m_program, location, i);
+	}
+
+	// shadow map arrays take consecutive units from SHADOW_MAP_TEXTURE, for as many elements as are declared
+	char name[32];
+	for (unsigned int i = 0;; ++i) {
+		snprintf(name, sizeof(name), "shadowMaps[%u]", i);
+		int location = glGetUniformLocation(m_program, name);
+		if (location < 0)
+			break;
+		glProgramUniform1i(m_program, location, SHADOW_MAP_TEXTURE + i);
+	}
+}
+
 void ShaderProgram::bind() {
 	assert(m_program > 0 && "Invalid shader program");
-	glUseProgram(m_program);
+	GLState::useProgram(m_program);
 }
 
 int ShaderProgram::getUniform(const char* name) {
 	return glGetUniformLocation(m_program, name);
 }
 
+bool ShaderProgram::bindUniformBlock(const char* name, unsigned int binding) {
+	assert(m_program > 0 && "Invalid shader program");
+	unsigned int index = glGetUniformBlockIndex(m_program, name);
+	if (index == GL_INVALID_INDEX)
+		return false;
+	glUniformBlockBinding(m_program, index, binding);
+	return true;
+}
+
 bool ShaderProgram::bindUniform(const char* name, int value) {
 	assert(m_program > 0 && "Invalid shader program");
 	int i = glGetUniformLocation(m_program, name);
@@ -19,10 +19,72 @@ enum eShaderStage : unsigned int {
 	TESSELLATION_CONTROL,
 	GEOMETRY,
 	FRAGMENT,
+	COMPUTE,
 
 	SHADER_STAGE_Count,
 };
 
+// fixed binding points for the uniform blocks shared between shader programs,
+// any block with a matching name is bound to its point when a program links
+enum eUniformBlockBinding : unsigned int {
+	FRAME_DATA_BLOCK = 0,
+	LIGHTS_BLOCK,
+
+	UNIFORM_BLOCK_Count,
+};
+
+// fixed binding points of the shader storage buffers used by clustered lighting and
+// gpu culling, these match the binding qualifiers in the lit shaders and gpu_cull.comp
+enum eShaderStorageBinding : unsigned int {
+	POINT_LIGHT_STORAGE = 0,
+	LIGHT_CLUSTER_STORAGE,
+	LIGHT_INDEX_STORAGE,
+
+	CULL_TRANSFORM_STORAGE,
+	CULL_INSTANCE_STORAGE,
+	CULL_BATCH_STORAGE,
+	CULL_CHUNK_STORAGE,
+	CULL_DRAW_STORAGE,
+	CULL_COMMAND_STORAGE,
+	CULLED_TRANSFORM_STORAGE,
+	CULLED_DEQUANTISE_STORAGE,
+	CULL_STATS_STORAGE,
+};
+
+// texture units that OBJMesh material textures are bound to
+enum eMaterialTexture : unsigned int {
+	DIFFUSE_TEXTURE = 0,
+	ALPHA_TEXTURE,
+	AMBIENT_TEXTURE,
+	SPECULAR_TEXTURE,
+	SPECULAR_HIGHLIGHT_TEXTURE,
+	NORMAL_TEXTURE,
+	DISPLACEMENT_TEXTURE,
+
+	MATERIAL_TEXTURE_Count,
+};
+
+// texture units the scene binds frame-wide textures to, after the material textures
+enum eSceneTexture : unsigned int {
+	SHADOW_MAP_TEXTURE = 8, // first of the shadow cascades, one unit per cascade
+	DEPTH_PYRAMID_TEXTURE = 12, // hierarchical depth read by gpu culling, past the last cascade's unit
+};
+
+// uniform locations of the OBJMesh material properties in a program, resolved
+// once at link so drawing never has to query them. -1 means the program
+// doesn't use that property
+struct MaterialBindingLayout {
+	int ambient = -1;		// Ka
+	int diffuse = -1;		// Kd
+	int specular = -1;		// Ks
+	int emissive = -1;		// Ke
+	int opacity = -1;
+	int specularPower = -1;
+
+	// whether the program samples each material texture unit
+	bool usesTexture[eMaterialTexture::MATERIAL_TEXTURE_Count] = {};
+};
+
 // individual sharable shader stages
 class Shader {
 public:
@@ -70,8 +132,14 @@ public:
 
 	unsigned int getHandle() const { return m_program; }
 
+	// material uniform locations, valid after a successful link
+	const MaterialBindingLayout& getMaterialLayout() const { return m_materialLayout; }
+
 	int getUniform(const char* name);
 
+	// binds a uniform block to a uniform buffer binding point, returns false if the block isn't used
+	bool bindUniformBlock(const char* name, unsigned int binding);
+
 	void bindUniform(int ID, int value);
 	void bindUniform(int ID, float value);
 	void bindUniform(int ID, const glm::vec2& value);
@@ -109,8 +177,12 @@ public:
 
 private:
 
+	void resolveMaterialLayout();
+
 	unsigned int	m_program;
 
+	MaterialBindingLayout	m_materialLayout;
+
 	std::shared_ptr<Shader> m_shaders[eShaderStage::SHADER_STAGE_Count];
 
 	char*			m_lastError;
@@ -0,0 +1,146 @@
+#include "ShadowCascades.h"
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+/// <summary>
+/// initialise() creates a depth only render target for each cascade, with a depth texture the lit shaders can
+/// sample from.
+/// </summary>
+/// <returns>True if successful, false if a cascade's render target couldn't be created.</returns>
+bool ShadowCascades::initialise()
+{
+	for (auto& cascade : m_cascades)
+	{
+		if (cascade.target.initialise(0, RESOLUTION, RESOLUTION, true) == false)
+			return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// fit() splits the camera's view into CASCADE_COUNT slices up to SHADOW_DISTANCE, blending logarithmic and uniform
+/// split distances by SPLIT_LAMBDA. The corners of each slice are found by interpolating along the frustum's edges
+/// (view depth is linear along them), and the slice's bounding sphere is taken from them. A cascade is refitted
+/// around it's slice when the sun direction changes, or when the slice's sphere has moved outside the cascade's.
+/// </summary>
+/// <param name="projection">The camera's projection transform this frame.</param>
+/// <param name="view">The camera's view transform this frame.</param>
+/// <param name="nearPlane">The camera's near plane distance.</param>
+/// <param name="farPlane">The camera's far plane distance.</param>
+/// <param name="sunDirection">The direction the sun light travels in.</param>
+void ShadowCascades::fit(const glm::mat4& projection, const glm::mat4& view, float nearPlane, float farPlane, glm::vec3 sunDirection)
+{
+	sunDirection = glm::normalize(sunDirection);
+	bool sunChanged = sunDirection != m_sunDirection;
+	m_sunDirection = sunDirection;
+	m_renderCount = 0;
+	m_refitCount = 0;
+
+	// The worldspace corners of the near and far planes, each far corner lying on the same frustum edge as it's near corner
+	glm::mat4 inverseProjectionView = glm::inverse(projection * view);
+	glm::vec3 nearCorners[4], farCorners[4];
+	for (int i = 0; i < 4; i++)
+	{
+		glm::vec2 ndc((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f);
+		glm::vec4 nearCorner = inverseProjectionView * glm::vec4(ndc, -1, 1);
+		glm::vec4 farCorner = inverseProjectionView * glm::vec4(ndc, 1, 1);
+		nearCorners[i] = glm::vec3(nearCorner) / nearCorner.w;
+		farCorners[i] = glm::vec3(farCorner) / farCorner.w;
+	}
+
+	float shadowDistance = glm::min(SHADOW_DISTANCE, farPlane);
+	float sliceNear = nearPlane;
+	for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+	{
+		float fraction = (float)(i + 1) / CASCADE_COUNT;
+		float logSplit = nearPlane * std::pow(shadowDistance / nearPlane, fraction);
+		float uniformSplit = nearPlane + (shadowDistance - nearPlane) * fraction;
+		float sliceFar = SPLIT_LAMBDA * logSplit + (1 - SPLIT_LAMBDA) * uniformSplit;
+
+		// Bound the slice's 8 corners with a sphere around their average
+		glm::vec3 corners[8];
+		glm::vec3 sliceCentre(0);
+		for (int c = 0; c < 4; c++)
+		{
+			corners[c] = glm::mix(nearCorners[c], farCorners[c], (sliceNear - nearPlane) / (farPlane - nearPlane));
+			corners[c + 4] = glm::mix(nearCorners[c], farCorners[c], (sliceFar - nearPlane) / (farPlane - nearPlane));
+			sliceCentre += corners[c] + corners[c + 4];
+		}
+		sliceCentre /= 8.0f;
+		float sliceRadius = 0;
+		for (auto& corner : corners)
+		{
+			sliceRadius = glm::max(sliceRadius, glm::length(corner - sliceCentre));
+		}
+
+		Cascade& cascade = m_cascades[i];
+		cascade.splitDepth = sliceFar;
+		if (sunChanged || cascade.radius == 0 || glm::length(sliceCentre - cascade.centre) + sliceRadius > cascade.radius)
+		{
+			fitCascade(cascade, sliceCentre, sliceRadius);
+			m_refitCount++;
+		}
+		sliceNear = sliceFar;
+	}
+}
+
+/// <summary>
+/// fitCascade() fits a cascade's orthographic projection around a sphere padded out from it's slice's sphere. The
+/// sun's view is rotated onto the sphere's centre, which is then snapped to a whole number of shadow map texels in
+/// the sun's view, so that static geometry always rasterises into the same texels however the cascade was fitted.
+/// The projection reaches CASTER_DISTANCE further towards the sun than the sphere, to include casters outside it.
+/// </summary>
+/// <param name="cascade">The cascade to refit.</param>
+/// <param name="sliceCentre">Worldspace centre of the slice's bounding sphere.</param>
+/// <param name="sliceRadius">Radius of the slice's bounding sphere.</param>
+void ShadowCascades::fitCascade(Cascade& cascade, glm::vec3 sliceCentre, float sliceRadius)
+{
+	// Round the radius up, so that the texel size only changes when the slice itself does
+	float radius = std::ceil(sliceRadius * SPHERE_PADDING * 16.0f) / 16.0f;
+	float texelSize = 2 * radius / RESOLUTION;
+
+	glm::vec3 up = glm::abs(m_sunDirection.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+	glm::mat4 sunRotation = glm::lookAt(glm::vec3(0), m_sunDirection, up);
+	glm::vec3 lightCentre = glm::vec3(sunRotation * glm::vec4(sliceCentre, 1));
+	lightCentre.x = std::floor(lightCentre.x / texelSize) * texelSize;
+	lightCentre.y = std::floor(lightCentre.y / texelSize) * texelSize;
+
+	cascade.centre = glm::vec3(glm::inverse(sunRotation) * glm::vec4(lightCentre, 1));
+	cascade.radius = radius;
+	cascade.lightView = glm::translate(glm::mat4(1), -lightCentre) * sunRotation;
+	glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, -(radius + CASTER_DISTANCE), radius);
+	cascade.lightProjectionView = projection * cascade.lightView;
+	cascade.refitted = true;
+}
+
+/// <summary>
+/// needsRender() returns whether a cascade has to be re-rendered this frame, which is when it has been refitted
+/// since it was last rendered, or when the hash of the casters drawn into it differs from the last render's.
+/// The cascade is assumed to be rendered when this returns true.
+/// </summary>
+/// <param name="cascade">Index of the cascade.</param>
+/// <param name="casterHash">Hash of the draws and transforms of the casters culled into the cascade this frame.</param>
+/// <returns>True if the cascade's shadow map is out of date.</returns>
+bool ShadowCascades::needsRender(unsigned int cascade, uint64_t casterHash)
+{
+	Cascade& target = m_cascades[cascade];
+	if (target.refitted == false && target.casterHash == casterHash)
+		return false;
+
+	target.refitted = false;
+	target.casterHash = casterHash;
+	m_renderCount++;
+	return true;
+}
+
+/// <summary>
+/// getShadowMatrix() returns the cascade's light projection view transform, followed by a scale and bias from
+/// NDC into the 0 to 1 range of the shadow map's texture coordinates and depth.
+/// </summary>
+/// <param name="cascade">Index of the cascade.</param>
+/// <returns>The cascade's worldspace to shadow map transform.</returns>
+glm::mat4 ShadowCascades::getShadowMatrix(unsigned int cascade) const
+{
+	glm::mat4 bias = glm::translate(glm::mat4(1), glm::vec3(0.5f)) * glm::scale(glm::mat4(1), glm::vec3(0.5f));
+	return bias * m_cascades[cascade].lightProjectionView;
+}
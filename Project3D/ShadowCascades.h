@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include "RenderTarget.h"
+#include "UniformBlocks.h"
+
+/// <summary>
+/// ShadowCascades holds the cascaded shadow maps of the scene's sun light. The camera frustum is split into
+/// CASCADE_COUNT slices along it's view depth, up to SHADOW_DISTANCE, and each slice gets it's own depth only
+/// render target covering a bounding sphere of the slice from the sun's direction. Nearby slices are small, so
+/// their shadows stay sharp without needing a single huge shadow map for the whole view.
+/// Each cascade's sphere is padded, and is only refitted when the camera's slice leaves it or the sun direction
+/// changes, with it's centre snapped to whole shadow map texels so that a refit doesn't make the shadows swim. A
+/// cascade only needs re-rendering when it has been refitted, or when the casters drawn into it have changed,
+/// which the scene detects by hashing the culled draws of each cascade and passing the hash to needsRender().
+/// </summary>
+class ShadowCascades
+{
+public:
+
+	static const unsigned int CASCADE_COUNT = 3;
+	static const unsigned int RESOLUTION = 1024; // Width and height of each cascade's shadow map
+	static constexpr float SHADOW_DISTANCE = 60.0f; // View depth past which nothing receives shadows
+	static constexpr float SPLIT_LAMBDA = 0.75f; // Blend between logarithmic (1) and uniform (0) cascade splits
+	static constexpr float SPHERE_PADDING = 1.15f; // Cascade spheres are this much bigger than their slice, so they can be kept while the camera moves
+	static constexpr float CASTER_DISTANCE = 100.0f; // How far towards the sun from a cascade's sphere casters are still drawn
+
+	static_assert(CASCADE_COUNT >= 1 && CASCADE_COUNT <= MAX_SHADOW_CASCADES, "CASCADE_COUNT must fit in the Lights uniform block");
+
+	bool initialise(); // Creates the depth render target of each cascade
+	void fit(const glm::mat4& projection, const glm::mat4& view, float nearPlane, float farPlane, glm::vec3 sunDirection); // Splits the view and refits any cascade that no longer covers it's slice
+	bool needsRender(unsigned int cascade, uint64_t casterHash); // Whether a cascade must be re-rendered this frame, given the hash of the casters inside it
+
+	// Getters
+	aie::RenderTarget& getTarget(unsigned int cascade) { return m_cascades[cascade].target; }
+	const glm::mat4& getLightView(unsigned int cascade) const { return m_cascades[cascade].lightView; }
+	const glm::mat4& getLightProjectionView(unsigned int cascade) const { return m_cascades[cascade].lightProjectionView; }
+	glm::mat4 getShadowMatrix(unsigned int cascade) const; // Transforms worldspace into the cascade's shadow map texture coordinates and depth
+	float getDepthRange(unsigned int cascade) const { return 2 * m_cascades[cascade].radius + CASTER_DISTANCE; }
+	float getSplitDepth(unsigned int cascade) const { return m_cascades[cascade].splitDepth; }
+	unsigned int getRenderCount() const { return m_renderCount; }
+	unsigned int getRefitCount() const { return m_refitCount; }
+
+protected:
+
+	/// <summary>
+	/// A Cascade is the shadow map of one slice of the camera frustum, along with the sphere it was last fitted to,
+	/// and the state it was last rendered with.
+	/// </summary>
+	struct Cascade
+	{
+		aie::RenderTarget target;
+		float splitDepth = 0; // View depth of the far end of this cascade's slice
+		glm::vec3 centre = glm::vec3(0);
+		float radius = 0;
+		glm::mat4 lightView = glm::mat4(1);
+		glm::mat4 lightProjectionView = glm::mat4(1);
+		bool refitted = true; // Whether the cascade has been refitted since it was last rendered
+		uint64_t casterHash = 0; // Hash of the casters it was last rendered with
+	};
+
+	void fitCascade(Cascade& cascade, glm::vec3 sliceCentre, float sliceRadius); // Fits a cascade's padded, texel snapped sphere around a slice
+
+	Cascade m_cascades[CASCADE_COUNT];
+	glm::vec3 m_sunDirection = glm::vec3(0);
+	unsigned int m_renderCount = 0; // Cascades re-rendered during the last frame
+	unsigned int m_refitCount = 0; // Cascades refitted during the last frame
+};
@@ -0,0 +1,84 @@
+#include "TextureCache.h"
+#include <filesystem>
+
+namespace aie {
+
+std::mutex TextureCache::sm_mutex;
+std::unordered_map<std::string, TextureCache::Entry> TextureCache::sm_entries;
+TextureCache::Stats TextureCache::sm_stats;
+
+// bytes a texture's pixels take up once uploaded, with a third more for the mip chain
+static size_t getResidentBytes(const Texture& texture) {
+	size_t bytes = (size_t)texture.getWidth() * texture.getHeight() * texture.getFormat();
+	return bytes + bytes / 3;
+}
+
+std::shared_ptr<Texture> TextureCache::acquire(const std::string& filename) {
+
+	if (filename.empty())
+		return nullptr;
+
+	// the same file named through different relative paths shares one texture
+	std::error_code error;
+	std::filesystem::path path = std::filesystem::weakly_canonical(filename, error);
+	std::string key = error ? std::filesystem::path(filename).lexically_normal().string() : path.string();
+
+	std::unique_lock<std::mutex> lock(sm_mutex);
+	auto found = sm_entries.find(key);
+	if (found != sm_entries.end()) {
+		std::shared_ptr<Texture> texture = found->second.reference.lock();
+		if (texture != nullptr) {
+			sm_stats.hits++;
+			std::shared_future<bool> decoded = found->second.decoded;
+			lock.unlock();
+			return decoded.get() ? texture : nullptr;
+		}
+	}
+
+	// load it, with the entry in place first so other threads wait for this decode rather than starting their own
+	sm_stats.misses++;
+	Texture* raw = new Texture();
+	std::shared_ptr<Texture> texture(raw, [key](Texture* texture) { release(key, texture); });
+	std::promise<bool> decoded;
+	sm_entries[key] = { raw, texture, decoded.get_future().share() };
+	lock.unlock();
+
+	bool success = raw->decode(key.c_str());
+
+	lock.lock();
+	if (success) {
+		sm_stats.residentCount++;
+		sm_stats.residentBytes += getResidentBytes(*raw);
+	}
+	else {
+		sm_entries.erase(key);
+	}
+	lock.unlock();
+
+	decoded.set_value(success);
+	return success ? texture : nullptr;
+}
+
+TextureCache::Stats TextureCache::getStats() {
+	std::lock_guard<std::mutex> lock(sm_mutex);
+	return sm_stats;
+}
+
+void TextureCache::release(const std::string& key, Texture* texture) {
+
+	{
+		std::lock_guard<std::mutex> lock(sm_mutex);
+
+		// the entry may already belong to a newer load of the same file, if this one failed or was being released as it was looked up
+		auto found = sm_entries.find(key);
+		if (found != sm_entries.end() && found->second.texture == texture)
+			sm_entries.erase(found);
+		if (texture->getWidth() > 0) {
+			sm_stats.residentCount--;
+			sm_stats.residentBytes -= getResidentBytes(*texture);
+		}
+	}
+	delete texture;
+}
+
+} // namespace aie
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Texture.h"
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace aie {
+
+// a registry of textures loaded from files, so a texture named by several meshes or materials is
+// only decoded and uploaded once. textures are keyed by their canonical path and handed out as
+// shared pointers, and a texture is deleted (and forgotten by the cache) when the last one drops.
+// acquire may be called from any thread, the same as Texture::decode, and leaves the upload to the
+// caller on the opengl thread (uploading a texture that is already up does nothing)
+class TextureCache {
+public:
+
+	// lookups that found a texture already loaded versus ones that loaded it, and the textures alive
+	// with the bytes their pixels take up once uploaded (including their mipmaps)
+	struct Stats {
+		unsigned int hits = 0;
+		unsigned int misses = 0;
+		unsigned int residentCount = 0;
+		size_t residentBytes = 0;
+	};
+
+	// returns the texture for a file, decoding it if it isn't loaded yet. returns null for an empty
+	// filename without touching the file system, and for a file that can't be decoded. a texture
+	// another thread is still decoding is waited for
+	static std::shared_ptr<Texture> acquire(const std::string& filename);
+
+	static Stats getStats();
+
+private:
+
+	// a loaded texture, not holding it alive, and the result of it's decode once that is finished
+	struct Entry {
+		Texture*				texture;
+		std::weak_ptr<Texture>	reference;
+		std::shared_future<bool> decoded;
+	};
+
+	static void release(const std::string& key, Texture* texture);
+
+	static std::mutex								sm_mutex;
+	static std::unordered_map<std::string, Entry>	sm_entries;
+	static Stats									sm_stats;
+};
+
+} // namespace aie
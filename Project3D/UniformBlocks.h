@@ -0,0 +1,51 @@
+#pragma once
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#define MAX_SHADOW_CASCADES 4 // Max number of shadow cascades the lit shaders can sample
+
+/// <summary>
+/// FrameDataBlock mirrors the std140 layout of the FrameData uniform block declared in the shaders, and holds
+/// the camera and timing values that are the same for everything drawn in a frame. The Scene fills it once per
+/// frame and uploads it into a uniform buffer bound at aie::FRAME_DATA_BLOCK, so every shader program reads the
+/// same copy without any uniforms needing to be set on it.
+/// </summary>
+struct FrameDataBlock
+{
+	glm::mat4 projectionView; // ProjectionViewTransform
+	glm::mat4 view; // ViewTransform
+	glm::mat4 projection; // ProjectionTransform
+	glm::vec3 cameraPosition; // CameraPosition
+	float time; // Time
+	glm::vec2 screenSize; // ScreenSize
+	glm::vec2 padding;
+	glm::mat4 inverseProjectionView; // InverseProjectionViewTransform, for rebuilding positions from depth
+};
+
+/// <summary>
+/// LightsBlock mirrors the std140 layout of the Lights uniform block declared in the lit shaders, holding the
+/// ambient colour, main directional light and the parameters needed to find a fragment's light cluster. Each vec3
+/// is padded out to 16 bytes as std140 requires (numLights packs into the padding of the light direction). The
+/// point lights themselves live in the LightClusterGrid's storage buffers, so there is no limit on their count.
+/// The sun's shadow cascades follow, with the view depth each cascade ends at (0 for unused cascades, so nothing
+/// falls in them) and each cascade's worldspace to shadow map transform.
+/// </summary>
+struct LightsBlock
+{
+	glm::vec3 ambientColour; // AmbientColour
+	float padding0;
+	glm::vec3 lightColour; // LightColour
+	float padding1;
+	glm::vec3 lightDirection; // LightDirection
+	int numLights; // numLights, the number of point lights uploaded to the cluster grid
+	glm::uvec4 clusterGrid; // ClusterGrid, the cluster counts along x, y and z
+	glm::vec4 clusterDepth; // ClusterDepth, the near and far plane, and the scale and bias from log(depth) to slice
+	glm::vec4 cascadeSplits; // CascadeSplits
+	glm::mat4 shadowMatrices[MAX_SHADOW_CASCADES]; // ShadowMatrices
+};
+
+static_assert(MAX_SHADOW_CASCADES == 4, "LightsBlock packs one split depth per shadow cascade into a vec4");
+static_assert(sizeof(FrameDataBlock) == 288, "FrameDataBlock must match the std140 FrameData block");
+static_assert(sizeof(LightsBlock) == 96 + 64 * MAX_SHADOW_CASCADES, "LightsBlock must match the std140 Lights block");
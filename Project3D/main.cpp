@@ -1,16 +1,25 @@
 #include "Application3D.h"
+#include <cstring>
 
 /// <summary>
 /// The main() entry simply instantiates a new Application3D object and calls run on it, which initialises
 /// an application window of size 1280x720, and continually triggers the application's update loop each frame
-/// the user has triggered the exit by pressing escape
+/// the user has triggered the exit by pressing escape. Passing --render-thread draws each frame on a render
+/// thread while the next frame is updated.
 /// </summary>
 /// <returns></returns>
-int main() {
+int main(int argc, char* argv[]) {
 	
 	// Instantiate an Application3D object
 	auto app = new Application3D();
 
+	// Draw on a render thread if asked to on the command line
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--render-thread") == 0)
+			app->setRenderThread(true);
+	}
+
 	// Initialise and loop until close
 	app->run("Graphics Engine Demonstration - Ronan Richardson", 1280, 720, false);
 
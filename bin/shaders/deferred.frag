@@ -0,0 +1,191 @@
+#version 430
+
+/// deferred.frag is the lighting pass of the deferred shading path, drawn
+/// with post.vert over a fullscreen quad after the opaque objects have been
+/// drawn into the G-buffer by the gbuffer shaders. For each pixel, the
+/// shader reads the surface properties from the G-buffer and rebuilds the
+/// worldspace position from the depth buffer, then lights it with the same
+/// phong model as the forward shaders. The main directional light is applied
+/// first, and then only the point lights in the pixel's light cluster, so
+/// every pixel is lit exactly once no matter how many surfaces were drawn
+/// over it. Pixels that nothing was drawn over are discarded, leaving the
+/// background colour the render target was cleared to.
+
+in vec2 vTexCoord;
+
+// Per-frame camera and timing data, shared by every shader and uploaded once per frame by the scene
+layout (std140) uniform FrameData
+{
+	mat4 ProjectionViewTransform;
+	mat4 ViewTransform;
+	mat4 ProjectionTransform;
+	vec3 CameraPosition;
+	float Time;
+	vec2 ScreenSize;
+	mat4 InverseProjectionViewTransform;
+};
+
+// Directional and ambient light properties, and the layout of the light clusters, uploaded once per frame by the scene
+const int MAX_SHADOW_CASCADES = 4;
+layout (std140) uniform Lights
+{
+	vec3 AmbientColour;
+	vec3 LightColour;
+	vec3 LightDirection;
+	int numLights;
+	uvec4 ClusterGrid; // xyz is the number of clusters along each axis of the view
+	vec4 ClusterDepth; // near plane, far plane, and the scale and bias from log(depth) to depth slice
+	vec4 CascadeSplits; // view depth each of the sun's shadow cascades ends at, 0 for unused cascades
+	mat4 ShadowMatrices[MAX_SHADOW_CASCADES]; // worldspace to shadow map texture coordinates and depth of each cascade
+};
+
+// Point lights that reach the view, binned into view space clusters by the scene's LightClusterGrid
+struct PointLight
+{
+	vec4 positionRange; // xyz is the worldspace position, w is the range past which the light is ignored
+	vec4 colour; // rgb is the colour pre-multiplied by intensity
+};
+layout (std430, binding = 0) readonly buffer PointLights
+{
+	PointLight pointLights[];
+};
+layout (std430, binding = 1) readonly buffer LightClusters
+{
+	uvec2 lightClusters[]; // x is the offset of the cluster's lights in lightIndices, y is the count
+};
+layout (std430, binding = 2) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
+
+// G-buffer targets written by the gbuffer shaders
+uniform sampler2D albedoTexture;
+uniform sampler2D normalTexture;
+uniform sampler2D specularTexture;
+uniform sampler2D ambientTexture;
+uniform sampler2D depthTexture;
+
+// Depth textures of the sun's shadow cascades
+uniform sampler2D shadowMaps[MAX_SHADOW_CASCADES];
+const float SHADOW_BIAS = 0.0005;
+
+// Final colour of this pixel
+out vec4 FragColour;
+
+/// sampleShadowMap() compares a shadow map coordinate's depth against a 2x2 block of
+/// shadow map texels around it, returning the fraction of them it is not behind.
+float sampleShadowMap(sampler2D shadowMap, vec3 coord)
+{
+	vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0));
+	float lit = 0;
+	for (int x = 0; x < 2; x++)
+	{
+		for (int y = 0; y < 2; y++)
+		{
+			float depth = textureLod(shadowMap, coord.xy + (vec2(x, y) - 0.5) * texelSize, 0).r;
+			lit += coord.z - SHADOW_BIAS <= depth ? 1.0 : 0.0;
+		}
+	}
+	return lit / 4;
+}
+
+/// getShadow() returns how much of the sun reaches a worldspace position, using the first shadow
+/// cascade whose slice the view depth falls in. Samplers can't be indexed by a value that differs
+/// between fragments, so each cascade is sampled with a constant index.
+float getShadow(vec3 worldPosition, float viewDepth)
+{
+	for (int i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		if (viewDepth < CascadeSplits[i])
+		{
+			vec3 coord = (ShadowMatrices[i] * vec4(worldPosition, 1)).xyz;
+			if (any(lessThan(coord, vec3(0))) || any(greaterThan(coord, vec3(1))))
+				return 1;
+			switch (i)
+			{
+			case 0: return sampleShadowMap(shadowMaps[0], coord);
+			case 1: return sampleShadowMap(shadowMaps[1], coord);
+			case 2: return sampleShadowMap(shadowMaps[2], coord);
+			default: return sampleShadowMap(shadowMaps[3], coord);
+			}
+		}
+	}
+	return 1;
+}
+
+/// getCluster() finds the light cluster containing this fragment, using it's screen position for the tile
+/// and the log of it's view depth for the exponentially spaced depth slice.
+uint getCluster(float viewDepth)
+{
+	uint slice = uint(clamp(log(viewDepth) * ClusterDepth.z - ClusterDepth.w, 0.0, float(ClusterGrid.z - 1u)));
+	uvec2 tile = uvec2(clamp(gl_FragCoord.xy / ScreenSize * vec2(ClusterGrid.xy), vec2(0), vec2(ClusterGrid.xy - 1u)));
+	return tile.x + tile.y * ClusterGrid.x + slice * ClusterGrid.x * ClusterGrid.y;
+}
+
+/// diffuse() takes an input of the direction to the light being calculated currently, the colour
+/// of said light, as well as the normal of this fragment, and uses them to calculate
+/// the lambertian reflectance for this pixel, multiplied by the light colour.
+vec3 diffuse(vec3 lightDirection, vec3 lightColour, vec3 normal)
+{
+	return lightColour * max(0, min(1, dot(normal, -lightDirection)));
+}
+
+/// specular() takes an input of the direction to the light being calculated currently, the colour
+/// of said light, as well as the normal, viewingDisplacement from the camera and specular power of this
+/// pixel, and uses them to calculate the specular term for this pixel, multiplied by the light colour.
+vec3 specular(vec3 lightDirection, vec3 lightColour, vec3 normal, vec3 viewingDisplacement, float specularPower)
+{
+	vec3 reflectedLight = reflect(lightDirection, normal);
+	return lightColour * pow(max(0, dot(reflectedLight, viewingDisplacement)), specularPower);
+}
+
+void main()
+{
+	// The G-buffer is the same size as the screen, so can be read texel for texel
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(depthTexture, texel, 0).r;
+	if (depth == 1)
+		discard;
+
+	// Rebuild the worldspace position of this pixel from it's NDC position and depth
+	vec4 worldPosition = InverseProjectionViewTransform * vec4(vec3(vTexCoord, depth) * 2 - 1, 1);
+	worldPosition /= worldPosition.w;
+
+	// Read back the surface properties, unpacking the normal and specular power
+	vec3 albedo = texelFetch(albedoTexture, texel, 0).rgb;
+	vec3 normal = normalize(texelFetch(normalTexture, texel, 0).rgb * 2 - 1);
+	vec4 specularSample = texelFetch(specularTexture, texel, 0);
+	float specularPower = exp2(specularSample.a * 10);
+	vec3 ambientAlbedo = texelFetch(ambientTexture, texel, 0).rgb;
+
+	// Calculate the diffuse and specular total starting with the main sunlight, darkened by the shadow cascades
+	float viewDepth = -(ViewTransform * vec4(worldPosition.xyz, 1)).z;
+	vec3 sunColour = LightColour * getShadow(worldPosition.xyz, viewDepth);
+	vec3 lightDirection = normalize(LightDirection);
+	vec3 diffuseTotal = diffuse(lightDirection, sunColour, normal);
+	vec3 viewingDisplacement = normalize(CameraPosition - worldPosition.xyz);
+	vec3 specularTotal = specular(lightDirection, sunColour, normal, viewingDisplacement, specularPower);
+
+	// Iterate through the point lights of this pixel's cluster, and accumulate their diffuse and specular lighting contributions
+	uvec2 cluster = lightClusters[getCluster(viewDepth)];
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		PointLight pointLight = pointLights[lightIndices[cluster.x + i]];
+		// Store the direction and distance of this point light
+		vec3 direction = worldPosition.xyz - pointLight.positionRange.xyz;
+		float distance = length(direction);
+		// Normalise the direction now that we have the distance
+		direction /= distance;
+
+		// Attenuate the light intensity of this point light with the inverse square law, windowed to reach zero at it's range
+		float window = clamp(1 - pow(distance / pointLight.positionRange.w, 4), 0, 1);
+		vec3 colour = pointLight.colour.rgb / (distance * distance) * window * window;
+
+		// Add this point lights diffuse and specular contribution
+		diffuseTotal += diffuse(direction, colour, normal);
+		specularTotal += specular(direction, colour, normal, viewingDisplacement, specularPower);
+	}
+
+	// Combine the three sections of phong lighting, the material colours were multiplied in by the gbuffer shaders
+	FragColour = vec4(AmbientColour * ambientAlbedo + diffuseTotal * albedo + specularTotal * specularSample.rgb, 1);
+}
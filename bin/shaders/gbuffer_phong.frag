@@ -0,0 +1,52 @@
+#version 410
+
+/// gbuffer_phong.frag is the deferred counterpart of phong.frag, used with
+/// phong.vert to fill the G-buffer rather than shading each fragment. The
+/// shader samples the same texture maps and normal map as phong.frag, and
+/// writes the fragment's surface properties into the G-buffer's targets
+/// (diffuse albedo, worldspace normal, specular colour and power, and ambient
+/// albedo). The lighting is then applied once per pixel by deferred.frag,
+/// so the cost of lighting no longer depends on how many times each pixel
+/// is drawn over.
+
+// Properties passed and interpolated from the vertex stage
+in vec3 vWorldPosition;
+in vec3 vNormal;
+in vec2 vTexCoord;
+in vec3 vTangent;
+in vec3 vBiTangent;
+
+// Material light reflectance properties
+uniform vec3 Ka;
+uniform vec3 Kd;
+uniform vec3 Ks;
+uniform float specularPower;
+
+// Texture maps
+uniform sampler2D diffuseTexture;
+uniform sampler2D specularTexture;
+uniform sampler2D normalTexture;
+
+// G-buffer targets, read back by deferred.frag
+layout (location = 0) out vec4 Albedo; // rgb is the diffuse albedo
+layout (location = 1) out vec4 Normal; // rgb is the worldspace normal, scaled into the 0 to 1 range
+layout (location = 2) out vec4 Specular; // rgb is the specular colour, a is log2 of the specular power over 10
+layout (location = 3) out vec4 Ambient; // rgb is the ambient albedo
+
+void main()
+{
+	// Construct the tangent basis matrix from the normalised worldspace normal, tangent and bi-tangent
+	mat3 TBN = mat3(normalize(vTangent), normalize(vBiTangent), normalize(vNormal));
+	// Get the high-res normal from the normal map (scale by * 2 - 1 to get from an RGB range to an XYZ normal range), and transform it into worldspace
+	vec3 normal = normalize(TBN * (texture(normalTexture, vTexCoord).rgb * 2 - 1));
+
+	// Sample the diffuse and specular texture maps using the interpolated UV coord for this fragment
+	vec3 diffuseTexColour = texture(diffuseTexture, vTexCoord).rgb;
+	vec3 specularTexColour = texture(specularTexture, vTexCoord).rgb;
+
+	// Multiply the material colours in, the same as phong.frag does when shading
+	Albedo = vec4(Kd * diffuseTexColour, 1);
+	Normal = vec4(normal * 0.5 + 0.5, 1);
+	Specular = vec4(Ks * specularTexColour, log2(max(specularPower, 1)) / 10);
+	Ambient = vec4(Ka * diffuseTexColour, 1);
+}
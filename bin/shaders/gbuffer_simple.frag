@@ -0,0 +1,32 @@
+#version 410
+
+/// gbuffer_simple.frag is the deferred counterpart of simple.frag, used with
+/// simple.vert to fill the G-buffer rather than shading each fragment. As
+/// with simple.frag no textures are used, so the fragment's surface properties
+/// written into the G-buffer's targets (diffuse albedo, worldspace normal,
+/// specular colour and power, and ambient albedo) come straight from the
+/// material. The lighting is then applied once per pixel by deferred.frag.
+
+// Properties passed and interpolated from the vertex stage
+in vec3 vWorldPosition; // position of this fragment in worldspace
+in vec3 vNormal; // normal of this fragment in worldspace
+
+// Material light reflectance properties
+uniform vec3 Ka;
+uniform vec3 Kd;
+uniform vec3 Ks;
+uniform float specularPower;
+
+// G-buffer targets, read back by deferred.frag
+layout (location = 0) out vec4 Albedo; // rgb is the diffuse albedo
+layout (location = 1) out vec4 Normal; // rgb is the worldspace normal, scaled into the 0 to 1 range
+layout (location = 2) out vec4 Specular; // rgb is the specular colour, a is log2 of the specular power over 10
+layout (location = 3) out vec4 Ambient; // rgb is the ambient albedo
+
+void main()
+{
+	Albedo = vec4(Kd, 1);
+	Normal = vec4(normalize(vNormal) * 0.5 + 0.5, 1);
+	Specular = vec4(Ks, log2(max(specularPower, 1)) / 10);
+	Ambient = vec4(Ka, 1);
+}
@@ -0,0 +1,10 @@
+#version 410
+
+/// occlusion_box.frag is the fragment shader of the occlusion query boxes.
+/// Colour and depth writes are disabled while the boxes are drawn, as the
+/// queries only count the samples that pass the depth test, so nothing
+/// needs to be output here.
+
+void main()
+{
+}
@@ -0,0 +1,15 @@
+#version 410
+
+/// occlusion_box.vert is the vertex shader of the scene's GPU occlusion
+/// queries. It draws the -1 to 1 query box, which the scene scales and
+/// moves onto the worldspace bounding box of the instance being queried.
+
+layout (location = 0) in vec4 Position;
+
+// Clip-space transform of the box, the camera's projection view combined with the instance's bounding box, set by the scene per query
+uniform mat4 BoxTransform;
+
+void main()
+{
+	gl_Position = BoxTransform * Position;
+}
@@ -1,4 +1,4 @@
-#version 410
+#version 430
 
 /// phong.frag is a standard fragment shader that shades each fragment 
 /// using it's mesh's material and texture properties combined with a 
@@ -6,8 +6,8 @@
 /// a normal map, and a specular map for drawing, and so for models to be 
 /// compatible with this shader, they must have passed these uniforms in before 
 /// drawing. For lighting, the function first calculates the specular and diffuse
-/// contribution from the main directional light, and then iterates through all point
-/// lights affecting this OBJMesh, adding their specular and diffuse contribution to 
+/// contribution from the shadowed main directional light, and then iterates through all point
+/// lights in this fragment's light cluster, adding their specular and diffuse contribution to 
 /// a running total. The shader then finishes by applying the totals to the appropriate
 /// ambient/diffuse/specular terms and summing them together as per the phong model.
 
@@ -18,29 +18,119 @@ in vec2 vTexCoord;
 in vec3 vTangent;
 in vec3 vBiTangent;
 
-// Directional and ambient light properties
-uniform vec3 AmbientColour;
-uniform vec3 LightColour;
-uniform vec3 LightDirection;
-// Point light properties
-const int MAX_LIGHTS = 4;
-uniform int numLights;
-uniform vec3 PointLightColours[MAX_LIGHTS];
-uniform vec3 PointLightPositions[MAX_LIGHTS];
+// Per-frame camera and timing data, shared by every shader and uploaded once per frame by the scene
+layout (std140) uniform FrameData
+{
+	mat4 ProjectionViewTransform;
+	mat4 ViewTransform;
+	mat4 ProjectionTransform;
+	vec3 CameraPosition;
+	float Time;
+	vec2 ScreenSize;
+	mat4 InverseProjectionViewTransform;
+};
+
+// Directional and ambient light properties, and the layout of the light clusters, uploaded once per frame by the scene
+const int MAX_SHADOW_CASCADES = 4;
+layout (std140) uniform Lights
+{
+	vec3 AmbientColour;
+	vec3 LightColour;
+	vec3 LightDirection;
+	int numLights;
+	uvec4 ClusterGrid; // xyz is the number of clusters along each axis of the view
+	vec4 ClusterDepth; // near plane, far plane, and the scale and bias from log(depth) to depth slice
+	vec4 CascadeSplits; // view depth each of the sun's shadow cascades ends at, 0 for unused cascades
+	mat4 ShadowMatrices[MAX_SHADOW_CASCADES]; // worldspace to shadow map texture coordinates and depth of each cascade
+};
+
+// Point lights that reach the view, binned into view space clusters by the scene's LightClusterGrid
+struct PointLight
+{
+	vec4 positionRange; // xyz is the worldspace position, w is the range past which the light is ignored
+	vec4 colour; // rgb is the colour pre-multiplied by intensity
+};
+layout (std430, binding = 0) readonly buffer PointLights
+{
+	PointLight pointLights[];
+};
+layout (std430, binding = 1) readonly buffer LightClusters
+{
+	uvec2 lightClusters[]; // x is the offset of the cluster's lights in lightIndices, y is the count
+};
+layout (std430, binding = 2) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
 
 // Material light reflectance properties
 uniform vec3 Ka;
 uniform vec3 Kd;
 uniform vec3 Ks;
 uniform float specularPower;
+uniform float opacity; // Materials with an opacity below 1 are drawn in the scene's transparent pass
+
+// Depth textures of the sun's shadow cascades
+uniform sampler2D shadowMaps[MAX_SHADOW_CASCADES];
+const float SHADOW_BIAS = 0.0005;
+
+// Final colour of this fragment
+out vec4 FragColour;
 
 // Texture maps
 uniform sampler2D diffuseTexture;
 uniform sampler2D specularTexture;
 uniform sampler2D normalTexture;
 
-// Camera Transform
-uniform vec3 CameraPosition;
+/// sampleShadowMap() compares a shadow map coordinate's depth against a 2x2 block of
+/// shadow map texels around it, returning the fraction of them it is not behind.
+float sampleShadowMap(sampler2D shadowMap, vec3 coord)
+{
+	vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0));
+	float lit = 0;
+	for (int x = 0; x < 2; x++)
+	{
+		for (int y = 0; y < 2; y++)
+		{
+			float depth = textureLod(shadowMap, coord.xy + (vec2(x, y) - 0.5) * texelSize, 0).r;
+			lit += coord.z - SHADOW_BIAS <= depth ? 1.0 : 0.0;
+		}
+	}
+	return lit / 4;
+}
+
+/// getShadow() returns how much of the sun reaches a worldspace position, using the first shadow
+/// cascade whose slice the view depth falls in. Samplers can't be indexed by a value that differs
+/// between fragments, so each cascade is sampled with a constant index.
+float getShadow(vec3 worldPosition, float viewDepth)
+{
+	for (int i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		if (viewDepth < CascadeSplits[i])
+		{
+			vec3 coord = (ShadowMatrices[i] * vec4(worldPosition, 1)).xyz;
+			if (any(lessThan(coord, vec3(0))) || any(greaterThan(coord, vec3(1))))
+				return 1;
+			switch (i)
+			{
+			case 0: return sampleShadowMap(shadowMaps[0], coord);
+			case 1: return sampleShadowMap(shadowMaps[1], coord);
+			case 2: return sampleShadowMap(shadowMaps[2], coord);
+			default: return sampleShadowMap(shadowMaps[3], coord);
+			}
+		}
+	}
+	return 1;
+}
+
+/// getCluster() finds the light cluster containing this fragment, using it's screen position for the tile
+/// and the log of it's view depth for the exponentially spaced depth slice.
+uint getCluster(float viewDepth)
+{
+	uint slice = uint(clamp(log(viewDepth) * ClusterDepth.z - ClusterDepth.w, 0.0, float(ClusterGrid.z - 1u)));
+	uvec2 tile = uvec2(clamp(gl_FragCoord.xy / ScreenSize * vec2(ClusterGrid.xy), vec2(0), vec2(ClusterGrid.xy - 1u)));
+	return tile.x + tile.y * ClusterGrid.x + slice * ClusterGrid.x * ClusterGrid.y;
+}
 
 /// diffuse() takes an input of the direction to the light being calculated currently, the colour
 /// of said light, as well as the normal of this fragment, and uses them to calculate
@@ -74,22 +164,27 @@ void main()
 	// Modify the lighting normal based on the high-res normal transformed into worldspace
 	normal = TBN * normalTex;
 
-	// Calculate the diffuse and specular total starting with the main sunlight
-	vec3 diffuseTotal = diffuse(lightDirection, LightColour, normal);
+	// Calculate the diffuse and specular total starting with the main sunlight, darkened by the shadow cascades
+	float viewDepth = -(ViewTransform * vec4(vWorldPosition, 1)).z;
+	vec3 sunColour = LightColour * getShadow(vWorldPosition, viewDepth);
+	vec3 diffuseTotal = diffuse(lightDirection, sunColour, normal);
 	vec3 viewingDisplacement = normalize(CameraPosition - vWorldPosition);
-	vec3 specularTotal = specular(lightDirection, LightColour, normal, viewingDisplacement);
+	vec3 specularTotal = specular(lightDirection, sunColour, normal, viewingDisplacement);
 	
-	// Iterate through all the point lights, and accumulate their diffuse and specular lighting contributions
-	for (int i = 0; i < numLights && i < MAX_LIGHTS; i++)
+	// Iterate through the point lights of this fragment's cluster, and accumulate their diffuse and specular lighting contributions
+	uvec2 cluster = lightClusters[getCluster(viewDepth)];
+	for (uint i = 0u; i < cluster.y; i++)
 	{
+		PointLight pointLight = pointLights[lightIndices[cluster.x + i]];
 		// Store the direction and distance of this point light
-		vec3 direction = vWorldPosition - PointLightPositions[i];
+		vec3 direction = vWorldPosition - pointLight.positionRange.xyz;
 		float distance = length(direction);
 		// Normalise the direction now that we have the distance
 		direction /= distance;
 
-		// Attenuate the light intensity of this point light with the inverse square law
-		vec3 colour = PointLightColours[i]/(distance * distance);
+		// Attenuate the light intensity of this point light with the inverse square law, windowed to reach zero at it's range
+		float window = clamp(1 - pow(distance / pointLight.positionRange.w, 4), 0, 1);
+		vec3 colour = pointLight.colour.rgb / (distance * distance) * window * window;
 
 		// Add this point lights diffuse and specular contribution
 		diffuseTotal += diffuse(direction, colour, normal);
@@ -106,5 +201,5 @@ void main()
 	vec3 specular = specularTotal * Ks * specularTexColour;
 
 	// Combine each lighting type for the final fragment colour
-	gl_FragColor = vec4(ambient + diffuse + specular, 1);
+	FragColour = vec4(ambient + diffuse + specular, opacity);
 }
\ No newline at end of file
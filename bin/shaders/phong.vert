@@ -7,13 +7,22 @@
 /// vertex needed for normal mapping, and simply passes the texture
 /// coordinate across unmodified. The shader then also converts the 
 /// position attribute into clip-space and passes it to the fragment 
-/// shader using the gl_Position keyword variable for drawing.
+/// shader using the gl_Position keyword variable for drawing. The model
+/// transform is an instanced attribute, so every instance drawn in a
+/// batch reads its own transform from the scene's instance buffer.
+/// Packed meshes are unpacked to the same attributes before use.
 
 // Attributes enabled by the OBJ loader
 layout ( location = 0 ) in vec4 Position;
 layout ( location = 1 ) in vec4 Normal;
 layout ( location = 2 ) in vec2 TexCoord;
 layout ( location = 3 ) in vec4 Tangent;
+// Per-instance model transform (occupies locations 4 to 7)
+layout ( location = 4 ) in mat4 ModelTransform;
+// Dequantisation of the mesh's vertices, the same for every vertex of a chunk. The scale's w is 1 when the
+// vertices are packed (quantised positions and octahedral normals and tangents, see OBJMesh::PackedVertex)
+layout ( location = 8 ) in vec4 DequantiseScale;
+layout ( location = 9 ) in vec4 DequantiseOffset;
 
 out vec3 vWorldPosition;
 out vec3 vNormal;
@@ -21,21 +30,49 @@ out vec2 vTexCoord;
 out vec3 vTangent;
 out vec3 vBiTangent;
 
-uniform mat4 ProjectionViewTransform;
-uniform mat4 ModelTransform;
+// Per-frame camera and timing data, shared by every shader and uploaded once per frame by the scene
+layout (std140) uniform FrameData
+{
+	mat4 ProjectionViewTransform;
+	mat4 ViewTransform;
+	mat4 ProjectionTransform;
+	vec3 CameraPosition;
+	float Time;
+	vec2 ScreenSize;
+	mat4 InverseProjectionViewTransform;
+};
+
+// Unfolds an octahedral encoded unit vector
+vec3 octahedralDecode(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0)
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0 ? 1.0 : -1.0, v.y >= 0 ? 1.0 : -1.0);
+	return normalize(v);
+}
 
 void main()
 {
+	// Unpack the position, normal and tangent (the tangent's handedness is kept in the packed position's w)
+	vec4 position = vec4(DequantiseOffset.xyz + Position.xyz * DequantiseScale.xyz, 1);
+	vec3 normal = Normal.xyz;
+	vec4 tangent = Tangent;
+	if (DequantiseScale.w > 0)
+	{
+		normal = octahedralDecode(Normal.xy);
+		tangent = vec4(octahedralDecode(Tangent.xy), Position.w * 2.0 - 1.0);
+	}
+
 	// Transform the vertex's position, normal and tangent into world space for lighting in frag shader
-	vWorldPosition = (ModelTransform * Position).xyz;
-	vNormal = (ModelTransform * Normal).xyz;
-	vTangent = (ModelTransform * vec4(Tangent.xyz, 0)).xyz;
+	vWorldPosition = (ModelTransform * position).xyz;
+	vNormal = (ModelTransform * vec4(normal, 0)).xyz;
+	vTangent = (ModelTransform * vec4(tangent.xyz, 0)).xyz;
 	// Use the worldspace normal and tangent to construct the worldspace bi-tangent for this point (for normal mapping)
-	vBiTangent = cross(vNormal, vTangent) * Tangent.w;
+	vBiTangent = cross(vNormal, vTangent) * tangent.w;
 
 	// Simply pass the texture coordinate to the frag stage for interpolation without modifying it
 	vTexCoord = TexCoord;
 
 	// Get the vertex's position in screen space for pixel shading and pass to the frag stage
-	gl_Position = ProjectionViewTransform * ModelTransform * Position;
+	gl_Position = ProjectionViewTransform * ModelTransform * position;
 }
\ No newline at end of file
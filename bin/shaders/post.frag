@@ -19,7 +19,19 @@
 #define EDGEDETECT 5
 
 in vec2 vTexCoord;
-uniform float Time;
+
+// Per-frame camera and timing data, shared by every shader and uploaded once per frame by the scene
+layout (std140) uniform FrameData
+{
+	mat4 ProjectionViewTransform;
+	mat4 ViewTransform;
+	mat4 ProjectionTransform;
+	vec3 CameraPosition;
+	float Time;
+	vec2 ScreenSize;
+	mat4 InverseProjectionViewTransform;
+};
+
 uniform int selectedPostProcessor;
 uniform sampler2D renderTexture;
 
@@ -0,0 +1,9 @@
+#version 410
+
+/// shadow.frag is the fragment shader of the depth only shadow pass.
+/// The shadow cascades have no colour targets, so only the depth of
+/// each fragment is written, and nothing needs to be output here.
+
+void main()
+{
+}
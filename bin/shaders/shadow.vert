@@ -0,0 +1,23 @@
+#version 410
+
+/// shadow.vert is the depth only vertex shader used to draw the sun's
+/// shadow cascades. It takes the same position and instanced model
+/// transform attributes as the scene's other vertex shaders, so every
+/// mesh can be drawn with it, and transforms the position into the
+/// clip-space of the cascade currently being drawn, dequantising it
+/// first for packed meshes.
+
+layout (location = 0) in vec4 Position;
+layout (location = 4) in mat4 ModelTransform; // per-instance, occupies locations 4 to 7
+// Dequantisation of the mesh's positions, the same for every vertex of a chunk (see OBJMesh::PackedVertex)
+layout (location = 8) in vec4 DequantiseScale;
+layout (location = 9) in vec4 DequantiseOffset;
+
+// Orthographic projection and view of the shadow cascade being drawn, set by the scene per cascade
+uniform mat4 LightProjectionView;
+
+void main()
+{
+	vec4 position = vec4(DequantiseOffset.xyz + Position.xyz * DequantiseScale.xyz, 1);
+	gl_Position = LightProjectionView * ModelTransform * position;
+}
@@ -5,19 +5,47 @@
 /// and converts them both into world space to pass to the simple.frag
 /// shader. The shader then also converts the position attribute into
 /// clip-space and passes it to the fragment shader using the gl_Position
-/// keyword variable for drawing.
+/// keyword variable for drawing. The model transform is an instanced
+/// attribute read from the scene's instance buffer. Packed meshes are
+/// unpacked to the same attributes before use.
 
 layout (location = 0) in vec4 Position;
 layout (location = 1) in vec4 Normal;
+layout (location = 4) in mat4 ModelTransform; // per-instance, occupies locations 4 to 7
+// Dequantisation of the mesh's vertices, the same for every vertex of a chunk. The scale's w is 1 when the
+// vertices are packed (quantised positions and octahedral normals and tangents, see OBJMesh::PackedVertex)
+layout (location = 8) in vec4 DequantiseScale;
+layout (location = 9) in vec4 DequantiseOffset;
 out vec3 vWorldPosition;
 out vec3 vNormal;
 
-uniform mat4 ProjectionViewTransform;
-uniform mat4 ModelTransform;
+// Per-frame camera and timing data, shared by every shader and uploaded once per frame by the scene
+layout (std140) uniform FrameData
+{
+	mat4 ProjectionViewTransform;
+	mat4 ViewTransform;
+	mat4 ProjectionTransform;
+	vec3 CameraPosition;
+	float Time;
+	vec2 ScreenSize;
+	mat4 InverseProjectionViewTransform;
+};
+
+// Unfolds an octahedral encoded unit vector
+vec3 octahedralDecode(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0)
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0 ? 1.0 : -1.0, v.y >= 0 ? 1.0 : -1.0);
+	return normalize(v);
+}
 
 void main()
 {
-	vWorldPosition = (ModelTransform * Position).xyz;
-	vNormal = (ModelTransform * Normal).xyz;
-	gl_Position = ProjectionViewTransform * ModelTransform * Position;
+	vec4 position = vec4(DequantiseOffset.xyz + Position.xyz * DequantiseScale.xyz, 1);
+	vec3 normal = DequantiseScale.w > 0 ? octahedralDecode(Normal.xy) : Normal.xyz;
+
+	vWorldPosition = (ModelTransform * position).xyz;
+	vNormal = (ModelTransform * vec4(normal, 0)).xyz;
+	gl_Position = ProjectionViewTransform * ModelTransform * position;
 }
\ No newline at end of file
@@ -5,13 +5,20 @@
 #include <iostream>
 #include "Input.h"
 #include "imgui_glfw3.h"
+#include "GLState.h"
+#include "JobSystem.h"
 
 namespace aie {
 
 Application::Application()
 	: m_window(nullptr),
 	m_gameOver(false),
-	m_fps(0) {
+	m_fps(0),
+	m_updateMilliseconds(0),
+	m_framePackets(),
+	m_updatePacket(nullptr),
+	m_drawPacket(nullptr),
+	m_renderThread(false) {
 }
 
 Application::~Application() {
@@ -36,7 +43,11 @@ bool Application::createWindow(const char* title, int width, int height, bool fu
 		return false;
 	}
 
-	glfwSetWindowSizeCallback(m_window, [](GLFWwindow*, int w, int h){ glViewport(0, 0, w, h); });
+	// the context isn't current here while a render thread has it, which follows the size of the packets instead
+	glfwSetWindowSizeCallback(m_window, [](GLFWwindow* window, int w, int h){
+		if (glfwGetCurrentContext() == window)
+			glViewport(0, 0, w, h);
+	});
 
 	glClearColor(0, 0, 0, 1);
 
@@ -49,6 +60,9 @@ bool Application::createWindow(const char* title, int width, int height, bool fu
 	// start input manager
 	Input::create();
 
+	// start the job system's workers, one per core besides this one
+	JobSystem::create();
+
 	// imgui
 	ImGui_Init(m_window, true);
 	
@@ -58,6 +72,7 @@ bool Application::createWindow(const char* title, int width, int height, bool fu
 void Application::destroyWindow() {
 
 	ImGui_Shutdown();
+	JobSystem::destroy();
 	Input::destroy();
 
 	glfwDestroyWindow(m_window);
@@ -67,6 +82,8 @@ void Application::destroyWindow() {
 void Application::run(const char* title, int width, int height, bool fullscreen) {
 
 	// start game loop if successfully initialised
+	FrameArena::setCurrent(&m_updateArena);
+
 	if (createWindow(title,width,height, fullscreen) &&
 		startup()) {
 
@@ -77,9 +94,28 @@ void Application::run(const char* title, int width, int height, bool fullscreen)
 		unsigned int frames = 0;
 		double fpsInterval = 0;
 
+		for (auto& packet : m_framePackets) {
+			packet = createFramePacket();
+			m_freeQueue.push(packet);
+		}
+
+		// hand the context to the render thread, after imgui has made it's font texture, and
+		// have imgui leave it's draw lists to be captured rather than drawing them itself
+		ImGuiIO& io = ImGui::GetIO();
+		void (*renderDrawLists)(ImDrawData*) = io.RenderDrawListsFn;
+		if (m_renderThread) {
+			ImGui_CreateDeviceObjects();
+			io.RenderDrawListsFn = nullptr;
+			glfwMakeContextCurrent(nullptr);
+			m_renderer = std::thread(&Application::renderLoop, this);
+		}
+
 		// loop while game is running
 		while (!m_gameOver) {
 
+			// free everything allocated for the last frame
+			m_updateArena.reset();
+
 			// update delta time
 			currTime = glfwGetTime();
 			deltaTime = currTime - prevTime;
@@ -107,27 +143,123 @@ void Application::run(const char* title, int width, int height, bool fullscreen)
 				fpsInterval -= 1.0f;
 			}
 
+			// take a packet to fill, which with a render thread waits until it's done with one of them
+			while (m_freeQueue.pop(m_updatePacket) == false)
+				std::this_thread::yield();
+			m_updatePacket->windowWidth = getWindowWidth();
+			m_updatePacket->windowHeight = getWindowHeight();
+
+			// roll the gl state counters over, and forget any state left by last frame's imgui rendering
+			if (m_renderThread == false) {
+				GLState::beginFrame();
+				GLState::invalidate();
+			}
+
 			// clear imgui
 			ImGui_NewFrame();
 
+			double updateStart = glfwGetTime();
 			update(float(deltaTime));
+			m_updateMilliseconds = float((glfwGetTime() - updateStart) * 1000.0);
 
-			draw();
-
-			// draw IMGUI last
-			ImGui::Render();
+			if (m_renderThread) {
+				// finish the ui, and send the frame to the render thread to draw while the next one is updated
+				ImGui::Render();
+				ImGui_CaptureFrame(&m_updatePacket->imgui);
+				m_drawQueue.push(m_updatePacket);
+			}
+			else {
+				// run the opengl work jobs have handed back to the main thread
+				JobSystem::getInstance()->runMainThreadJobs();
 
-			//present backbuffer to the monitor
-			glfwSwapBuffers(m_window);
+				drawFrame(m_updatePacket);
+				m_freeQueue.push(m_updatePacket);
+			}
 
 			// should the game exit?
 			m_gameOver = m_gameOver || glfwWindowShouldClose(m_window) == GLFW_TRUE;
 		}
+
+		// let the render thread draw what it's been sent, then take the context back for shutdown
+		if (m_renderThread) {
+			while (m_drawQueue.push(nullptr) == false)
+				std::this_thread::yield();
+			m_renderer.join();
+			glfwMakeContextCurrent(m_window);
+			JobSystem::getInstance()->setMainThread();
+			io.RenderDrawListsFn = renderDrawLists;
+		}
 	}
 
+	for (auto& packet : m_framePackets) {
+		delete packet;
+		packet = nullptr;
+	}
+	m_updatePacket = m_drawPacket = nullptr;
+
 	// cleanup
 	shutdown();
 	destroyWindow();
+
+	FrameArena::setCurrent(nullptr);
+}
+
+void Application::renderLoop() {
+
+	glfwMakeContextCurrent(m_window);
+	JobSystem::getInstance()->setMainThread();
+	FrameArena::setCurrent(&m_renderArena);
+
+	unsigned int viewportWidth = 0, viewportHeight = 0;
+	while (true) {
+
+		FramePacket* packet = nullptr;
+		while (m_drawQueue.pop(packet) == false)
+			std::this_thread::yield();
+		if (packet == nullptr)
+			break;
+
+		// free everything allocated drawing the last frame
+		m_renderArena.reset();
+
+		if (packet->windowWidth != viewportWidth || packet->windowHeight != viewportHeight) {
+			viewportWidth = packet->windowWidth;
+			viewportHeight = packet->windowHeight;
+			glViewport(0, 0, viewportWidth, viewportHeight);
+		}
+
+		// roll the gl state counters over, and forget any state left by last frame's imgui rendering
+		GLState::beginFrame();
+		GLState::invalidate();
+
+		// run the opengl work jobs have handed back to the thread with the context
+		JobSystem::getInstance()->runMainThreadJobs();
+
+		drawFrame(packet);
+		m_freeQueue.push(packet);
+	}
+
+	FrameArena::setCurrent(nullptr);
+	glfwMakeContextCurrent(nullptr);
+}
+
+void Application::drawFrame(FramePacket* packet) {
+
+	double drawStart = glfwGetTime();
+	m_drawPacket = packet;
+	draw();
+
+	// draw IMGUI last
+	if (m_renderThread)
+		ImGui_RenderFrame(&packet->imgui);
+	else
+		ImGui::Render();
+	packet->drawMilliseconds = float((glfwGetTime() - drawStart) * 1000.0);
+	packet->drawArenaUsed = FrameArena::getCurrent()->getUsed();
+	packet->drawArenaHighWater = FrameArena::getCurrent()->getHighWater();
+
+	//present backbuffer to the monitor
+	glfwSwapBuffers(m_window);
 }
 
 bool Application::hasWindowClosed() {
@@ -1,10 +1,41 @@
 #pragma once
 
+#include "imgui_glfw3.h"
+#include "FrameArena.h"
+#include "SPSCQueue.h"
+#include <thread>
+
 // forward declared structure for access to GLFW window
 struct GLFWwindow;
 
 namespace aie {
 
+// everything update() hands to draw() for a frame. when the application renders on a render thread,
+// draw() runs a frame behind update(), so it must only read what update() left in the packet, as
+// update() is already changing everything else for the next frame. applications derive their own
+// packet with the rest of what their draw() reads (see Application::createFramePacket()). draw() may
+// write results back into the packet, which update() can read when the packet next comes round to it
+class FramePacket {
+public:
+
+	FramePacket() : windowWidth(0), windowHeight(0), drawMilliseconds(0), drawArenaUsed(0), drawArenaHighWater(0) {}
+	virtual ~FramePacket() {}
+
+	// the size of the window when the frame was updated
+	unsigned int		windowWidth;
+	unsigned int		windowHeight;
+
+	// the imgui draw lists built by update(), only captured while rendering on a render thread
+	ImGui_FrameDrawData	imgui;
+
+	// written back after drawing: how long draw() and the imgui draw lists took
+	float				drawMilliseconds;
+
+	// written back after drawing: how much of the drawing thread's frame arena the frame used, and the most any frame has
+	size_t				drawArenaUsed;
+	size_t				drawArenaHighWater;
+};
+
 // this is the pure-virtual base class that wraps up an application for us.
 // we derive our own applications from this class
 class Application {
@@ -24,6 +55,17 @@ public:
 	virtual void update(float deltaTime) = 0;
 	virtual void draw() = 0;
 
+	// runs draw() on a render thread that owns the opengl context, a frame behind update(), so a frame
+	// takes as long as the slower of the two rather than both. must be set before run(). update() must
+	// then leave the opengl context alone, and hand draw() everything it reads through frame packets
+	void setRenderThread(bool enabled) { m_renderThread = enabled; }
+	bool hasRenderThread() const { return m_renderThread; }
+
+	// the packet update() is filling this frame, and the packet draw() is drawing, which while rendering
+	// on a render thread is the one update() filled the frame before
+	FramePacket* getUpdatePacket() const { return m_updatePacket; }
+	FramePacket* getDrawPacket() const { return m_drawPacket; }
+
 	// wipes the screen clear to begin a frame of drawing
 	void clearScreen();
 
@@ -48,6 +90,13 @@ public:
 	// returns the frames-per-second that the loop is running at
 	unsigned int getFPS() const { return m_fps; }
 
+	// returns how long the last update() took
+	float getUpdateMilliseconds() const { return m_updateMilliseconds; }
+
+	// the frame arena of the update thread, reset at the start of every frame. the render thread has its
+	// own, reset before it draws each frame, whose use is written back into the packets
+	const FrameArena& getFrameArena() const { return m_updateArena; }
+
 	// returns the width / height of the game window
 	unsigned int getWindowWidth() const;
 	unsigned int getWindowHeight() const;
@@ -60,12 +109,36 @@ protected:
 	virtual bool createWindow(const char* title, int width, int height, bool fullscreen);
 	virtual void destroyWindow();
 
+	// creates one of the packets update() hands to draw(), derived applications return their own
+	virtual FramePacket* createFramePacket() { return new FramePacket(); }
+
+	void renderLoop();
+	void drawFrame(FramePacket* packet);
+
 	GLFWwindow*		m_window;
 
 	// if set to false, the main game loop will exit
 	bool			m_gameOver;
 	
 	unsigned int	m_fps;
+	float			m_updateMilliseconds;
+
+	// two packets, so update() can fill one while the render thread draws the other
+	static const unsigned int FRAME_PACKET_COUNT = 2;
+	FramePacket*	m_framePackets[FRAME_PACKET_COUNT];
+	FramePacket*	m_updatePacket;
+	FramePacket*	m_drawPacket;
+
+	// the render thread, and the packets passing to it to draw and back to be filled again. a null
+	// packet tells the render thread to stop
+	bool			m_renderThread;
+	std::thread		m_renderer;
+	SPSCQueue<FramePacket*, 4>	m_drawQueue;
+	SPSCQueue<FramePacket*, 4>	m_freeQueue;
+
+	// transient memory for a frame, current on the main thread and (while there is one) the render thread
+	FrameArena		m_updateArena;
+	FrameArena		m_renderArena;
 
 };
 
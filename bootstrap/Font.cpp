@@ -1,5 +1,6 @@
 #include "gl_core_4_4.h"
 #include "Font.h"
+#include "GLState.h"
 #include <stdio.h>
 
 #define STB_TRUETYPE_IMPLEMENTATION
@@ -51,7 +52,7 @@ Font::Font(const char* trueTypeFontFile, unsigned short fontHeight)
 		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
 
 		glGenTextures(1, &m_glHandle);
-		glBindTexture(GL_TEXTURE_2D, m_glHandle);
+		GLState::bindTexture(0, m_glHandle);
 
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, m_textureWidth, m_textureHeight, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
 
@@ -69,6 +70,7 @@ Font::Font(const char* trueTypeFontFile, unsigned short fontHeight)
 Font::~Font() {
 	delete[] (stbtt_bakedchar*)m_glyphData;
 
+	GLState::forgetTexture(m_glHandle);
 	glDeleteTextures(1, &m_glHandle);
 	glDeleteBuffers(1, &m_pixelBufferHandle);
 }
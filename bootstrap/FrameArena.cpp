@@ -0,0 +1,88 @@
+#include "FrameArena.h"
+#include <cstdint>
+
+namespace aie {
+
+thread_local FrameArena* FrameArena::t_current = nullptr;
+
+FrameArena::FrameArena(size_t blockSize)
+	: m_blockSize(blockSize),
+	m_top(nullptr),
+	m_end(nullptr),
+	m_used(0),
+	m_lastFrameUsed(0),
+	m_highWater(0),
+	m_heapAllocations(0),
+	m_resetCount(0) {
+}
+
+FrameArena::~FrameArena() {
+	for (auto& block : m_blocks)
+		delete[] block.memory;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+
+	// align the address itself, as blocks are only aligned for the largest built in type
+	uintptr_t top = (uintptr_t)m_top;
+	uintptr_t aligned = (top + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+
+	if (m_top == nullptr ||
+		aligned + size > (uintptr_t)m_end) {
+		// chain on a block at least double the last, so a frame that overflows only does so a few times
+		size_t blockSize = m_blocks.empty() ? m_blockSize : m_blocks.back().size * 2;
+		if (blockSize < size + alignment)
+			blockSize = size + alignment;
+		addBlock(blockSize);
+
+		top = (uintptr_t)m_top;
+		aligned = (top + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+	}
+
+	m_used += (aligned - top) + size;
+	m_top = (char*)(aligned + size);
+	return (void*)aligned;
+}
+
+void FrameArena::deallocate(void* memory, size_t size) {
+	if ((char*)memory + size == m_top) {
+		m_top = (char*)memory;
+		m_used -= size;
+	}
+}
+
+void FrameArena::reset() {
+
+	if (m_used > m_highWater)
+		m_highWater = m_used;
+	m_lastFrameUsed = m_used;
+	m_used = 0;
+	m_resetCount++;
+
+	// replace a chain of blocks with a single block as big as all of them, which the frame would have fit in
+	if (m_blocks.size() > 1) {
+		size_t size = getCapacity();
+		for (auto& block : m_blocks)
+			delete[] block.memory;
+		m_blocks.clear();
+		addBlock(size);
+	}
+	else if (m_blocks.empty() == false)
+		m_top = m_blocks.front().memory;
+}
+
+size_t FrameArena::getCapacity() const {
+	size_t capacity = 0;
+	for (auto& block : m_blocks)
+		capacity += block.size;
+	return capacity;
+}
+
+void FrameArena::addBlock(size_t size) {
+	m_blocks.push_back({ new char[size], size });
+	m_top = m_blocks.back().memory;
+	m_end = m_top + size;
+	m_heapAllocations++;
+}
+
+} // namespace aie
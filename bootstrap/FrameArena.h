@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace aie {
+
+// a linear allocator for data that only lives for a frame. allocations bump an offset through a block
+// of memory and are all freed at once by reset(), which the application calls at the start of each
+// frame (each thread that draws frames has its own arena, made current on that thread). when a frame
+// needs more than the arena holds it chains on another block, and the next reset() folds them into one
+// block big enough for the whole frame, so once the arena has seen the busiest frame it stops touching
+// the heap. nothing allocated from it may be used after it's reset
+class FrameArena {
+public:
+
+	// blockSize is the size of the first block, which isn't allocated until something is
+	FrameArena(size_t blockSize = 1024 * 1024);
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// returns size bytes aligned to alignment (a power of 2), valid until the next reset()
+	void*	allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	// uninitialised storage for count items of T
+	template <typename T>
+	T*		allocateArray(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+
+	// gives memory back early, which only reclaims it if it was the last allocation (as it is
+	// for temporaries freed in the reverse of the order they were made)
+	void	deallocate(void* memory, size_t size);
+
+	// frees everything allocated since the last reset, coalescing the blocks if the frame overflowed
+	void	reset();
+
+	// bytes allocated since the last reset, including alignment padding
+	size_t	getUsed() const { return m_used; }
+	// bytes allocated in the frame before the last reset
+	size_t	getLastFrameUsed() const { return m_lastFrameUsed; }
+	// the most bytes allocated in any one frame
+	size_t	getHighWater() const { return m_highWater > m_used ? m_highWater : m_used; }
+	// bytes held in blocks, allocated or not
+	size_t	getCapacity() const;
+	// the number of times the arena has allocated a block from the heap
+	unsigned int	getHeapAllocations() const { return m_heapAllocations; }
+	// the number of resets so far, telling apart memory handed out before and after one
+	unsigned int	getResetCount() const { return m_resetCount; }
+
+	// the arena of the calling thread's frame, or null on threads that don't have one
+	static FrameArena*	getCurrent() { return t_current; }
+	static void			setCurrent(FrameArena* arena) { t_current = arena; }
+
+private:
+
+	struct Block {
+		char*	memory;
+		size_t	size;
+	};
+
+	void	addBlock(size_t size);
+
+	std::vector<Block>	m_blocks;
+	size_t				m_blockSize;
+	char*				m_top;
+	char*				m_end;
+
+	size_t			m_used;
+	size_t			m_lastFrameUsed;
+	size_t			m_highWater;
+	unsigned int	m_heapAllocations;
+	unsigned int	m_resetCount;
+
+	static thread_local FrameArena* t_current;
+};
+
+// an stl allocator that takes memory from a frame arena, the calling thread's current one by default,
+// or from the heap if there isn't one (so containers using it still work on threads without a frame).
+// containers using it must be destroyed or emptied before the arena is reset. Alignment raises the
+// alignment of everything allocated above that of T, such as for simd loads
+template <typename T, size_t Alignment = alignof(T)>
+class FrameAllocator {
+public:
+
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind { typedef FrameAllocator<U, Alignment> other; };
+
+	FrameAllocator() : m_arena(FrameArena::getCurrent()) {}
+	explicit FrameAllocator(FrameArena* arena) : m_arena(arena) {}
+	template <typename U>
+	FrameAllocator(const FrameAllocator<U, Alignment>& other) : m_arena(other.getArena()) {}
+
+	T* allocate(size_t count) {
+		if (m_arena != nullptr)
+			return static_cast<T*>(m_arena->allocate(count * sizeof(T), alignment()));
+		return static_cast<T*>(::operator new(count * sizeof(T)));
+	}
+
+	void deallocate(T* memory, size_t count) {
+		if (m_arena != nullptr)
+			m_arena->deallocate(memory, count * sizeof(T));
+		else
+			::operator delete(memory);
+	}
+
+	FrameArena* getArena() const { return m_arena; }
+
+	static constexpr size_t alignment() { return Alignment > alignof(T) ? Alignment : alignof(T); }
+
+private:
+
+	FrameArena* m_arena;
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const FrameAllocator<T, Alignment>& a, const FrameAllocator<U, Alignment>& b) {
+	return a.getArena() == b.getArena();
+}
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const FrameAllocator<T, Alignment>& a, const FrameAllocator<U, Alignment>& b) {
+	return a.getArena() != b.getArena();
+}
+
+// a vector whose memory comes from the current frame arena
+template <typename T, size_t Alignment = alignof(T)>
+using FrameVector = std::vector<T, FrameAllocator<T, Alignment>>;
+
+} // namespace aie
@@ -0,0 +1,109 @@
+#include "GLState.h"
+#include "gl_core_4_4.h"
+
+namespace aie {
+
+unsigned int GLState::sm_program = UNKNOWN_BINDING;
+unsigned int GLState::sm_vao = UNKNOWN_BINDING;
+unsigned int GLState::sm_fbo = UNKNOWN_BINDING;
+unsigned int GLState::sm_activeUnit = UNKNOWN_BINDING;
+unsigned int GLState::sm_textures[GLState::MAX_TEXTURE_UNITS] = {
+	UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING,
+	UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING,
+	UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING,
+	UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING,
+	UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING,
+	UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING,
+	UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING,
+	UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING,
+};
+
+GLState::Counters GLState::sm_counters;
+GLState::Counters GLState::sm_lastFrame;
+
+void GLState::useProgram(unsigned int program) {
+	if (sm_program == program) {
+		sm_counters.skipped++;
+		return;
+	}
+	sm_program = program;
+	sm_counters.issued++;
+	glUseProgram(program);
+}
+
+void GLState::bindVertexArray(unsigned int vao) {
+	if (sm_vao == vao) {
+		sm_counters.skipped++;
+		return;
+	}
+	sm_vao = vao;
+	sm_counters.issued++;
+	glBindVertexArray(vao);
+}
+
+void GLState::bindFramebuffer(unsigned int fbo) {
+	if (sm_fbo == fbo) {
+		sm_counters.skipped++;
+		return;
+	}
+	sm_fbo = fbo;
+	sm_counters.issued++;
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+void GLState::bindTexture(unsigned int unit, unsigned int texture) {
+	if (unit < MAX_TEXTURE_UNITS) {
+		if (sm_textures[unit] == texture) {
+			sm_counters.skipped++;
+			return;
+		}
+		sm_textures[unit] = texture;
+	}
+
+	// the active unit is only switched when a bind actually needs it
+	if (sm_activeUnit != unit) {
+		sm_activeUnit = unit;
+		sm_counters.issued++;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	sm_counters.issued++;
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GLState::forgetProgram(unsigned int program) {
+	// a deleted program stays in use until something else is bound
+	if (sm_program == program)
+		sm_program = UNKNOWN_BINDING;
+}
+
+void GLState::forgetVertexArray(unsigned int vao) {
+	if (sm_vao == vao)
+		sm_vao = 0;
+}
+
+void GLState::forgetFramebuffer(unsigned int fbo) {
+	if (sm_fbo == fbo)
+		sm_fbo = 0;
+}
+
+void GLState::forgetTexture(unsigned int texture) {
+	for (auto& bound : sm_textures)
+		if (bound == texture)
+			bound = 0;
+}
+
+void GLState::invalidate() {
+	sm_program = UNKNOWN_BINDING;
+	sm_vao = UNKNOWN_BINDING;
+	sm_fbo = UNKNOWN_BINDING;
+	sm_activeUnit = UNKNOWN_BINDING;
+	for (auto& bound : sm_textures)
+		bound = UNKNOWN_BINDING;
+}
+
+void GLState::beginFrame() {
+	sm_lastFrame = sm_counters;
+	sm_counters = Counters();
+}
+
+} // namespace aie
@@ -0,0 +1,61 @@
+#pragma once
+
+namespace aie {
+
+// a shadow of the opengl binding state that filters out redundant binds.
+// all program, vertex array, framebuffer and 2D texture binds should go through
+// here so the shadow stays in sync; code that binds behind its back must call
+// invalidate() afterwards
+class GLState {
+public:
+
+	// number of texture units that are shadowed, binds to higher units are always issued
+	static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+	// calls issued to opengl versus calls skipped as redundant
+	struct Counters {
+		unsigned int issued = 0;
+		unsigned int skipped = 0;
+	};
+
+	static void useProgram(unsigned int program);
+	static void bindVertexArray(unsigned int vao);
+	static void bindFramebuffer(unsigned int fbo);
+	static void bindTexture(unsigned int unit, unsigned int texture);
+
+	// shadowed binding that no real object can have, so the next bind is always issued
+	static const unsigned int UNKNOWN_BINDING = ~0u;
+
+	// currently shadowed program (or UNKNOWN_BINDING), for code that needs to restore it
+	static unsigned int getProgram() { return sm_program; }
+
+	// must be called when a bound object is deleted, as opengl falls back to
+	// binding 0 (and may hand the name out again)
+	static void forgetProgram(unsigned int program);
+	static void forgetVertexArray(unsigned int vao);
+	static void forgetFramebuffer(unsigned int fbo);
+	static void forgetTexture(unsigned int texture);
+
+	// forget all shadowed state so the next bind of everything is issued
+	static void invalidate();
+
+	// rolls the counters over to a new frame (called by the Application each frame)
+	static void beginFrame();
+
+	// counters for the previous full frame, and the frame in progress
+	static const Counters& getLastFrameCounters() { return sm_lastFrame; }
+	static const Counters& getCounters() { return sm_counters; }
+
+private:
+
+	static unsigned int	sm_program;
+	static unsigned int	sm_vao;
+	static unsigned int	sm_fbo;
+	static unsigned int	sm_activeUnit;
+	static unsigned int	sm_textures[MAX_TEXTURE_UNITS];
+
+	static Counters		sm_counters;
+	static Counters		sm_lastFrame;
+};
+
+} // namespace aie
@@ -1,7 +1,9 @@
 #include "Gizmos.h"
 #include "gl_core_4_4.h"
+#include "GLState.h"
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
+#include <cstring>
 #include <iostream>
 
 namespace aie {
@@ -10,20 +12,28 @@ Gizmos* Gizmos::sm_singleton = nullptr;
 
 Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
 			   unsigned int max2DLines, unsigned int max2DTris)
-	: m_maxLines(maxLines),
+	: m_arena(nullptr),
+	m_arenaResets(0),
+	m_ownArena(64 * 1024),
+	m_maxLines(maxLines),
 	m_lineCount(0),
-	m_lines(new GizmoLine[maxLines]),
+	m_lineCapacity(0),
+	m_lines(nullptr),
 	m_maxTris(maxTris),
 	m_triCount(0),
-	m_tris(new GizmoTri[maxTris]),
+	m_triCapacity(0),
+	m_tris(nullptr),
 	m_transparentTriCount(0),
-	m_transparentTris(new GizmoTri[maxTris]),
+	m_transparentTriCapacity(0),
+	m_transparentTris(nullptr),
 	m_max2DLines(max2DLines),
 	m_2DlineCount(0),
-	m_2Dlines(new GizmoLine[max2DLines]),
+	m_2DlineCapacity(0),
+	m_2Dlines(nullptr),
 	m_max2DTris(max2DTris),
 	m_2DtriCount(0),
-	m_2Dtris(new GizmoTri[max2DTris]) {
+	m_2DtriCapacity(0),
+	m_2Dtris(nullptr) {
 
 	// create shaders
 	const char* vsSource = "#version 150\n \
@@ -92,7 +102,7 @@ Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
 	glBufferData(GL_ARRAY_BUFFER, m_max2DTris * sizeof(GizmoTri), m_2Dtris, GL_DYNAMIC_DRAW);
 
 	glGenVertexArrays(1, &m_lineVAO);
-	glBindVertexArray(m_lineVAO);
+	GLState::bindVertexArray(m_lineVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
@@ -100,7 +110,7 @@ Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
 	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
 
 	glGenVertexArrays(1, &m_triVAO);
-	glBindVertexArray(m_triVAO);
+	GLState::bindVertexArray(m_triVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, m_triVBO);
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
@@ -108,7 +118,7 @@ Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
 	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
 
 	glGenVertexArrays(1, &m_transparentTriVAO);
-	glBindVertexArray(m_transparentTriVAO);
+	GLState::bindVertexArray(m_transparentTriVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, m_transparentTriVBO);
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
@@ -116,7 +126,7 @@ Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
 	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
 
 	glGenVertexArrays(1, &m_2DlineVAO);
-	glBindVertexArray(m_2DlineVAO);
+	GLState::bindVertexArray(m_2DlineVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, m_2DlineVBO);
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
@@ -124,33 +134,34 @@ Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
 	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
 
 	glGenVertexArrays(1, &m_2DtriVAO);
-	glBindVertexArray(m_2DtriVAO);
+	GLState::bindVertexArray(m_2DtriVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, m_2DtriVBO);
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
 	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
 
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 Gizmos::~Gizmos() {
-	delete[] m_lines;
-	delete[] m_tris;
-	delete[] m_transparentTris;
 	glDeleteBuffers( 1, &m_lineVBO );
 	glDeleteBuffers( 1, &m_triVBO );
 	glDeleteBuffers( 1, &m_transparentTriVBO );
+	GLState::forgetVertexArray(m_lineVAO);
+	GLState::forgetVertexArray(m_triVAO);
+	GLState::forgetVertexArray(m_transparentTriVAO);
+	GLState::forgetVertexArray(m_2DlineVAO);
+	GLState::forgetVertexArray(m_2DtriVAO);
 	glDeleteVertexArrays( 1, &m_lineVAO );
 	glDeleteVertexArrays( 1, &m_triVAO );
 	glDeleteVertexArrays( 1, &m_transparentTriVAO );
-	delete[] m_2Dlines;
-	delete[] m_2Dtris;
 	glDeleteBuffers( 1, &m_2DlineVBO );
 	glDeleteBuffers( 1, &m_2DtriVBO );
 	glDeleteVertexArrays( 1, &m_2DlineVAO );
 	glDeleteVertexArrays( 1, &m_2DtriVAO );
+	GLState::forgetProgram(m_shader);
 	glDeleteProgram(m_shader);
 }
 
@@ -171,6 +182,51 @@ void Gizmos::clear() {
 	sm_singleton->m_transparentTriCount = 0;
 	sm_singleton->m_2DlineCount = 0;
 	sm_singleton->m_2DtriCount = 0;
+
+	// an arena of their own is only reset here, as the application doesn't know about it
+	if (sm_singleton->m_arena == &sm_singleton->m_ownArena)
+		sm_singleton->m_ownArena.reset();
+}
+
+FrameArena* Gizmos::frameArena() {
+	FrameArena* arena = FrameArena::getCurrent();
+	if (arena == nullptr)
+		arena = &m_ownArena;
+
+	// arrays from before the arena was reset are gone, along with the gizmos in them
+	if (arena != m_arena ||
+		arena->getResetCount() != m_arenaResets) {
+		m_arena = arena;
+		m_arenaResets = arena->getResetCount();
+		m_lineCount = m_lineCapacity = 0;
+		m_triCount = m_triCapacity = 0;
+		m_transparentTriCount = m_transparentTriCapacity = 0;
+		m_2DlineCount = m_2DlineCapacity = 0;
+		m_2DtriCount = m_2DtriCapacity = 0;
+		m_lines = m_2Dlines = nullptr;
+		m_tris = m_transparentTris = m_2Dtris = nullptr;
+	}
+	return arena;
+}
+
+template <typename T>
+bool Gizmos::reserve(T*& items, unsigned int& count, unsigned int& capacity, unsigned int max) {
+	FrameArena* arena = frameArena();
+	if (count < capacity)
+		return true;
+	if (capacity >= max)
+		return false;
+
+	// the old array is left in the arena, which doubling keeps to less than the new one
+	unsigned int newCapacity = capacity == 0 ? 256 : capacity * 2;
+	if (newCapacity > max)
+		newCapacity = max;
+	T* newItems = arena->allocateArray<T>(newCapacity);
+	if (count > 0)
+		memcpy(newItems, items, count * sizeof(T));
+	items = newItems;
+	capacity = newCapacity;
+	return true;
 }
 
 // Adds 3 unit-length lines (red,green,blue) representing the 3 axis of a transform, 
@@ -536,7 +592,7 @@ void Gizmos::addSphere(const glm::vec3& center, float radius, int rows, int colu
 	float longitudinalRange = (longMax - longMin) * DEG2RAD;
 
 	// for each row of the mesh
-	glm::vec3* v4Array = new glm::vec3[rows*columns + columns];
+	FrameVector<glm::vec3> v4Array(rows*columns + columns);
 
 	for (int row = 0; row <= rows; ++row) {
 		// y ordinates this may be a little confusing but here we are navigating around the xAxis in GL
@@ -570,8 +626,6 @@ void Gizmos::addSphere(const glm::vec3& center, float radius, int rows, int colu
 		addTri(tempCenter + v4Array[iNextFace+columns], tempCenter + v4Array[face], tempCenter + v4Array[iNextFace], fillColour);
 		addTri(tempCenter + v4Array[iNextFace+columns], tempCenter + v4Array[face+columns], tempCenter + v4Array[face], fillColour);
 	}
-
-	delete[] v4Array;	
 }
 
 void Gizmos::addCapsule(const glm::vec3& center, float height, float radius,
@@ -604,7 +658,7 @@ void Gizmos::addCapsule(const glm::vec3& center, float height, float radius,
 	float longitudinalRange = (longMax - longMin) * DEG2RAD;
 
 	// for each row of the mesh
-	glm::vec3* v4Array = new glm::vec3[rows*cols + cols];
+	FrameVector<glm::vec3> v4Array(rows*cols + cols);
 
 	for (int row = 0; row <= (rows); ++row) {
 		// y ordinates this may be a little confusing but here we are navigating around the xAxis in GL
@@ -650,8 +704,6 @@ void Gizmos::addCapsule(const glm::vec3& center, float height, float radius,
 		addTri(tempCenter + v4Array[iNextFace + cols], tempCenter + v4Array[face + cols], tempCenter + v4Array[face], fillColour);
 	}
 
-	delete[] v4Array;
-
 	for (int i = 0; i < cols; ++i) {
 		float x = (float)i / (float)cols;
 		float x1 = (float)(i+1) / (float)cols;
@@ -705,7 +757,7 @@ void Gizmos::addLine(const glm::vec3& v0,  const glm::vec3& v1, const glm::vec4&
 void Gizmos::addLine(const glm::vec3& v0, const glm::vec3& v1, const glm::vec4& colour0, const glm::vec4& colour1) {
 
 	if (sm_singleton != nullptr &&
-		sm_singleton->m_lineCount < sm_singleton->m_maxLines) {
+		sm_singleton->reserve(sm_singleton->m_lines, sm_singleton->m_lineCount, sm_singleton->m_lineCapacity, sm_singleton->m_maxLines)) {
 		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.x = v0.x;
 		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.y = v0.y;
 		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.z = v0.z;
@@ -731,7 +783,7 @@ void Gizmos::addLine(const glm::vec3& v0, const glm::vec3& v1, const glm::vec4&
 void Gizmos::addTri(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const glm::vec4& colour) {
 	if (sm_singleton != nullptr) {
 		if (colour.w == 1) {
-			if (sm_singleton->m_triCount < sm_singleton->m_maxTris) {
+			if (sm_singleton->reserve(sm_singleton->m_tris, sm_singleton->m_triCount, sm_singleton->m_triCapacity, sm_singleton->m_maxTris)) {
 				sm_singleton->m_tris[sm_singleton->m_triCount].v0.x = v0.x;
 				sm_singleton->m_tris[sm_singleton->m_triCount].v0.y = v0.y;
 				sm_singleton->m_tris[sm_singleton->m_triCount].v0.z = v0.z;
@@ -762,7 +814,7 @@ void Gizmos::addTri(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v
 			}
 		}
 		else {
-			if (sm_singleton->m_transparentTriCount < sm_singleton->m_maxTris) {
+			if (sm_singleton->reserve(sm_singleton->m_transparentTris, sm_singleton->m_transparentTriCount, sm_singleton->m_transparentTriCapacity, sm_singleton->m_maxTris)) {
 				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.x = v0.x;
 				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.y = v0.y;
 				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.z = v0.z;
@@ -867,7 +919,7 @@ void Gizmos::add2DLine(const glm::vec2& rv0,  const glm::vec2& rv1, const glm::v
 
 void Gizmos::add2DLine(const glm::vec2& rv0, const glm::vec2& rv1, const glm::vec4& colour0, const glm::vec4& colour1) {
 	if (sm_singleton != nullptr &&
-		sm_singleton->m_2DlineCount < sm_singleton->m_max2DLines) {
+		sm_singleton->reserve(sm_singleton->m_2Dlines, sm_singleton->m_2DlineCount, sm_singleton->m_2DlineCapacity, sm_singleton->m_max2DLines)) {
 		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.x = rv0.x;
 		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.y = rv0.y;
 		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.z = 1;
@@ -895,7 +947,7 @@ void Gizmos::add2DTri(const glm::vec2& rv0, const glm::vec2& rv1, const glm::vec
 
 void Gizmos::add2DTri(const glm::vec2& rv0, const glm::vec2& rv1, const glm::vec2& rv2, const glm::vec4& colour0, const glm::vec4& colour1, const glm::vec4& colour2) {
 	if (sm_singleton != nullptr) {
-		if (sm_singleton->m_2DtriCount < sm_singleton->m_max2DTris) {
+		if (sm_singleton->reserve(sm_singleton->m_2Dtris, sm_singleton->m_2DtriCount, sm_singleton->m_2DtriCapacity, sm_singleton->m_max2DTris)) {
 			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.x = rv0.x;
 			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.y = rv0.y;
 			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.z = 1;
@@ -931,35 +983,88 @@ void Gizmos::draw(const glm::mat4& projection, const glm::mat4& view) {
 }
 
 void Gizmos::draw(const glm::mat4& projectionView) {
-	if ( sm_singleton != nullptr && 
-		(sm_singleton->m_lineCount > 0 || 
-		 sm_singleton->m_triCount > 0 || 
-		 sm_singleton->m_transparentTriCount > 0)) {
-		int shader = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &shader);
-
-		glUseProgram(sm_singleton->m_shader);
+	if (sm_singleton == nullptr)
+		return;
+
+	sm_singleton->frameArena();
+	drawBuffers(projectionView,
+				sm_singleton->m_lines, sm_singleton->m_lineCount,
+				sm_singleton->m_tris, sm_singleton->m_triCount,
+				sm_singleton->m_transparentTris, sm_singleton->m_transparentTriCount);
+}
+
+void Gizmos::draw2D(float screenWidth, float screenHeight) {
+	draw2D(glm::ortho(0.f, screenWidth, 0.f, screenHeight));
+}
+
+void Gizmos::draw2D(const glm::mat4& projection) {
+	if (sm_singleton == nullptr)
+		return;
+
+	sm_singleton->frameArena();
+	drawBuffers2D(projection,
+				  sm_singleton->m_2Dlines, sm_singleton->m_2DlineCount,
+				  sm_singleton->m_2Dtris, sm_singleton->m_2DtriCount);
+}
+
+void Gizmos::capture(Frame& frame) {
+	if (sm_singleton == nullptr)
+		return;
+
+	sm_singleton->frameArena();
+	frame.lines.assign(sm_singleton->m_lines, sm_singleton->m_lines + sm_singleton->m_lineCount);
+	frame.tris.assign(sm_singleton->m_tris, sm_singleton->m_tris + sm_singleton->m_triCount);
+	frame.transparentTris.assign(sm_singleton->m_transparentTris, sm_singleton->m_transparentTris + sm_singleton->m_transparentTriCount);
+	frame.lines2D.assign(sm_singleton->m_2Dlines, sm_singleton->m_2Dlines + sm_singleton->m_2DlineCount);
+	frame.tris2D.assign(sm_singleton->m_2Dtris, sm_singleton->m_2Dtris + sm_singleton->m_2DtriCount);
+}
+
+void Gizmos::draw(const Frame& frame, const glm::mat4& projectionView) {
+	if (sm_singleton != nullptr)
+		drawBuffers(projectionView,
+					frame.lines.data(), (unsigned int)frame.lines.size(),
+					frame.tris.data(), (unsigned int)frame.tris.size(),
+					frame.transparentTris.data(), (unsigned int)frame.transparentTris.size());
+}
+
+void Gizmos::draw2D(const Frame& frame, const glm::mat4& projection) {
+	if (sm_singleton != nullptr)
+		drawBuffers2D(projection,
+					  frame.lines2D.data(), (unsigned int)frame.lines2D.size(),
+					  frame.tris2D.data(), (unsigned int)frame.tris2D.size());
+}
+
+void Gizmos::drawBuffers(const glm::mat4& projectionView,
+						 const GizmoLine* lines, unsigned int lineCount,
+						 const GizmoTri* tris, unsigned int triCount,
+						 const GizmoTri* transparentTris, unsigned int transparentTriCount) {
+	if (lineCount > 0 || 
+		triCount > 0 || 
+		transparentTriCount > 0) {
+		unsigned int shader = GLState::getProgram();
+
+		GLState::useProgram(sm_singleton->m_shader);
 		
 		unsigned int projectionViewUniform = glGetUniformLocation(sm_singleton->m_shader,"ProjectionView");
 		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(projectionView));
 
-		if (sm_singleton->m_lineCount > 0) {
+		if (lineCount > 0) {
 			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_lineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_lineCount * sizeof(GizmoLine), sm_singleton->m_lines);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, lineCount * sizeof(GizmoLine), lines);
 
-			glBindVertexArray(sm_singleton->m_lineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_lineCount * 2);
+			GLState::bindVertexArray(sm_singleton->m_lineVAO);
+			glDrawArrays(GL_LINES, 0, lineCount * 2);
 		}
 
-		if (sm_singleton->m_triCount > 0) {
+		if (triCount > 0) {
 			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_triVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_triCount * sizeof(GizmoTri), sm_singleton->m_tris);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, triCount * sizeof(GizmoTri), tris);
 
-			glBindVertexArray(sm_singleton->m_triVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_triCount * 3);
+			GLState::bindVertexArray(sm_singleton->m_triVAO);
+			glDrawArrays(GL_TRIANGLES, 0, triCount * 3);
 		}
 		
-		if (sm_singleton->m_transparentTriCount > 0) {
+		if (transparentTriCount > 0) {
 			// not ideal to store these, but Gizmos must work stand-alone
 			GLboolean blendEnabled = glIsEnabled(GL_BLEND);
 			GLboolean depthMask = GL_TRUE;
@@ -976,10 +1081,10 @@ void Gizmos::draw(const glm::mat4& projectionView) {
 			glDepthMask(GL_FALSE);
 
 			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_transparentTriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_transparentTriCount * sizeof(GizmoTri), sm_singleton->m_transparentTris);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, transparentTriCount * sizeof(GizmoTri), transparentTris);
 
-			glBindVertexArray(sm_singleton->m_transparentTriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_transparentTriCount * 3);
+			GLState::bindVertexArray(sm_singleton->m_transparentTriVAO);
+			glDrawArrays(GL_TRIANGLES, 0, transparentTriCount * 3);
 
 			// reset state
 			glDepthMask(depthMask);
@@ -988,35 +1093,32 @@ void Gizmos::draw(const glm::mat4& projectionView) {
 				glDisable(GL_BLEND);
 		}
 
-		glUseProgram(shader);
+		if (shader != GLState::UNKNOWN_BINDING)
+			GLState::useProgram(shader);
 	}
 }
 
-void Gizmos::draw2D(float screenWidth, float screenHeight) {
-	draw2D(glm::ortho(0.f, screenWidth, 0.f, screenHeight));
-}
-
-void Gizmos::draw2D(const glm::mat4& projection) {
-	if ( sm_singleton != nullptr && 
-		(sm_singleton->m_2DlineCount > 0 || 
-		 sm_singleton->m_2DtriCount > 0)) {
-		int shader = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &shader);
+void Gizmos::drawBuffers2D(const glm::mat4& projection,
+						   const GizmoLine* lines, unsigned int lineCount,
+						   const GizmoTri* tris, unsigned int triCount) {
+	if (lineCount > 0 || 
+		triCount > 0) {
+		unsigned int shader = GLState::getProgram();
 
-		glUseProgram(sm_singleton->m_shader);
+		GLState::useProgram(sm_singleton->m_shader);
 		
 		unsigned int projectionViewUniform = glGetUniformLocation(sm_singleton->m_shader,"ProjectionView");
 		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(projection));
 
-		if (sm_singleton->m_2DlineCount > 0) {
+		if (lineCount > 0) {
 			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DlineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DlineCount * sizeof(GizmoLine), sm_singleton->m_2Dlines);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, lineCount * sizeof(GizmoLine), lines);
 
-			glBindVertexArray(sm_singleton->m_2DlineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_2DlineCount * 2);
+			GLState::bindVertexArray(sm_singleton->m_2DlineVAO);
+			glDrawArrays(GL_LINES, 0, lineCount * 2);
 		}
 
-		if (sm_singleton->m_2DtriCount > 0) {
+		if (triCount > 0) {
 			GLboolean blendEnabled = glIsEnabled(GL_BLEND);
 
 			GLboolean depthMask = GL_TRUE;
@@ -1034,10 +1136,10 @@ void Gizmos::draw2D(const glm::mat4& projection) {
 			glDepthMask(GL_FALSE);
 
 			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DtriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DtriCount * sizeof(GizmoTri), sm_singleton->m_2Dtris);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, triCount * sizeof(GizmoTri), tris);
 
-			glBindVertexArray(sm_singleton->m_2DtriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_2DtriCount * 3);
+			GLState::bindVertexArray(sm_singleton->m_2DtriVAO);
+			glDrawArrays(GL_TRIANGLES, 0, triCount * 3);
 
 			glDepthMask(depthMask);
 
@@ -1047,7 +1149,8 @@ void Gizmos::draw2D(const glm::mat4& projection) {
 				glDisable(GL_BLEND);
 		}
 
-		glUseProgram(shader);
+		if (shader != GLState::UNKNOWN_BINDING)
+			GLState::useProgram(shader);
 	}
 }
 
@@ -1,13 +1,44 @@
 #pragma once
 
 #include <glm/fwd.hpp>
+#include <vector>
+#include "FrameArena.h"
 
 namespace aie {
 
-// a singleton class for rendering immediate-mode 3-D primitives
+// a singleton class for rendering immediate-mode 3-D primitives. the primitives are kept in arrays
+// taken from the calling thread's frame arena, which grow as they're added (up to the maximums given
+// to create(), the size of the vertex buffers), so they only last until the arena is next reset.
+// without a frame arena they're kept in an arena of the gizmos' own, reset by clear()
 class Gizmos {
 public:
 
+	struct GizmoVertex {
+		float x, y, z, w;
+		float r, g, b, a;
+	};
+
+	struct GizmoLine {
+		GizmoVertex v0;
+		GizmoVertex v1;
+	};
+
+	struct GizmoTri {
+		GizmoVertex v0;
+		GizmoVertex v1;
+		GizmoVertex v2;
+	};
+
+	// a copy of the gizmos added for a frame, which can still be drawn after they've been
+	// cleared for the next frame (by the thread with the opengl context, while another adds them)
+	struct Frame {
+		std::vector<GizmoLine>	lines;
+		std::vector<GizmoTri>	tris;
+		std::vector<GizmoTri>	transparentTris;
+		std::vector<GizmoLine>	lines2D;
+		std::vector<GizmoTri>	tris2D;
+	};
+
 	static void		create(unsigned int maxLines, unsigned int maxTris,
 						   unsigned int max2DLines, unsigned int max2DTris);
 	static void		destroy();
@@ -23,6 +54,13 @@ public:
 	static void		draw2D(const glm::mat4& projection);
 	static void		draw2D(float screenWidth, float screenHeight);
 
+	// copies the current Gizmo buffers into frame, reusing it's storage
+	static void		capture(Frame& frame);
+
+	// draws Gizmo buffers copied earlier instead of the current ones
+	static void		draw(const Frame& frame, const glm::mat4& projectionView);
+	static void		draw2D(const Frame& frame, const glm::mat4& projection);
+
 	// adds a single debug line
 	static void		addLine(const glm::vec3& v0, const glm::vec3& v1, const glm::vec4& colour);
 
@@ -97,27 +135,34 @@ private:
 		   unsigned int max2DLines, unsigned int max2DTris);
 	~Gizmos();
 
-	struct GizmoVertex {
-		float x, y, z, w;
-		float r, g, b, a;
-	};
+	// uploads and draws the given primitives through the singleton's buffers
+	static void		drawBuffers(const glm::mat4& projectionView,
+								const GizmoLine* lines, unsigned int lineCount,
+								const GizmoTri* tris, unsigned int triCount,
+								const GizmoTri* transparentTris, unsigned int transparentTriCount);
+	static void		drawBuffers2D(const glm::mat4& projection,
+								  const GizmoLine* lines, unsigned int lineCount,
+								  const GizmoTri* tris, unsigned int triCount);
 
-	struct GizmoLine {
-		GizmoVertex v0;
-		GizmoVertex v1;
-	};
+	// the arena the arrays are taken from, forgetting any taken before it was last reset
+	FrameArena*		frameArena();
 
-	struct GizmoTri {
-		GizmoVertex v0;
-		GizmoVertex v1;
-		GizmoVertex v2;
-	};
+	// makes room in an array for another primitive, taking an array twice the size from the arena
+	// when it's full, and returns false once it holds max primitives
+	template <typename T>
+	bool			reserve(T*& items, unsigned int& count, unsigned int& capacity, unsigned int max);
 
 	unsigned int	m_shader;
 
+	// the arena the arrays were taken from, and how many times it had been reset when they were
+	FrameArena*		m_arena;
+	unsigned int	m_arenaResets;
+	FrameArena		m_ownArena;
+
 	// line data
 	unsigned int	m_maxLines;
 	unsigned int	m_lineCount;
+	unsigned int	m_lineCapacity;
 	GizmoLine*		m_lines;
 
 	unsigned int	m_lineVAO;
@@ -126,12 +171,14 @@ private:
 	// triangle data
 	unsigned int	m_maxTris;
 	unsigned int	m_triCount;
+	unsigned int	m_triCapacity;
 	GizmoTri*		m_tris;
 
 	unsigned int	m_triVAO;
 	unsigned int 	m_triVBO;
 	
 	unsigned int	m_transparentTriCount;
+	unsigned int	m_transparentTriCapacity;
 	GizmoTri*		m_transparentTris;
 
 	unsigned int	m_transparentTriVAO;
@@ -140,6 +187,7 @@ private:
 	// 2D line data
 	unsigned int	m_max2DLines;
 	unsigned int	m_2DlineCount;
+	unsigned int	m_2DlineCapacity;
 	GizmoLine*		m_2Dlines;
 
 	unsigned int	m_2DlineVAO;
@@ -148,6 +196,7 @@ private:
 	// 2D triangle data
 	unsigned int	m_max2DTris;
 	unsigned int	m_2DtriCount;
+	unsigned int	m_2DtriCapacity;
 	GizmoTri*		m_2Dtris;
 
 	unsigned int	m_2DtriVAO;
@@ -0,0 +1,202 @@
+#include "JobSystem.h"
+
+namespace aie {
+
+JobSystem* JobSystem::m_instance = nullptr;
+
+// the job system a thread is a worker of, and which worker it is
+static thread_local JobSystem* t_system = nullptr;
+static thread_local unsigned int t_workerIndex = 0;
+
+JobSystem::JobSystem(unsigned int workerCount)
+	: m_activeWorkers(0),
+	m_mainThread(std::this_thread::get_id()),
+	m_queued(0),
+	m_stopping(false) {
+
+	if (workerCount == 0)
+		workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	// every worker's deque exists before any worker can try stealing from it
+	for (unsigned int i = 0; i < workerCount; ++i)
+		m_workers.emplace_back(new Worker());
+	m_activeWorkers = workerCount;
+	for (unsigned int i = 0; i < workerCount; ++i)
+		m_workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers)
+		worker->thread.join();
+}
+
+void JobSystem::run(Job job, Counter* counter, Counter* dependency) {
+
+	if (counter != nullptr)
+		counter->m_count++;
+
+	// the dependency's last job queues this one as it finishes, unless it's already done
+	if (dependency != nullptr) {
+		std::lock_guard<std::mutex> lock(dependency->m_mutex);
+		if (dependency->m_count.load() != 0) {
+			dependency->m_dependents.emplace_back(std::move(job), counter);
+			return;
+		}
+	}
+	push(QueuedJob(std::move(job), counter));
+}
+
+void JobSystem::runOnMainThread(Job job, Counter* counter) {
+
+	if (counter != nullptr)
+		counter->m_count++;
+
+	std::lock_guard<std::mutex> lock(m_mainMutex);
+	m_mainJobs.emplace_back(std::move(job), counter);
+}
+
+void JobSystem::wait(Counter& counter) {
+	while (counter.isDone() == false) {
+		if (runNextJob() == false)
+			std::this_thread::yield();
+	}
+
+	// the job that finished the counter may still hold it's lock
+	std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::runMainThreadJobs() {
+	if (std::this_thread::get_id() != m_mainThread.load())
+		return;
+
+	while (true) {
+		QueuedJob job;
+		{
+			std::lock_guard<std::mutex> lock(m_mainMutex);
+			if (m_mainJobs.empty())
+				return;
+			job = std::move(m_mainJobs.front());
+			m_mainJobs.pop_front();
+		}
+		job.first();
+		finish(job.second);
+	}
+}
+
+void JobSystem::setThreadCount(unsigned int threadCount) {
+	threadCount = std::max(1u, std::min(threadCount, getMaxThreadCount()));
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_activeWorkers = threadCount - 1;
+	}
+	m_wake.notify_all();
+}
+
+void JobSystem::workerLoop(unsigned int index) {
+
+	t_system = this;
+	t_workerIndex = index;
+
+	while (true) {
+
+		// parked workers don't take jobs, but their deques can still be stolen from
+		if (index < m_activeWorkers.load() && runNextJob())
+			continue;
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wake.wait(lock, [this, index]() { return m_stopping || (m_queued.load() != 0 && index < m_activeWorkers.load()); });
+		if (m_stopping)
+			return;
+	}
+}
+
+void JobSystem::push(QueuedJob job) {
+
+	// jobs spawned by a worker go on the back of its own deque, and everyone else's on the shared queue
+	if (t_system == this) {
+		Worker& worker = *m_workers[t_workerIndex];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.jobs.push_back(std::move(job));
+	}
+	else {
+		std::lock_guard<std::mutex> lock(m_injectedMutex);
+		m_injected.push_back(std::move(job));
+	}
+
+	// counted and signalled under the sleep lock, so a worker can't miss it between checking and sleeping
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_queued++;
+	}
+	m_wake.notify_one();
+}
+
+bool JobSystem::runNextJob() {
+
+	QueuedJob job;
+	bool found = false;
+
+	// newest job of this worker's own, then the oldest submitted from outside, then the oldest of another worker's
+	bool isWorker = t_system == this;
+	if (isWorker) {
+		Worker& worker = *m_workers[t_workerIndex];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (worker.jobs.empty() == false) {
+			job = std::move(worker.jobs.back());
+			worker.jobs.pop_back();
+			found = true;
+		}
+	}
+	if (found == false) {
+		std::lock_guard<std::mutex> lock(m_injectedMutex);
+		if (m_injected.empty() == false) {
+			job = std::move(m_injected.front());
+			m_injected.pop_front();
+			found = true;
+		}
+	}
+	unsigned int workerCount = (unsigned int)m_workers.size();
+	unsigned int start = isWorker ? t_workerIndex + 1 : 0;
+	for (unsigned int i = 0; i < workerCount && found == false; ++i) {
+		Worker& victim = *m_workers[(start + i) % workerCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.jobs.empty() == false) {
+			job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			found = true;
+		}
+	}
+	if (found == false)
+		return false;
+
+	m_queued--;
+	job.first();
+	finish(job.second);
+	return true;
+}
+
+void JobSystem::finish(Counter* counter) {
+
+	if (counter == nullptr)
+		return;
+
+	// counted down under the counter's lock, as once it's done a waiter may destroy it as soon as the lock is free
+	std::vector<QueuedJob> dependents;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_mutex);
+		if (--counter->m_count != 0)
+			return;
+		dependents.swap(counter->m_dependents);
+	}
+
+	// the counter is done, so queue everything that was waiting on it
+	for (auto& dependent : dependents)
+		push(std::move(dependent));
+}
+
+} // namespace aie
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aie {
+
+// a pool of worker threads that run small jobs. each worker keeps its own deque of the jobs it spawns,
+// taking them back from the end it pushed them (depth first, while their data is still in cache), and
+// when it runs out steals the oldest jobs from the other workers and from the queue that threads
+// outside the pool submit to. jobs are counted by Counters, which can be waited for or made the
+// dependency of later jobs. opengl can only be used on the thread holding its context, so jobs that
+// touch it are queued separately and only run by that thread (the main thread, or the render thread
+// while the application renders on one), in runMainThreadJobs once a frame
+class JobSystem {
+public:
+
+	typedef std::function<void()> Job;
+
+	// the number of jobs run against it that haven't finished yet, and the jobs waiting on it
+	class Counter {
+	public:
+
+		Counter() : m_count(0) {}
+
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+		bool isDone() const { return m_count.load() == 0; }
+
+	private:
+
+		friend class JobSystem;
+
+		std::atomic<unsigned int>	m_count;
+		std::mutex					m_mutex;
+		std::vector<std::pair<Job, Counter*>>	m_dependents;
+	};
+
+	// a job and the counter it's counted in
+	typedef std::pair<Job, Counter*> QueuedJob;
+
+	// starts workerCount worker threads, 0 for one per hardware thread other than the calling thread,
+	// which is taken to be the main thread
+	JobSystem(unsigned int workerCount = 0);
+	// waits for the jobs that are running, dropping any still queued, so counters should be waited for first
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// the job system shared by the whole application, created and destroyed with its window
+	static JobSystem* getInstance() { return m_instance; }
+	static void create(unsigned int workerCount = 0) { m_instance = new JobSystem(workerCount); }
+	static void destroy() { delete m_instance; m_instance = nullptr; }
+
+	// runs a job on any thread, counting it in counter (if given) until it has finished. a job with a
+	// dependency isn't started until the dependency's counter is done
+	void run(Job job, Counter* counter = nullptr, Counter* dependency = nullptr);
+
+	// runs a job on the main thread, counting it in counter (if given) until it has finished
+	void runOnMainThread(Job job, Counter* counter = nullptr);
+
+	// returns once counter is done, running other jobs while it waits rather than blocking. main thread
+	// jobs are left for runMainThreadJobs, so a wait in the middle of drawing a frame can't pick up opengl
+	// work, and the main thread mustn't wait for a counter they're counted in. a counter with jobs run
+	// against it must be waited for before it is destroyed
+	void wait(Counter& counter);
+
+	// runs every main thread job queued so far, does nothing unless called on the main thread
+	void runMainThreadJobs();
+
+	// makes the calling thread the main thread, for when the opengl context moves to another thread
+	void setMainThread() { m_mainThread = std::this_thread::get_id(); }
+
+	// calls function(first, last) over slices of [0, count) of at least minimumPerJob, in parallel on
+	// jobSystem (the shared one by default), and returns once every slice is done. the first slice is run by
+	// the calling thread, which runs the whole range itself when there is no job system (such as outside the
+	// application)
+	template <typename Function>
+	static void parallelFor(size_t count, size_t minimumPerJob, const Function& function, JobSystem* jobSystem = getInstance());
+
+	// threads a parallelFor on jobSystem can split its range over, only the calling thread when there's none
+	static unsigned int getAvailableThreadCount(JobSystem* jobSystem = getInstance()) {
+		return jobSystem != nullptr ? jobSystem->getThreadCount() : 1;
+	}
+
+	// threads that run jobs: the workers in use and the thread waiting on them
+	unsigned int getThreadCount() const { return m_activeWorkers.load() + 1; }
+	unsigned int getMaxThreadCount() const { return (unsigned int)m_workers.size() + 1; }
+
+	// limits the threads running jobs to threadCount (clamped to [1, getMaxThreadCount()]), parking the
+	// rest, so the same work can be timed on fewer cores
+	void setThreadCount(unsigned int threadCount);
+
+protected:
+
+	struct Worker {
+		std::mutex				mutex;
+		std::deque<QueuedJob>	jobs;
+		std::thread				thread;
+	};
+
+	void workerLoop(unsigned int index);
+	void push(QueuedJob job);
+	bool runNextJob();
+	void finish(Counter* counter);
+
+	static JobSystem* m_instance;
+
+	std::vector<std::unique_ptr<Worker>>	m_workers;
+	std::atomic<unsigned int>	m_activeWorkers;
+
+	// jobs submitted by threads outside the pool
+	std::mutex					m_injectedMutex;
+	std::deque<QueuedJob>		m_injected;
+
+	// jobs that must run on the main thread
+	std::atomic<std::thread::id>	m_mainThread;
+	std::mutex					m_mainMutex;
+	std::deque<QueuedJob>		m_mainJobs;
+
+	// jobs queued in any deque but the main thread's, which idle workers sleep until there are some of
+	std::atomic<unsigned int>	m_queued;
+	std::mutex					m_sleepMutex;
+	std::condition_variable		m_wake;
+	bool						m_stopping;
+};
+
+template <typename Function>
+void JobSystem::parallelFor(size_t count, size_t minimumPerJob, const Function& function, JobSystem* jobSystem) {
+
+	// a few slices per thread so that threads finishing early can steal the remainder
+	unsigned int threadCount = getAvailableThreadCount(jobSystem);
+	size_t jobCount = std::min(count / std::max((size_t)1, minimumPerJob), (size_t)threadCount * 4);
+	if (jobCount <= 1 || threadCount == 1) {
+		function((size_t)0, count);
+		return;
+	}
+
+	Counter counter;
+	size_t sliceSize = (count + jobCount - 1) / jobCount;
+	for (size_t first = sliceSize; first < count; first += sliceSize) {
+		size_t last = std::min(count, first + sliceSize);
+		jobSystem->run([&function, first, last]() { function(first, last); }, &counter);
+	}
+	function((size_t)0, sliceSize);
+	jobSystem->wait(counter);
+}
+
+} // namespace aie
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+namespace aie {
+
+// a read only view of a whole file, memory mapped so the os pages it in as
+// it is read rather than it being copied in to a buffer up front
+class MappedFile {
+public:
+
+	MappedFile() {}
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// fails if the file doesn't exist or is empty, closing any file already open
+	bool open(const char* filename);
+	void close();
+
+	bool isOpen() const { return m_data != nullptr; }
+
+	const unsigned char* getData() const { return m_data; }
+	size_t getSize() const { return m_size; }
+
+protected:
+
+	const unsigned char*	m_data = nullptr;
+	size_t					m_size = 0;
+
+	// platform handles, a file and mapping handle on windows and a descriptor elsewhere
+	void*					m_file = nullptr;
+	void*					m_mapping = nullptr;
+	int						m_descriptor = -1;
+};
+
+} // namespace aie
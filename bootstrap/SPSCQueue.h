@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace aie {
+
+// a fixed size, lock-free queue between exactly one producing thread and one consuming thread.
+// the producer only writes the tail and the consumer only writes the head, so each side just
+// publishes its own index with a release store, which the other side picks up with an acquire load
+// before touching the slot it guards. capacity must be a power of two
+template <typename T, size_t CAPACITY>
+class SPSCQueue {
+public:
+
+	static_assert(CAPACITY != 0 && (CAPACITY & (CAPACITY - 1)) == 0, "SPSCQueue capacity must be a power of two");
+
+	SPSCQueue() : m_head(0), m_tail(0) {}
+
+	SPSCQueue(const SPSCQueue&) = delete;
+	SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+	// adds value to the back, returning false if the queue is full. producer only
+	bool push(const T& value) {
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == CAPACITY)
+			return false;
+		m_items[tail & (CAPACITY - 1)] = value;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// takes the value at the front, returning false if the queue is empty. consumer only
+	bool pop(T& value) {
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (m_tail.load(std::memory_order_acquire) == head)
+			return false;
+		value = m_items[head & (CAPACITY - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const { return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire); }
+
+private:
+
+	// the indices only ever increase, wrapping onto the slots, and sit on their own cache lines so
+	// the two threads don't invalidate each other's line on every push and pop
+	T					m_items[CAPACITY];
+	alignas(64) std::atomic<size_t>	m_head;
+	alignas(64) std::atomic<size_t>	m_tail;
+};
+
+} // namespace aie
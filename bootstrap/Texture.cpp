@@ -1,5 +1,6 @@
 #include "gl_core_4_4.h"
 #include "Texture.h"
+#include "GLState.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -37,66 +38,88 @@ Texture::Texture(unsigned int width, unsigned int height, Format format, unsigne
 }
 
 Texture::~Texture() {
-	if (m_glHandle != 0)
+	if (m_glHandle != 0) {
+		GLState::forgetTexture(m_glHandle);
 		glDeleteTextures(1, &m_glHandle);
+	}
 	if (m_loadedPixels != nullptr)
 		stbi_image_free(m_loadedPixels);
 }
 
 bool Texture::load(const char* filename) {
+	return decode(filename) && upload();
+}
+
+bool Texture::decode(const char* filename) {
 
 	if (m_glHandle != 0) {
+		GLState::forgetTexture(m_glHandle);
 		glDeleteTextures(1, &m_glHandle);
 		m_glHandle = 0;
-		m_width = 0;
-		m_height = 0;
-		m_filename = "none";
 	}
+	if (m_loadedPixels != nullptr) {
+		stbi_image_free(m_loadedPixels);
+		m_loadedPixels = nullptr;
+	}
+	m_width = 0;
+	m_height = 0;
+	m_filename = "none";
 
 	int x = 0, y = 0, comp = 0;
 	m_loadedPixels = stbi_load(filename, &x, &y, &comp, STBI_default);
+	if (m_loadedPixels == nullptr)
+		return false;
+
+	switch (comp) {
+	case STBI_grey:			m_format = RED;		break;
+	case STBI_grey_alpha:	m_format = RG;		break;
+	case STBI_rgb:			m_format = RGB;		break;
+	case STBI_rgb_alpha:	m_format = RGBA;	break;
+	default:				m_format = 0;		break;
+	};
+	m_width = (unsigned int)x;
+	m_height = (unsigned int)y;
+	m_filename = filename;
+	return true;
+}
 
-	if (m_loadedPixels != nullptr) {
-		glGenTextures(1, &m_glHandle);
-		glBindTexture(GL_TEXTURE_2D, m_glHandle);
-		switch (comp) {
-		case STBI_grey:
-			m_format = RED;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, x, y,
-						 0, GL_RED, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_grey_alpha:
-			m_format = RG;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, x, y,
-						 0, GL_RG, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_rgb:
-			m_format = RGB;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, x, y,
-						 0, GL_RGB, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_rgb_alpha:
-			m_format = RGBA;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y,
-						 0, GL_RGBA, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		default:	break;
-		};
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		m_width = (unsigned int)x;
-		m_height = (unsigned int)y;
-		m_filename = filename;
-		return true;
-	}
-	return false;
+bool Texture::upload() {
+
+	if (isPendingUpload() == false)
+		return false;
+
+	glGenTextures(1, &m_glHandle);
+	GLState::bindTexture(0, m_glHandle);
+	switch (m_format) {
+	case RED:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_width, m_height,
+					 0, GL_RED, GL_UNSIGNED_BYTE, m_loadedPixels);
+		break;
+	case RG:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, m_width, m_height,
+					 0, GL_RG, GL_UNSIGNED_BYTE, m_loadedPixels);
+		break;
+	case RGB:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height,
+					 0, GL_RGB, GL_UNSIGNED_BYTE, m_loadedPixels);
+		break;
+	case RGBA:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height,
+					 0, GL_RGBA, GL_UNSIGNED_BYTE, m_loadedPixels);
+		break;
+	default:	break;
+	};
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	GLState::bindTexture(0, 0);
+	return true;
 }
 
 void Texture::create(unsigned int width, unsigned int height, Format format, unsigned char* pixels) {
 
 	if (m_glHandle != 0) {
+		GLState::forgetTexture(m_glHandle);
 		glDeleteTextures(1, &m_glHandle);
 		m_glHandle = 0;
 		m_filename = "none";
@@ -107,7 +130,7 @@ void Texture::create(unsigned int width, unsigned int height, Format format, uns
 	m_format = format;
 
 	glGenTextures(1, &m_glHandle);
-	glBindTexture(GL_TEXTURE_2D, m_glHandle);
+	GLState::bindTexture(0, m_glHandle);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -130,12 +153,11 @@ void Texture::create(unsigned int width, unsigned int height, Format format, uns
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 	};
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::bindTexture(0, 0);
 }
 
 void Texture::bind(unsigned int slot) const {
-	glActiveTexture(GL_TEXTURE0 + slot);
-	glBindTexture(GL_TEXTURE_2D, m_glHandle);
+	GLState::bindTexture(slot, m_glHandle);
 }
 
 } // namespace aie
\ No newline at end of file
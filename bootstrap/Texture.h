@@ -23,6 +23,14 @@ public:
 	// load a jpg, bmp, png or tga
 	bool load(const char* filename);
 
+	// load split in two, so the image can be decoded on another thread. decode only reads the
+	// file in to pixels, and upload (which must be on the opengl thread) creates the texture
+	bool decode(const char* filename);
+	bool upload();
+
+	// whether pixels have been decoded but not uploaded yet
+	bool isPendingUpload() const { return m_glHandle == 0 && m_loadedPixels != nullptr; }
+
 	// creates a texture that can be filled in with pixels
 	void create(unsigned int width, unsigned int height, Format format, unsigned char* pixels = nullptr);
 
@@ -33,10 +33,9 @@ static int          g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;
 static int          g_AttribLocationPosition = 0, g_AttribLocationUV = 0, g_AttribLocationColor = 0;
 static unsigned int g_VboHandle = 0, g_VaoHandle = 0, g_ElementsHandle = 0;
 
-// This is the main rendering function that you have to implement and provide to ImGui (via setting up 'RenderDrawListsFn' in the ImGuiIO structure)
-// If text or lines are blurry when integrating ImGui in your engine:
-// - in your Render function, try translating your projection matrix by (0.5f,0.5f) or (0.375f,0.375f)
-void ImGui_RenderDrawLists(ImDrawData* draw_data) {
+// Renders draw data built for a display of the given size, which is passed in rather than read from io so that a
+// frame captured earlier can be rendered while imgui builds the next one
+static void ImGui_RenderDrawData(ImDrawData* draw_data, const ImVec2& display_size, const ImVec2& framebuffer_scale) {
     // Backup GL state
     GLint last_program; glGetIntegerv(GL_CURRENT_PROGRAM, &last_program);
     GLint last_texture; glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
@@ -63,18 +62,17 @@ void ImGui_RenderDrawLists(ImDrawData* draw_data) {
     glActiveTexture(GL_TEXTURE0);
 
     // Handle cases of screen coordinates != from framebuffer coordinates (e.g. retina displays)
-    ImGuiIO& io = ImGui::GetIO();
-    int fb_width = (int)(io.DisplaySize.x * io.DisplayFramebufferScale.x);
-    int fb_height = (int)(io.DisplaySize.y * io.DisplayFramebufferScale.y);
+    int fb_width = (int)(display_size.x * framebuffer_scale.x);
+    int fb_height = (int)(display_size.y * framebuffer_scale.y);
     if (fb_width == 0 || fb_height == 0)
         return;
-    draw_data->ScaleClipRects(io.DisplayFramebufferScale);
+    draw_data->ScaleClipRects(framebuffer_scale);
 
     // Setup viewport, orthographic projection matrix
     glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
     const float ortho_projection[4][4] = {
-        { 2.0f/io.DisplaySize.x, 0.0f,                   0.0f, 0.0f },
-        { 0.0f,                  2.0f/-io.DisplaySize.y, 0.0f, 0.0f },
+        { 2.0f/display_size.x,   0.0f,                   0.0f, 0.0f },
+        { 0.0f,                  2.0f/-display_size.y,   0.0f, 0.0f },
         { 0.0f,                  0.0f,                  -1.0f, 0.0f },
         {-1.0f,                  1.0f,                   0.0f, 1.0f },
     };
@@ -120,6 +118,53 @@ void ImGui_RenderDrawLists(ImDrawData* draw_data) {
     glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
 }
 
+// This is the main rendering function that you have to implement and provide to ImGui (via setting up 'RenderDrawListsFn' in the ImGuiIO structure)
+// If text or lines are blurry when integrating ImGui in your engine:
+// - in your Render function, try translating your projection matrix by (0.5f,0.5f) or (0.375f,0.375f)
+void ImGui_RenderDrawLists(ImDrawData* draw_data) {
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui_RenderDrawData(draw_data, io.DisplaySize, io.DisplayFramebufferScale);
+}
+
+ImGui_FrameDrawData::~ImGui_FrameDrawData() {
+    for (int n = 0; n < CmdLists.Size; n++)
+        delete CmdLists[n];
+}
+
+void ImGui_CaptureFrame(ImGui_FrameDrawData* frame) {
+    ImDrawData* draw_data = ImGui::GetDrawData();
+    int count = (draw_data != NULL && draw_data->Valid) ? draw_data->CmdListsCount : 0;
+
+    // The copies are kept between captures, so their buffers only grow while the UI does
+    while (frame->CmdLists.Size < count)
+        frame->CmdLists.push_back(new ImDrawList());
+
+    for (int n = 0; n < count; n++) {
+        const ImDrawList* src = draw_data->CmdLists[n];
+        ImDrawList* dst = frame->CmdLists[n];
+        dst->CmdBuffer.resize(src->CmdBuffer.Size);
+        dst->IdxBuffer.resize(src->IdxBuffer.Size);
+        dst->VtxBuffer.resize(src->VtxBuffer.Size);
+        memcpy(dst->CmdBuffer.Data, src->CmdBuffer.Data, src->CmdBuffer.Size * sizeof(ImDrawCmd));
+        memcpy(dst->IdxBuffer.Data, src->IdxBuffer.Data, src->IdxBuffer.Size * sizeof(ImDrawIdx));
+        memcpy(dst->VtxBuffer.Data, src->VtxBuffer.Data, src->VtxBuffer.Size * sizeof(ImDrawVert));
+    }
+
+    ImGuiIO& io = ImGui::GetIO();
+    frame->DrawData.Valid = count > 0;
+    frame->DrawData.CmdLists = frame->CmdLists.Data;
+    frame->DrawData.CmdListsCount = count;
+    frame->DrawData.TotalVtxCount = count > 0 ? draw_data->TotalVtxCount : 0;
+    frame->DrawData.TotalIdxCount = count > 0 ? draw_data->TotalIdxCount : 0;
+    frame->DisplaySize = io.DisplaySize;
+    frame->DisplayFramebufferScale = io.DisplayFramebufferScale;
+}
+
+void ImGui_RenderFrame(ImGui_FrameDrawData* frame) {
+    if (frame->DrawData.Valid)
+        ImGui_RenderDrawData(&frame->DrawData, frame->DisplaySize, frame->DisplayFramebufferScale);
+}
+
 static const char* ImGui_GetClipboardText() {
     return glfwGetClipboardString(g_Window);
 }
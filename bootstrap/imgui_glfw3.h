@@ -1,3 +1,5 @@
+#pragma once
+
 // ImGui GLFW binding with OpenGL3 + shaders
 // You can copy and use unmodified imgui_impl_* files in your project. See main.cpp for an example of using this.
 // If you use this binding you'll need to call 4 functions: ImGui_ImplXXXX_Init(), ImGui_ImplXXXX_NewFrame(), ImGui::Render() and ImGui_ImplXXXX_Shutdown().
@@ -14,6 +16,26 @@ IMGUI_API bool        ImGui_Init(GLFWwindow* window, bool install_callbacks);
 IMGUI_API void        ImGui_Shutdown();
 IMGUI_API void        ImGui_NewFrame();
 
+// A copy of one frame's draw lists, which stays valid once ImGui moves on to the next frame, so that the frame can be
+// rendered later on whichever thread owns the GL context. Capture it after ImGui::Render() with io.RenderDrawListsFn
+// set to NULL. User callbacks are called with the copied list as their parent.
+struct ImGui_FrameDrawData {
+    ImGui_FrameDrawData() {}
+    ~ImGui_FrameDrawData();
+
+    ImVector<ImDrawList*>   CmdLists;                   // Copies of the frame's lists, kept allocated between captures
+    ImDrawData              DrawData;                   // Points into CmdLists
+    ImVec2                  DisplaySize;
+    ImVec2                  DisplayFramebufferScale;
+
+private:
+    ImGui_FrameDrawData(const ImGui_FrameDrawData&);
+    ImGui_FrameDrawData& operator=(const ImGui_FrameDrawData&);
+};
+
+IMGUI_API void        ImGui_CaptureFrame(ImGui_FrameDrawData* frame);
+IMGUI_API void        ImGui_RenderFrame(ImGui_FrameDrawData* frame);
+
 // Use if you want to reset your rendering device without losing ImGui state.
 IMGUI_API void        ImGui_InvalidateDeviceObjects();
 IMGUI_API bool        ImGui_CreateDeviceObjects();